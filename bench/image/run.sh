@@ -0,0 +1,17 @@
+#! /usr/bin/env bash
+
+bin_dir=../../build/bin
+out_dir=out
+out_file="${out_dir}/$(git rev-parse HEAD)".csv
+
+width=3840
+height=2160
+n_repeats=20
+sigma=1.6
+
+mkdir -p "${out_dir}"
+
+>&2 printf "running image benchmark on %dx%d images\n" ${width} ${height}
+
+${bin_dir}/nx-image-benchmark --width ${width} --height ${height} \
+          --n-repeats ${n_repeats} --sigma ${sigma} | tee "${out_file}"
@@ -49,6 +49,14 @@ void *nx_xaligned_alloc(size_t alignment, size_t sz);
 
 void nx_free(void *ptr);
 
+/**
+ * Rounds sz up to the next multiple of alignment.
+ */
+static inline size_t nx_align_size(size_t sz, size_t alignment)
+{
+        return ((sz + alignment - 1) / alignment) * alignment;
+}
+
 #define NX_NEW(n,type) ((type *)nx_xmalloc((n) * sizeof(type)))
 #define NX_NEW_B(n)    NX_NEW((n),NXBool)
 #define NX_NEW_C(n)    NX_NEW((n),char)
@@ -0,0 +1,107 @@
+/**
+ * @file nx_alloc_stats.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_ALLOC_STATS_H
+#define VIRG_NEXUS_NX_ALLOC_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "virg/nexus/nx_config.h"
+#include "virg/nexus/nx_types.h"
+
+__NX_BEGIN_DECL
+
+/**
+ * Allocation accounting for the nx_alloc functions. Counting is compiled in
+ * only when the library is configured with VIRG_NEXUS_ALLOC_STATS, otherwise
+ * all statistics stay at zero and the tag macros compile to nothing.
+ *
+ * Allocations can be attributed to a call-site tag by bracketing them with
+ * NX_ALLOC_TAG_PUSH("sift.levels") and NX_ALLOC_TAG_POP(). Tags nest per
+ * thread, allocations are counted under the innermost tag.
+ */
+#define NX_ALLOC_STATS_MAX_TAGS 64
+#define NX_ALLOC_STATS_MAX_TAG_DEPTH 16
+
+struct NXJSONNode;
+
+struct NXAllocStats
+{
+        int64_t live_bytes;
+        int64_t peak_bytes;
+        uint64_t n_allocs;
+        uint64_t n_reallocs;
+        uint64_t n_frees;
+};
+
+struct NXAllocTagStats
+{
+        const char *tag;
+        uint64_t n_allocs;
+        uint64_t n_bytes;
+};
+
+NXBool nx_alloc_stats_enabled();
+
+void nx_alloc_stats_get(struct NXAllocStats *stats);
+
+/**
+ * Copies statistics of at most max_n_tags tags and returns the number of tags
+ * copied.
+ */
+int nx_alloc_stats_get_tags(int max_n_tags, struct NXAllocTagStats *tag_stats);
+
+/**
+ * Sets the peak to the current number of live bytes.
+ */
+void nx_alloc_stats_reset_peak();
+
+/**
+ * Returns a JSON object with global and per tag statistics, must be freed by
+ * nx_json_tree_free().
+ */
+struct NXJSONNode *nx_alloc_stats_to_json();
+
+void nx_alloc_stats_fprint(FILE *stream);
+
+#if (NX_ALLOC_STATS)
+void nx_alloc_stats_push_tag(const char *tag);
+void nx_alloc_stats_pop_tag();
+void nx_alloc_stats_on_alloc(void *ptr);
+void nx_alloc_stats_on_realloc(void *ptr, size_t old_sz);
+void nx_alloc_stats_on_free(void *ptr);
+size_t nx_alloc_stats_usable_size(void *ptr);
+
+#  define NX_ALLOC_TAG_PUSH(tag) nx_alloc_stats_push_tag(tag)
+#  define NX_ALLOC_TAG_POP() nx_alloc_stats_pop_tag()
+#else
+#  define NX_ALLOC_TAG_PUSH(tag) do { (void)sizeof(tag); } while (0)
+#  define NX_ALLOC_TAG_POP() do { (void)sizeof(int); } while (0)
+#endif
+
+__NX_END_DECL
+
+#endif
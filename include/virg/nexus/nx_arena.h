@@ -0,0 +1,98 @@
+/**
+ * @file nx_arena.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_ARENA_H
+#define VIRG_NEXUS_NX_ARENA_H
+
+#include <stdlib.h>
+
+#include "virg/nexus/nx_config.h"
+#include "virg/nexus/nx_types.h"
+
+__NX_BEGIN_DECL
+
+/**
+ * Scratch arena for transient buffers. Allocations bump a pointer inside the
+ * current chunk and are released together by rewinding to a mark or by
+ * resetting the arena. When a chunk overflows a new chunk is chained; once the
+ * arena is rewound to empty the chunks are merged into a single chunk large
+ * enough for the observed peak, so repeated work of the same size does not
+ * touch the heap.
+ */
+struct NXArenaChunk;
+
+struct NXArena
+{
+        struct NXArenaChunk *chunk;
+        size_t used;
+        size_t peak;
+};
+
+struct NXArenaMark
+{
+        struct NXArenaChunk *chunk;
+        size_t chunk_used;
+};
+
+#define NX_ARENA_ALIGNMENT 64
+#define NX_ARENA_DEFAULT_CAPACITY 65536
+
+struct NXArena *nx_arena_new(size_t capacity);
+
+void nx_arena_free(struct NXArena *arena);
+
+/**
+ * Returns a block of sz bytes aligned to NX_ARENA_ALIGNMENT. The memory stays
+ * valid until the arena is rewound past it or reset.
+ */
+void *nx_arena_alloc(struct NXArena *arena, size_t sz);
+
+struct NXArenaMark nx_arena_mark(const struct NXArena *arena);
+
+void nx_arena_rewind(struct NXArena *arena, struct NXArenaMark mark);
+
+void nx_arena_reset(struct NXArena *arena);
+
+size_t nx_arena_capacity(const struct NXArena *arena);
+
+/**
+ * Returns the arena of the calling thread, creating it on first use.
+ */
+struct NXArena *nx_arena_instance();
+
+/**
+ * Frees the arena of the calling thread.
+ */
+void nx_arena_instance_free();
+
+#define NX_ARENA_NEW(arena,n,type) ((type *)nx_arena_alloc((arena), (n) * sizeof(type)))
+#define NX_ARENA_NEW_UC(arena,n)   NX_ARENA_NEW((arena),(n),unsigned char)
+#define NX_ARENA_NEW_I(arena,n)    NX_ARENA_NEW((arena),(n),int)
+#define NX_ARENA_NEW_S(arena,n)    NX_ARENA_NEW((arena),(n),float)
+#define NX_ARENA_NEW_D(arena,n)    NX_ARENA_NEW((arena),(n),double)
+
+__NX_END_DECL
+
+#endif
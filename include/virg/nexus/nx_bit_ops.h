@@ -47,6 +47,16 @@ static inline uint64_t nx_rotr64(uint64_t x, uint8_t n)
         return (x >> n) | (x << (64 - n));
 }
 
+static inline uint32_t nx_rotl32(uint32_t x, uint8_t n)
+{
+        return (x << n) | (x >> (32 - n));
+}
+
+static inline uint64_t nx_rotl64(uint64_t x, uint8_t n)
+{
+        return (x << n) | (x >> (64 - n));
+}
+
 static inline void nx_split_big_endian32(uint8_t *bytep, uint32_t x) {
         bytep[0] = (uint8_t) (x >> 24);
         bytep[1] = (uint8_t) (x >> 16);
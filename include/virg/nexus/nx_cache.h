@@ -0,0 +1,99 @@
+/**
+ * @file nx_cache.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_CACHE_H
+#define VIRG_NEXUS_NX_CACHE_H
+
+#include <stdlib.h>
+
+#include "virg/nexus/nx_config.h"
+#include "virg/nexus/nx_types.h"
+
+__NX_BEGIN_DECL
+
+#define NX_CACHE_VERSION 2
+#define NX_CACHE_DEFAULT_BYTE_BUDGET ((size_t)1 << 30)
+
+/**
+ * Persistent cache of computation results in a directory, shared by the
+ * threads and processes that open the same directory.
+ *
+ * Every record is a file with a versioned header, written to a temporary file
+ * and renamed into place, so readers never see partial records. Records are
+ * listed in a memory-mapped index file that is only modified under an
+ * exclusive lock. The index tracks the last use of every record, and records
+ * are evicted least recently used first to keep the cache within its byte
+ * budget. Failing to open the cache or to write a record is not an error, the
+ * result is simply not cached.
+ */
+struct NXCache;
+
+struct NXCacheKey {
+        uint64_t h[2];
+};
+
+/**
+ * Opens the cache in dir, creating it if necessary, NULL for
+ * NX_DEFAULT_CACHE_DIRECTORY. The index is reset if it was written by a
+ * different cache version. Record files missing from the index and the
+ * temporary files of writers that have exited are removed. Returns NULL with a
+ * warning if the directory or the index cannot be created, the other functions
+ * accept the NULL cache as an empty one that stores nothing.
+ */
+struct NXCache *nx_cache_open(const char *dir, size_t byte_budget);
+
+void nx_cache_close(struct NXCache *cache);
+
+/**
+ * Returns the key of the concatenation of the messages.
+ */
+struct NXCacheKey nx_cache_key_multi(int n_msg, const uint8_t * const *msg,
+                                     const size_t *lmsg);
+
+/**
+ * Looks up the record of the given kind, a short name made of letters, digits
+ * and underscores. On a hit, the payload is returned in a buffer allocated
+ * with nx_malloc() that the caller frees. Missing, stale or damaged records
+ * are misses.
+ */
+NXBool nx_cache_get(struct NXCache *cache, struct NXCacheKey key,
+                    const char *kind, void **payload, size_t *size);
+
+/**
+ * Stores the concatenation of the payload parts as the record of the given
+ * kind and key, replacing an existing record.
+ */
+void nx_cache_put(struct NXCache *cache, struct NXCacheKey key,
+                  const char *kind, int n_parts, const void * const *parts,
+                  const size_t *lparts);
+
+/**
+ * Returns the number of records and their total size in bytes.
+ */
+void nx_cache_usage(struct NXCache *cache, int *n_records, size_t *n_bytes);
+
+__NX_END_DECL
+
+#endif
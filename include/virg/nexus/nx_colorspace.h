@@ -26,14 +26,29 @@
 #ifndef VIRG_NEXUS_NX_COLORSPACE_H
 #define VIRG_NEXUS_NX_COLORSPACE_H
 
+#include <math.h>
+
 #include "virg/nexus/nx_config.h"
 #include "virg/nexus/nx_types.h"
 
 __NX_BEGIN_DECL
 
+/**
+ * Weighted sum of the color channels. The evaluation order is fixed so that
+ * the vectorized conversions produce the same values.
+ */
+static inline float nx_rgb_to_gray_sum(float r, float g, float b)
+{
+#if (NX_SIMD_AVX2)
+        return fmaf(b, 0.11f, fmaf(r, 0.3f, g*0.59f));
+#else
+        return r*0.3f + g*0.59f + b*0.11f;
+#endif
+}
+
 static inline uchar nx_rgb_to_gray_uc(uchar r, uchar g, uchar b)
 {
-        int gray = r*0.3f + g*0.59f + b*0.11f;
+        int gray = nx_rgb_to_gray_sum(r, g, b);
 
         if (gray < 0)
                 return 0;
@@ -45,7 +60,7 @@ static inline uchar nx_rgb_to_gray_uc(uchar r, uchar g, uchar b)
 
 static inline float nx_rgb_to_gray_f32(float r, float g, float b)
 {
-        float gray = r*0.3f + g*0.59f + b*0.11f;
+        float gray = nx_rgb_to_gray_sum(r, g, b);
 
         if (gray < 0.0f)
                 return 0.0f;
@@ -67,6 +82,14 @@ void nx_convert_rgba_to_gray_f32(int width, int height, float *gray, int gray_st
 void nx_convert_gray_to_rgba_f32(int width, int height, float *rgba, int rgba_stride,
                                  const float *gray, int gray_stride);
 
+/**
+ * Converts an RGBA uchar image to a grayscale float image with values in
+ * [0,1]. The result is identical to nx_convert_rgba_to_gray_uc() followed by
+ * a division by 255, without the intermediate image.
+ */
+void nx_convert_rgba_uc_to_gray_f32(int width, int height, float *gray, int gray_stride,
+                                    const uchar *rgba, int rgba_stride);
+
 enum NXColorMap {
         NX_COLOR_MAP_GRAY = 0,
         NX_COLOR_MAP_VIRIDIS,
@@ -31,12 +31,23 @@
 #include "virg/nexus/nx_keypoint_vector.h"
 #include "virg/nexus/nx_image.h"
 #include "virg/nexus/nx_image_pyr.h"
+#include "virg/nexus/nx_image_region.h"
 
 __NX_BEGIN_DECL
 
 int nx_fast_detect_keypoints(int n_keys_max, struct NXKeypoint *keys,
                              const struct NXImage *img, int threshold);
 
+/**
+ * Detects corners of img, a level with the given scale, only within the
+ * bounds of region, the segment test is not run outside them. Corners on
+ * invalid mask pixels are dropped before they are scored.
+ */
+int nx_fast_detect_keypoints_region(int n_keys_max, struct NXKeypoint *keys,
+                                    const struct NXImage *img, int threshold,
+                                    const struct NXImageRegion *region,
+                                    float scale);
+
 void nx_fast_score_keypoints(int n_keys, struct NXKeypoint *keys,
                              const struct NXImage *img, int threshold);
 
@@ -45,6 +56,12 @@ int nx_fast_detect_keypoints_pyr(int n_keys_supp_max, struct NXKeypoint *keys_su
                                  const struct NXImagePyr *pyr, int threshold,
                                  int n_pyr_key_levels);
 
+int nx_fast_detect_keypoints_pyr_region(int n_keys_supp_max, struct NXKeypoint *keys_supp,
+                                        int n_keys_max, struct NXKeypoint *keys,
+                                        const struct NXImagePyr *pyr, int threshold,
+                                        int n_pyr_key_levels,
+                                        const struct NXImageRegion *region);
+
 int nx_fast_suppress_keypoints(int n_keys_supp_max, struct NXKeypoint *keys_supp,
                                int n_keys, const struct NXKeypoint *keys);
 
@@ -67,8 +84,14 @@ void nx_fast_detector_free(struct NXFastDetector *detector);
 
 int nx_fast_detector_detect(struct NXFastDetector *detector, int max_n_keys, struct NXKeypoint* keys, const struct NXImage *img);
 
+int nx_fast_detector_detect_region(struct NXFastDetector *detector, int max_n_keys, struct NXKeypoint* keys, const struct NXImage *img,
+                                   const struct NXImageRegion *region);
+
 int nx_fast_detector_detect_pyr(struct NXFastDetector *detector, int max_n_keys, struct NXKeypoint* keys, const struct NXImagePyr *pyr, int n_pyr_key_levels);
 
+int nx_fast_detector_detect_pyr_region(struct NXFastDetector *detector, int max_n_keys, struct NXKeypoint* keys, const struct NXImagePyr *pyr, int n_pyr_key_levels,
+                                       const struct NXImageRegion *region);
+
 void nx_fast_detector_set_ori_param(struct NXFastDetector *detector, NXBool compute_ori_p, int patch_radius);
 
 void nx_fast_detector_adapt_threshold(struct NXFastDetector *detector, int n_keys, int max_n_keys);
@@ -46,8 +46,27 @@ void nx_kernel_sym_gaussian(int n_k, float *kernel, float sigma);
 
 void nx_convolve_sym(int n, float *data, int n_k, const float *kernel);
 
+void nx_kernel_sym_quantize(int n_k, uint16_t *kernel_q, const float *kernel, int frac_bits);
+
+void nx_convolve_sym_uc_q8(int n, uint16_t *dest, const uchar *data, int step,
+                           int n_k, const uint16_t *kernel);
+
+void nx_convolve_sym_rows_q8(int n, uchar *dest, const uint16_t *const *rows,
+                             int n_k, const uint16_t *kernel);
+
+void nx_recursive_gaussian_coefficients(float sigma, float *coeffs);
+
+void nx_convolve_recursive_gaussian(int n, int n_border, float *data, int stride,
+                                    int n_lanes, const float *coeffs);
+
 void nx_convolve_box(int n, float *data, int n_r);
 
+void nx_convolve_sym_rows(int n, float *dest, const float *const *rows, int n_k, const float *kernel);
+
+void nx_filter_convert_uc_to_f32(int n, float *dest, const uchar *src);
+
+void nx_filter_convert_f32_to_uc(int n, uchar *dest, const float *src);
+
 void nx_filter_copy_to_buffer1_uc(int n, float *buffer, const uchar *data, int n_border, enum NXBorderMode mode);
 
 void nx_filter_copy_to_buffer_uc(int n, float *buffer, const uchar *data, int stride, int n_border, enum NXBorderMode mode);
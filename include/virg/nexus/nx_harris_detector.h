@@ -30,9 +30,14 @@
 #include "virg/nexus/nx_image.h"
 #include "virg/nexus/nx_image_io.h"
 #include "virg/nexus/nx_keypoint.h"
+#include "virg/nexus/nx_image_region.h"
 
 __NX_BEGIN_DECL
 
+enum NXHarrisScoreType {
+        NX_HARRIS_SCORE_HARRIS = 0,
+        NX_HARRIS_SCORE_SHI_TOMASI
+};
 
 /**
  * Calculates the derivative images I_x^2, I_y^2, and I_xI_y and convolves them
@@ -54,6 +59,37 @@ void nx_harris_deriv_images(struct NXImage **dimg, const struct NXImage *img, fl
  */
 void nx_harris_score_image(struct NXImage *simg, struct NXImage **dimg, float k);
 
+/**
+ * Calculates the cornerness score image in a single pass over img without the
+ * intermediate derivative images. Columns are processed in tiles and only the
+ * rows of the tile still needed by the Gaussian window are kept. The result
+ * is the same as nx_harris_deriv_images followed by nx_harris_score_image
+ * for window sigmas that nx_image_smooth filters with a FIR kernel.
+ *
+ * @param simg       Output cornerness score image
+ * @param img        Input image
+ * @param sigma_win  Standard deviation of the Gaussian window
+ * @param k          Harris score parameter, unused for Shi-Tomasi
+ * @param score_type Harris det-k*trace^2 or Shi-Tomasi minimum eigenvalue
+ */
+void nx_harris_compute_score_image(struct NXImage *simg,
+                                   const struct NXImage *img,
+                                   float sigma_win, float k,
+                                   enum NXHarrisScoreType score_type);
+
+/**
+ * Calculates the cornerness scores of img, a level with the given scale, only
+ * within the bounds of region and one pixel around them for the non-maxima
+ * test of nx_harris_detect_keypoints_region(). Scores there are the same as
+ * those of nx_harris_compute_score_image(), the rest of simg is set to zero.
+ */
+void nx_harris_compute_score_image_region(struct NXImage *simg,
+                                          const struct NXImage *img,
+                                          float sigma_win, float k,
+                                          enum NXHarrisScoreType score_type,
+                                          const struct NXImageRegion *region,
+                                          float scale);
+
 /**
  *
  *
@@ -67,6 +103,16 @@ void nx_harris_score_image(struct NXImage *simg, struct NXImage **dimg, float k)
 int nx_harris_detect_keypoints(int n_keys_max, struct NXKeypoint *keys,
                                const struct NXImage *simg, float threshold);
 
+/**
+ * Extracts keypoints like nx_harris_detect_keypoints() from the score image of
+ * a level with the given scale, scanning only the bounds of region and
+ * dropping maxima on invalid mask pixels.
+ */
+int nx_harris_detect_keypoints_region(int n_keys_max, struct NXKeypoint *keys,
+                                      const struct NXImage *simg, float threshold,
+                                      const struct NXImageRegion *region,
+                                      float scale);
+
 
 
 __NX_END_DECL
@@ -0,0 +1,106 @@
+/**
+ * @file nx_hash.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_HASH_H
+#define VIRG_NEXUS_NX_HASH_H
+
+#include <stdlib.h>
+
+#include "virg/nexus/nx_config.h"
+#include "virg/nexus/nx_types.h"
+
+__NX_BEGIN_DECL
+
+/**
+ * Incremental 64-bit non-cryptographic hash with the XXH64 algorithm. The
+ * result does not depend on how the input is split into updates.
+ */
+struct NXHash64State {
+        uint64_t acc[4];
+        uint64_t seed;
+        uint64_t n_total;
+        uint8_t stripe[32];
+        int n_stripe;
+};
+
+void nx_hash64_init(struct NXHash64State *state, uint64_t seed);
+void nx_hash64_update(struct NXHash64State *state, const void *data, size_t n);
+uint64_t nx_hash64_final(const struct NXHash64State *state);
+
+uint64_t nx_hash64(const void *data, size_t n, uint64_t seed);
+
+/**
+ * Hash of the concatenation of the messages, the same API as
+ * nx_sha256_multi.
+ */
+uint64_t nx_hash64_multi(int n_msg, const uint8_t * const *msg,
+                         const size_t *lmsg, uint64_t seed);
+
+#define NX_HASH3_SECRET_SIZE 192
+#define NX_HASH3_BUFFER_SIZE 256
+
+struct NXHash128 {
+        uint64_t lo;
+        uint64_t hi;
+};
+
+/**
+ * Incremental 64 and 128-bit non-cryptographic hash with the XXH3 algorithm,
+ * the values match the reference XXH3_64bits_withSeed and
+ * XXH3_128bits_withSeed. Long inputs are consumed in 64 byte stripes with
+ * AVX2 when available, a few times faster than nx_hash64 on large buffers.
+ * The result does not depend on how the input is split into updates, and
+ * both widths can be taken from the same state.
+ */
+struct NXHash3State {
+        uint64_t acc[8];
+        uint8_t secret[NX_HASH3_SECRET_SIZE];
+        uint8_t buffer[NX_HASH3_BUFFER_SIZE];
+        uint64_t seed;
+        uint64_t n_total;
+        int n_buffer;
+        int n_stripes;
+};
+
+void nx_hash3_init(struct NXHash3State *state, uint64_t seed);
+void nx_hash3_update(struct NXHash3State *state, const void *data, size_t n);
+uint64_t nx_hash3_final64(const struct NXHash3State *state);
+struct NXHash128 nx_hash3_final128(const struct NXHash3State *state);
+
+uint64_t nx_hash3_64(const void *data, size_t n, uint64_t seed);
+struct NXHash128 nx_hash3_128(const void *data, size_t n, uint64_t seed);
+
+/**
+ * Hashes of the concatenation of the messages, the same API as
+ * nx_sha256_multi.
+ */
+uint64_t nx_hash3_64_multi(int n_msg, const uint8_t * const *msg,
+                           const size_t *lmsg, uint64_t seed);
+struct NXHash128 nx_hash3_128_multi(int n_msg, const uint8_t * const *msg,
+                                    const size_t *lmsg, uint64_t seed);
+
+__NX_END_DECL
+
+#endif
@@ -30,6 +30,7 @@
 #include "virg/nexus/nx_types.h"
 #include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_colorspace.h"
+#include "virg/nexus/nx_thread_pool.h"
 
 __NX_BEGIN_DECL
 
@@ -47,6 +48,13 @@ enum NXImageDataType {
 
 static const int NX_IMAGE_STRIDE_DEFAULT = -1;
 
+/**
+ * Pads each row to a multiple of NX_SIMD_ALIGNMENT bytes. Together with the
+ * aligned image storage this makes every row start on a vector boundary and
+ * lets kernels process full vectors up to the row stride without a tail.
+ */
+static const int NX_IMAGE_STRIDE_PADDED = -2;
+
 struct NXImage
 {
         int width;
@@ -148,6 +156,25 @@ static inline int nx_image_bytes_per_channel(enum NXImageDataType dtype)
         }
 }
 
+/**
+ * Returns the row stride in elements that pads a row of the given width to a
+ * multiple of NX_SIMD_ALIGNMENT bytes.
+ */
+static inline int nx_image_padded_row_stride(int width, enum NXImageType type,
+                                             enum NXImageDataType dtype)
+{
+        int n_bytes = nx_image_bytes_per_channel(dtype);
+        int row_bytes = width * nx_image_n_channels(type) * n_bytes;
+        return ((row_bytes + NX_SIMD_ALIGNMENT - 1) / NX_SIMD_ALIGNMENT)
+                * NX_SIMD_ALIGNMENT / n_bytes;
+}
+
+/**
+ * Resizes the image. row_stride is given in elements and can also be one of
+ * NX_IMAGE_STRIDE_DEFAULT for tightly packed rows or NX_IMAGE_STRIDE_PADDED
+ * for rows padded to the SIMD alignment.
+ *
+ */
 void nx_image_resize(struct NXImage *img, int width, int height,
                      int row_stride, enum NXImageType type,
                      enum NXImageDataType dtype);
@@ -170,6 +197,15 @@ void nx_image_convert_type(struct NXImage* img, enum NXImageType type);
 
 void nx_image_convert_dtype(struct NXImage* dest, const struct NXImage *src);
 
+/**
+ * Converts src of any type and data type to a grayscale float image with
+ * values in [0,1], the input format detector front ends expect. RGBA uchar
+ * images are converted in a single pass without an intermediate gray uchar
+ * image, the values are the same as those of nx_image_convert_type()
+ * followed by nx_image_convert_dtype().
+ */
+void nx_image_convert_to_gray_f32(struct NXImage* dest, const struct NXImage *src);
+
 void nx_image_apply_colormap(struct NXImage* color, struct NXImage* gray,
                              enum NXColorMap map);
 
@@ -188,6 +224,20 @@ void nx_image_wrap(struct NXImage *img, void *data, int width, int height,
 
 void nx_image_swap(struct NXImage *img0, struct NXImage *img1);
 
+/**
+ * Splits [0, n) into consecutive chunks and runs func on them on the shared
+ * thread pool. Each item covers item_size pixels, an image row or a band of
+ * rows, and chunks are kept large enough to pay for the scheduling, so small
+ * images run in a single chunk on the calling thread. The image operators
+ * use this for their row bands.
+ */
+void nx_image_parallel_for(int n, int item_size, NXParallelForFunc func, void *arg);
+
+/**
+ * Returns the chunk length nx_image_parallel_for() uses for n items.
+ */
+int nx_image_parallel_grain(int n, int item_size);
+
 void nx_image_scale(struct NXImage *dest, const struct NXImage *src,
                     float scale_f);
 
@@ -195,31 +245,78 @@ void nx_image_downsample(struct NXImage *dest, const struct NXImage *src);
 
 void nx_image_upsample(struct NXImage *dest, const struct NXImage *src);
 
+/**
+ * Variance in source pixels of the [1 6 11 6 1] / 25 anti-aliasing kernel of
+ * the nx_image_downsample_aa functions.
+ */
+#define NX_IMAGE_DOWNSAMPLE_AA_VARIANCE 0.8f
+
 void nx_image_downsample_aa_x(struct NXImage *dest, const struct NXImage *src);
 
 void nx_image_downsample_aa_y(struct NXImage *dest, const struct NXImage *src);
 
+/**
+ * Halves both dimensions in a single pass over src with the anti-aliasing
+ * kernel of nx_image_downsample_aa_x and nx_image_downsample_aa_y, the result
+ * is the same as the two passes without the intermediate image.
+ */
+void nx_image_downsample_aa(struct NXImage *dest, const struct NXImage *src);
+
 float *nx_image_filter_buffer_alloc(int width, int height,
                                     float sigma_x, float sigma_y,
                                     float kernel_truncation_factor,
                                     int *nk_x, int *nk_y);
 
+/**
+ * Gaussian smoothing, dest may be src. Both passes run over row bands or
+ * column blocks on the shared thread pool and give the same result for any
+ * number of workers. filter_buffer is no longer used, every band allocates
+ * its own row buffer, and may be NULL.
+ */
 void nx_image_smooth(struct NXImage *dest, const struct NXImage *src,
                      float sigma_x, float sigma_y,
                      float kernel_truncation_factor, float *filter_buffer);
 
+/**
+ * Gaussian smoothing with the recursive filter, dest may be src. The right and
+ * bottom borders are approximate, see nx_convolve_recursive_gaussian, the error
+ * shrinks with kernel_truncation_factor.
+ */
+void nx_image_smooth_iir(struct NXImage *dest, const struct NXImage *src,
+                         float sigma_x, float sigma_y,
+                         float kernel_truncation_factor);
+
+void nx_image_smooth_fixed(struct NXImage *dest, const struct NXImage *src,
+                           float sigma_x, float sigma_y,
+                           float kernel_truncation_factor);
+
+void nx_image_downsample_aa_fixed(struct NXImage *dest, const struct NXImage *src);
+
+/**
+ * Box means over (2 sum_radius_x + 1) x (2 sum_radius_y + 1) pixels with
+ * repeated borders, computed from a summed area table in constant time per
+ * pixel for any radius. uchar results are truncated.
+ */
 void nx_image_filter_box_x(struct NXImage *dest, const struct NXImage *src,
-                           int sum_radius, float *filter_buffer);
+                           int sum_radius);
 void nx_image_filter_box_y(struct NXImage *dest, const struct NXImage *src,
-                           int sum_radius, float *filter_buffer);
+                           int sum_radius);
 void nx_image_filter_box(struct NXImage *dest, const struct NXImage *src,
-                         int sum_radius_x, int sum_radius_y,
-                         float *filter_buffer);
+                         int sum_radius_x, int sum_radius_y);
 
 void nx_image_deriv_x(struct NXImage *dest, const struct NXImage *src);
 
 void nx_image_deriv_y(struct NXImage *dest, const struct NXImage *src);
 
+/**
+ * Gradient magnitude and orientation images of src in a single pass, using
+ * the derivatives of nx_image_deriv_x() and nx_image_deriv_y(). Orientations
+ * are atan2(dy, dx) in [-pi, pi] with y pointing down the image, evaluated
+ * with nx_vmath_atan2f(), which stays within 2e-6 radians of libm.
+ */
+void nx_image_gradient_polar(struct NXImage *mag, struct NXImage *ori,
+                             const struct NXImage *src);
+
 __NX_END_DECL
 
 #endif
@@ -0,0 +1,87 @@
+/**
+ * @file nx_image_pool.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_IMAGE_POOL_H
+#define VIRG_NEXUS_NX_IMAGE_POOL_H
+
+#include <stdlib.h>
+
+#include "virg/nexus/nx_config.h"
+#include "virg/nexus/nx_types.h"
+
+__NX_BEGIN_DECL
+
+/**
+ * Process-wide pool of image buffers. When enabled, nx_image_resize() checks
+ * out buffers from the pool instead of allocating, and nx_image_release() and
+ * nx_image_free() return buffers to the pool instead of freeing them. Cached
+ * buffers are grouped in size classes, four per power of two, so images of the
+ * same or similar size share buffers. When the cached bytes exceed the pool
+ * capacity, least recently returned buffers are freed.
+ *
+ * The pool is disabled by default (zero capacity).
+ */
+#define NX_IMAGE_POOL_MIN_BYTES 4096
+
+struct NXImagePoolStats
+{
+        size_t n_checkouts;
+        size_t n_hits;
+        size_t n_returns;
+        size_t n_evictions;
+        size_t n_cached;
+        size_t cached_bytes;
+};
+
+/**
+ * Sets the maximum number of bytes kept in the pool. A capacity of zero
+ * disables the pool and frees all cached buffers.
+ */
+void nx_image_pool_set_capacity(size_t max_bytes);
+
+size_t nx_image_pool_capacity();
+
+NXBool nx_image_pool_is_enabled();
+
+/**
+ * Returns a buffer of at least sz bytes aligned to NX_SIMD_ALIGNMENT and stores
+ * its actual capacity in capacity. The buffer can be freed with nx_free() or
+ * given back with nx_image_pool_return().
+ */
+void *nx_image_pool_checkout(size_t sz, size_t *capacity);
+
+/**
+ * Gives a buffer of the given capacity to the pool. The buffer must be aligned
+ * to NX_SIMD_ALIGNMENT and allocated by the nx_alloc functions.
+ */
+void nx_image_pool_return(void *ptr, size_t capacity);
+
+void nx_image_pool_clear();
+
+void nx_image_pool_get_stats(struct NXImagePoolStats *stats);
+
+__NX_END_DECL
+
+#endif
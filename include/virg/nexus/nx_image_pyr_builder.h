@@ -41,6 +41,14 @@ enum NXImagePyrBuilderType {
         NX_IMAGE_PYR_BUILDER_SCALED
 };
 
+/**
+ * Arithmetic used to filter the levels.
+ */
+enum NXImagePyrEngine {
+        NX_IMAGE_PYR_ENGINE_FLOAT = 0,  /**< Filters in single precision */
+        NX_IMAGE_PYR_ENGINE_FIXED_POINT /**< Filters unsigned char levels in 16-bit fixed point */
+};
+
 struct NXImagePyrInfo {
         int n_levels;
 
@@ -55,6 +63,7 @@ struct NXImagePyrInfo {
 struct NXImagePyrBuilder
 {
         enum NXImagePyrBuilderType type;
+        enum NXImagePyrEngine engine;
         struct NXImagePyrInfo pyr_info;
         struct NXImage *work_img;
 };
@@ -75,6 +84,12 @@ void nx_image_pyr_builder_set_fine(struct NXImagePyrBuilder *builder, int n_octa
 
 void nx_image_pyr_builder_set_scaled(struct NXImagePyrBuilder *builder, int n_levels, float scale_factor, float sigma0);
 
+/**
+ * Selects the filtering arithmetic. The fixed-point engine only applies to
+ * unsigned char images, float images are always filtered in single precision.
+ */
+void nx_image_pyr_builder_set_engine(struct NXImagePyrBuilder *builder, enum NXImagePyrEngine engine);
+
 struct NXImagePyr *nx_image_pyr_builder_build0(struct NXImagePyrBuilder *builder, const struct NXImage *img);
 
 void nx_image_pyr_builder_build(struct NXImagePyrBuilder *builder, struct NXImagePyr *pyr, const struct NXImage *img);
@@ -0,0 +1,84 @@
+/**
+ * @file nx_image_region.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_IMAGE_REGION_H
+#define VIRG_NEXUS_NX_IMAGE_REGION_H
+
+#include "virg/nexus/nx_config.h"
+#include "virg/nexus/nx_types.h"
+#include "virg/nexus/nx_image.h"
+
+__NX_BEGIN_DECL
+
+/**
+ * Region of an image that detectors restrict their work to, a rectangle and an
+ * optional grayscale uchar mask in the pixel coordinates of the input image
+ * (pyramid level 0). Pixels of the rectangle with a non-zero mask value are
+ * valid. Pixel (x, y) of a pyramid level with scale s is at (x s, y s) in
+ * level 0. Functions taking a region accept NULL for the whole image.
+ */
+struct NXImageRegion {
+        int x;
+        int y;
+        int width;
+        int height;
+        const struct NXImage *mask;
+};
+
+/**
+ * Sets the rectangle and the mask of the region. The rectangle is shrunk to
+ * the bounding box of the non-zero mask pixels, so that the work done for a
+ * masked region scales with the valid area of the mask. mask is not copied
+ * and may be NULL.
+ */
+void nx_image_region_init(struct NXImageRegion *region, int x, int y,
+                          int width, int height, const struct NXImage *mask);
+
+static inline NXBool nx_image_region_is_empty(const struct NXImageRegion *region)
+{
+        return region != NULL && (region->width <= 0 || region->height <= 0);
+}
+
+/**
+ * Returns true if the level 0 point (x, y) is in the rectangle and on a valid
+ * mask pixel, the point is rounded to the nearest pixel.
+ */
+NXBool nx_image_region_contains(const struct NXImageRegion *region,
+                                float x, float y);
+
+/**
+ * Computes the bounds [x0, x1) x [y0, y1) of the pixels of a width x height
+ * level with the given scale that nx_image_region_contains() can accept,
+ * grown by margin pixels on all sides and clipped to the level. The bounds
+ * are empty, x1 <= x0 or y1 <= y0, if the region misses the level.
+ */
+void nx_image_region_level_bounds(const struct NXImageRegion *region,
+                                  float scale, int margin,
+                                  int width, int height,
+                                  int *x0, int *y0, int *x1, int *y1);
+
+__NX_END_DECL
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file nx_integral_image.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_INTEGRAL_IMAGE_H
+#define VIRG_NEXUS_NX_INTEGRAL_IMAGE_H
+
+#include <stdint.h>
+
+#include "virg/nexus/nx_config.h"
+#include "virg/nexus/nx_types.h"
+#include "virg/nexus/nx_image.h"
+
+__NX_BEGIN_DECL
+
+struct NXMemBlock;
+
+/**
+ * Summed area tables of grayscale images. Tables of uchar images hold 32-bit
+ * sums that are allowed to wrap around, box sums stay exact as long as the box
+ * sum itself fits in 32 bits. Tables of float images hold double sums.
+ *
+ * The image is extended by pad pixels on each side by repeating its borders,
+ * pixels further away count as zero.
+ */
+enum NXIntegralImageDataType {
+        NX_INTEGRAL_IMAGE_U32 = 0,
+        NX_INTEGRAL_IMAGE_F64
+};
+
+/**
+ * Upright tables hold at (i,j) the sum of padded pixels left of column i and
+ * above row j. Rotated tables index the padded image by its 45 degree rotated
+ * coordinates s = x + y and d = x - y + padded height - 1 instead, so boxes
+ * aligned with the image diagonals also cost four lookups. A rotated table
+ * has about (width + height)^2 entries.
+ */
+struct NXIntegralImage
+{
+        int width;
+        int height;
+        int pad;
+        NXBool rotated;
+        enum NXIntegralImageDataType dtype;
+
+        int n_rows;
+        int n_cols;
+        struct NXMemBlock *mem;
+        union {
+                void *v;
+                uint32_t *u32;
+                double *f64;
+        } data;
+};
+
+struct NXIntegralImage *nx_integral_image_alloc();
+
+void nx_integral_image_free(struct NXIntegralImage *ii);
+
+void nx_integral_image_compute(struct NXIntegralImage *ii,
+                               const struct NXImage *img, int pad);
+
+void nx_integral_image_compute_rotated(struct NXIntegralImage *ii,
+                                       const struct NXImage *img, int pad);
+
+/**
+ * Returns the sum of the pixels in columns x0 to x1 and rows y0 to y1
+ * inclusive.
+ */
+double nx_integral_image_box_sum(const struct NXIntegralImage *ii,
+                                 int x0, int y0, int x1, int y1);
+
+/**
+ * Returns the sum of the pixels (x + u, y + v) with |u + v| <= 2 r_diag and
+ * |u - v| <= 2 r_anti, i.e. the 45 degree rotated box centered on (x, y)
+ * that extends r_diag pixels along the (1,1) diagonal and r_anti pixels
+ * along the (1,-1) diagonal. With r_anti = 0 this is the line of 2 r_diag + 1
+ * pixels along the diagonal.
+ */
+double nx_integral_image_rotated_box_sum(const struct NXIntegralImage *ii,
+                                         int x, int y, int r_diag, int r_anti);
+
+/**
+ * Fills dest with the box means of an upright table. dest is uchar with
+ * truncated means for U32 tables and float for F64 tables. The radii can not
+ * be larger than the table padding.
+ */
+void nx_integral_image_box_filter(struct NXImage *dest,
+                                  const struct NXIntegralImage *ii,
+                                  int r_x, int r_y);
+
+/**
+ * Same as nx_integral_image_box_filter() for the rotated boxes of
+ * nx_integral_image_rotated_box_sum(). r_diag + r_anti can not be larger than
+ * the table padding.
+ */
+void nx_integral_image_rotated_box_filter(struct NXImage *dest,
+                                          const struct NXIntegralImage *ii,
+                                          int r_diag, int r_anti);
+
+__NX_END_DECL
+
+#endif
@@ -37,13 +37,26 @@ __NX_BEGIN_DECL
 #define NX_JLOG_N_STREAMS 32
 #define NX_JLOG_PRETTY_PRINT_LEVEL 1
 
+/**
+ * Returns the stream jlog_id of the calling thread. Threads log into separate
+ * trees, so NX_JLOG needs no locking.
+ */
 struct NXJSONNode *nx_json_log_get_stream(int jlog_id);
+
+/**
+ * Moves the records other threads logged to jlog_id into the stream of the
+ * calling thread and returns it. Arrays under the same key are concatenated
+ * in the order the threads first logged. The other threads must not be
+ * logging to the stream during the merge.
+ */
+struct NXJSONNode *nx_json_log_merge_stream(int jlog_id);
 void nx_json_log_clear_all();
 void nx_json_log_clear_stream(int jlog_id);
 void nx_json_log_free();
 
 #define NX_JLOG_CLEAR_ALL() nx_json_log_free()
 #define NX_JLOG_CLEAR(jlogid) nx_json_log_clear_stream(jlogid)
+#define NX_JLOG_MERGE(jlogid) nx_json_log_merge_stream(jlogid)
 #define NX_JLOG(jlogid,key,value) nx_json_object_add(nx_json_log_get_stream(jlogid), (key), (value))
 #define NX_JLOG_TEMPLATE(jlogid,key,value,jbundlefn) nx_json_object_add(nx_json_log_get_stream(jlogid), (key), jbundlefn(value))
 #define NX_JLOG_ARR_TEMPLATE(jlogid,key,n,value,jbundlefn) nx_json_object_add(nx_json_log_get_stream(jlogid), (key), jbundlefn((n),(value)))
@@ -57,17 +70,18 @@ void nx_json_log_free();
                 nx_json_array_add(_nx_jlog_arr, jbundlefn(value));      \
         } while (0);
 
-#define NX_JLOG_PRINT(jlogid) nx_json_tree_print(nx_json_log_get_stream(jlogid), NX_JLOG_PRETTY_PRINT_LEVEL)
-#define NX_JLOG_FPRINT(jlogid,stream) nx_json_tree_fprint(stream,nx_json_log_get_stream(jlogid), NX_JLOG_PRETTY_PRINT_LEVEL)
+#define NX_JLOG_PRINT(jlogid) nx_json_tree_print(nx_json_log_merge_stream(jlogid), NX_JLOG_PRETTY_PRINT_LEVEL)
+#define NX_JLOG_FPRINT(jlogid,stream) nx_json_tree_fprint(stream,nx_json_log_merge_stream(jlogid), NX_JLOG_PRETTY_PRINT_LEVEL)
 #define NX_JLOG_XWRITE(jlogid,filename)                                 \
         do {                                                            \
                 FILE *nx_jlog_stream = nx_xfopen(filename,"w");         \
-                nx_json_tree_fprint(nx_jlog_stream, nx_json_log_get_stream(jlogid), NX_JLOG_PRETTY_PRINT_LEVEL); \
+                nx_json_tree_fprint(nx_jlog_stream, nx_json_log_merge_stream(jlogid), NX_JLOG_PRETTY_PRINT_LEVEL); \
                 nx_xfclose(nx_jlog_stream, filename);                   \
         } while (0);
 #else
 #  define NX_JLOG_CLEAR_ALL() do { (void)sizeof(int); } while(0)
 #  define NX_JLOG_CLEAR(jlogid) do { (void)sizeof(jlogid); } while(0)
+#  define NX_JLOG_MERGE(jlogid) do { (void)sizeof(jlogid); } while(0)
 #  define NX_JLOG(jlogid,key,value) do { (void)sizeof(value); } while(0)
 #  define NX_JLOG_TEMPLATE(jlogid,key,value,jbundlefn) do { (void)sizeof(value); } while(0)
 #  define NX_JLOG_ARR_TEMPLATE(jlogid,key,n,value,jbundlefn) do { (void)sizeof(value); } while(0)
@@ -78,6 +78,7 @@ struct NXJSONNode *nx_json_object_get(struct NXJSONNode *jobject, const char *na
 struct NXJSONNode *nx_json_node_add_child(struct NXJSONNode *parent, struct NXJSONNode *node);
 struct NXJSONNode *nx_json_array_add(struct NXJSONNode *jarray, struct NXJSONNode *node);
 struct NXJSONNode *nx_json_object_add(struct NXJSONNode *jobject, const char *name, struct NXJSONNode *node);
+void nx_json_object_merge(struct NXJSONNode *dest, struct NXJSONNode *src);
 
 struct NXJSONNode *nx_json_array_fget(struct NXJSONNode *jarray, int position, int type);
 struct NXJSONNode *nx_json_object_fget(struct NXJSONNode *jobject, const char *name, int type);
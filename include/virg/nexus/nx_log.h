@@ -27,6 +27,8 @@
 #define VIRG_NEXUS_NX_LOG_H
 
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
 
 #include "virg/nexus/nx_config.h"
 
@@ -78,6 +80,40 @@ __NX_NO_RETURN void nx_log_fatal(const char* function_name, int line_no, const c
 
 void nx_log_verbosity (enum NXLogVerbosity verb); /**< Sets which logs get printed and which are suppressed. */
 void nx_log_fatal_func(__NX_NO_RETURN_PTR NXLogFatalFuncP fatal_func);      /**< Change the function that gets called in case of a fatal error. */
+void nx_log_stream(FILE *stream); /**< Sets the stream logs are written to, NULL restores stderr. */
+
+#define NX_LOG_ASYNC_DEFAULT_CAPACITY 4096
+#define NX_LOG_ASYNC_TAG_LENGTH 32
+#define NX_LOG_ASYNC_TEXT_LENGTH 256
+
+/**
+ * Switches logging to a background writer thread. Logging threads format
+ * their record into a slot of a bounded lock-free ring of capacity records
+ * (rounded up to a power of two) and return without touching the stream. If
+ * the ring is full the record is dropped and counted. Records are formatted
+ * into fixed size slots, tags are truncated to NX_LOG_ASYNC_TAG_LENGTH - 1 and
+ * messages to NX_LOG_ASYNC_TEXT_LENGTH - 1 characters. Fatal errors are still
+ * reported synchronously after the pending records are written.
+ */
+void nx_log_async_start(int capacity);
+
+/**
+ * Writes the pending records, stops the writer thread and returns to
+ * synchronous logging.
+ */
+void nx_log_async_stop();
+
+/**
+ * Returns once every record logged before the call has been written.
+ */
+void nx_log_async_flush();
+
+int nx_log_async_is_running();
+
+/**
+ * Number of records dropped because the ring was full since the last start.
+ */
+size_t nx_log_async_n_dropped();
 
 __NX_END_DECL
 
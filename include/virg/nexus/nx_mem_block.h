@@ -39,10 +39,18 @@ struct NXMemBlock
         size_t size;
         size_t capacity;
         NXBool own_memory;
+        size_t alignment;
 };
 
 struct NXMemBlock *nx_mem_block_alloc();
 
+/**
+ * Allocates an empty memory block whose storage is always allocated on the
+ * given alignment boundary with a capacity that is a multiple of
+ * alignment. Wrapped memory is used as is.
+ */
+struct NXMemBlock *nx_mem_block_alloc_aligned(size_t alignment);
+
 struct NXMemBlock *nx_mem_block_new(size_t init_sz);
 
 void nx_mem_block_free(struct NXMemBlock *mem);
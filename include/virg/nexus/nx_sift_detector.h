@@ -40,6 +40,7 @@
 #include "virg/nexus/nx_io.h"
 #include "virg/nexus/nx_options.h"
 #include "virg/nexus/nx_image.h"
+#include "virg/nexus/nx_image_region.h"
 #include "virg/nexus/nx_keypoint.h"
 #include "virg/nexus/nx_point_match_2d.h"
 
@@ -56,6 +57,13 @@ struct NXSIFTDetectorParams {
         float peak_threshold;
         float edge_threshold;
         int magnification_factor;
+        /* Start octaves from nx_image_downsample_aa instead of decimation */
+        NXBool downsample_aa;
+        /* Maximum number of keypoints, 0 for no limit. Peaks are selected
+         * before descriptors are computed, spread over a grid of
+         * budget_grid_size x budget_grid_size cells by their |DoG| score. */
+        int key_budget;
+        int budget_grid_size;
 };
 
 static inline struct NXSIFTDetectorParams nx_sift_default_parameters()
@@ -69,6 +77,9 @@ static inline struct NXSIFTDetectorParams nx_sift_default_parameters()
         params.peak_threshold = 0.04f;
         params.edge_threshold = 10.0f;
         params.magnification_factor = 3;
+        params.downsample_aa = NX_FALSE;
+        params.key_budget = 0;
+        params.budget_grid_size = 8;
 
         return params;
 }
@@ -82,12 +93,37 @@ struct NXSIFTDetector *nx_sift_detector_new(struct NXSIFTDetectorParams sift_par
 
 void nx_sift_detector_free(struct NXSIFTDetector *detector);
 
+/**
+ * Detects keypoints and computes their descriptors. The scale space of each
+ * octave is built one level at a time and every DoG is scanned as soon as its
+ * neighbours exist, so about nine float images of the (doubled) input size
+ * are alive at the peak, independent of n_scales_per_octave. With a key
+ * budget, the levels needed for the gradients of the selected peaks are kept
+ * until the selection, about 4/3 n_scales_per_octave more images.
+ */
 int nx_sift_detector_compute(struct NXSIFTDetector *detector,
                              struct NXImage *image,
                              int *max_n_keys,
                              struct NXKeypoint **keys,
                              uchar **desc);
 
+/**
+ * Detects keypoints like nx_sift_detector_compute() only within region. The
+ * scale space is built from the input cropped to the bounds of the region and
+ * a margin of a few tens of pixels around them, so the work scales with the
+ * region area, and only the bounds are scanned at every octave. Peaks outside
+ * the region or on invalid mask pixels are dropped before their descriptors
+ * are computed. Keypoints well inside the region are the same as those of the
+ * whole image in the first octaves, at coarse octaves the crop border and the
+ * border distance limit the keypoints near the boundary of the region.
+ */
+int nx_sift_detector_compute_region(struct NXSIFTDetector *detector,
+                                    struct NXImage *image,
+                                    const struct NXImageRegion *region,
+                                    int *max_n_keys,
+                                    struct NXKeypoint **keys,
+                                    uchar **desc);
+
 int nx_sift_detector_compute_with_cache(struct NXSIFTDetector *detector,
                                         struct NXImage *image,
                                         int *max_n_keys,
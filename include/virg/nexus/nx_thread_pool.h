@@ -0,0 +1,123 @@
+/**
+ * @file nx_thread_pool.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_THREAD_POOL_H
+#define VIRG_NEXUS_NX_THREAD_POOL_H
+
+#include <stdlib.h>
+
+#include "virg/nexus/nx_config.h"
+#include "virg/nexus/nx_types.h"
+
+__NX_BEGIN_DECL
+
+/**
+ * Pool of worker threads with one work-stealing deque per worker. Workers
+ * take tasks from the bottom of their own deque and steal from the top of the
+ * other deques when it runs dry. Threads outside the pool submit to a shared
+ * injection deque. A thread waiting on a task group executes pending tasks
+ * instead of blocking, so parallel loops can be nested.
+ */
+struct NXThreadPool;
+struct NXTaskGroup;
+
+typedef void (*NXTaskFunc)(void *arg);
+typedef void (*NXParallelForFunc)(void *arg, int begin, int end);
+typedef void (*NXParallelFor2DFunc)(void *arg, int x0, int y0, int x1, int y1);
+
+#define NX_THREAD_POOL_ENV_N_WORKERS "NX_N_WORKERS"
+
+/**
+ * Creates a pool with n_workers background threads. If n_workers is negative
+ * the default worker count is used, zero creates a pool that runs everything
+ * on the calling thread.
+ */
+struct NXThreadPool *nx_thread_pool_new(int n_workers);
+
+void nx_thread_pool_free(struct NXThreadPool *pool);
+
+int nx_thread_pool_n_workers(const struct NXThreadPool *pool);
+
+/**
+ * Returns 1..n_workers when called from a worker of any pool, 0 otherwise.
+ */
+int nx_thread_pool_worker_id();
+
+/**
+ * Default number of workers for new pools and the shared instance: the value
+ * set with nx_thread_pool_set_default_n_workers(), else the NX_N_WORKERS
+ * environment variable, else one less than the number of online processors.
+ */
+int nx_thread_pool_default_n_workers();
+
+void nx_thread_pool_set_default_n_workers(int n_workers);
+
+/**
+ * Returns the process-wide pool, creating it on first use.
+ */
+struct NXThreadPool *nx_thread_pool_instance();
+
+/**
+ * Joins the workers of the process-wide pool and frees it. The next call to
+ * nx_thread_pool_instance() creates a new pool, so this can also be used to
+ * apply a changed default worker count.
+ */
+void nx_thread_pool_instance_free();
+
+struct NXTaskGroup *nx_task_group_new(struct NXThreadPool *pool);
+
+/**
+ * Waits for the pending tasks of the group and frees it.
+ */
+void nx_task_group_free(struct NXTaskGroup *group);
+
+void nx_task_group_run(struct NXTaskGroup *group, NXTaskFunc func, void *arg);
+
+/**
+ * Returns once every task submitted to the group has finished. The calling
+ * thread executes queued tasks while it waits.
+ */
+void nx_task_group_wait(struct NXTaskGroup *group);
+
+/**
+ * Calls func on consecutive subranges of [begin, end) of at most grain
+ * elements and returns when all have finished. A grain of zero or less picks
+ * a size that gives a few chunks per thread. A NULL pool uses the shared
+ * instance.
+ */
+void nx_parallel_for(struct NXThreadPool *pool, int begin, int end, int grain,
+                     NXParallelForFunc func, void *arg);
+
+/**
+ * Calls func on the tiles of a width x height grid with tiles of at most
+ * tile_width x tile_height and returns when all have finished.
+ */
+void nx_parallel_for_2d(struct NXThreadPool *pool, int width, int height,
+                        int tile_width, int tile_height,
+                        NXParallelFor2DFunc func, void *arg);
+
+__NX_END_DECL
+
+#endif
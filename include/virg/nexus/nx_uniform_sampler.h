@@ -33,22 +33,47 @@ __NX_BEGIN_DECL
 
 struct NXUniformSampler;
 
+/**
+ * Returns the sampler of the calling thread, creating it on first use. Each
+ * thread draws from its own stream derived from the master seed, so the
+ * instance can be used concurrently without locking.
+ */
 struct NXUniformSampler *nx_uniform_sampler_instance();
 
+/**
+ * Frees the sampler of the calling thread.
+ */
 void nx_uniform_sampler_instance_free();
 
+/**
+ * Sets the master seed of the per-thread instances. Instances are reseeded on
+ * their next use and are assigned streams in the order they are used, the
+ * calling thread first. For results that do not depend on scheduling, seed a
+ * sampler per work item with nx_uniform_sampler_init_stream() instead.
+ */
+void nx_uniform_sampler_set_seed(uint32_t seed);
+
 struct NXUniformSampler *nx_uniform_sampler_alloc();
 
 struct NXUniformSampler *nx_uniform_sampler_new();
 
 struct NXUniformSampler *nx_uniform_sampler_new_with_seed(uint32_t seed);
 
+struct NXUniformSampler *nx_uniform_sampler_new_stream(uint32_t seed, uint32_t stream_id);
+
 void nx_uniform_sampler_free(struct NXUniformSampler *sampler);
 
 void nx_uniform_sampler_init_time(struct NXUniformSampler *sampler);
 
 void nx_uniform_sampler_init_seed(struct NXUniformSampler *sampler, uint32_t seed);
 
+/**
+ * Initializes the sampler to stream stream_id of seed. The generator key is
+ * expanded from (seed, stream_id) with SplitMix64, so distinct streams start
+ * from unrelated states of the generator.
+ */
+void nx_uniform_sampler_init_stream(struct NXUniformSampler *sampler, uint32_t seed, uint32_t stream_id);
+
 uint32_t nx_uniform_sampler_sample32(struct NXUniformSampler *sampler);
 
 uint64_t nx_uniform_sampler_sample64(struct NXUniformSampler *sampler);
@@ -61,6 +86,21 @@ float nx_uniform_sampler_sample_s(struct NXUniformSampler *sampler);
 
 double nx_uniform_sampler_sample_d(struct NXUniformSampler *sampler);
 
+/**
+ * Returns a uniform integer in [0, range).
+ */
+int nx_uniform_sampler_sample_index(struct NXUniformSampler *sampler, int range);
+
+/**
+ * Fills samples with n uniform floats in [0, 1).
+ */
+void nx_uniform_sampler_fill_s(struct NXUniformSampler *sampler, int n, float *samples);
+
+/**
+ * Fills ids with n distinct uniform integers in [0, range), n <= range.
+ */
+void nx_uniform_sampler_fill_index(struct NXUniformSampler *sampler, int n, int *ids, int range);
+
 #define NX_UNIFORM_SAMPLE32 (nx_uniform_sampler_sample32(nx_uniform_sampler_instance()))
 
 #define NX_UNIFORM_SAMPLE64 (nx_uniform_sampler_sample64(nx_uniform_sampler_instance()))
@@ -0,0 +1,262 @@
+/**
+ * @file nx_vmath.h
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#ifndef VIRG_NEXUS_NX_VMATH_H
+#define VIRG_NEXUS_NX_VMATH_H
+
+#include <math.h>
+#include <float.h>
+#include <stdint.h>
+
+#include "virg/nexus/nx_config.h"
+#if (NX_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+__NX_BEGIN_DECL
+
+/*
+ * Approximate single precision math for inner loops. Each function comes as an
+ * AVX2 kernel on 8 lanes (_ps), a scalar version and an array version. In AVX2
+ * builds the scalar versions run the vector kernel on a single lane, so all
+ * three give identical results. Inputs are assumed to be finite.
+ *
+ * Maximum errors measured against double precision libm:
+ *
+ *   exp     1 ulp, inputs are clamped to [-87.33, 88.37], results below
+ *           FLT_MIN are flushed to zero
+ *   atan2   2e-6 radians, results in [-pi, pi]
+ *   sqrt    correctly rounded
+ *   sincos  1e-7 absolute (2 ulp where |value| > 0.1) for |x| <= 8192,
+ *           precision degrades with the range reduction beyond that
+ */
+
+#define NX_VMATH_EXP_HI 88.3762626647949f
+#define NX_VMATH_EXP_LO -87.3365447505531f
+
+static inline float nx_vmath_expf(float x);
+static inline float nx_vmath_atan2f(float y, float x);
+static inline float nx_vmath_sqrtf(float x);
+static inline void  nx_vmath_sincosf(float x, float *s, float *c);
+
+void nx_vmath_exp   (int n, float *y, const float *x);
+void nx_vmath_atan2 (int n, float *theta, const float *y, const float *x);
+void nx_vmath_sqrt  (int n, float *y, const float *x);
+void nx_vmath_sincos(int n, float *s, float *c, const float *x);
+
+/*
+ * -----------------------------------------------------------------------------
+ *                                   Definitions
+ * -----------------------------------------------------------------------------
+ */
+#if (NX_SIMD_AVX2)
+static inline __m256 nx_vmath_exp_ps(__m256 x)
+{
+        __m256 xc = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(NX_VMATH_EXP_LO)),
+                                  _mm256_set1_ps(NX_VMATH_EXP_HI));
+
+        /* exp(x) = 2^n exp(r) with |r| <= ln(2)/2 */
+        __m256 fn = _mm256_round_ps(_mm256_mul_ps(xc, _mm256_set1_ps(1.44269504088896341f)),
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_fnmadd_ps(fn, _mm256_set1_ps(0.693359375f), xc);
+        r = _mm256_fnmadd_ps(fn, _mm256_set1_ps(-2.12194440e-4f), r);
+
+        __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(1.9875691500e-4f), r, _mm256_set1_ps(1.3981999507e-3f));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+        p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r);
+        p = _mm256_add_ps(p, _mm256_set1_ps(1.0f));
+
+        __m256i n = _mm256_add_epi32(_mm256_cvtps_epi32(fn), _mm256_set1_epi32(127));
+        __m256 y = _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(n, 23)));
+        return _mm256_andnot_ps(_mm256_cmp_ps(x, _mm256_set1_ps(NX_VMATH_EXP_LO), _CMP_LT_OQ), y);
+}
+
+static inline __m256 nx_vmath_atan2_ps(__m256 y, __m256 x)
+{
+        const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+        __m256 ax = _mm256_andnot_ps(sign_mask, x);
+        __m256 ay = _mm256_andnot_ps(sign_mask, y);
+
+        /* atan(a) for a in [0,1] as a degree 11 odd polynomial */
+        __m256 a = _mm256_div_ps(_mm256_min_ps(ax, ay),
+                                 _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(FLT_MIN)));
+        __m256 s = _mm256_mul_ps(a, a);
+        __m256 r = _mm256_fmadd_ps(_mm256_set1_ps(-0.01172120f), s, _mm256_set1_ps(0.05265332f));
+        r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(-0.11643287f));
+        r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(0.19354346f));
+        r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(-0.33262347f));
+        r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(0.99997726f));
+        r = _mm256_mul_ps(r, a);
+
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.57079632679489662f), r),
+                             _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(3.14159265358979324f), r),
+                             _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+        return _mm256_or_ps(r, _mm256_and_ps(sign_mask, y));
+}
+
+static inline __m256 nx_vmath_sqrt_ps(__m256 x)
+{
+        return _mm256_sqrt_ps(x);
+}
+
+static inline void nx_vmath_sincos_ps(__m256 x, __m256 *s, __m256 *c)
+{
+        const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+        __m256 ax = _mm256_andnot_ps(sign_mask, x);
+        __m256 sign_sin = _mm256_and_ps(sign_mask, x);
+
+        /* Reduce to |r| <= pi/4 around the nearest even multiple j of pi/4,
+         * pi/4 is split in three parts to keep the reduction exact */
+        __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(ax, _mm256_set1_ps(1.27323954473516268f)));
+        j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+        __m256 fj = _mm256_cvtepi32_ps(j);
+        __m256 r = _mm256_fnmadd_ps(fj, _mm256_set1_ps(0.78515625f), ax);
+        r = _mm256_fnmadd_ps(fj, _mm256_set1_ps(2.4187564849853515625e-4f), r);
+        r = _mm256_fnmadd_ps(fj, _mm256_set1_ps(3.77489497744594108e-8f), r);
+
+        sign_sin = _mm256_xor_ps(sign_sin, _mm256_castsi256_ps(
+                                         _mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29)));
+        __m256 sign_cos = _mm256_castsi256_ps(
+                _mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)),
+                                                      _mm256_set1_epi32(4)), 29));
+        __m256 swap = _mm256_castsi256_ps(
+                _mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(2)));
+
+        __m256 z = _mm256_mul_ps(r, r);
+        __m256 pc = _mm256_fmadd_ps(_mm256_set1_ps(2.443315711809948e-5f), z, _mm256_set1_ps(-1.388731625493765e-3f));
+        pc = _mm256_fmadd_ps(pc, z, _mm256_set1_ps(4.166664568298827e-2f));
+        pc = _mm256_mul_ps(_mm256_mul_ps(pc, z), z);
+        pc = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, pc);
+        pc = _mm256_add_ps(pc, _mm256_set1_ps(1.0f));
+
+        __m256 ps = _mm256_fmadd_ps(_mm256_set1_ps(-1.9515295891e-4f), z, _mm256_set1_ps(8.3321608736e-3f));
+        ps = _mm256_fmadd_ps(ps, z, _mm256_set1_ps(-1.6666654611e-1f));
+        ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, z), r, r);
+
+        *s = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, swap), sign_sin);
+        *c = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, swap), sign_cos);
+}
+
+static inline float nx_vmath_expf(float x)
+{
+        return _mm256_cvtss_f32(nx_vmath_exp_ps(_mm256_set1_ps(x)));
+}
+
+static inline float nx_vmath_atan2f(float y, float x)
+{
+        return _mm256_cvtss_f32(nx_vmath_atan2_ps(_mm256_set1_ps(y), _mm256_set1_ps(x)));
+}
+
+static inline void nx_vmath_sincosf(float x, float *s, float *c)
+{
+        __m256 vs, vc;
+        nx_vmath_sincos_ps(_mm256_set1_ps(x), &vs, &vc);
+        *s = _mm256_cvtss_f32(vs);
+        *c = _mm256_cvtss_f32(vc);
+}
+#else
+static inline float nx_vmath_expf(float x)
+{
+        if (x < NX_VMATH_EXP_LO)
+                return 0.0f;
+        float xc = (x > NX_VMATH_EXP_HI) ? NX_VMATH_EXP_HI : x;
+
+        float fn = rintf(xc * 1.44269504088896341f);
+        float r = xc - fn * 0.693359375f;
+        r = r - fn * -2.12194440e-4f;
+
+        float p = 1.9875691500e-4f * r + 1.3981999507e-3f;
+        p = p * r + 8.3334519073e-3f;
+        p = p * r + 4.1665795894e-2f;
+        p = p * r + 1.6666665459e-1f;
+        p = p * r + 5.0000001201e-1f;
+        p = p * (r * r) + r + 1.0f;
+
+        union { uint32_t i; float f; } pow2n = { (uint32_t)((int)fn + 127) << 23 };
+        return p * pow2n.f;
+}
+
+static inline float nx_vmath_atan2f(float y, float x)
+{
+        float ax = fabsf(x);
+        float ay = fabsf(y);
+        float mx = (ax > ay) ? ax : ay;
+        float a = ((ax < ay) ? ax : ay) / ((mx > FLT_MIN) ? mx : FLT_MIN);
+        float s = a * a;
+        float r = -0.01172120f * s + 0.05265332f;
+        r = r * s - 0.11643287f;
+        r = r * s + 0.19354346f;
+        r = r * s - 0.33262347f;
+        r = r * s + 0.99997726f;
+        r *= a;
+        if (ay > ax)
+                r = 1.57079632679489662f - r;
+        if (x < 0.0f)
+                r = 3.14159265358979324f - r;
+        return copysignf(r, y);
+}
+
+static inline void nx_vmath_sincosf(float x, float *s, float *c)
+{
+        float ax = fabsf(x);
+        int j = (int)(ax * 1.27323954473516268f);
+        j = (j + 1) & ~1;
+        float fj = (float)j;
+        float r = ax - fj * 0.78515625f;
+        r = r - fj * 2.4187564849853515625e-4f;
+        r = r - fj * 3.77489497744594108e-8f;
+
+        float z = r * r;
+        float pc = 2.443315711809948e-5f * z - 1.388731625493765e-3f;
+        pc = pc * z + 4.166664568298827e-2f;
+        pc = pc * z * z - 0.5f * z + 1.0f;
+        float ps = -1.9515295891e-4f * z + 8.3321608736e-3f;
+        ps = ps * z - 1.6666654611e-1f;
+        ps = ps * z * r + r;
+
+        int swap = (j & 2) != 0;
+        float vs = swap ? pc : ps;
+        float vc = swap ? ps : pc;
+        if (((j & 4) != 0) != (x < 0.0f))
+                vs = -vs;
+        if (((j - 2) & 4) == 0)
+                vc = -vc;
+        *s = vs;
+        *c = vc;
+}
+#endif
+
+static inline float nx_vmath_sqrtf(float x)
+{
+        return sqrtf(x);
+}
+
+__NX_END_DECL
+
+#endif
@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "virg/nexus/nx_keypoint.h"
+#include "virg/nexus/nx_harris_detector.h"
 #include "virg/nexus/vg_image.hpp"
 #include "virg/nexus/vg_image_pyr.hpp"
 
@@ -43,20 +44,28 @@ public:
         void set_sigma_win(float sigma_win);
         void set_k(float k);
         void set_threshold(float threshold);
+        void set_score_type(enum NXHarrisScoreType score_type);
+
+        // Restricts detection to the region, NULL for the whole image. The
+        // region is copied, its mask is not.
+        void set_region(const struct NXImageRegion *region);
 
         int detect(const VGImage& image, std::vector<struct NXKeypoint> &keys,
                    int max_n_keys, bool adapt_threshold);
         int detect_pyr(const VGImagePyr& pyr, std::vector<struct NXKeypoint> &keys,
                        int n_key_levels, int max_n_keys, bool adapt_threshold);
 private:
-        void update_score_image(const VGImage& image);
+        void update_score_image(const VGImage& image, float scale);
+        const struct NXImageRegion *region() const;
         float adapt_threshold(float threshold, int n_keys, int max_n_keys);
 
         float m_sigma_win;
         float m_k;
         float m_threshold;
+        enum NXHarrisScoreType m_score_type;
+        bool m_use_region;
+        struct NXImageRegion m_region;
 
-        VGImage m_dimg[3];
         VGImage m_simg;
 };
 
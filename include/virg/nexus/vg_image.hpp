@@ -46,6 +46,7 @@ public:
         enum LoadMode { LOAD_AS_IS = -1, LOAD_GRAYSCALE = 0, LOAD_RGBA };
 
         static const int STRIDE_DEFAULT = NX_IMAGE_STRIDE_DEFAULT;
+        static const int STRIDE_PADDED = NX_IMAGE_STRIDE_PADDED;
 
         VGImage();
         VGImage(struct NXImage* nx_img, bool own_memory);
@@ -34,15 +34,10 @@
 # include <smmintrin.h>
 #endif
 
-#ifdef _OPENMP
-#  include <omp.h>
-#else
-# define omp_get_thread_num() 0
-# define omp_get_max_threads() 1
-#endif
-
 #include <virg/nexus/nx_assert.h>
 #include <virg/nexus/nx_alloc.h>
+#include <virg/nexus/nx_arena.h>
+#include <virg/nexus/nx_thread_pool.h>
 #include <virg/nexus/nx_filter.h>
 #include <virg/nexus/nx_image.h>
 #include <virg/nexus/nx_math.h>
@@ -469,10 +464,18 @@ inline static void fill_inverse_transform(float* t, float cx_in, float cy_in,
         t[8] = 1.0f;
 }
 
-static void warp_buffer_affine_bilinear(const struct NXImage* in_buffer,
-                                        struct NXImage* out_buffer,
-                                        const float* t)
+struct WarpBufferJob {
+        const struct NXImage *in_buffer;
+        struct NXImage *out_buffer;
+        const float *t;
+};
+
+static void warp_buffer_affine_bilinear_rows(void *arg, int y_begin, int y_end)
 {
+        const struct WarpBufferJob *job = (const struct WarpBufferJob *)arg;
+        const struct NXImage *in_buffer = job->in_buffer;
+        struct NXImage *out_buffer = job->out_buffer;
+        const float *t = job->t;
 #ifdef USE_SSE
         const float LAST_X = in_buffer->width - 2;
         const float LAST_Y = in_buffer->height - 2;
@@ -484,10 +487,7 @@ static void warp_buffer_affine_bilinear(const struct NXImage* in_buffer,
 
         int32_t pixels[4] __attribute__ ((aligned (16)));
 
-#ifdef _OPENMP
-#pragma omp parallel for private(pixels) schedule(dynamic, 4)
-#endif
-        for (int y = 0; y < out_buffer->height; ++y) {
+        for (int y = y_begin; y < y_end; ++y) {
                 uchar *drow = out_buffer->data.uc + y*out_buffer->row_stride;
 
                 __m128 XY = _mm_add_ps(T67, _mm_mul_ps(T34, _mm_set1_ps(y)));
@@ -531,10 +531,7 @@ static void warp_buffer_affine_bilinear(const struct NXImage* in_buffer,
         const int LAST_X = in_buffer->width - 1;
         const int LAST_Y = in_buffer->height - 1;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 4)
-#endif
-        for (int y = 0; y < out_buffer->height; ++y) {
+        for (int y = y_begin; y < y_end; ++y) {
                 uchar *drow = out_buffer->data.uc + y*out_buffer->row_stride;
 
                 float xp = y*t[3] + t[6];
@@ -570,6 +567,18 @@ static void warp_buffer_affine_bilinear(const struct NXImage* in_buffer,
 #endif
 }
 
+static void warp_buffer_affine_bilinear(const struct NXImage* in_buffer,
+                                        struct NXImage* out_buffer,
+                                        const float* t)
+{
+        struct WarpBufferJob job;
+        job.in_buffer = in_buffer;
+        job.out_buffer = out_buffer;
+        job.t = t;
+        nx_parallel_for(NULL, 0, out_buffer->height, 4,
+                        warp_buffer_affine_bilinear_rows, &job);
+}
+
 void fill_warp_buffer_bg(const struct NXImage* image,
                          struct NXImage* warp_buffer,
                          float t0, float t1, float t2,
@@ -578,6 +587,7 @@ void fill_warp_buffer_bg(const struct NXImage* image,
 {
         const int LAST_X = image->width - 1;
         const int LAST_Y = image->height - 1;
+        struct NXUniformSampler *sampler = nx_uniform_sampler_instance();
 
         for (int y = 0; y < warp_buffer->height; ++y) {
                 uchar *drow = warp_buffer->data.uc + y*warp_buffer->row_stride;
@@ -610,7 +620,7 @@ void fill_warp_buffer_bg(const struct NXImage* image,
                         case NX_AWP_BG_NOISE:
                                 if (idx[0] <= 0 || idx[1] >= LAST_X
                                     || idy[0] <= 0 || idy[1] >= LAST_Y) {
-                                        drow[x] = 255.0f * NX_UNIFORM_SAMPLE_S;
+                                        drow[x] = 255.0f * nx_uniform_sampler_sample_s(sampler);
                                         continue;
                                 }
                                 break;
@@ -654,55 +664,79 @@ void fill_warp_buffer_bg(const struct NXImage* image,
         }
 }
 
-static void warp_processor_blur(struct NXImage *image,
-                                float sigma_x, float sigma_y)
+struct WarpBlurJob {
+        struct NXImage *image;
+        const float *kernel;
+        int nk;
+        int n_border;
+};
+
+static void warp_processor_blur_rows(void *arg, int y_begin, int y_end)
 {
-        const int N_THREADS = omp_get_max_threads();
-        const float KERNEL_TRUNCATION_FACTOR = 3.0f;
-        float *buffers[N_THREADS];
-        int nkx;
-        int nky;
-        for (int i = 0; i < N_THREADS; ++i)
-                buffers[i] = nx_image_filter_buffer_alloc(image->width, image->height,
-                                                          sigma_x, sigma_y,
-                                                          KERNEL_TRUNCATION_FACTOR,
-                                                          &nkx, &nky);
+        const struct WarpBlurJob *job = (const struct WarpBlurJob *)arg;
+        struct NXImage *image = job->image;
 
-        int nk_max = nx_max_i(nkx, nky);
-        int nk_sym = nk_max / 2 + 1;
-        float *kernel = NX_NEW_S(nk_sym);
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *buffer = NX_ARENA_NEW_S(arena, image->width + 2 * job->n_border);
 
-        // Smooth in x-direction
-        int nk = nkx / 2 + 1;
-        nx_kernel_sym_gaussian(nk, kernel, sigma_x);
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 4)
-#endif
-        for (int y = 0; y < image->height; ++y) {
-                float *buffer = buffers[omp_get_thread_num()];
+        for (int y = y_begin; y < y_end; ++y) {
                 uchar *image_row = image->data.uc + y * image->row_stride;
-                nx_filter_copy_to_buffer1_uc(image->width, buffer, image_row, nkx / 2, NX_BORDER_MIRROR);
-                nx_convolve_sym(image->width, buffer, nk, kernel);
+                nx_filter_copy_to_buffer1_uc(image->width, buffer, image_row, job->n_border, NX_BORDER_MIRROR);
+                nx_convolve_sym(image->width, buffer, job->nk, job->kernel);
                 for (int x = 0; x < image->width; ++x)
                         image_row[x] = (uchar)buffer[x];
         }
 
-        // Smooth in y-direction
-        nk = nky / 2 + 1;
-        nx_kernel_sym_gaussian(nk, kernel, sigma_y);
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 4)
-#endif
-        for (int x = 0; x < image->width; ++x) {
-                float *buffer = buffers[omp_get_thread_num()];
+        nx_arena_rewind(arena, mark);
+}
+
+static void warp_processor_blur_cols(void *arg, int x_begin, int x_end)
+{
+        const struct WarpBlurJob *job = (const struct WarpBlurJob *)arg;
+        struct NXImage *image = job->image;
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *buffer = NX_ARENA_NEW_S(arena, image->height + 2 * job->n_border);
+
+        for (int x = x_begin; x < x_end; ++x) {
                 uchar *image_col = image->data.uc + x;
-                nx_filter_copy_to_buffer_uc(image->height, buffer, image_col, image->row_stride, nky / 2, NX_BORDER_MIRROR);
-                nx_convolve_sym(image->height, buffer, nk, kernel);
+                nx_filter_copy_to_buffer_uc(image->height, buffer, image_col, image->row_stride, job->n_border, NX_BORDER_MIRROR);
+                nx_convolve_sym(image->height, buffer, job->nk, job->kernel);
                 for (int y = 0; y < image->height; ++y)
                         image_col[y*image->row_stride] = (uchar)buffer[y];
         }
 
+        nx_arena_rewind(arena, mark);
+}
+
+static void warp_processor_blur(struct NXImage *image,
+                                float sigma_x, float sigma_y)
+{
+        const float KERNEL_TRUNCATION_FACTOR = 3.0f;
+        int nkx = nx_kernel_size_gaussian(sigma_x, KERNEL_TRUNCATION_FACTOR);
+        int nky = nx_kernel_size_gaussian(sigma_y, KERNEL_TRUNCATION_FACTOR);
+
+        int nk_max = nx_max_i(nkx, nky);
+        int nk_sym = nk_max / 2 + 1;
+        float *kernel = NX_NEW_S(nk_sym);
+
+        struct WarpBlurJob job;
+        job.image = image;
+        job.kernel = kernel;
+
+        // Smooth in x-direction
+        job.nk = nkx / 2 + 1;
+        job.n_border = nkx / 2;
+        nx_kernel_sym_gaussian(job.nk, kernel, sigma_x);
+        nx_parallel_for(NULL, 0, image->height, 4, warp_processor_blur_rows, &job);
+
+        // Smooth in y-direction
+        job.nk = nky / 2 + 1;
+        job.n_border = nky / 2;
+        nx_kernel_sym_gaussian(job.nk, kernel, sigma_y);
+        nx_parallel_for(NULL, 0, image->width, 4, warp_processor_blur_cols, &job);
+
         nx_free(kernel);
-        for (int i = 0; i < N_THREADS; ++i)
-                nx_free(buffers[i]);
 }
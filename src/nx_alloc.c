@@ -30,6 +30,19 @@
 
 #include "virg/nexus/nx_log.h"
 #include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_alloc_stats.h"
+
+#if (NX_ALLOC_STATS)
+#  define NX_ALLOC_STATS_ON_ALLOC(ptr) nx_alloc_stats_on_alloc(ptr)
+#  define NX_ALLOC_STATS_ON_REALLOC(ptr,old_sz) nx_alloc_stats_on_realloc((ptr),(old_sz))
+#  define NX_ALLOC_STATS_ON_FREE(ptr) nx_alloc_stats_on_free(ptr)
+#  define NX_ALLOC_STATS_USABLE_SIZE(ptr) nx_alloc_stats_usable_size(ptr)
+#else
+#  define NX_ALLOC_STATS_ON_ALLOC(ptr) do { (void)sizeof(ptr); } while (0)
+#  define NX_ALLOC_STATS_ON_REALLOC(ptr,old_sz) do { (void)sizeof(ptr); (void)sizeof(old_sz); } while (0)
+#  define NX_ALLOC_STATS_ON_FREE(ptr) do { (void)sizeof(ptr); } while (0)
+#  define NX_ALLOC_STATS_USABLE_SIZE(ptr) 0
+#endif
 
 void *nx_aligned_alloc(size_t alignment, size_t sz)
 {
@@ -41,6 +54,7 @@ void *nx_aligned_alloc(size_t alignment, size_t sz)
                 NX_ERROR(NX_LOG_TAG, "Error allocating %zd bytes, out of memory!", sz);
                 return NULL;
         } else {
+                NX_ALLOC_STATS_ON_ALLOC(ptr);
                 return ptr;
         }
 }
@@ -54,6 +68,7 @@ void *nx_xaligned_alloc(size_t alignment, size_t sz)
         if (!ptr) {
                 NX_FATAL(NX_LOG_TAG, "Error allocating %zd bytes, out of memory!", sz);
         } else {
+                NX_ALLOC_STATS_ON_ALLOC(ptr);
                 return ptr;
         }
 }
@@ -67,6 +82,7 @@ void *nx_malloc(size_t sz)
                 return NULL;
         }
 
+        NX_ALLOC_STATS_ON_ALLOC(ptr);
         return ptr;
 }
 
@@ -89,6 +105,7 @@ void *nx_xmalloc(size_t sz)
                 NX_FATAL(NX_LOG_TAG, "Error allocating %zd bytes, out of memory!", sz);
                 return NULL;
         } else {
+                NX_ALLOC_STATS_ON_ALLOC(ptr);
                 return ptr;
         }
 }
@@ -104,14 +121,17 @@ void *nx_xcalloc(size_t n_memb, size_t sz)
 
 void *nx_xrealloc(void *ptr, size_t sz)
 {
+        size_t old_sz = NX_ALLOC_STATS_USABLE_SIZE(ptr);
         void *res_ptr = realloc(ptr, sz);
         if (sz != 0 && !res_ptr)
                 NX_FATAL(NX_LOG_TAG, "Error reallocating %zd bytes, out of memory!", sz);
+        NX_ALLOC_STATS_ON_REALLOC(res_ptr, old_sz);
 
         return res_ptr;
 }
 
 void nx_free(void *ptr)
 {
+        NX_ALLOC_STATS_ON_FREE(ptr);
         free(ptr);
 }
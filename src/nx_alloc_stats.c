@@ -0,0 +1,261 @@
+/**
+ * @file nx_alloc_stats.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_alloc_stats.h"
+
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <malloc.h>
+
+#include "virg/nexus/nx_log.h"
+#include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_json_tree.h"
+#include "virg/nexus/nx_json_bundle.h"
+
+#if (NX_ALLOC_STATS)
+
+struct NXAllocTagCounter
+{
+        const char *tag;
+        atomic_uint_fast64_t n_allocs;
+        atomic_uint_fast64_t n_bytes;
+};
+
+static atomic_int_fast64_t nx_s_live_bytes = 0;
+static atomic_int_fast64_t nx_s_peak_bytes = 0;
+static atomic_uint_fast64_t nx_s_n_allocs = 0;
+static atomic_uint_fast64_t nx_s_n_reallocs = 0;
+static atomic_uint_fast64_t nx_s_n_frees = 0;
+
+static pthread_mutex_t nx_s_tag_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct NXAllocTagCounter nx_s_tags[NX_ALLOC_STATS_MAX_TAGS];
+static atomic_int nx_s_n_tags = 0;
+
+static _Thread_local int nx_s_tag_stack[NX_ALLOC_STATS_MAX_TAG_DEPTH];
+static _Thread_local int nx_s_tag_depth = 0;
+
+static int nx_alloc_stats_find_tag(const char *tag)
+{
+        int n_tags = atomic_load(&nx_s_n_tags);
+        for (int i = 0; i < n_tags; ++i)
+                if (nx_s_tags[i].tag == tag || strcmp(nx_s_tags[i].tag, tag) == 0)
+                        return i;
+
+        pthread_mutex_lock(&nx_s_tag_mutex);
+        n_tags = atomic_load(&nx_s_n_tags);
+        int id = -1;
+        for (int i = 0; i < n_tags && id < 0; ++i)
+                if (strcmp(nx_s_tags[i].tag, tag) == 0)
+                        id = i;
+        if (id < 0 && n_tags < NX_ALLOC_STATS_MAX_TAGS) {
+                id = n_tags;
+                nx_s_tags[id].tag = tag;
+                atomic_init(&nx_s_tags[id].n_allocs, 0);
+                atomic_init(&nx_s_tags[id].n_bytes, 0);
+                atomic_store(&nx_s_n_tags, n_tags + 1);
+        }
+        pthread_mutex_unlock(&nx_s_tag_mutex);
+
+        return id;
+}
+
+void nx_alloc_stats_push_tag(const char *tag)
+{
+        if (nx_s_tag_depth >= NX_ALLOC_STATS_MAX_TAG_DEPTH)
+                NX_FATAL(NX_LOG_TAG, "Allocation tags are nested deeper than %d!",
+                         NX_ALLOC_STATS_MAX_TAG_DEPTH);
+
+        nx_s_tag_stack[nx_s_tag_depth++] = nx_alloc_stats_find_tag(tag);
+}
+
+void nx_alloc_stats_pop_tag()
+{
+        if (nx_s_tag_depth <= 0)
+                NX_FATAL(NX_LOG_TAG, "Allocation tag stack underflow!");
+
+        --nx_s_tag_depth;
+}
+
+size_t nx_alloc_stats_usable_size(void *ptr)
+{
+        return ptr ? malloc_usable_size(ptr) : 0;
+}
+
+static void nx_alloc_stats_add_live(int64_t delta)
+{
+        int64_t live = atomic_fetch_add(&nx_s_live_bytes, delta) + delta;
+        int64_t peak = atomic_load(&nx_s_peak_bytes);
+        while (live > peak
+               && !atomic_compare_exchange_weak(&nx_s_peak_bytes, &peak, live))
+                ;
+}
+
+static void nx_alloc_stats_count_tag(size_t sz)
+{
+        if (nx_s_tag_depth > 0) {
+                int id = nx_s_tag_stack[nx_s_tag_depth - 1];
+                if (id >= 0) {
+                        atomic_fetch_add(&nx_s_tags[id].n_allocs, 1);
+                        atomic_fetch_add(&nx_s_tags[id].n_bytes, sz);
+                }
+        }
+}
+
+void nx_alloc_stats_on_alloc(void *ptr)
+{
+        if (!ptr)
+                return;
+
+        size_t sz = nx_alloc_stats_usable_size(ptr);
+        atomic_fetch_add(&nx_s_n_allocs, 1);
+        nx_alloc_stats_add_live((int64_t)sz);
+        nx_alloc_stats_count_tag(sz);
+}
+
+void nx_alloc_stats_on_realloc(void *ptr, size_t old_sz)
+{
+        if (!ptr) {
+                if (old_sz > 0) {
+                        atomic_fetch_add(&nx_s_n_frees, 1);
+                        atomic_fetch_sub(&nx_s_live_bytes, (int64_t)old_sz);
+                }
+                return;
+        }
+
+        size_t sz = nx_alloc_stats_usable_size(ptr);
+        atomic_fetch_add(&nx_s_n_reallocs, 1);
+        nx_alloc_stats_add_live((int64_t)sz - (int64_t)old_sz);
+        if (sz > old_sz)
+                nx_alloc_stats_count_tag(sz - old_sz);
+}
+
+void nx_alloc_stats_on_free(void *ptr)
+{
+        if (!ptr)
+                return;
+
+        atomic_fetch_add(&nx_s_n_frees, 1);
+        atomic_fetch_sub(&nx_s_live_bytes, (int64_t)nx_alloc_stats_usable_size(ptr));
+}
+
+NXBool nx_alloc_stats_enabled()
+{
+        return NX_TRUE;
+}
+
+void nx_alloc_stats_get(struct NXAllocStats *stats)
+{
+        NX_ASSERT_PTR(stats);
+
+        stats->live_bytes = atomic_load(&nx_s_live_bytes);
+        stats->peak_bytes = atomic_load(&nx_s_peak_bytes);
+        stats->n_allocs = atomic_load(&nx_s_n_allocs);
+        stats->n_reallocs = atomic_load(&nx_s_n_reallocs);
+        stats->n_frees = atomic_load(&nx_s_n_frees);
+}
+
+int nx_alloc_stats_get_tags(int max_n_tags, struct NXAllocTagStats *tag_stats)
+{
+        int n_tags = atomic_load(&nx_s_n_tags);
+        if (n_tags > max_n_tags)
+                n_tags = max_n_tags;
+
+        for (int i = 0; i < n_tags; ++i) {
+                tag_stats[i].tag = nx_s_tags[i].tag;
+                tag_stats[i].n_allocs = atomic_load(&nx_s_tags[i].n_allocs);
+                tag_stats[i].n_bytes = atomic_load(&nx_s_tags[i].n_bytes);
+        }
+
+        return n_tags;
+}
+
+void nx_alloc_stats_reset_peak()
+{
+        atomic_store(&nx_s_peak_bytes, atomic_load(&nx_s_live_bytes));
+}
+
+#else
+
+NXBool nx_alloc_stats_enabled()
+{
+        return NX_FALSE;
+}
+
+void nx_alloc_stats_get(struct NXAllocStats *stats)
+{
+        NX_ASSERT_PTR(stats);
+
+        memset(stats, 0, sizeof(*stats));
+}
+
+int nx_alloc_stats_get_tags(int max_n_tags, struct NXAllocTagStats *tag_stats)
+{
+        (void)max_n_tags;
+        (void)tag_stats;
+
+        return 0;
+}
+
+void nx_alloc_stats_reset_peak()
+{
+}
+
+#endif
+
+struct NXJSONNode *nx_alloc_stats_to_json()
+{
+        struct NXAllocStats stats;
+        nx_alloc_stats_get(&stats);
+
+        struct NXAllocTagStats tag_stats[NX_ALLOC_STATS_MAX_TAGS];
+        int n_tags = nx_alloc_stats_get_tags(NX_ALLOC_STATS_MAX_TAGS, &tag_stats[0]);
+
+        struct NXJSONNode *root = nx_json_node_new_object();
+        nx_json_object_add(root, "enabled", nx_json_bundle_bool(nx_alloc_stats_enabled()));
+        nx_json_object_add(root, "live_bytes", nx_json_bundle_size_t((size_t)stats.live_bytes));
+        nx_json_object_add(root, "peak_bytes", nx_json_bundle_size_t((size_t)stats.peak_bytes));
+        nx_json_object_add(root, "n_allocs", nx_json_bundle_size_t(stats.n_allocs));
+        nx_json_object_add(root, "n_reallocs", nx_json_bundle_size_t(stats.n_reallocs));
+        nx_json_object_add(root, "n_frees", nx_json_bundle_size_t(stats.n_frees));
+
+        struct NXJSONNode *jtags = nx_json_node_new_object();
+        for (int i = 0; i < n_tags; ++i) {
+                struct NXJSONNode *jtag = nx_json_node_new_object();
+                nx_json_object_add(jtag, "n_allocs", nx_json_bundle_size_t(tag_stats[i].n_allocs));
+                nx_json_object_add(jtag, "n_bytes", nx_json_bundle_size_t(tag_stats[i].n_bytes));
+                nx_json_object_add(jtags, tag_stats[i].tag, jtag);
+        }
+        nx_json_object_add(root, "tags", jtags);
+
+        return root;
+}
+
+void nx_alloc_stats_fprint(FILE *stream)
+{
+        struct NXJSONNode *root = nx_alloc_stats_to_json();
+        nx_json_tree_fprint(stream, root, 1);
+        nx_json_tree_free(root);
+}
@@ -0,0 +1,187 @@
+/**
+ * @file nx_arena.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_arena.h"
+
+#include <string.h>
+
+#include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_alloc.h"
+
+struct NXArenaChunk
+{
+        struct NXArenaChunk *prev;
+        char *data;
+        size_t capacity;
+        size_t used;
+};
+
+static _Thread_local struct NXArena *nx_s_arena = NULL;
+
+static struct NXArenaChunk *nx_arena_chunk_new(struct NXArenaChunk *prev, size_t capacity)
+{
+        struct NXArenaChunk *chunk = NX_NEW(1, struct NXArenaChunk);
+
+        chunk->prev = prev;
+        chunk->capacity = nx_align_size(capacity, NX_ARENA_ALIGNMENT);
+        chunk->data = nx_xaligned_alloc(NX_ARENA_ALIGNMENT, chunk->capacity);
+        chunk->used = 0;
+
+        return chunk;
+}
+
+static struct NXArenaChunk *nx_arena_chunk_free(struct NXArenaChunk *chunk)
+{
+        struct NXArenaChunk *prev = chunk->prev;
+
+        nx_free(chunk->data);
+        nx_free(chunk);
+
+        return prev;
+}
+
+struct NXArena *nx_arena_new(size_t capacity)
+{
+        NX_ASSERT(capacity > 0);
+
+        struct NXArena *arena = NX_NEW(1, struct NXArena);
+
+        arena->chunk = nx_arena_chunk_new(NULL, capacity);
+        arena->used = 0;
+        arena->peak = 0;
+
+        return arena;
+}
+
+void nx_arena_free(struct NXArena *arena)
+{
+        if (arena) {
+                struct NXArenaChunk *chunk = arena->chunk;
+                while (chunk)
+                        chunk = nx_arena_chunk_free(chunk);
+                nx_free(arena);
+        }
+}
+
+void *nx_arena_alloc(struct NXArena *arena, size_t sz)
+{
+        NX_ASSERT_PTR(arena);
+
+        sz = nx_align_size(sz > 0 ? sz : 1, NX_ARENA_ALIGNMENT);
+
+        struct NXArenaChunk *chunk = arena->chunk;
+        if (chunk->capacity - chunk->used < sz) {
+                size_t capacity = 2 * chunk->capacity;
+                if (capacity < sz)
+                        capacity = sz;
+                chunk = nx_arena_chunk_new(chunk, capacity);
+                arena->chunk = chunk;
+        }
+
+        void *ptr = chunk->data + chunk->used;
+        chunk->used += sz;
+
+        arena->used += sz;
+        if (arena->used > arena->peak)
+                arena->peak = arena->used;
+
+        return ptr;
+}
+
+struct NXArenaMark nx_arena_mark(const struct NXArena *arena)
+{
+        NX_ASSERT_PTR(arena);
+
+        struct NXArenaMark mark;
+        mark.chunk = arena->chunk;
+        mark.chunk_used = arena->chunk->used;
+
+        return mark;
+}
+
+void nx_arena_rewind(struct NXArena *arena, struct NXArenaMark mark)
+{
+        NX_ASSERT_PTR(arena);
+        NX_ASSERT_PTR(mark.chunk);
+
+        while (arena->chunk != mark.chunk) {
+                NX_ASSERT_PTR(arena->chunk->prev);
+                arena->used -= arena->chunk->used;
+                arena->chunk = nx_arena_chunk_free(arena->chunk);
+        }
+
+        NX_ASSERT(mark.chunk_used <= arena->chunk->used);
+        arena->used -= arena->chunk->used - mark.chunk_used;
+        arena->chunk->used = mark.chunk_used;
+
+        /* Grow the base chunk to cover the peak once nothing is live. The
+         * chunk itself is kept so that outstanding marks stay valid. */
+        if (arena->used == 0 && arena->chunk->capacity < arena->peak) {
+                struct NXArenaChunk *chunk = arena->chunk;
+                NX_ASSERT(chunk->prev == NULL);
+                nx_free(chunk->data);
+                chunk->capacity = nx_align_size(arena->peak, NX_ARENA_ALIGNMENT);
+                chunk->data = nx_xaligned_alloc(NX_ARENA_ALIGNMENT, chunk->capacity);
+        }
+}
+
+void nx_arena_reset(struct NXArena *arena)
+{
+        NX_ASSERT_PTR(arena);
+
+        struct NXArenaChunk *chunk = arena->chunk;
+        while (chunk->prev)
+                chunk = chunk->prev;
+
+        struct NXArenaMark mark;
+        mark.chunk = chunk;
+        mark.chunk_used = 0;
+        nx_arena_rewind(arena, mark);
+}
+
+size_t nx_arena_capacity(const struct NXArena *arena)
+{
+        NX_ASSERT_PTR(arena);
+
+        size_t capacity = 0;
+        for (const struct NXArenaChunk *chunk = arena->chunk; chunk; chunk = chunk->prev)
+                capacity += chunk->capacity;
+
+        return capacity;
+}
+
+struct NXArena *nx_arena_instance()
+{
+        if (nx_s_arena == NULL)
+                nx_s_arena = nx_arena_new(NX_ARENA_DEFAULT_CAPACITY);
+
+        return nx_s_arena;
+}
+
+void nx_arena_instance_free()
+{
+        nx_arena_free(nx_s_arena);
+        nx_s_arena = NULL;
+}
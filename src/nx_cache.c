@@ -0,0 +1,595 @@
+/**
+ * @file nx_cache.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_log.h"
+#include "virg/nexus/nx_io.h"
+#include "virg/nexus/nx_string.h"
+#include "virg/nexus/nx_hash.h"
+
+#define NX_CACHE_N_SLOTS 4096
+#define NX_CACHE_MAX_LOAD_NUM 3
+#define NX_CACHE_MAX_LOAD_DEN 4
+#define NX_CACHE_KIND_MAX_LENGTH 32
+
+static const char NX_CACHE_INDEX_MAGIC[8] = "NXCINDX";
+static const char NX_CACHE_RECORD_MAGIC[8] = "NXCRECD";
+
+struct NXCacheIndexHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t n_slots;
+        uint64_t n_records;
+        uint64_t n_bytes;
+        uint64_t tick;
+};
+
+/* Open addressing with linear probing, last_use is zero for empty slots. */
+struct NXCacheSlot {
+        uint64_t key[2];
+        uint64_t kind;
+        uint64_t size;
+        uint64_t last_use;
+        char kind_name[NX_CACHE_KIND_MAX_LENGTH];
+};
+
+struct NXCacheRecordHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t key[2];
+        uint64_t kind;
+        uint64_t payload_size;
+        uint64_t payload_hash;
+};
+
+struct NXCache {
+        char *dir;
+        size_t byte_budget;
+        int index_fd;
+        size_t index_size;
+        struct NXCacheIndexHeader *header;
+        struct NXCacheSlot *slots;
+        pthread_mutex_t mutex;
+};
+
+static atomic_uint nx_s_cache_tmp_counter = 0;
+
+/* The mutex serializes the threads of a process, flock() the processes. */
+static void nx_cache_lock(struct NXCache *cache)
+{
+        pthread_mutex_lock(&cache->mutex);
+        while (flock(cache->index_fd, LOCK_EX) != 0) {
+                if (errno != EINTR)
+                        NX_IO_FATAL(NX_LOG_TAG, "Could not lock the index of cache %s",
+                                    cache->dir);
+        }
+}
+
+static void nx_cache_unlock(struct NXCache *cache)
+{
+        flock(cache->index_fd, LOCK_UN);
+        pthread_mutex_unlock(&cache->mutex);
+}
+
+static NXBool nx_cache_index_is_valid(const struct NXCache *cache)
+{
+        const struct NXCacheIndexHeader *header = cache->header;
+        return memcmp(header->magic, NX_CACHE_INDEX_MAGIC, sizeof(header->magic)) == 0
+                && header->version == NX_CACHE_VERSION
+                && header->n_slots == NX_CACHE_N_SLOTS;
+}
+
+static void nx_cache_index_reset(struct NXCache *cache)
+{
+        memset(cache->header, 0, cache->index_size);
+        memcpy(cache->header->magic, NX_CACHE_INDEX_MAGIC, sizeof(cache->header->magic));
+        cache->header->version = NX_CACHE_VERSION;
+        cache->header->n_slots = NX_CACHE_N_SLOTS;
+}
+
+static NXBool nx_cache_kind_is_valid(const char *kind)
+{
+        int length = 0;
+        for (; length < NX_CACHE_KIND_MAX_LENGTH && kind[length] != '\0'; ++length) {
+                char c = kind[length];
+                if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                      || (c >= '0' && c <= '9') || c == '_'))
+                        return NX_FALSE;
+        }
+        return length > 0 && length < NX_CACHE_KIND_MAX_LENGTH;
+}
+
+static uint64_t nx_cache_kind_hash(const char *kind)
+{
+        NX_ASSERT_PTR(kind);
+        NX_ASSERT_CUSTOM("Cache record kinds must be short names of letters, digits and underscores",
+                         nx_cache_kind_is_valid(kind));
+        return nx_hash3_64(kind, strlen(kind), 0);
+}
+
+static inline uint32_t nx_cache_home_slot(uint64_t key0, uint64_t kind)
+{
+        return (uint32_t)((key0 ^ kind) % NX_CACHE_N_SLOTS);
+}
+
+static int nx_cache_find_slot(const struct NXCache *cache, struct NXCacheKey key,
+                              uint64_t kind)
+{
+        uint32_t i = nx_cache_home_slot(key.h[0], kind);
+        for (int k = 0; k < NX_CACHE_N_SLOTS; ++k) {
+                const struct NXCacheSlot *slot = cache->slots + i;
+                if (slot->last_use == 0)
+                        return -1;
+                if (slot->key[0] == key.h[0] && slot->key[1] == key.h[1]
+                    && slot->kind == kind)
+                        return (int)i;
+                i = (i + 1) % NX_CACHE_N_SLOTS;
+        }
+        return -1;
+}
+
+/* Backward shift deletion keeps the probe sequences of the remaining slots
+ * intact without tombstones. */
+static void nx_cache_remove_slot(struct NXCache *cache, uint32_t i)
+{
+        cache->header->n_records--;
+        cache->header->n_bytes -= cache->slots[i].size;
+
+        uint32_t j = i;
+        while (1) {
+                cache->slots[i].last_use = 0;
+                while (1) {
+                        j = (j + 1) % NX_CACHE_N_SLOTS;
+                        const struct NXCacheSlot *slot = cache->slots + j;
+                        if (slot->last_use == 0)
+                                return;
+
+                        uint32_t home = nx_cache_home_slot(slot->key[0], slot->kind);
+                        NXBool movable = (i <= j) ? (home <= i || home > j)
+                                : (home <= i && home > j);
+                        if (movable)
+                                break;
+                }
+                cache->slots[i] = cache->slots[j];
+                i = j;
+        }
+}
+
+static void nx_cache_insert_slot(struct NXCache *cache, struct NXCacheKey key,
+                                 const char *kind_name, uint64_t kind,
+                                 uint64_t size)
+{
+        uint32_t i = nx_cache_home_slot(key.h[0], kind);
+        while (cache->slots[i].last_use != 0)
+                i = (i + 1) % NX_CACHE_N_SLOTS;
+
+        struct NXCacheSlot *slot = cache->slots + i;
+        slot->key[0] = key.h[0];
+        slot->key[1] = key.h[1];
+        slot->kind = kind;
+        strcpy(slot->kind_name, kind_name);
+        slot->size = size;
+        slot->last_use = ++cache->header->tick;
+
+        cache->header->n_records++;
+        cache->header->n_bytes += size;
+}
+
+static char *nx_cache_record_path(const struct NXCache *cache, struct NXCacheKey key,
+                                  const char *kind)
+{
+        return nx_fstr("%s/%016llx%016llx.%s", cache->dir,
+                       (unsigned long long)key.h[0], (unsigned long long)key.h[1],
+                       kind);
+}
+
+static void nx_cache_evict_lru(struct NXCache *cache)
+{
+        int lru = -1;
+        for (int i = 0; i < NX_CACHE_N_SLOTS; ++i) {
+                const struct NXCacheSlot *slot = cache->slots + i;
+                if (slot->last_use != 0
+                    && (lru < 0 || slot->last_use < cache->slots[lru].last_use))
+                        lru = i;
+        }
+        NX_ASSERT(lru >= 0);
+
+        const struct NXCacheSlot *slot = cache->slots + lru;
+        if (nx_cache_kind_is_valid(slot->kind_name)) {
+                struct NXCacheKey key = { { slot->key[0], slot->key[1] } };
+                char *path = nx_cache_record_path(cache, key, slot->kind_name);
+                unlink(path);
+                nx_free(path);
+        }
+
+        nx_cache_remove_slot(cache, (uint32_t)lru);
+}
+
+static NXBool nx_cache_parse_record_name(const char *name, struct NXCacheKey *key,
+                                         const char **kind)
+{
+        for (int i = 0; i < 32; ++i) {
+                char c = name[i];
+                if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+                        return NX_FALSE;
+        }
+        if (name[32] != '.' || !nx_cache_kind_is_valid(name + 33))
+                return NX_FALSE;
+
+        char digits[17];
+        digits[16] = '\0';
+        for (int j = 0; j < 2; ++j) {
+                memcpy(digits, name + 16 * j, 16);
+                key->h[j] = strtoull(digits, NULL, 16);
+        }
+        *kind = name + 33;
+        return NX_TRUE;
+}
+
+/* Records are only created and removed under the lock together with their
+ * slots, so with the lock held a record file without a slot was left by a
+ * reset index or a crash. Temporary files are removed once their writer has
+ * exited. */
+static void nx_cache_sweep(struct NXCache *cache)
+{
+        DIR *d = opendir(cache->dir);
+        if (!d)
+                return;
+
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL) {
+                const char *name = entry->d_name;
+                NXBool orphan = NX_FALSE;
+
+                struct NXCacheKey key;
+                const char *kind;
+                long pid;
+                if (nx_cache_parse_record_name(name, &key, &kind))
+                        orphan = nx_cache_find_slot(cache, key, nx_cache_kind_hash(kind)) < 0;
+                else if (sscanf(name, ".tmp.%ld.", &pid) == 1)
+                        orphan = kill((pid_t)pid, 0) != 0 && errno == ESRCH;
+
+                if (orphan) {
+                        char *path = nx_fstr("%s/%s", cache->dir, name);
+                        unlink(path);
+                        nx_free(path);
+                }
+        }
+        closedir(d);
+}
+
+struct NXCache *nx_cache_open(const char *dir, size_t byte_budget)
+{
+        if (!dir)
+                dir = NX_DEFAULT_CACHE_DIRECTORY;
+
+        if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+                NX_WARNING(NX_LOG_TAG, "Could not create cache directory %s: %s",
+                           dir, strerror(errno));
+                return NULL;
+        }
+
+        char *index_path = nx_fstr("%s/index", dir);
+        int index_fd = open(index_path, O_RDWR | O_CREAT, 0600);
+        if (index_fd < 0) {
+                NX_WARNING(NX_LOG_TAG, "Could not open cache index %s: %s",
+                           index_path, strerror(errno));
+                nx_free(index_path);
+                return NULL;
+        }
+
+        struct NXCache *cache = NX_NEW(1, struct NXCache);
+        cache->dir = nx_strdup(dir);
+        cache->byte_budget = byte_budget;
+        cache->index_fd = index_fd;
+        cache->index_size = sizeof(struct NXCacheIndexHeader)
+                + NX_CACHE_N_SLOTS * sizeof(struct NXCacheSlot);
+        pthread_mutex_init(&cache->mutex, NULL);
+
+        nx_cache_lock(cache);
+
+        /* The index only grows, other processes may still map a larger index
+         * of another version. */
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fstat(cache->index_fd, &st) == 0
+            && ((size_t)st.st_size >= cache->index_size
+                || ftruncate(cache->index_fd, cache->index_size) == 0))
+                map = mmap(NULL, cache->index_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, cache->index_fd, 0);
+        if (map == MAP_FAILED) {
+                NX_WARNING(NX_LOG_TAG, "Could not map cache index %s: %s",
+                           index_path, strerror(errno));
+                nx_cache_unlock(cache);
+                close(cache->index_fd);
+                pthread_mutex_destroy(&cache->mutex);
+                nx_free(cache->dir);
+                nx_free(cache);
+                nx_free(index_path);
+                return NULL;
+        }
+        cache->header = (struct NXCacheIndexHeader *)map;
+        cache->slots = (struct NXCacheSlot *)(cache->header + 1);
+
+        if (!nx_cache_index_is_valid(cache))
+                nx_cache_index_reset(cache);
+        nx_cache_sweep(cache);
+
+        nx_cache_unlock(cache);
+        nx_free(index_path);
+
+        return cache;
+}
+
+void nx_cache_close(struct NXCache *cache)
+{
+        if (!cache)
+                return;
+
+        munmap(cache->header, cache->index_size);
+        close(cache->index_fd);
+        pthread_mutex_destroy(&cache->mutex);
+        nx_free(cache->dir);
+        nx_free(cache);
+}
+
+struct NXCacheKey nx_cache_key_multi(int n_msg, const uint8_t * const *msg,
+                                     const size_t *lmsg)
+{
+        NX_ASSERT(n_msg >= 0);
+
+        struct NXHash128 h = nx_hash3_128_multi(n_msg, msg, lmsg, 0);
+        struct NXCacheKey key = { { h.lo, h.hi } };
+        return key;
+}
+
+static NXBool nx_cache_read_all(int fd, void *data, size_t n)
+{
+        uint8_t *p = (uint8_t *)data;
+        while (n > 0) {
+                ssize_t n_read = read(fd, p, n);
+                if (n_read < 0 && errno == EINTR)
+                        continue;
+                if (n_read <= 0)
+                        return NX_FALSE;
+                p += n_read;
+                n -= n_read;
+        }
+        return NX_TRUE;
+}
+
+static NXBool nx_cache_write_all(int fd, const void *data, size_t n)
+{
+        const uint8_t *p = (const uint8_t *)data;
+        while (n > 0) {
+                ssize_t n_written = write(fd, p, n);
+                if (n_written < 0 && errno == EINTR)
+                        continue;
+                if (n_written <= 0)
+                        return NX_FALSE;
+                p += n_written;
+                n -= n_written;
+        }
+        return NX_TRUE;
+}
+
+static NXBool nx_cache_read_record(int fd, struct NXCacheKey key, uint64_t kind,
+                                   void **payload, size_t *size)
+{
+        struct NXCacheRecordHeader header;
+        struct stat st;
+        if (fstat(fd, &st) != 0
+            || !nx_cache_read_all(fd, &header, sizeof(header))
+            || memcmp(header.magic, NX_CACHE_RECORD_MAGIC, sizeof(header.magic)) != 0
+            || header.version != NX_CACHE_VERSION
+            || header.header_size != sizeof(header)
+            || header.key[0] != key.h[0] || header.key[1] != key.h[1]
+            || header.kind != kind
+            || header.payload_size != (uint64_t)st.st_size - sizeof(header))
+                return NX_FALSE;
+
+        size_t payload_size = (size_t)header.payload_size;
+        void *data = nx_xmalloc(payload_size > 0 ? payload_size : 1);
+        if (!nx_cache_read_all(fd, data, payload_size)
+            || nx_hash3_64(data, payload_size, 0) != header.payload_hash) {
+                nx_free(data);
+                return NX_FALSE;
+        }
+
+        *payload = data;
+        *size = payload_size;
+        return NX_TRUE;
+}
+
+NXBool nx_cache_get(struct NXCache *cache, struct NXCacheKey key,
+                    const char *kind, void **payload, size_t *size)
+{
+        NX_ASSERT_PTR(payload);
+        NX_ASSERT_PTR(size);
+
+        if (!cache)
+                return NX_FALSE;
+
+        uint64_t kind_hash = nx_cache_kind_hash(kind);
+        char *path = nx_cache_record_path(cache, key, kind);
+
+        /* Records are replaced by rename, an open descriptor keeps reading
+         * the complete record it found even if it is replaced or evicted. */
+        int fd = -1;
+        nx_cache_lock(cache);
+        if (nx_cache_index_is_valid(cache)) {
+                int i = nx_cache_find_slot(cache, key, kind_hash);
+                if (i >= 0) {
+                        fd = open(path, O_RDONLY);
+                        if (fd < 0)
+                                nx_cache_remove_slot(cache, (uint32_t)i);
+                        else
+                                cache->slots[i].last_use = ++cache->header->tick;
+                }
+        }
+        nx_cache_unlock(cache);
+
+        if (fd < 0) {
+                nx_free(path);
+                return NX_FALSE;
+        }
+
+        NXBool hit = nx_cache_read_record(fd, key, kind_hash, payload, size);
+        close(fd);
+
+        if (!hit) {
+                NX_WARNING(NX_LOG_TAG, "Dropping damaged cache record %s", path);
+                nx_cache_lock(cache);
+                if (nx_cache_index_is_valid(cache)) {
+                        int i = nx_cache_find_slot(cache, key, kind_hash);
+                        if (i >= 0) {
+                                unlink(path);
+                                nx_cache_remove_slot(cache, (uint32_t)i);
+                        }
+                }
+                nx_cache_unlock(cache);
+        }
+
+        nx_free(path);
+        return hit;
+}
+
+void nx_cache_put(struct NXCache *cache, struct NXCacheKey key,
+                  const char *kind, int n_parts, const void * const *parts,
+                  const size_t *lparts)
+{
+        NX_ASSERT(n_parts >= 0);
+
+        if (!cache)
+                return;
+
+        struct NXCacheRecordHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, NX_CACHE_RECORD_MAGIC, sizeof(header.magic));
+        header.version = NX_CACHE_VERSION;
+        header.header_size = sizeof(header);
+        header.key[0] = key.h[0];
+        header.key[1] = key.h[1];
+        header.kind = nx_cache_kind_hash(kind);
+
+        struct NXHash3State state;
+        nx_hash3_init(&state, 0);
+        for (int i = 0; i < n_parts; ++i) {
+                nx_hash3_update(&state, parts[i], lparts[i]);
+                header.payload_size += lparts[i];
+        }
+        header.payload_hash = nx_hash3_final64(&state);
+
+        uint64_t record_size = sizeof(header) + header.payload_size;
+        if (record_size > cache->byte_budget)
+                return;
+
+        char *tmp_path = nx_fstr("%s/.tmp.%ld.%u.%s", cache->dir, (long)getpid(),
+                                 atomic_fetch_add(&nx_s_cache_tmp_counter, 1), kind);
+        char *path = nx_cache_record_path(cache, key, kind);
+
+        int fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+        NXBool written = fd >= 0 && nx_cache_write_all(fd, &header, sizeof(header));
+        for (int i = 0; written && i < n_parts; ++i)
+                written = nx_cache_write_all(fd, parts[i], lparts[i]);
+        if (fd >= 0 && close(fd) != 0)
+                written = NX_FALSE;
+
+        if (!written) {
+                NX_WARNING(NX_LOG_TAG, "Could not write cache record %s: %s",
+                           tmp_path, strerror(errno));
+                unlink(tmp_path);
+                nx_free(tmp_path);
+                nx_free(path);
+                return;
+        }
+
+        /* The record file and its slot change together under the lock, so
+         * evictions of other processes and racing writers of the same key
+         * always see matching files and sizes. Renaming over an existing
+         * record makes ext4 flush the new data first, which costs far more
+         * than the put. Records are validated on reads, so a replaced record
+         * is unlinked first instead. */
+        nx_cache_lock(cache);
+        if (nx_cache_index_is_valid(cache)) {
+                int i = nx_cache_find_slot(cache, key, header.kind);
+                if (i >= 0)
+                        nx_cache_remove_slot(cache, (uint32_t)i);
+
+                unlink(path);
+                if (rename(tmp_path, path) != 0) {
+                        NX_WARNING(NX_LOG_TAG, "Could not write cache record %s: %s",
+                                   path, strerror(errno));
+                        unlink(tmp_path);
+                } else {
+                        const uint64_t max_records = NX_CACHE_N_SLOTS * NX_CACHE_MAX_LOAD_NUM
+                                / NX_CACHE_MAX_LOAD_DEN;
+                        while (cache->header->n_records > 0
+                               && (cache->header->n_bytes + record_size > cache->byte_budget
+                                   || cache->header->n_records >= max_records))
+                                nx_cache_evict_lru(cache);
+
+                        nx_cache_insert_slot(cache, key, kind, header.kind, record_size);
+                }
+        } else {
+                unlink(tmp_path);
+        }
+        nx_cache_unlock(cache);
+
+        nx_free(tmp_path);
+        nx_free(path);
+}
+
+void nx_cache_usage(struct NXCache *cache, int *n_records, size_t *n_bytes)
+{
+        NXBool valid = NX_FALSE;
+        if (cache) {
+                nx_cache_lock(cache);
+                valid = nx_cache_index_is_valid(cache);
+        }
+        if (n_records)
+                *n_records = valid ? (int)cache->header->n_records : 0;
+        if (n_bytes)
+                *n_bytes = valid ? (size_t)cache->header->n_bytes : 0;
+        if (cache)
+                nx_cache_unlock(cache);
+}
@@ -29,43 +29,35 @@
 #include <math.h>
 
 #include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_image.h"
-#include "virg/nexus/nx_image_warp.h"
-#include "virg/nexus/nx_filter.h"
+#include "virg/nexus/nx_integral_image.h"
 #include "virg/nexus/nx_math.h"
 
 void nx_checkers_local_radon_images(struct NXImage **lr_images,
                                     struct NXImage *img, int sum_radius)
 {
-        for (int i = 0; i < 4; ++i) {
+        NX_ASSERT_PTR(img);
+        NX_IMAGE_ASSERT_GRAYSCALE_UCHAR(img);
+        NX_ASSERT(sum_radius >= 1);
+
+        for (int i = 0; i < 4; ++i)
                 if (!lr_images[i])
                         lr_images[i] = nx_image_alloc();
-                nx_image_resize(lr_images[i], img->width, img->height,
-                                NX_IMAGE_STRIDE_DEFAULT,
-                                NX_IMAGE_GRAYSCALE, NX_IMAGE_UCHAR);
-        }
-
-        int temp_dim = (img->width + img->height + 2) / sqrt(2.0);
-        int dim = nx_max_i(temp_dim, nx_max_i(img->width, img->height));
-        float *buffer = nx_filter_buffer_alloc(dim, sum_radius);
-
-        nx_image_filter_box_x(lr_images[0], img, sum_radius, buffer);
-        nx_image_filter_box_y(lr_images[1], img, sum_radius, buffer);
-
-        struct NXImage *temp = nx_image_alloc();
-        nx_image_resize(temp, temp_dim, temp_dim, NX_IMAGE_STRIDE_DEFAULT,
-                        NX_IMAGE_GRAYSCALE, NX_IMAGE_UCHAR);
 
-        nx_image_rotate45(temp, img, NX_TRUE);
-        nx_image_filter_box_x(temp, temp, sum_radius, buffer);
-        nx_image_rotate45(lr_images[2], temp, NX_FALSE);
+        // Diagonal pixels are sqrt(2) apart, shorten the diagonal lines to
+        // cover about the same length as the horizontal and vertical ones
+        int diag_radius = nx_max_i(1, (int)(sum_radius / sqrt(2.0) + 0.5));
 
-        nx_image_rotate45(temp, img, NX_FALSE);
-        nx_image_filter_box_x(temp, temp, sum_radius, buffer);
-        nx_image_rotate45(lr_images[3], temp, NX_TRUE);
+        struct NXIntegralImage *ii = nx_integral_image_alloc();
+        nx_integral_image_compute(ii, img, sum_radius);
+        nx_integral_image_box_filter(lr_images[0], ii, sum_radius, 0);
+        nx_integral_image_box_filter(lr_images[1], ii, 0, sum_radius);
 
-        nx_free(buffer);
-        nx_image_free(temp);
+        nx_integral_image_compute_rotated(ii, img, diag_radius);
+        nx_integral_image_rotated_box_filter(lr_images[2], ii, diag_radius, 0);
+        nx_integral_image_rotated_box_filter(lr_images[3], ii, 0, diag_radius);
+        nx_integral_image_free(ii);
 }
 
 static inline int min4_array_uc(uchar **arr, int x)
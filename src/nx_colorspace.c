@@ -25,10 +25,30 @@
  */
 #include "virg/nexus/nx_colorspace.h"
 
+#include "virg/nexus/nx_config.h"
+#if (NX_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
 #include "virg/nexus/nx_assert.h"
 
 #include "nx_color_map_data.h"
 
+#if (NX_SIMD_AVX2)
+/* Gray values of 8 RGBA pixels packed as uchar. */
+static inline __m256 rgba_to_gray_8_uc(const uchar *rgba)
+{
+        const __m256i mask = _mm256_set1_epi32(0xFF);
+        __m256i v = _mm256_loadu_si256((const __m256i *)rgba);
+        __m256 r = _mm256_cvtepi32_ps(_mm256_and_si256(v, mask));
+        __m256 g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 8), mask));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 16), mask));
+        __m256 gray = _mm256_mul_ps(g, _mm256_set1_ps(0.59f));
+        gray = _mm256_fmadd_ps(r, _mm256_set1_ps(0.3f), gray);
+        return _mm256_fmadd_ps(b, _mm256_set1_ps(0.11f), gray);
+}
+#endif
+
 void nx_convert_rgba_to_gray_uc(int width, int height, uchar *gray, int gray_stride,
                                 const uchar *rgba, int rgba_stride)
 {
@@ -38,7 +58,16 @@ void nx_convert_rgba_to_gray_uc(int width, int height, uchar *gray, int gray_str
         for (int y = 0; y < height; ++y) {
                 const uchar* rgba_row = rgba + y*rgba_stride;
                 uchar* gray_row = gray + y*gray_stride;
-                for (int x = 0; x < width; ++x) {
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                for (; x + 8 <= width; x += 8) {
+                        __m256i v = _mm256_cvttps_epi32(rgba_to_gray_8_uc(rgba_row + 4*x));
+                        __m128i v16 = _mm_packus_epi32(_mm256_castsi256_si128(v),
+                                                       _mm256_extracti128_si256(v, 1));
+                        _mm_storel_epi64((__m128i *)(gray_row + x), _mm_packus_epi16(v16, v16));
+                }
+#endif
+                for (; x < width; ++x) {
                         gray_row[x] = nx_rgb_to_gray_uc(rgba_row[4*x],
                                                         rgba_row[4*x+1],
                                                         rgba_row[4*x+2]);
@@ -55,7 +84,17 @@ void nx_convert_gray_to_rgba_uc(int width, int height, uchar *rgba, int rgba_str
         for (int y = 0; y < height; ++y) {
                 const uchar* gray_row = gray + y*gray_stride;
                 uchar* rgba_row = rgba + y*rgba_stride;
-                for (int x = 0; x < width; ++x) {
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                const __m256i spread = _mm256_set1_epi32(0x00010101);
+                const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+                for (; x + 8 <= width; x += 8) {
+                        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(gray_row + x)));
+                        v = _mm256_or_si256(_mm256_mullo_epi32(v, spread), alpha);
+                        _mm256_storeu_si256((__m256i *)(rgba_row + 4*x), v);
+                }
+#endif
+                for (; x < width; ++x) {
                         rgba_row[4*x]   = gray_row[x];
                         rgba_row[4*x+1] = gray_row[x];
                         rgba_row[4*x+2] = gray_row[x];
@@ -73,7 +112,33 @@ void nx_convert_rgba_to_gray_f32(int width, int height, float *gray, int gray_st
         for (int y = 0; y < height; ++y) {
                 const float* rgba_row = rgba + y*rgba_stride;
                 float* gray_row = gray + y*gray_stride;
-                for (int x = 0; x < width; ++x) {
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                /* The unpacks leave even pixels in the low lane and odd
+                 * pixels in the high lane, the final permute restores the
+                 * order. */
+                const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+                for (; x + 8 <= width; x += 8) {
+                        const float *p = rgba_row + 4*x;
+                        __m256 p01 = _mm256_loadu_ps(p);
+                        __m256 p23 = _mm256_loadu_ps(p + 8);
+                        __m256 p45 = _mm256_loadu_ps(p + 16);
+                        __m256 p67 = _mm256_loadu_ps(p + 24);
+                        __m256 rg0 = _mm256_unpacklo_ps(p01, p23);
+                        __m256 ba0 = _mm256_unpackhi_ps(p01, p23);
+                        __m256 rg1 = _mm256_unpacklo_ps(p45, p67);
+                        __m256 ba1 = _mm256_unpackhi_ps(p45, p67);
+                        __m256 r = _mm256_shuffle_ps(rg0, rg1, 0x44);
+                        __m256 g = _mm256_shuffle_ps(rg0, rg1, 0xEE);
+                        __m256 b = _mm256_shuffle_ps(ba0, ba1, 0x44);
+                        __m256 v = _mm256_mul_ps(g, _mm256_set1_ps(0.59f));
+                        v = _mm256_fmadd_ps(r, _mm256_set1_ps(0.3f), v);
+                        v = _mm256_fmadd_ps(b, _mm256_set1_ps(0.11f), v);
+                        v = _mm256_min_ps(_mm256_set1_ps(1.0f), _mm256_max_ps(_mm256_setzero_ps(), v));
+                        _mm256_storeu_ps(gray_row + x, _mm256_permutevar8x32_ps(v, order));
+                }
+#endif
+                for (; x < width; ++x) {
                         gray_row[x] = nx_rgb_to_gray_f32(rgba_row[4*x],
                                                          rgba_row[4*x+1],
                                                          rgba_row[4*x+2]);
@@ -90,7 +155,21 @@ void nx_convert_gray_to_rgba_f32(int width, int height, float *rgba, int rgba_st
         for (int y = 0; y < height; ++y) {
                 const float* gray_row = gray + y*gray_stride;
                 float* rgba_row = rgba + y*rgba_stride;
-                for (int x = 0; x < width; ++x) {
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                const __m256 one = _mm256_set1_ps(1.0f);
+                for (; x + 8 <= width; x += 8) {
+                        __m256 v = _mm256_loadu_ps(gray_row + x);
+                        float *p = rgba_row + 4*x;
+                        for (int k = 0; k < 4; ++k) {
+                                __m256i idx = _mm256_setr_epi32(2*k, 2*k, 2*k, 2*k,
+                                                                2*k+1, 2*k+1, 2*k+1, 2*k+1);
+                                __m256 pair = _mm256_permutevar8x32_ps(v, idx);
+                                _mm256_storeu_ps(p + 8*k, _mm256_blend_ps(pair, one, 0x88));
+                        }
+                }
+#endif
+                for (; x < width; ++x) {
                         rgba_row[4*x]   = gray_row[x];
                         rgba_row[4*x+1] = gray_row[x];
                         rgba_row[4*x+2] = gray_row[x];
@@ -99,6 +178,32 @@ void nx_convert_gray_to_rgba_f32(int width, int height, float *rgba, int rgba_st
         }
 }
 
+void nx_convert_rgba_uc_to_gray_f32(int width, int height, float *gray, int gray_stride,
+                                    const uchar *rgba, int rgba_stride)
+{
+        NX_ASSERT_PTR(gray);
+        NX_ASSERT_PTR(rgba);
+
+        for (int y = 0; y < height; ++y) {
+                const uchar* rgba_row = rgba + y*rgba_stride;
+                float* gray_row = gray + y*gray_stride;
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                const __m256 max_value = _mm256_set1_ps(255.0f);
+                for (; x + 8 <= width; x += 8) {
+                        __m256i v = _mm256_cvttps_epi32(rgba_to_gray_8_uc(rgba_row + 4*x));
+                        v = _mm256_min_epi32(_mm256_set1_epi32(255), _mm256_max_epi32(_mm256_setzero_si256(), v));
+                        _mm256_storeu_ps(gray_row + x, _mm256_div_ps(_mm256_cvtepi32_ps(v), max_value));
+                }
+#endif
+                for (; x < width; ++x) {
+                        gray_row[x] = nx_rgb_to_gray_uc(rgba_row[4*x],
+                                                        rgba_row[4*x+1],
+                                                        rgba_row[4*x+2]) / 255.0f;
+                }
+        }
+}
+
 static void interpolate_color_map_data(float *rgb, float value,
                                        int n, float color_map_data[][3])
 {
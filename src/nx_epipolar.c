@@ -28,6 +28,7 @@
 #include <float.h>
 
 #include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_arena.h"
 #include "virg/nexus/nx_log.h"
 #include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_svd.h"
@@ -121,14 +122,16 @@ double nx_fundamental_estimate_8pt(double *F, int corr_ids[8],
         NX_ASSERT_PTR(corr_list);
 
         size_t lA = 8 * 9;
-        double *A = NX_NEW_D(lA);
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        double *A = NX_ARENA_NEW_D(arena, lA);
         double *Ac = A;
         for (int i = 0; i < 8; ++i, Ac += 9)
                 nx_fundamental_constraints_from_corr(Ac, corr_list + corr_ids[i]);
 
         double sval = nx_fundamental_svd_solve(F, 8, A);
         nx_fundamental_fix_rank(F);
-        nx_free(A);
+        nx_arena_rewind(arena, mark);
 
         return sval;
 }
@@ -146,14 +149,16 @@ double nx_fundamental_estimate(double *F, int n_corr,
         NX_ASSERT(n_corr >= 8);
 
         size_t lA = n_corr * 9;
-        double *A = NX_NEW_D(lA);
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        double *A = NX_ARENA_NEW_D(arena, lA);
         double *Ac = A;
         for (int i = 0; i < n_corr; ++i, Ac += 9)
                 nx_fundamental_constraints_from_corr(Ac, corr_list + i);
 
         double sval = nx_fundamental_svd_solve(F, n_corr, A);
         nx_fundamental_fix_rank(F);
-        nx_free(A);
+        nx_arena_rewind(arena, mark);
 
         /* nx_dmat3_print(F, "F"); */
         /* NX_LOG("SDA", "%.4g / %.4g", sval, s2); */
@@ -175,7 +180,9 @@ double nx_fundamental_estimate_inliers(double *F, int n_corr,
         NX_ASSERT(n_inliers >= 8);
 
         size_t lA = n_inliers * 9;
-        double *A = NX_NEW_D(lA);
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        double *A = NX_ARENA_NEW_D(arena, lA);
         double *Ac = A;
         for (int i = 0; i < n_corr; ++i)
                 if (corr_list[i].is_inlier) {
@@ -185,22 +192,14 @@ double nx_fundamental_estimate_inliers(double *F, int n_corr,
 
         double sval = nx_fundamental_svd_solve(F, n_inliers, A);
         nx_fundamental_fix_rank(F);
-        nx_free(A);
+        nx_arena_rewind(arena, mark);
 
         return sval;
 }
 
 static inline void nx_select_prosac_candidates(int n_top, int corr_ids[8])
 {
-        corr_ids[0] = (int)(NX_UNIFORM_SAMPLE_S*n_top);
-        for (int i = 1; i < 8; ++i) {
-                corr_ids[i] = (int)(NX_UNIFORM_SAMPLE_S*n_top);
-                for (int j = i-1; j > 0; --j)
-                        if (corr_ids[i] == corr_ids[j]) {
-                                --i;
-                                break;
-                        }
-        }
+        nx_uniform_sampler_fill_index(nx_uniform_sampler_instance(), 8, corr_ids, n_top);
 }
 
 int nx_fundamental_estimate_ransac(double *F, int n_corr,
@@ -33,6 +33,7 @@
 #include "virg/nexus/nx_mem_block.h"
 
 #define NX_FAST_DETECTOR_WORK_MULTIPLIER 10
+#define NX_FAST_CIRCLE_RADIUS 3
 
 extern void fast9_detect(struct NXKeypoint *ret_corners, const unsigned char *im, int xsize, int ysize, int stride, int b, int *ret_num_corners);
 extern void fast9_score (const unsigned char *i, int stride, struct NXKeypoint *corners, int num_corners, int b);
@@ -40,6 +41,15 @@ extern void fast_nonmax_suppression(int *ret_num_nonmax, struct NXKeypoint *ret_
 
 int nx_fast_detect_keypoints(int n_keys_max, struct NXKeypoint *keys,
                              const struct NXImage *img, int threshold)
+{
+        return nx_fast_detect_keypoints_region(n_keys_max, keys, img, threshold,
+                                               NULL, 1.0f);
+}
+
+int nx_fast_detect_keypoints_region(int n_keys_max, struct NXKeypoint *keys,
+                                    const struct NXImage *img, int threshold,
+                                    const struct NXImageRegion *region,
+                                    float scale)
 {
         NX_ASSERT(n_keys_max >= 0);
         NX_ASSERT_PTR(keys);
@@ -51,21 +61,40 @@ int nx_fast_detect_keypoints(int n_keys_max, struct NXKeypoint *keys,
                 return 0;
         }
 
-        fast9_detect(keys, img->data.uc, img->width, img->height,
-                     img->row_stride, threshold, &n_keys_max);
+        // the segment test reads a circle of radius 3 and skips the pixels
+        // within 3 of the border of the image it is given
+        int x0, y0, x1, y1;
+        nx_image_region_level_bounds(region, scale, NX_FAST_CIRCLE_RADIUS,
+                                     img->width, img->height,
+                                     &x0, &y0, &x1, &y1);
+        if (x1 - x0 <= 2 * NX_FAST_CIRCLE_RADIUS || y1 - y0 <= 2 * NX_FAST_CIRCLE_RADIUS)
+                return 0;
+
+        fast9_detect(keys, img->data.uc + y0 * img->row_stride + x0,
+                     x1 - x0, y1 - y0, img->row_stride, threshold, &n_keys_max);
 
+        int n_keys = 0;
         for (int i = 0; i < n_keys_max; ++i) {
-                keys[i].xs = keys[i].x;
-                keys[i].ys = keys[i].y;
-                keys[i].level = 0;
-                keys[i].scale = 1.0f;
-                keys[i].sigma = 0.0f;
-                keys[i].score = 0.0f;
-                keys[i].ori = 0.0f;
-                keys[i].id = i;
+                int x = keys[i].x + x0;
+                int y = keys[i].y + y0;
+                if (region != NULL && !nx_image_region_contains(region, x * scale, y * scale))
+                        continue;
+
+                struct NXKeypoint *key = keys + n_keys;
+                key->x = x;
+                key->y = y;
+                key->xs = x;
+                key->ys = y;
+                key->level = 0;
+                key->scale = 1.0f;
+                key->sigma = 0.0f;
+                key->score = 0.0f;
+                key->ori = 0.0f;
+                key->id = n_keys;
+                ++n_keys;
         }
 
-        return n_keys_max;
+        return n_keys;
 }
 
 void nx_fast_score_keypoints(int n_keys, struct NXKeypoint *keys,
@@ -83,6 +112,17 @@ int nx_fast_detect_keypoints_pyr(int n_keys_supp_max, struct NXKeypoint *keys_su
                                  int n_keys_max, struct NXKeypoint *keys,
                                  const struct NXImagePyr *pyr, int threshold,
                                  int n_pyr_key_levels)
+{
+        return nx_fast_detect_keypoints_pyr_region(n_keys_supp_max, keys_supp,
+                                                   n_keys_max, keys, pyr, threshold,
+                                                   n_pyr_key_levels, NULL);
+}
+
+int nx_fast_detect_keypoints_pyr_region(int n_keys_supp_max, struct NXKeypoint *keys_supp,
+                                        int n_keys_max, struct NXKeypoint *keys,
+                                        const struct NXImagePyr *pyr, int threshold,
+                                        int n_pyr_key_levels,
+                                        const struct NXImageRegion *region)
 {
         NX_ASSERT(n_keys_supp_max >= 0);
         NX_ASSERT(n_keys_max >= 0);
@@ -103,10 +143,11 @@ int nx_fast_detect_keypoints_pyr(int n_keys_supp_max, struct NXKeypoint *keys_su
         int n_level_keys_max = n_keys_supp_max;
         struct NXKeypoint *level_keys = keys_supp;
         for (int i = n_pyr_key_levels-1; i >= 0 ; --i) {
-                int n_level_keys = nx_fast_detect_keypoints(n_keys_max,
-                                                            keys,
-                                                            pyr->levels[i].img,
-                                                            threshold);
+                int n_level_keys = nx_fast_detect_keypoints_region(n_keys_max,
+                                                                   keys,
+                                                                   pyr->levels[i].img,
+                                                                   threshold, region,
+                                                                   pyr->levels[i].scale);
 
                 nx_fast_score_keypoints(n_level_keys, keys,
                                         pyr->levels[i].img, threshold);
@@ -265,6 +306,12 @@ static void nx_fast_detector_compute_keypoint_ori_ic(int n_keys, struct NXKeypoi
 }
 
 int nx_fast_detector_detect(struct NXFastDetector *detector, int max_n_keys, struct NXKeypoint* keys, const struct NXImage *img)
+{
+        return nx_fast_detector_detect_region(detector, max_n_keys, keys, img, NULL);
+}
+
+int nx_fast_detector_detect_region(struct NXFastDetector *detector, int max_n_keys, struct NXKeypoint* keys, const struct NXImage *img,
+                                   const struct NXImageRegion *region)
 {
         NX_ASSERT_PTR(detector);
         NX_ASSERT_PTR(img);
@@ -274,9 +321,10 @@ int nx_fast_detector_detect(struct NXFastDetector *detector, int max_n_keys, str
         size_t work_size = max_n_keys * detector->work_multiplier;
         nx_keypoint_vector_resize(detector->keys_work, work_size);
 
-        int n_keys = nx_fast_detect_keypoints(detector->keys_work->size,
-                                              detector->keys_work->data,
-                                              img, detector->threshold);
+        int n_keys = nx_fast_detect_keypoints_region(detector->keys_work->size,
+                                                     detector->keys_work->data,
+                                                     img, detector->threshold,
+                                                     region, 1.0f);
 
         nx_fast_score_keypoints(n_keys, detector->keys_work->data,
                                 img, detector->threshold);
@@ -293,6 +341,13 @@ int nx_fast_detector_detect(struct NXFastDetector *detector, int max_n_keys, str
 }
 
 int nx_fast_detector_detect_pyr(struct NXFastDetector *detector, int max_n_keys, struct NXKeypoint* keys, const struct NXImagePyr *pyr, int n_pyr_key_levels)
+{
+        return nx_fast_detector_detect_pyr_region(detector, max_n_keys, keys, pyr,
+                                                  n_pyr_key_levels, NULL);
+}
+
+int nx_fast_detector_detect_pyr_region(struct NXFastDetector *detector, int max_n_keys, struct NXKeypoint* keys, const struct NXImagePyr *pyr, int n_pyr_key_levels,
+                                       const struct NXImageRegion *region)
 {
         NX_ASSERT_PTR(detector);
         NX_ASSERT_PTR(pyr);
@@ -309,10 +364,11 @@ int nx_fast_detector_detect_pyr(struct NXFastDetector *detector, int max_n_keys,
         int n_level_keys_max = max_n_keys;
         struct NXKeypoint *level_keys = keys;
         for (int i = n_pyr_key_levels-1; i >= 0 ; --i) {
-                int n_level_keys = nx_fast_detect_keypoints(detector->keys_work->size,
-                                                            detector->keys_work->data,
-                                                            pyr->levels[i].img,
-                                                            detector->threshold);
+                int n_level_keys = nx_fast_detect_keypoints_region(detector->keys_work->size,
+                                                                   detector->keys_work->data,
+                                                                   pyr->levels[i].img,
+                                                                   detector->threshold,
+                                                                   region, pyr->levels[i].scale);
 
                 nx_fast_score_keypoints(n_level_keys, detector->keys_work->data,
                                         pyr->levels[i].img, detector->threshold);
@@ -29,6 +29,11 @@
 #include <string.h>
 #include <math.h>
 
+#include "virg/nexus/nx_config.h"
+#if (NX_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
 #include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_alloc.h"
 #include "virg/nexus/nx_math.h"
@@ -86,6 +91,106 @@ void nx_kernel_sym_gaussian(int n_k, float *kernel, float sigma)
         }
 }
 
+/* Kernels with up to NX_CONVOLVE_SYM_N_UNROLLED - 1 elements, i.e. up to 13
+ * taps, have fully unrolled variants selected through a table indexed by
+ * n_k. Longer kernels use the generic loops. Every output is computed as
+ * kernel[0] * center followed by one multiply-add of kernel[k] * (left +
+ * right) per k, in the same order as the scalar code. */
+#define NX_CONVOLVE_SYM_N_UNROLLED 8
+
+typedef void (*NXConvolveSymFunc)(int n, float *data, const float *kernel);
+typedef void (*NXConvolveSymRowsFunc)(int n, float *dest, const float *const *rows, const float *kernel);
+
+/* The remainder of a row rounds the same way as the vector lanes. */
+static inline float convolve_sym_madd(float k, float s, float sum)
+{
+#if (NX_SIMD_AVX2)
+        return fmaf(k, s, sum);
+#else
+        return sum + k * s;
+#endif
+}
+
+/* In place is safe as the loads of a block of 8 outputs happen before its
+ * store, and later blocks only read elements to the right of it. */
+static inline void convolve_sym(int n, float *data, int n_k, const float *kernel)
+{
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        for (; i + 8 <= n; i += 8) {
+                const float *dk0 = data + i + n_k - 1;
+                __m256 sum = _mm256_mul_ps(_mm256_set1_ps(kernel[0]), _mm256_loadu_ps(dk0));
+#pragma GCC unroll 16
+                for (int k = 1; k < n_k; ++k) {
+                        __m256 s = _mm256_add_ps(_mm256_loadu_ps(dk0 - k), _mm256_loadu_ps(dk0 + k));
+                        sum = _mm256_fmadd_ps(_mm256_set1_ps(kernel[k]), s, sum);
+                }
+                _mm256_storeu_ps(data + i, sum);
+        }
+#endif
+        for (; i < n; ++i) {
+                float* dk0 = data + i + n_k - 1;
+                float sum = kernel[0] * *dk0;
+                for (int k = 1; k < n_k; ++k) {
+                        sum = convolve_sym_madd(kernel[k], dk0[-k] + dk0[+k], sum);
+                }
+                data[i] = sum;
+        }
+}
+
+static inline void convolve_sym_rows(int n, float *dest, const float *const *rows,
+                                     int n_k, const float *kernel)
+{
+        const float *const *rk0 = rows + n_k - 1;
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        for (; i + 8 <= n; i += 8) {
+                __m256 sum = _mm256_mul_ps(_mm256_set1_ps(kernel[0]), _mm256_loadu_ps(rk0[0] + i));
+#pragma GCC unroll 16
+                for (int k = 1; k < n_k; ++k) {
+                        __m256 s = _mm256_add_ps(_mm256_loadu_ps(rk0[-k] + i), _mm256_loadu_ps(rk0[+k] + i));
+                        sum = _mm256_fmadd_ps(_mm256_set1_ps(kernel[k]), s, sum);
+                }
+                _mm256_storeu_ps(dest + i, sum);
+        }
+#endif
+        for (; i < n; ++i) {
+                float sum = kernel[0] * rk0[0][i];
+                for (int k = 1; k < n_k; ++k) {
+                        sum = convolve_sym_madd(kernel[k], rk0[-k][i] + rk0[+k][i], sum);
+                }
+                dest[i] = sum;
+        }
+}
+
+#define NX_DEFINE_CONVOLVE_SYM_FUNC(NK)                                 \
+        static void convolve_sym_##NK(int n, float *data, const float *kernel) \
+        {                                                               \
+                convolve_sym(n, data, NK, kernel);                      \
+        }                                                               \
+        static void convolve_sym_rows_##NK(int n, float *dest, const float *const *rows, \
+                                           const float *kernel)         \
+        {                                                               \
+                convolve_sym_rows(n, dest, rows, NK, kernel);           \
+        }
+
+NX_DEFINE_CONVOLVE_SYM_FUNC(2)
+NX_DEFINE_CONVOLVE_SYM_FUNC(3)
+NX_DEFINE_CONVOLVE_SYM_FUNC(4)
+NX_DEFINE_CONVOLVE_SYM_FUNC(5)
+NX_DEFINE_CONVOLVE_SYM_FUNC(6)
+NX_DEFINE_CONVOLVE_SYM_FUNC(7)
+
+static const NXConvolveSymFunc CONVOLVE_SYM_FUNCS[NX_CONVOLVE_SYM_N_UNROLLED] = {
+        NULL, NULL, convolve_sym_2, convolve_sym_3,
+        convolve_sym_4, convolve_sym_5, convolve_sym_6, convolve_sym_7
+};
+
+static const NXConvolveSymRowsFunc CONVOLVE_SYM_ROWS_FUNCS[NX_CONVOLVE_SYM_N_UNROLLED] = {
+        NULL, NULL, convolve_sym_rows_2, convolve_sym_rows_3,
+        convolve_sym_rows_4, convolve_sym_rows_5, convolve_sym_rows_6, convolve_sym_rows_7
+};
+
 /**
  * Convolves float data buffer using a symmetric kernel of length
  * (2*n_k+1) in single precision.
@@ -102,13 +207,360 @@ void nx_convolve_sym(int n, float *data, int n_k, const float *kernel)
         NX_ASSERT(n_k > 1);
         NX_ASSERT_PTR(kernel);
 
-        for (int i = 0; i < n; ++i) {
-                float* dk0 = data + i + n_k - 1;
-                float sum = kernel[0] * *dk0;
-                for (int k = 1; k < n_k; ++k) {
+        if (n_k < NX_CONVOLVE_SYM_N_UNROLLED) {
+                CONVOLVE_SYM_FUNCS[n_k](n, data, kernel);
+        } else {
+                convolve_sym(n, data, n_k, kernel);
+        }
+}
+
+/**
+ * Convolves across rows with a symmetric kernel of length (2*n_k-1) in single
+ * precision, i.e. dest[i] = kernel[0] * rows[n_k-1][i] + sum_k kernel[k] *
+ * (rows[n_k-1-k][i] + rows[n_k-1+k][i]).
+ *
+ * @param n Number of elements in each row
+ * @param dest Output row, may be one of the input rows
+ * @param rows The 2*n_k-1 input rows, the center row is rows[n_k-1]
+ * @param n_k Number of elements in the kernel array
+ * @param kernel The kernel
+ */
+void nx_convolve_sym_rows(int n, float *dest, const float *const *rows, int n_k, const float *kernel)
+{
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT_PTR(rows);
+        NX_ASSERT(n_k > 1);
+        NX_ASSERT_PTR(kernel);
+
+        if (n_k < NX_CONVOLVE_SYM_N_UNROLLED) {
+                CONVOLVE_SYM_ROWS_FUNCS[n_k](n, dest, rows, kernel);
+        } else {
+                convolve_sym_rows(n, dest, rows, n_k, kernel);
+        }
+}
+
+/**
+ * Converts n unsigned char values to float.
+ */
+void nx_filter_convert_uc_to_f32(int n, float *dest, const uchar *src)
+{
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        for (; i + 8 <= n; i += 8) {
+                __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+                _mm256_storeu_ps(dest + i, _mm256_cvtepi32_ps(v));
+        }
+#endif
+        for (; i < n; ++i)
+                dest[i] = src[i];
+}
+
+/**
+ * Converts n float values to unsigned char by truncation. Values outside
+ * [0,255] saturate.
+ */
+void nx_filter_convert_f32_to_uc(int n, uchar *dest, const float *src)
+{
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        const __m256 max_value = _mm256_set1_ps(255.0f);
+        for (; i + 8 <= n; i += 8) {
+                __m256 vf = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), _mm256_setzero_ps()), max_value);
+                __m256i v = _mm256_cvttps_epi32(vf);
+                __m128i v16 = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+                _mm_storel_epi64((__m128i *)(dest + i), _mm_packus_epi16(v16, v16));
+        }
+#endif
+        for (; i < n; ++i)
+                dest[i] = (uchar)nx_min_s(255.0f, nx_max_s(0.0f, src[i]));
+}
+
+/**
+ * Quantizes a symmetric kernel to fixed point with frac_bits fractional
+ * bits. The center element absorbs the rounding error so that the full kernel
+ * sums up to 1 << frac_bits, or as close as 16 bits allow.
+ *
+ * @param n_k Number of elements in the kernel array
+ * @param kernel_q Array to store the quantized kernel
+ * @param kernel The kernel in single precision
+ * @param frac_bits Number of fractional bits, at most 16
+ */
+void nx_kernel_sym_quantize(int n_k, uint16_t *kernel_q, const float *kernel, int frac_bits)
+{
+        NX_ASSERT(n_k > 1);
+        NX_ASSERT_PTR(kernel_q);
+        NX_ASSERT_PTR(kernel);
+        NX_ASSERT(frac_bits > 0 && frac_bits <= 16);
+
+        int one = 1 << frac_bits;
+        int sum = 0;
+        for (int i = 1; i < n_k; ++i) {
+                kernel_q[i] = lrintf(kernel[i] * one);
+                sum += 2 * kernel_q[i];
+        }
+        kernel_q[0] = nx_min_i(UINT16_MAX, nx_max_i(0, one - sum));
+}
+
+/**
+ * Convolves an unsigned char buffer with a symmetric Q8 kernel of length
+ * (2*n_k-1). The results are in Q8, i.e. 256 times the filtered values, and
+ * are exact as long as the kernel sums up to at most 256.
+ *
+ * @param n Number of outputs
+ * @param dest Output array
+ * @param data Pointer to the beginning of the buffer, with n_k-1 border elements
+ * @param step Distance between the input elements of consecutive outputs, 1 or 2
+ * @param n_k Number of elements in the kernel array
+ * @param kernel The Q8 kernel
+ */
+void nx_convolve_sym_uc_q8(int n, uint16_t *dest, const uchar *data, int step,
+                           int n_k, const uint16_t *kernel)
+{
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT_PTR(data);
+        NX_ASSERT(step == 1 || step == 2);
+        NX_ASSERT(n_k > 1);
+        NX_ASSERT_PTR(kernel);
+
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        /* With step 2, the even bytes of 32 consecutive inputs are the low
+         * bytes of 16 words. */
+        const __m256i even_mask = _mm256_set1_epi16(0x00FF);
+        for (; i + 16 <= n; i += 16) {
+                const uchar *dk0 = data + step * i + n_k - 1;
+                __m256i sum;
+                if (step == 1) {
+                        __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)dk0));
+                        sum = _mm256_mullo_epi16(_mm256_set1_epi16(kernel[0]), c);
+                        for (int k = 1; k < n_k; ++k) {
+                                __m256i l = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(dk0 - k)));
+                                __m256i r = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(dk0 + k)));
+                                __m256i s = _mm256_mullo_epi16(_mm256_set1_epi16(kernel[k]), _mm256_add_epi16(l, r));
+                                sum = _mm256_add_epi16(sum, s);
+                        }
+                } else {
+                        __m256i c = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)dk0), even_mask);
+                        sum = _mm256_mullo_epi16(_mm256_set1_epi16(kernel[0]), c);
+                        for (int k = 1; k < n_k; ++k) {
+                                __m256i l = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(dk0 - k)), even_mask);
+                                __m256i r = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(dk0 + k)), even_mask);
+                                __m256i s = _mm256_mullo_epi16(_mm256_set1_epi16(kernel[k]), _mm256_add_epi16(l, r));
+                                sum = _mm256_add_epi16(sum, s);
+                        }
+                }
+                _mm256_storeu_si256((__m256i *)(dest + i), sum);
+        }
+#endif
+        for (; i < n; ++i) {
+                const uchar *dk0 = data + step * i + n_k - 1;
+                int sum = kernel[0] * dk0[0];
+                for (int k = 1; k < n_k; ++k)
                         sum += kernel[k] * (dk0[-k] + dk0[+k]);
+                dest[i] = (uint16_t)sum;
+        }
+}
+
+/**
+ * Convolves across Q8 rows with a symmetric Q16 kernel of length (2*n_k-1)
+ * and rounds the results to unsigned char. Each product is truncated to Q8
+ * before it is summed, as with a 16-bit high multiply.
+ *
+ * @param n Number of elements in each row
+ * @param dest Output row
+ * @param rows The 2*n_k-1 input rows in Q8, the center row is rows[n_k-1]
+ * @param n_k Number of elements in the kernel array
+ * @param kernel The Q16 kernel
+ */
+void nx_convolve_sym_rows_q8(int n, uchar *dest, const uint16_t *const *rows,
+                             int n_k, const uint16_t *kernel)
+{
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT_PTR(rows);
+        NX_ASSERT(n_k > 1);
+        NX_ASSERT_PTR(kernel);
+
+        const uint16_t *const *rk0 = rows + n_k - 1;
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        const __m256i half = _mm256_set1_epi16(128);
+        for (; i + 32 <= n; i += 32) {
+                __m256i sum[2];
+                for (int j = 0; j < 2; ++j) {
+                        int ij = i + 16 * j;
+                        __m256i c = _mm256_loadu_si256((const __m256i *)(rk0[0] + ij));
+                        sum[j] = _mm256_mulhi_epu16(_mm256_set1_epi16(kernel[0]), c);
+                        for (int k = 1; k < n_k; ++k) {
+                                __m256i kk = _mm256_set1_epi16(kernel[k]);
+                                __m256i u = _mm256_loadu_si256((const __m256i *)(rk0[-k] + ij));
+                                __m256i d = _mm256_loadu_si256((const __m256i *)(rk0[+k] + ij));
+                                sum[j] = _mm256_adds_epu16(sum[j], _mm256_mulhi_epu16(kk, u));
+                                sum[j] = _mm256_adds_epu16(sum[j], _mm256_mulhi_epu16(kk, d));
+                        }
+                        sum[j] = _mm256_srli_epi16(_mm256_adds_epu16(sum[j], half), 8);
+                }
+                __m256i v = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum[0], sum[1]), 0xD8);
+                _mm256_storeu_si256((__m256i *)(dest + i), v);
+        }
+#endif
+        for (; i < n; ++i) {
+                uint32_t sum = ((uint32_t)kernel[0] * rk0[0][i]) >> 16;
+                for (int k = 1; k < n_k; ++k) {
+                        sum += ((uint32_t)kernel[k] * rk0[-k][i]) >> 16;
+                        sum += ((uint32_t)kernel[k] * rk0[+k][i]) >> 16;
+                }
+                dest[i] = (uchar)nx_min_i(255, (sum + 128) >> 8);
+        }
+}
+
+/**
+ * Computes the coefficients of the third order recursive Gaussian of Young and
+ * van Vliet, "Recursive implementation of the Gaussian filter", Signal
+ * Processing 44, 1995. Filtering is a causal pass w[i] = coeffs[0] * x[i] +
+ * sum_k coeffs[k] * w[i-k] followed by the same recursion anti-causally.
+ *
+ * @param sigma Gaussian standard deviation, must be >= 0.5
+ * @param coeffs Array of 4 elements to store the coefficients
+ */
+void nx_recursive_gaussian_coefficients(float sigma, float *coeffs)
+{
+        NX_ASSERT(sigma >= 0.5f);
+        NX_ASSERT_PTR(coeffs);
+
+        double q;
+        if (sigma >= 2.5f)
+                q = 0.98711 * sigma - 0.96330;
+        else
+                q = 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+
+        double q2 = q * q;
+        double q3 = q2 * q;
+        double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+        double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+        double b2 = -(1.4281 * q2 + 1.26661 * q3);
+        double b3 = 0.422205 * q3;
+
+        coeffs[0] = 1.0 - (b1 + b2 + b3) / b0;
+        coeffs[1] = b1 / b0;
+        coeffs[2] = b2 / b0;
+        coeffs[3] = b3 / b0;
+}
+
+#define NX_RECURSIVE_GAUSSIAN_MAX_VECTORS 4
+
+static inline float recursive_gaussian_step(const float *c, float x, float w1, float w2, float w3)
+{
+        return c[1] * w1 + (c[0] * x + (c[3] * w3 + c[2] * w2));
+}
+
+#if (NX_SIMD_AVX2)
+/* Runs n_vec groups of 8 lanes together so that their recursions overlap. */
+static inline void recursive_gaussian_avx2(int n, int n_border, float *data, int stride,
+                                           int n_vec, const float *coeffs)
+{
+        const __m256 c0 = _mm256_set1_ps(coeffs[0]);
+        const __m256 c1 = _mm256_set1_ps(coeffs[1]);
+        const __m256 c2 = _mm256_set1_ps(coeffs[2]);
+        const __m256 c3 = _mm256_set1_ps(coeffs[3]);
+        __m256 x[NX_RECURSIVE_GAUSSIAN_MAX_VECTORS];
+        __m256 w1[NX_RECURSIVE_GAUSSIAN_MAX_VECTORS];
+        __m256 w2[NX_RECURSIVE_GAUSSIAN_MAX_VECTORS];
+        __m256 w3[NX_RECURSIVE_GAUSSIAN_MAX_VECTORS];
+
+        for (int v = 0; v < n_vec; ++v)
+                w1[v] = w2[v] = w3[v] = x[v] = _mm256_loadu_ps(data + 8 * v);
+
+        for (int i = 0; i < n + n_border; ++i) {
+                float *p = data + i * stride;
+                for (int v = 0; v < n_vec; ++v) {
+                        if (i < n)
+                                x[v] = _mm256_loadu_ps(p + 8 * v);
+                        __m256 w = _mm256_fmadd_ps(c3, w3[v], _mm256_mul_ps(c2, w2[v]));
+                        w = _mm256_fmadd_ps(c1, w1[v], _mm256_fmadd_ps(c0, x[v], w));
+                        _mm256_storeu_ps(p + 8 * v, w);
+                        w3[v] = w2[v];
+                        w2[v] = w1[v];
+                        w1[v] = w;
+                }
+        }
+
+        for (int v = 0; v < n_vec; ++v)
+                w2[v] = w3[v] = w1[v];
+
+        for (int i = n + n_border - 1; i >= 0; --i) {
+                float *p = data + i * stride;
+                for (int v = 0; v < n_vec; ++v) {
+                        __m256 w = _mm256_fmadd_ps(c3, w3[v], _mm256_mul_ps(c2, w2[v]));
+                        w = _mm256_fmadd_ps(c1, w1[v], _mm256_fmadd_ps(c0, _mm256_loadu_ps(p + 8 * v), w));
+                        _mm256_storeu_ps(p + 8 * v, w);
+                        w3[v] = w2[v];
+                        w2[v] = w1[v];
+                        w1[v] = w;
+                }
+        }
+}
+#endif
+
+/**
+ * Filters n_lanes interleaved signals with the recursive Gaussian. Element i
+ * of lane l is at data[i * stride + l]. The signals are extended with their
+ * first and last elements. The left extension is exact through the steady
+ * state of the causal pass, the right one runs the recursion over n_border
+ * more elements, which are stored after the signal and must be allocated.
+ *
+ * The anti-causal pass starts from the steady state of the last causal output
+ * instead of the initialisation of Triggs and Sdika, so the right border is
+ * approximate near it. The error decays with n_border, for 8-bit data it is
+ * about 0.02 grey levels at three sigmas and 0.001 at four.
+ *
+ * @param n Number of elements in each lane
+ * @param n_border Number of elements of right extension
+ * @param data Pointer to the first element of the first lane
+ * @param stride Distance between consecutive elements of a lane
+ * @param n_lanes Number of lanes, at most stride
+ * @param coeffs Coefficients from nx_recursive_gaussian_coefficients
+ */
+void nx_convolve_recursive_gaussian(int n, int n_border, float *data, int stride,
+                                    int n_lanes, const float *coeffs)
+{
+        NX_ASSERT(n > 0);
+        NX_ASSERT(n_border >= 0);
+        NX_ASSERT_PTR(data);
+        NX_ASSERT(n_lanes > 0 && n_lanes <= stride);
+        NX_ASSERT_PTR(coeffs);
+
+        int l = 0;
+#if (NX_SIMD_AVX2)
+        for (; l + 8 * NX_RECURSIVE_GAUSSIAN_MAX_VECTORS <= n_lanes; l += 8 * NX_RECURSIVE_GAUSSIAN_MAX_VECTORS)
+                recursive_gaussian_avx2(n, n_border, data + l, stride,
+                                        NX_RECURSIVE_GAUSSIAN_MAX_VECTORS, coeffs);
+        for (; l + 8 <= n_lanes; l += 8)
+                recursive_gaussian_avx2(n, n_border, data + l, stride, 1, coeffs);
+#endif
+        for (; l < n_lanes; ++l) {
+                float *p = data + l;
+                float x = p[0];
+                float w1 = x;
+                float w2 = x;
+                float w3 = x;
+                for (int i = 0; i < n + n_border; ++i) {
+                        if (i < n)
+                                x = p[i * stride];
+                        float w = recursive_gaussian_step(coeffs, x, w1, w2, w3);
+                        p[i * stride] = w;
+                        w3 = w2;
+                        w2 = w1;
+                        w1 = w;
+                }
+
+                w2 = w3 = w1;
+                for (int i = n + n_border - 1; i >= 0; --i) {
+                        float w = recursive_gaussian_step(coeffs, p[i * stride], w1, w2, w3);
+                        p[i * stride] = w;
+                        w3 = w2;
+                        w2 = w1;
+                        w1 = w;
                 }
-                data[i] = sum;
         }
 }
 
@@ -173,8 +625,7 @@ void nx_filter_copy_to_buffer1_uc(int n, float *buffer, const uchar *data, int n
         NX_ASSERT_PTR(buffer);
         NX_ASSERT_PTR(data);
 
-        for (int i = 0; i < n; ++i)
-                buffer[n_border + i] = data[i];
+        nx_filter_convert_uc_to_f32(n, buffer + n_border, data);
         fill_buffer_border(n, buffer, n_border, mode);
 }
 
@@ -255,8 +706,7 @@ float *nx_filter_buffer_alloc(int n, int n_border)
         size_t l = n + 2 * n_border;
 #if (NX_HAVE_SIMD)
         size_t sz = l * sizeof(float);
-        if (sz % NX_SIMD_ALIGNMENT != 0)
-                sz = ((sz / NX_SIMD_ALIGNMENT) + 1) * NX_SIMD_ALIGNMENT;
+        sz = nx_align_size(sz, NX_SIMD_ALIGNMENT);
         return (float *)nx_xaligned_alloc(NX_SIMD_ALIGNMENT, sz);
 #else
         return NX_NEW_S(l);
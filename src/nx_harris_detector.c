@@ -25,11 +25,29 @@
  */
 #include "virg/nexus/nx_harris_detector.h"
 
+#include <string.h>
+#include <math.h>
+
 #include "virg/nexus/nx_mem_block.h"
 #include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_arena.h"
+#include "virg/nexus/nx_math.h"
+#include "virg/nexus/nx_filter.h"
+
+#if (NX_SIMD_AVX2)
+#include <immintrin.h>
+#endif
 
 #define NX_HARRIS_KERNEL_TRUNCATION_FACTOR 3.0f
+#define NX_HARRIS_TILE_WIDTH 256
+
+#if (NX_SIMD_AVX2)
+static inline __m256i load8_epu8(const uchar *p)
+{
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+}
+#endif
 
 void nx_harris_deriv_images(struct NXImage **dimg,
                             const struct NXImage *img,
@@ -98,8 +116,244 @@ void nx_harris_score_image(struct NXImage *simg, struct NXImage **dimg, float k)
         }
 }
 
+/* Fills n entries of the I_x^2, I_y^2 and I_xI_y rows starting from column
+ * x_start of row y. Derivatives are the same as nx_image_deriv_x and
+ * nx_image_deriv_y, columns outside the image repeat the border. */
+static void harris_products(float **products, const struct NXImage *img,
+                            int y, int x_start, int n)
+{
+        const int w = img->width;
+        const uchar *row = img->data.uc + y * img->row_stride;
+        const uchar *row_m = (y > 0) ? row - img->row_stride : row;
+        const uchar *row_p = (y < img->height - 1) ? row + img->row_stride : row;
+        const float y_scale = (row_m == row || row_p == row) ? 2.0f : 1.0f;
+        float *x2 = products[0] - x_start;
+        float *y2 = products[1] - x_start;
+        float *xy = products[2] - x_start;
+
+        int x0 = nx_max_i(x_start, 0);
+        int x1 = nx_min_i(x_start + n, w);
+        int x = x0;
+        if (x == 0) {
+                float dx = 2.0f * (row[1] - row[0]) / 255.0f;
+                float dy = y_scale * (row_p[0] - row_m[0]) / 255.0f;
+                xy[0] = dx * dy;
+                x2[0] = dx * dx;
+                y2[0] = dy * dy;
+                ++x;
+        }
+
+        int x_end = nx_min_i(x1, w - 1);
+#if (NX_SIMD_AVX2)
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        const __m256 y_scale_v = _mm256_set1_ps(y_scale);
+        for (; x + 8 <= x_end; x += 8) {
+                __m256i dxi = _mm256_sub_epi32(load8_epu8(row + x + 1), load8_epu8(row + x - 1));
+                __m256i dyi = _mm256_sub_epi32(load8_epu8(row_p + x), load8_epu8(row_m + x));
+                __m256 dx = _mm256_div_ps(_mm256_cvtepi32_ps(dxi), scale);
+                __m256 dy = _mm256_div_ps(_mm256_mul_ps(y_scale_v, _mm256_cvtepi32_ps(dyi)), scale);
+                _mm256_storeu_ps(xy + x, _mm256_mul_ps(dx, dy));
+                _mm256_storeu_ps(x2 + x, _mm256_mul_ps(dx, dx));
+                _mm256_storeu_ps(y2 + x, _mm256_mul_ps(dy, dy));
+        }
+#endif
+        for (; x < x_end; ++x) {
+                float dx = (row[x+1] - row[x-1]) / 255.0f;
+                float dy = y_scale * (row_p[x] - row_m[x]) / 255.0f;
+                xy[x] = dx * dy;
+                x2[x] = dx * dx;
+                y2[x] = dy * dy;
+        }
+
+        if (x1 == w) {
+                float dx = 2.0f * (row[w-1] - row[w-2]) / 255.0f;
+                float dy = y_scale * (row_p[w-1] - row_m[w-1]) / 255.0f;
+                xy[w-1] = dx * dy;
+                x2[w-1] = dx * dx;
+                y2[w-1] = dy * dy;
+        }
+
+        for (int x = x_start; x < x0; ++x) {
+                x2[x] = x2[x0];
+                y2[x] = y2[x0];
+                xy[x] = xy[x0];
+        }
+        for (int x = x1; x < x_start + n; ++x) {
+                x2[x] = x2[x1-1];
+                y2[x] = y2[x1-1];
+                xy[x] = xy[x1-1];
+        }
+}
+
+static void harris_score_row(int n, float *s_row, float **m, float k,
+                             enum NXHarrisScoreType score_type)
+{
+        const float *x2_row = m[0];
+        const float *y2_row = m[1];
+        const float *xy_row = m[2];
+        switch (score_type) {
+        case NX_HARRIS_SCORE_HARRIS:
+                for (int x = 0; x < n; ++x) {
+                        float det = x2_row[x]*y2_row[x] - xy_row[x]*xy_row[x];
+                        float tr = x2_row[x] + y2_row[x];
+                        s_row[x] = det - k*tr*tr;
+                }
+                break;
+        case NX_HARRIS_SCORE_SHI_TOMASI: {
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                const __m256 half = _mm256_set1_ps(0.5f);
+                for (; x + 8 <= n; x += 8) {
+                        __m256 a = _mm256_loadu_ps(x2_row + x);
+                        __m256 c = _mm256_loadu_ps(y2_row + x);
+                        __m256 b = _mm256_loadu_ps(xy_row + x);
+                        __m256 hd = _mm256_mul_ps(half, _mm256_sub_ps(a, c));
+                        __m256 r = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(hd, hd), _mm256_mul_ps(b, b)));
+                        _mm256_storeu_ps(s_row + x, _mm256_sub_ps(_mm256_mul_ps(half, _mm256_add_ps(a, c)), r));
+                }
+#endif
+                for (; x < n; ++x) {
+                        float hd = 0.5f * (x2_row[x] - y2_row[x]);
+                        s_row[x] = 0.5f * (x2_row[x] + y2_row[x])
+                                - sqrtf(hd*hd + xy_row[x]*xy_row[x]);
+                }
+                break;
+        }
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for Harris score type");
+        }
+}
+
+void nx_harris_compute_score_image(struct NXImage *simg,
+                                   const struct NXImage *img,
+                                   float sigma_win, float k,
+                                   enum NXHarrisScoreType score_type)
+{
+        nx_harris_compute_score_image_region(simg, img, sigma_win, k,
+                                             score_type, NULL, 1.0f);
+}
+
+/* Zeros the score image outside [x0, x1) x [y0, y1) */
+static void harris_clear_outside(struct NXImage *simg,
+                                 int x0, int y0, int x1, int y1)
+{
+        const int w = simg->width;
+        if (x1 <= x0 || y1 <= y0) {
+                x0 = x1 = w;
+                y0 = y1 = simg->height;
+        }
+        for (int y = 0; y < simg->height; ++y) {
+                float *s_row = simg->data.f32 + y * simg->row_stride;
+                if (y < y0 || y >= y1) {
+                        memset(s_row, 0, w * sizeof(float));
+                } else {
+                        memset(s_row, 0, x0 * sizeof(float));
+                        memset(s_row + x1, 0, (w - x1) * sizeof(float));
+                }
+        }
+}
+
+void nx_harris_compute_score_image_region(struct NXImage *simg,
+                                          const struct NXImage *img,
+                                          float sigma_win, float k,
+                                          enum NXHarrisScoreType score_type,
+                                          const struct NXImageRegion *region,
+                                          float scale)
+{
+        NX_ASSERT_PTR(simg);
+        NX_ASSERT_PTR(img);
+        NX_IMAGE_ASSERT_GRAYSCALE_UCHAR(img);
+        NX_ASSERT(img->width > 1 && img->height > 1);
+
+        const int width = img->width;
+        const int height = img->height;
+        nx_image_resize(simg, width, height, NX_IMAGE_STRIDE_DEFAULT,
+                        NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+
+        // scores are needed one pixel around the keypoints for the non-maxima
+        // test
+        int bx0, by0, bx1, by1;
+        nx_image_region_level_bounds(region, scale, 1, width, height,
+                                     &bx0, &by0, &bx1, &by1);
+        if (region != NULL)
+                harris_clear_outside(simg, bx0, by0, bx1, by1);
+        if (bx1 <= bx0 || by1 <= by0)
+                return;
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+
+        int n_k = 1;
+        float *kernel = NULL;
+        if (sigma_win > 0.0f) {
+                n_k = nx_kernel_size_gaussian(sigma_win, NX_HARRIS_KERNEL_TRUNCATION_FACTOR) / 2 + 1;
+                kernel = NX_ARENA_NEW_S(arena, n_k);
+                nx_kernel_sym_gaussian(n_k, kernel, sigma_win);
+        }
+        const int radius = n_k - 1;
+        const int n_ring = 2 * radius + 1;
+
+        // Split the columns evenly so that no tile is too narrow to convolve
+        const int n_tiles = (bx1 - bx0 + NX_HARRIS_TILE_WIDTH - 1) / NX_HARRIS_TILE_WIDTH;
+        const int tile_width = (bx1 - bx0 + n_tiles - 1) / n_tiles;
+        const int ring_stride = nx_align_size(tile_width * sizeof(float), NX_ARENA_ALIGNMENT) / sizeof(float);
+
+        float *products[3];
+        float *ring[3];
+        float *m[3];
+        const float **rows = NX_ARENA_NEW(arena, n_ring, const float *);
+        for (int c = 0; c < 3; ++c) {
+                products[c] = NX_ARENA_NEW_S(arena, tile_width + 2 * radius);
+                ring[c] = NX_ARENA_NEW_S(arena, n_ring * ring_stride);
+                m[c] = NX_ARENA_NEW_S(arena, ring_stride);
+        }
+
+        for (int x0 = bx0; x0 < bx1; x0 += tile_width) {
+                const int w = nx_min_i(tile_width, bx1 - x0);
+                int n_loaded = nx_max_i(0, by0 - radius);
+                for (int y = by0; y < by1; ++y) {
+                        int last = nx_min_i(height - 1, y + radius);
+                        for (; n_loaded <= last; ++n_loaded) {
+                                harris_products(&products[0], img, n_loaded, x0 - radius, w + 2 * radius);
+                                for (int c = 0; c < 3; ++c) {
+                                        if (radius > 0)
+                                                nx_convolve_sym(w, products[c], n_k, kernel);
+                                        memcpy(ring[c] + (n_loaded % n_ring) * ring_stride,
+                                               products[c], w * sizeof(float));
+                                }
+                        }
+
+                        for (int c = 0; c < 3; ++c) {
+                                if (radius > 0) {
+                                        for (int i = -radius; i <= radius; ++i) {
+                                                int yi = nx_min_i(height - 1, nx_max_i(0, y + i));
+                                                rows[radius + i] = ring[c] + (yi % n_ring) * ring_stride;
+                                        }
+                                        nx_convolve_sym_rows(w, m[c], rows, n_k, kernel);
+                                } else {
+                                        memcpy(m[c], ring[c], w * sizeof(float));
+                                }
+                        }
+
+                        harris_score_row(w, simg->data.f32 + y * simg->row_stride + x0,
+                                         &m[0], k, score_type);
+                }
+        }
+
+        nx_arena_rewind(arena, mark);
+}
+
 int nx_harris_detect_keypoints(int n_keys_max, struct NXKeypoint *keys,
                                const struct NXImage *simg, float threshold)
+{
+        return nx_harris_detect_keypoints_region(n_keys_max, keys, simg,
+                                                 threshold, NULL, 1.0f);
+}
+
+int nx_harris_detect_keypoints_region(int n_keys_max, struct NXKeypoint *keys,
+                                      const struct NXImage *simg, float threshold,
+                                      const struct NXImageRegion *region,
+                                      float scale)
 {
         NX_ASSERT_PTR(keys);
         NX_ASSERT_PTR(simg);
@@ -114,19 +368,28 @@ int nx_harris_detect_keypoints(int n_keys_max, struct NXKeypoint *keys,
 
         int w = simg->width;
         int h = simg->height;
+        int x0, y0, x1, y1;
+        nx_image_region_level_bounds(region, scale, 0, w, h, &x0, &y0, &x1, &y1);
+        x0 = nx_max_i(x0, BORDER);
+        y0 = nx_max_i(y0, BORDER);
+        x1 = nx_min_i(x1, w - BORDER);
+        y1 = nx_min_i(y1, h - BORDER);
+
         int n = 0;
         struct NXKeypoint* key = keys;
-        for (int y = BORDER; y < h - BORDER; ++y) {
+        for (int y = y0; y < y1; ++y) {
                 const float* s_rowm = simg->data.f32 + (y-1)*simg->row_stride;
                 const float* s_row = simg->data.f32 + y*simg->row_stride;
                 const float* s_rowp = simg->data.f32 + (y+1)*simg->row_stride;
-                for (int x = BORDER; x < w - BORDER; ++x) {
+                for (int x = x0; x < x1; ++x) {
                         if (s_row[x] > threshold &&
                             s_row[x] > s_row[x-1] && s_row[x] > s_row[x+1]
                             && s_row[x] > s_rowm[x-1] && s_row[x] > s_rowm[x]
                             && s_row[x] > s_rowm[x+1]
                             && s_row[x] > s_rowp[x-1] && s_row[x] > s_rowp[x]
-                            && s_row[x] > s_rowp[x+1]) {
+                            && s_row[x] > s_rowp[x+1]
+                            && (region == NULL
+                                || nx_image_region_contains(region, x * scale, y * scale))) {
                                 key->x = x;
                                 key->y = y;
                                 key->xs = x;
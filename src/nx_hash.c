@@ -0,0 +1,719 @@
+/**
+ * @file nx_hash.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_hash.h"
+
+#include <string.h>
+
+#include "virg/nexus/nx_config.h"
+#if (NX_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+#include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_bit_ops.h"
+
+#define NX_HASH64_P1 0x9E3779B185EBCA87ULL
+#define NX_HASH64_P2 0xC2B2AE3D27D4EB4FULL
+#define NX_HASH64_P3 0x165667B19E3779F9ULL
+#define NX_HASH64_P4 0x85EBCA77C2B2AE63ULL
+#define NX_HASH64_P5 0x27D4EB2F165667C5ULL
+
+/* Inputs are read as little-endian words on little-endian hosts */
+static inline uint64_t nx_hash_read64(const uint8_t *p)
+{
+        uint64_t x;
+        memcpy(&x, p, sizeof(x));
+        return x;
+}
+
+static inline uint32_t nx_hash_read32(const uint8_t *p)
+{
+        uint32_t x;
+        memcpy(&x, p, sizeof(x));
+        return x;
+}
+
+static inline uint64_t nx_hash64_round(uint64_t acc, uint64_t input)
+{
+        acc += input * NX_HASH64_P2;
+        acc = nx_rotl64(acc, 31);
+        return acc * NX_HASH64_P1;
+}
+
+static inline uint64_t nx_hash64_merge(uint64_t h, uint64_t acc)
+{
+        h ^= nx_hash64_round(0, acc);
+        return h * NX_HASH64_P1 + NX_HASH64_P4;
+}
+
+/* Consumes the 32 byte stripes of data, returns the number of bytes used */
+static inline uint64_t nx_hash64_avalanche(uint64_t h)
+{
+        h ^= h >> 33;
+        h *= NX_HASH64_P2;
+        h ^= h >> 29;
+        h *= NX_HASH64_P3;
+        h ^= h >> 32;
+        return h;
+}
+
+static size_t nx_hash64_stripes(uint64_t *acc, const uint8_t *data, size_t n)
+{
+        uint64_t v0 = acc[0];
+        uint64_t v1 = acc[1];
+        uint64_t v2 = acc[2];
+        uint64_t v3 = acc[3];
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+                v0 = nx_hash64_round(v0, nx_hash_read64(data + i));
+                v1 = nx_hash64_round(v1, nx_hash_read64(data + i + 8));
+                v2 = nx_hash64_round(v2, nx_hash_read64(data + i + 16));
+                v3 = nx_hash64_round(v3, nx_hash_read64(data + i + 24));
+#if defined(__GNUC__)
+                /* Keeps GCC from vectorizing the lanes with emulated 64-bit
+                 * multiplies, three times slower than the scalar rounds. */
+                __asm__("" : "+r" (v0));
+#endif
+        }
+        acc[0] = v0;
+        acc[1] = v1;
+        acc[2] = v2;
+        acc[3] = v3;
+        return i;
+}
+
+void nx_hash64_init(struct NXHash64State *state, uint64_t seed)
+{
+        NX_ASSERT_PTR(state);
+
+        state->acc[0] = seed + NX_HASH64_P1 + NX_HASH64_P2;
+        state->acc[1] = seed + NX_HASH64_P2;
+        state->acc[2] = seed;
+        state->acc[3] = seed - NX_HASH64_P1;
+        state->seed = seed;
+        state->n_total = 0;
+        state->n_stripe = 0;
+}
+
+void nx_hash64_update(struct NXHash64State *state, const void *data, size_t n)
+{
+        NX_ASSERT_PTR(state);
+        NX_ASSERT(n == 0 || data != NULL);
+
+        const uint8_t *p = (const uint8_t *)data;
+        state->n_total += n;
+
+        if (state->n_stripe > 0) {
+                size_t n_fill = 32 - state->n_stripe;
+                if (n < n_fill) {
+                        memcpy(state->stripe + state->n_stripe, p, n);
+                        state->n_stripe += n;
+                        return;
+                }
+                memcpy(state->stripe + state->n_stripe, p, n_fill);
+                nx_hash64_stripes(state->acc, state->stripe, 32);
+                state->n_stripe = 0;
+                p += n_fill;
+                n -= n_fill;
+        }
+
+        size_t n_used = nx_hash64_stripes(state->acc, p, n);
+        memcpy(state->stripe, p + n_used, n - n_used);
+        state->n_stripe = n - n_used;
+}
+
+uint64_t nx_hash64_final(const struct NXHash64State *state)
+{
+        NX_ASSERT_PTR(state);
+
+        uint64_t h;
+        if (state->n_total >= 32) {
+                const uint64_t *v = &state->acc[0];
+                h = nx_rotl64(v[0], 1) + nx_rotl64(v[1], 7)
+                        + nx_rotl64(v[2], 12) + nx_rotl64(v[3], 18);
+                for (int i = 0; i < 4; ++i)
+                        h = nx_hash64_merge(h, v[i]);
+        } else {
+                h = state->seed + NX_HASH64_P5;
+        }
+        h += state->n_total;
+
+        const uint8_t *p = state->stripe;
+        const uint8_t *end = p + state->n_stripe;
+        for (; p + 8 <= end; p += 8) {
+                h ^= nx_hash64_round(0, nx_hash_read64(p));
+                h = nx_rotl64(h, 27) * NX_HASH64_P1 + NX_HASH64_P4;
+        }
+        if (p + 4 <= end) {
+                h ^= (uint64_t)nx_hash_read32(p) * NX_HASH64_P1;
+                h = nx_rotl64(h, 23) * NX_HASH64_P2 + NX_HASH64_P3;
+                p += 4;
+        }
+        for (; p < end; ++p) {
+                h ^= *p * NX_HASH64_P5;
+                h = nx_rotl64(h, 11) * NX_HASH64_P1;
+        }
+
+        return nx_hash64_avalanche(h);
+}
+
+uint64_t nx_hash64(const void *data, size_t n, uint64_t seed)
+{
+        struct NXHash64State state;
+        nx_hash64_init(&state, seed);
+        nx_hash64_update(&state, data, n);
+        return nx_hash64_final(&state);
+}
+
+uint64_t nx_hash64_multi(int n_msg, const uint8_t * const *msg,
+                         const size_t *lmsg, uint64_t seed)
+{
+        NX_ASSERT(n_msg >= 0);
+        NX_ASSERT(n_msg == 0 || (msg != NULL && lmsg != NULL));
+
+        struct NXHash64State state;
+        nx_hash64_init(&state, seed);
+        for (int i = 0; i < n_msg; ++i)
+                nx_hash64_update(&state, msg[i], lmsg[i]);
+        return nx_hash64_final(&state);
+}
+
+#define NX_HASH3_P32_1 0x9E3779B1U
+#define NX_HASH3_P32_2 0x85EBCA77U
+#define NX_HASH3_P32_3 0xC2B2AE3DU
+#define NX_HASH3_MX1 0x165667919E3779F9ULL
+#define NX_HASH3_MX2 0x9FB21C651E98DF25ULL
+
+#define NX_HASH3_STRIPE_LEN 64
+#define NX_HASH3_STRIPES_PER_BLOCK ((NX_HASH3_SECRET_SIZE - NX_HASH3_STRIPE_LEN) / 8)
+#define NX_HASH3_MIDSIZE_MAX 240
+#define NX_HASH3_SECRET_SIZE_MIN 136
+#define NX_HASH3_LASTACC_START 7
+#define NX_HASH3_MERGEACCS_START 11
+#define NX_HASH3_MIDSIZE_STARTOFFSET 3
+#define NX_HASH3_MIDSIZE_LASTOFFSET 17
+
+static const uint8_t NX_HASH3_SECRET[NX_HASH3_SECRET_SIZE] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline void nx_hash_mul128(uint64_t a, uint64_t b, uint64_t *lo, uint64_t *hi)
+{
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 p = (unsigned __int128)a * b;
+        *lo = (uint64_t)p;
+        *hi = (uint64_t)(p >> 64);
+#else
+        uint64_t lo_lo = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+        uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFFULL);
+        uint64_t lo_hi = (a & 0xFFFFFFFFULL) * (b >> 32);
+        uint64_t hi_hi = (a >> 32) * (b >> 32);
+        uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+        *hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+        *lo = (cross << 32) | (lo_lo & 0xFFFFFFFFULL);
+#endif
+}
+
+static inline uint64_t nx_hash3_mul128_fold64(uint64_t a, uint64_t b)
+{
+        uint64_t lo, hi;
+        nx_hash_mul128(a, b, &lo, &hi);
+        return lo ^ hi;
+}
+
+static inline uint64_t nx_hash3_avalanche(uint64_t h)
+{
+        h ^= h >> 37;
+        h *= NX_HASH3_MX1;
+        return h ^ (h >> 32);
+}
+
+static inline uint64_t nx_hash3_rrmxmx(uint64_t h, uint64_t n)
+{
+        h ^= nx_rotl64(h, 49) ^ nx_rotl64(h, 24);
+        h *= NX_HASH3_MX2;
+        h ^= (h >> 35) + n;
+        h *= NX_HASH3_MX2;
+        return h ^ (h >> 28);
+}
+
+static inline uint64_t nx_hash3_mix16(const uint8_t *p, const uint8_t *secret,
+                                      uint64_t seed)
+{
+        return nx_hash3_mul128_fold64(nx_hash_read64(p) ^ (nx_hash_read64(secret) + seed),
+                                      nx_hash_read64(p + 8) ^ (nx_hash_read64(secret + 8) - seed));
+}
+
+static uint64_t nx_hash3_64_short(const uint8_t *p, size_t n, const uint8_t *secret,
+                                  uint64_t seed)
+{
+        if (n > 128) {
+                uint64_t acc = n * NX_HASH64_P1;
+                for (int i = 0; i < 8; ++i)
+                        acc += nx_hash3_mix16(p + 16 * i, secret + 16 * i, seed);
+                acc = nx_hash3_avalanche(acc);
+
+                uint64_t acc_end = nx_hash3_mix16(p + n - 16, secret + NX_HASH3_SECRET_SIZE_MIN
+                                                  - NX_HASH3_MIDSIZE_LASTOFFSET, seed);
+                const int n_rounds = (int)n / 16;
+                for (int i = 8; i < n_rounds; ++i)
+                        acc_end += nx_hash3_mix16(p + 16 * i, secret + 16 * (i - 8)
+                                                  + NX_HASH3_MIDSIZE_STARTOFFSET, seed);
+                return nx_hash3_avalanche(acc + acc_end);
+        } else if (n > 16) {
+                uint64_t acc = n * NX_HASH64_P1;
+                for (int i = (int)(n - 1) / 32; i >= 0; --i) {
+                        acc += nx_hash3_mix16(p + 16 * i, secret + 32 * i, seed);
+                        acc += nx_hash3_mix16(p + n - 16 * (i + 1), secret + 32 * i + 16, seed);
+                }
+                return nx_hash3_avalanche(acc);
+        } else if (n > 8) {
+                uint64_t flip1 = (nx_hash_read64(secret + 24) ^ nx_hash_read64(secret + 32)) + seed;
+                uint64_t flip2 = (nx_hash_read64(secret + 40) ^ nx_hash_read64(secret + 48)) - seed;
+                uint64_t lo = nx_hash_read64(p) ^ flip1;
+                uint64_t hi = nx_hash_read64(p + n - 8) ^ flip2;
+                uint64_t acc = n + __builtin_bswap64(lo) + hi + nx_hash3_mul128_fold64(lo, hi);
+                return nx_hash3_avalanche(acc);
+        } else if (n >= 4) {
+                seed ^= (uint64_t)__builtin_bswap32((uint32_t)seed) << 32;
+                uint64_t flip = (nx_hash_read64(secret + 8) ^ nx_hash_read64(secret + 16)) - seed;
+                uint64_t x = nx_hash_read32(p + n - 4) + ((uint64_t)nx_hash_read32(p) << 32);
+                return nx_hash3_rrmxmx(x ^ flip, n);
+        } else if (n > 0) {
+                uint32_t c = ((uint32_t)p[0] << 16) | ((uint32_t)p[n >> 1] << 24)
+                        | (uint32_t)p[n - 1] | ((uint32_t)n << 8);
+                uint64_t flip = (nx_hash_read32(secret) ^ nx_hash_read32(secret + 4)) + seed;
+                return nx_hash64_avalanche(c ^ flip);
+        } else {
+                return nx_hash64_avalanche(seed ^ nx_hash_read64(secret + 56)
+                                           ^ nx_hash_read64(secret + 64));
+        }
+}
+
+static inline struct NXHash128 nx_hash3_mix32(struct NXHash128 acc, const uint8_t *p0,
+                                              const uint8_t *p1, const uint8_t *secret,
+                                              uint64_t seed)
+{
+        acc.lo += nx_hash3_mix16(p0, secret, seed);
+        acc.lo ^= nx_hash_read64(p1) + nx_hash_read64(p1 + 8);
+        acc.hi += nx_hash3_mix16(p1, secret + 16, seed);
+        acc.hi ^= nx_hash_read64(p0) + nx_hash_read64(p0 + 8);
+        return acc;
+}
+
+static inline struct NXHash128 nx_hash3_128_mid_final(struct NXHash128 acc, size_t n,
+                                                      uint64_t seed)
+{
+        struct NXHash128 h;
+        h.lo = nx_hash3_avalanche(acc.lo + acc.hi);
+        h.hi = 0 - nx_hash3_avalanche(acc.lo * NX_HASH64_P1 + acc.hi * NX_HASH64_P4
+                                      + (n - seed) * NX_HASH64_P2);
+        return h;
+}
+
+static struct NXHash128 nx_hash3_128_short(const uint8_t *p, size_t n,
+                                           const uint8_t *secret, uint64_t seed)
+{
+        struct NXHash128 h;
+        if (n > 128) {
+                struct NXHash128 acc = { n * NX_HASH64_P1, 0 };
+                for (int i = 32; i < 160; i += 32)
+                        acc = nx_hash3_mix32(acc, p + i - 32, p + i - 16, secret + i - 32, seed);
+                acc.lo = nx_hash3_avalanche(acc.lo);
+                acc.hi = nx_hash3_avalanche(acc.hi);
+                for (size_t i = 160; i <= n; i += 32)
+                        acc = nx_hash3_mix32(acc, p + i - 32, p + i - 16,
+                                             secret + NX_HASH3_MIDSIZE_STARTOFFSET + i - 160, seed);
+                acc = nx_hash3_mix32(acc, p + n - 16, p + n - 32,
+                                     secret + NX_HASH3_SECRET_SIZE_MIN
+                                     - NX_HASH3_MIDSIZE_LASTOFFSET - 16, 0 - seed);
+                return nx_hash3_128_mid_final(acc, n, seed);
+        } else if (n > 16) {
+                struct NXHash128 acc = { n * NX_HASH64_P1, 0 };
+                for (int i = (int)(n - 1) / 32; i >= 0; --i)
+                        acc = nx_hash3_mix32(acc, p + 16 * i, p + n - 16 * (i + 1),
+                                             secret + 32 * i, seed);
+                return nx_hash3_128_mid_final(acc, n, seed);
+        } else if (n > 8) {
+                uint64_t flip_lo = (nx_hash_read64(secret + 32) ^ nx_hash_read64(secret + 40)) - seed;
+                uint64_t flip_hi = (nx_hash_read64(secret + 48) ^ nx_hash_read64(secret + 56)) + seed;
+                uint64_t in_lo = nx_hash_read64(p);
+                uint64_t in_hi = nx_hash_read64(p + n - 8);
+                uint64_t m_lo, m_hi;
+                nx_hash_mul128(in_lo ^ in_hi ^ flip_lo, NX_HASH64_P1, &m_lo, &m_hi);
+                m_lo += (uint64_t)(n - 1) << 54;
+                in_hi ^= flip_hi;
+                m_hi += in_hi + (uint64_t)(uint32_t)in_hi * (NX_HASH3_P32_2 - 1);
+                m_lo ^= __builtin_bswap64(m_hi);
+                nx_hash_mul128(m_lo, NX_HASH64_P2, &h.lo, &h.hi);
+                h.hi += m_hi * NX_HASH64_P2;
+                h.lo = nx_hash3_avalanche(h.lo);
+                h.hi = nx_hash3_avalanche(h.hi);
+        } else if (n >= 4) {
+                seed ^= (uint64_t)__builtin_bswap32((uint32_t)seed) << 32;
+                uint64_t x = nx_hash_read32(p) + ((uint64_t)nx_hash_read32(p + n - 4) << 32);
+                uint64_t flip = (nx_hash_read64(secret + 16) ^ nx_hash_read64(secret + 24)) + seed;
+                nx_hash_mul128(x ^ flip, NX_HASH64_P1 + (n << 2), &h.lo, &h.hi);
+                h.hi += h.lo << 1;
+                h.lo ^= h.hi >> 3;
+                h.lo ^= h.lo >> 35;
+                h.lo *= NX_HASH3_MX2;
+                h.lo ^= h.lo >> 28;
+                h.hi = nx_hash3_avalanche(h.hi);
+        } else if (n > 0) {
+                uint32_t c_lo = ((uint32_t)p[0] << 16) | ((uint32_t)p[n >> 1] << 24)
+                        | (uint32_t)p[n - 1] | ((uint32_t)n << 8);
+                uint32_t c_hi = nx_rotl32(__builtin_bswap32(c_lo), 13);
+                uint64_t flip_lo = (nx_hash_read32(secret) ^ nx_hash_read32(secret + 4)) + seed;
+                uint64_t flip_hi = (nx_hash_read32(secret + 8) ^ nx_hash_read32(secret + 12)) - seed;
+                h.lo = nx_hash64_avalanche(c_lo ^ flip_lo);
+                h.hi = nx_hash64_avalanche(c_hi ^ flip_hi);
+        } else {
+                h.lo = nx_hash64_avalanche(seed ^ nx_hash_read64(secret + 64)
+                                           ^ nx_hash_read64(secret + 72));
+                h.hi = nx_hash64_avalanche(seed ^ nx_hash_read64(secret + 80)
+                                           ^ nx_hash_read64(secret + 88));
+        }
+        return h;
+}
+
+/* Accumulates n_stripes consecutive stripes against the secret advancing by 8
+ * bytes per stripe. */
+static void nx_hash3_accumulate(uint64_t *acc, const uint8_t *p, const uint8_t *secret,
+                                int n_stripes)
+{
+#if (NX_SIMD_AVX2)
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(acc + 4));
+        for (int s = 0; s < n_stripes; ++s) {
+                const uint8_t *ps = p + s * NX_HASH3_STRIPE_LEN;
+                const uint8_t *ks = secret + s * 8;
+                __m256i d0 = _mm256_loadu_si256((const __m256i *)ps);
+                __m256i d1 = _mm256_loadu_si256((const __m256i *)(ps + 32));
+                __m256i dk0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i *)ks));
+                __m256i dk1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i *)(ks + 32)));
+                __m256i prod0 = _mm256_mul_epu32(dk0, _mm256_srli_epi64(dk0, 32));
+                __m256i prod1 = _mm256_mul_epu32(dk1, _mm256_srli_epi64(dk1, 32));
+                a0 = _mm256_add_epi64(a0, _mm256_add_epi64(prod0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+                a1 = _mm256_add_epi64(a1, _mm256_add_epi64(prod1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        _mm256_storeu_si256((__m256i *)acc, a0);
+        _mm256_storeu_si256((__m256i *)(acc + 4), a1);
+#else
+        for (int s = 0; s < n_stripes; ++s) {
+                const uint8_t *ps = p + s * NX_HASH3_STRIPE_LEN;
+                const uint8_t *ks = secret + s * 8;
+                for (int i = 0; i < 8; ++i) {
+                        uint64_t d = nx_hash_read64(ps + 8 * i);
+                        uint64_t dk = d ^ nx_hash_read64(ks + 8 * i);
+                        acc[i ^ 1] += d;
+                        acc[i] += (dk & 0xFFFFFFFFULL) * (dk >> 32);
+                }
+        }
+#endif
+}
+
+static void nx_hash3_scramble(uint64_t *acc, const uint8_t *secret)
+{
+#if (NX_SIMD_AVX2)
+        const __m256i prime = _mm256_set1_epi32((int)NX_HASH3_P32_1);
+        for (int i = 0; i < 8; i += 4) {
+                __m256i a = _mm256_loadu_si256((const __m256i *)(acc + i));
+                a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+                a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *)(secret + 8 * i)));
+                __m256i lo = _mm256_mul_epu32(a, prime);
+                __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+                _mm256_storeu_si256((__m256i *)(acc + i),
+                                    _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+        }
+#else
+        for (int i = 0; i < 8; ++i) {
+                uint64_t a = acc[i];
+                a ^= a >> 47;
+                a ^= nx_hash_read64(secret + 8 * i);
+                acc[i] = a * NX_HASH3_P32_1;
+        }
+#endif
+}
+
+/* Consumes whole stripes, scrambling the accumulators at the end of every
+ * block of NX_HASH3_STRIPES_PER_BLOCK stripes. */
+static void nx_hash3_consume(uint64_t *acc, int *n_stripes_in_block, const uint8_t *p,
+                             size_t n_stripes, const uint8_t *secret)
+{
+        while (n_stripes > 0) {
+                int n_left = NX_HASH3_STRIPES_PER_BLOCK - *n_stripes_in_block;
+                int n = n_stripes < (size_t)n_left ? (int)n_stripes : n_left;
+                nx_hash3_accumulate(acc, p, secret + *n_stripes_in_block * 8, n);
+                p += n * NX_HASH3_STRIPE_LEN;
+                n_stripes -= n;
+                *n_stripes_in_block += n;
+                if (*n_stripes_in_block == NX_HASH3_STRIPES_PER_BLOCK) {
+                        nx_hash3_scramble(acc, secret + NX_HASH3_SECRET_SIZE
+                                          - NX_HASH3_STRIPE_LEN);
+                        *n_stripes_in_block = 0;
+                }
+        }
+}
+
+static inline void nx_hash3_init_acc(uint64_t *acc)
+{
+        acc[0] = NX_HASH3_P32_3;
+        acc[1] = NX_HASH64_P1;
+        acc[2] = NX_HASH64_P2;
+        acc[3] = NX_HASH64_P3;
+        acc[4] = NX_HASH64_P4;
+        acc[5] = NX_HASH3_P32_2;
+        acc[6] = NX_HASH64_P5;
+        acc[7] = NX_HASH3_P32_1;
+}
+
+static void nx_hash3_init_secret(uint8_t *secret, uint64_t seed)
+{
+        for (int i = 0; i < NX_HASH3_SECRET_SIZE; i += 16) {
+                uint64_t lo = nx_hash_read64(NX_HASH3_SECRET + i) + seed;
+                uint64_t hi = nx_hash_read64(NX_HASH3_SECRET + i + 8) - seed;
+                memcpy(secret + i, &lo, sizeof(lo));
+                memcpy(secret + i + 8, &hi, sizeof(hi));
+        }
+}
+
+static uint64_t nx_hash3_merge(const uint64_t *acc, const uint8_t *secret, uint64_t h)
+{
+        for (int i = 0; i < 4; ++i)
+                h += nx_hash3_mul128_fold64(acc[2 * i] ^ nx_hash_read64(secret + 16 * i),
+                                            acc[2 * i + 1] ^ nx_hash_read64(secret + 16 * i + 8));
+        return nx_hash3_avalanche(h);
+}
+
+static inline uint64_t nx_hash3_long_final64(const uint64_t *acc, const uint8_t *secret,
+                                             uint64_t n)
+{
+        return nx_hash3_merge(acc, secret + NX_HASH3_MERGEACCS_START, n * NX_HASH64_P1);
+}
+
+static inline struct NXHash128 nx_hash3_long_final128(const uint64_t *acc,
+                                                      const uint8_t *secret, uint64_t n)
+{
+        struct NXHash128 h;
+        h.lo = nx_hash3_merge(acc, secret + NX_HASH3_MERGEACCS_START, n * NX_HASH64_P1);
+        h.hi = nx_hash3_merge(acc, secret + NX_HASH3_SECRET_SIZE - 64 - NX_HASH3_MERGEACCS_START,
+                              ~(n * NX_HASH64_P2));
+        return h;
+}
+
+/* Accumulators of an input longer than NX_HASH3_MIDSIZE_MAX, the last stripe
+ * always overlaps the end of the input. */
+static void nx_hash3_long(uint64_t *acc, const uint8_t *p, size_t n, const uint8_t *secret)
+{
+        nx_hash3_init_acc(acc);
+        int n_stripes_in_block = 0;
+        nx_hash3_consume(acc, &n_stripes_in_block, p, (n - 1) / NX_HASH3_STRIPE_LEN, secret);
+        nx_hash3_accumulate(acc, p + n - NX_HASH3_STRIPE_LEN, secret + NX_HASH3_SECRET_SIZE
+                            - NX_HASH3_STRIPE_LEN - NX_HASH3_LASTACC_START, 1);
+}
+
+uint64_t nx_hash3_64(const void *data, size_t n, uint64_t seed)
+{
+        NX_ASSERT(n == 0 || data != NULL);
+
+        const uint8_t *p = (const uint8_t *)data;
+        if (n <= NX_HASH3_MIDSIZE_MAX)
+                return nx_hash3_64_short(p, n, NX_HASH3_SECRET, seed);
+
+        uint8_t custom_secret[NX_HASH3_SECRET_SIZE];
+        const uint8_t *secret = NX_HASH3_SECRET;
+        if (seed != 0) {
+                nx_hash3_init_secret(custom_secret, seed);
+                secret = custom_secret;
+        }
+
+        uint64_t acc[8];
+        nx_hash3_long(acc, p, n, secret);
+        return nx_hash3_long_final64(acc, secret, n);
+}
+
+struct NXHash128 nx_hash3_128(const void *data, size_t n, uint64_t seed)
+{
+        NX_ASSERT(n == 0 || data != NULL);
+
+        const uint8_t *p = (const uint8_t *)data;
+        if (n <= NX_HASH3_MIDSIZE_MAX)
+                return nx_hash3_128_short(p, n, NX_HASH3_SECRET, seed);
+
+        uint8_t custom_secret[NX_HASH3_SECRET_SIZE];
+        const uint8_t *secret = NX_HASH3_SECRET;
+        if (seed != 0) {
+                nx_hash3_init_secret(custom_secret, seed);
+                secret = custom_secret;
+        }
+
+        uint64_t acc[8];
+        nx_hash3_long(acc, p, n, secret);
+        return nx_hash3_long_final128(acc, secret, n);
+}
+
+void nx_hash3_init(struct NXHash3State *state, uint64_t seed)
+{
+        NX_ASSERT_PTR(state);
+
+        nx_hash3_init_acc(&state->acc[0]);
+        nx_hash3_init_secret(&state->secret[0], seed);
+        state->seed = seed;
+        state->n_total = 0;
+        state->n_buffer = 0;
+        state->n_stripes = 0;
+}
+
+/* The buffer always keeps at least one byte, the last stripe is only known
+ * when the state is finalized. Once stripes are consumed, the last 64 bytes
+ * of the buffer hold the end of the consumed input for a short last stripe. */
+void nx_hash3_update(struct NXHash3State *state, const void *data, size_t n)
+{
+        NX_ASSERT_PTR(state);
+        NX_ASSERT(n == 0 || data != NULL);
+
+        const uint8_t *p = (const uint8_t *)data;
+        state->n_total += n;
+        if (n <= (size_t)(NX_HASH3_BUFFER_SIZE - state->n_buffer)) {
+                if (n > 0)
+                        memcpy(state->buffer + state->n_buffer, p, n);
+                state->n_buffer += (int)n;
+                return;
+        }
+
+        if (state->n_buffer > 0) {
+                size_t n_fill = NX_HASH3_BUFFER_SIZE - state->n_buffer;
+                memcpy(state->buffer + state->n_buffer, p, n_fill);
+                p += n_fill;
+                n -= n_fill;
+                nx_hash3_consume(&state->acc[0], &state->n_stripes, state->buffer,
+                                 NX_HASH3_BUFFER_SIZE / NX_HASH3_STRIPE_LEN, state->secret);
+                state->n_buffer = 0;
+        }
+
+        if (n > NX_HASH3_BUFFER_SIZE) {
+                size_t n_stripes = (n - 1) / NX_HASH3_STRIPE_LEN;
+                nx_hash3_consume(&state->acc[0], &state->n_stripes, p, n_stripes,
+                                 state->secret);
+                p += n_stripes * NX_HASH3_STRIPE_LEN;
+                n -= n_stripes * NX_HASH3_STRIPE_LEN;
+                memcpy(state->buffer + NX_HASH3_BUFFER_SIZE - NX_HASH3_STRIPE_LEN,
+                       p - NX_HASH3_STRIPE_LEN, NX_HASH3_STRIPE_LEN);
+        }
+
+        memcpy(state->buffer, p, n);
+        state->n_buffer = (int)n;
+}
+
+static void nx_hash3_final_acc(const struct NXHash3State *state, uint64_t *acc)
+{
+        memcpy(acc, state->acc, sizeof(state->acc));
+
+        uint8_t last_stripe[NX_HASH3_STRIPE_LEN];
+        const uint8_t *last = last_stripe;
+        if (state->n_buffer >= NX_HASH3_STRIPE_LEN) {
+                int n_stripes = state->n_stripes;
+                nx_hash3_consume(acc, &n_stripes, state->buffer,
+                                 (state->n_buffer - 1) / NX_HASH3_STRIPE_LEN, state->secret);
+                last = state->buffer + state->n_buffer - NX_HASH3_STRIPE_LEN;
+        } else {
+                int n_catchup = NX_HASH3_STRIPE_LEN - state->n_buffer;
+                memcpy(last_stripe, state->buffer + NX_HASH3_BUFFER_SIZE - n_catchup, n_catchup);
+                memcpy(last_stripe + n_catchup, state->buffer, state->n_buffer);
+        }
+        nx_hash3_accumulate(acc, last, state->secret + NX_HASH3_SECRET_SIZE
+                            - NX_HASH3_STRIPE_LEN - NX_HASH3_LASTACC_START, 1);
+}
+
+uint64_t nx_hash3_final64(const struct NXHash3State *state)
+{
+        NX_ASSERT_PTR(state);
+
+        if (state->n_total <= NX_HASH3_MIDSIZE_MAX)
+                return nx_hash3_64_short(state->buffer, state->n_total,
+                                         NX_HASH3_SECRET, state->seed);
+
+        uint64_t acc[8];
+        nx_hash3_final_acc(state, &acc[0]);
+        return nx_hash3_long_final64(&acc[0], state->secret, state->n_total);
+}
+
+struct NXHash128 nx_hash3_final128(const struct NXHash3State *state)
+{
+        NX_ASSERT_PTR(state);
+
+        if (state->n_total <= NX_HASH3_MIDSIZE_MAX)
+                return nx_hash3_128_short(state->buffer, state->n_total,
+                                          NX_HASH3_SECRET, state->seed);
+
+        uint64_t acc[8];
+        nx_hash3_final_acc(state, &acc[0]);
+        return nx_hash3_long_final128(&acc[0], state->secret, state->n_total);
+}
+
+uint64_t nx_hash3_64_multi(int n_msg, const uint8_t * const *msg,
+                           const size_t *lmsg, uint64_t seed)
+{
+        NX_ASSERT(n_msg >= 0);
+        NX_ASSERT(n_msg == 0 || (msg != NULL && lmsg != NULL));
+
+        if (n_msg == 1)
+                return nx_hash3_64(msg[0], lmsg[0], seed);
+
+        struct NXHash3State state;
+        nx_hash3_init(&state, seed);
+        for (int i = 0; i < n_msg; ++i)
+                nx_hash3_update(&state, msg[i], lmsg[i]);
+        return nx_hash3_final64(&state);
+}
+
+struct NXHash128 nx_hash3_128_multi(int n_msg, const uint8_t * const *msg,
+                                    const size_t *lmsg, uint64_t seed)
+{
+        NX_ASSERT(n_msg >= 0);
+        NX_ASSERT(n_msg == 0 || (msg != NULL && lmsg != NULL));
+
+        if (n_msg == 1)
+                return nx_hash3_128(msg[0], lmsg[0], seed);
+
+        struct NXHash3State state;
+        nx_hash3_init(&state, seed);
+        for (int i = 0; i < n_msg; ++i)
+                nx_hash3_update(&state, msg[i], lmsg[i]);
+        return nx_hash3_final128(&state);
+}
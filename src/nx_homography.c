@@ -30,6 +30,7 @@
 #include <float.h>
 
 #include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_arena.h"
 #include "virg/nexus/nx_math.h"
 #include "virg/nexus/nx_uniform_sampler.h"
 #include "virg/nexus/nx_mat234.h"
@@ -222,13 +223,15 @@ double nx_homography_estimate_dlt(double *h, int n_corr, const struct NXPointMat
         }
 
         size_t lA = 2*n_corr * 9;
-        double *A = NX_NEW_D(lA);
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        double *A = NX_ARENA_NEW_D(arena, lA);
         double *Ac = A;
         for (int i = 0; i < n_corr; ++i, Ac += 18)
                 nx_homography_constraints_from_corr(Ac, corr_list + i);
 
         double sval = nx_homography_svd_solve(h, n_corr, A);
-        nx_free(A);
+        nx_arena_rewind(arena, mark);
 
         return sval;
 }
@@ -242,7 +245,9 @@ double nx_homography_estimate_dlt_inliers(double *h, int n_corr, const struct NX
         }
 
         size_t lA = 2*n_inliers * 9;
-        double *A = NX_NEW_D(lA);
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        double *A = NX_ARENA_NEW_D(arena, lA);
         double *Ac = A;
         for (int i = 0; i < n_corr; ++i)
                 if (corr_list[i].is_inlier) {
@@ -251,26 +256,14 @@ double nx_homography_estimate_dlt_inliers(double *h, int n_corr, const struct NX
                 }
 
         double sval = nx_homography_svd_solve(h, n_inliers, A);
-        nx_free(A);
+        nx_arena_rewind(arena, mark);
 
         return sval;
 }
 
 static inline void nx_select_prosac_candidates(int n_top, int corr_ids[4])
 {
-        corr_ids[0] = (int)(NX_UNIFORM_SAMPLE_S*n_top);
-
-        do {
-            corr_ids[1] = (int)(NX_UNIFORM_SAMPLE_S*n_top);
-        } while(corr_ids[1]==corr_ids[0]);
-
-        do {
-            corr_ids[2] = (int)(NX_UNIFORM_SAMPLE_S*n_top);
-        } while(corr_ids[2]==corr_ids[1] || corr_ids[2]==corr_ids[0]);
-
-        do {
-            corr_ids[3] = (int)(NX_UNIFORM_SAMPLE_S*n_top);
-        } while(corr_ids[3]==corr_ids[1] || corr_ids[3]==corr_ids[1] || corr_ids[3]==corr_ids[0]);
+        nx_uniform_sampler_fill_index(nx_uniform_sampler_instance(), 4, corr_ids, n_top);
 }
 
 int nx_homography_estimate_ransac(double *h, int n_corr, struct NXPointMatch2D *corr_list, double inlier_tolerance, int max_n_iter)
@@ -28,17 +28,77 @@
 #include <stdlib.h>
 #include <string.h>
 #include <float.h>
+#include <math.h>
 
 #include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_arena.h"
 #include "virg/nexus/nx_io.h"
 #include "virg/nexus/nx_math.h"
+#include "virg/nexus/nx_vmath.h"
 #include "virg/nexus/nx_mat234.h"
 #include "virg/nexus/nx_mem_block.h"
+#include "virg/nexus/nx_image_pool.h"
 #include "virg/nexus/nx_colorspace.h"
 #include "virg/nexus/nx_filter.h"
+#include "virg/nexus/nx_integral_image.h"
 #include "virg/nexus/nx_transform_2d.h"
 #include "virg/nexus/nx_image_warp.h"
+#include "virg/nexus/nx_thread_pool.h"
+
+#if (NX_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+#define NX_IMAGE_SMOOTH_BLOCK_WIDTH 512
+/* nx_image_smooth switches to the recursive Gaussian from this sigma on. The
+ * FIR and recursive passes break even around 2.0 to 2.5 on AVX2 at 4K, the
+ * recursive filter is also less accurate for small sigmas. */
+#define NX_IMAGE_SMOOTH_IIR_MIN_SIGMA 3.0f
+#define NX_IMAGE_SMOOTH_IIR_BAND_HEIGHT 16
+#define NX_IMAGE_SMOOTH_IIR_BLOCK_WIDTH 32
+/* Parallel chunks cover at least this many pixels, smaller images are
+ * processed on the calling thread. */
+#define NX_IMAGE_PARALLEL_MIN_PIXELS (64 * 1024)
+#define NX_IMAGE_PARALLEL_CHUNKS_PER_THREAD 2
+
+/* Arguments of the row band functions run by nx_image_parallel_for */
+struct NXImageRowsJob
+{
+        struct NXImage *dest;
+        const struct NXImage *src;
+        float scale_f;
+};
+
+/* Hands owned, aligned storage to the image pool when it is enabled */
+static void nx_image_mem_release(struct NXMemBlock *mem)
+{
+        if (mem->own_memory && mem->ptr && nx_image_pool_is_enabled()
+            && ((size_t)mem->ptr % NX_SIMD_ALIGNMENT) == 0) {
+                nx_image_pool_return(mem->ptr, mem->capacity);
+                mem->ptr = NULL;
+                mem->size = 0;
+                mem->capacity = 0;
+                mem->own_memory = NX_FALSE;
+        } else {
+                nx_mem_block_release(mem);
+        }
+}
+
+/* Grows storage through the image pool when it is enabled, contents are not
+ * preserved in that case */
+static void nx_image_mem_resize(struct NXMemBlock *mem, size_t sz)
+{
+        if (sz > mem->capacity && sz >= NX_IMAGE_POOL_MIN_BYTES
+            && nx_image_pool_is_enabled()) {
+                nx_image_mem_release(mem);
+                size_t capacity;
+                void *ptr = nx_image_pool_checkout(sz, &capacity);
+                nx_mem_block_wrap(mem, ptr, sz, capacity, NX_TRUE);
+        } else {
+                nx_mem_block_resize(mem, sz);
+        }
+}
 
 struct NXImage *nx_image_alloc()
 {
@@ -50,7 +110,11 @@ struct NXImage *nx_image_alloc()
         img->dtype = NX_IMAGE_UCHAR;
         img->n_channels = 1;
 
+#if (NX_HAVE_SIMD)
+        img->mem = nx_mem_block_alloc_aligned(NX_SIMD_ALIGNMENT);
+#else
         img->mem = nx_mem_block_alloc();
+#endif
         img->data.v = NULL;
         img->row_stride = 0;
 
@@ -111,6 +175,7 @@ struct NXImage *nx_image_new_like(const struct NXImage* src)
 void nx_image_free(struct NXImage *img)
 {
         if (img) {
+                nx_image_mem_release(img->mem);
                 nx_mem_block_free(img->mem);
                 nx_free(img);
         }
@@ -132,12 +197,14 @@ void nx_image_resize(struct NXImage *img, int width, int height, int row_stride,
 
         int n_ch = nx_image_n_channels(type);
         int rs = n_ch * width;
-        if (row_stride < rs)
+        if (row_stride == NX_IMAGE_STRIDE_PADDED)
+                row_stride = nx_image_padded_row_stride(width, type, dtype);
+        else if (row_stride < rs)
                 row_stride = rs;
 
         size_t length = row_stride * height;
         size_t n_bytes = nx_image_bytes_per_channel(dtype);
-        nx_mem_block_resize(img->mem, length*n_bytes);
+        nx_image_mem_resize(img->mem, length*n_bytes);
 
         img->width = width;
         img->height = height;
@@ -165,7 +232,7 @@ void nx_image_release(struct NXImage *img)
 {
         NX_ASSERT_PTR(img);
 
-        nx_mem_block_release(img->mem);
+        nx_image_mem_release(img->mem);
 
         img->width = 0;
         img->height = 0;
@@ -190,7 +257,9 @@ void nx_image_copy(struct NXImage *dest, const struct NXImage *src)
         NX_ASSERT_PTR(src);
         NX_ASSERT_PTR(dest);
 
-        nx_mem_block_copy(dest->mem, src->mem);
+        nx_image_mem_resize(dest->mem, src->mem->size);
+        if (src->mem->ptr)
+                memcpy(dest->mem->ptr, src->mem->ptr, src->mem->size);
 
         dest->width = src->width;
         dest->height = src->height;
@@ -306,52 +375,78 @@ void nx_image_axpy(struct NXImage *img, float a, float y)
         }
 }
 
-static inline void convert_image_gray_to_rgba(struct NXImage* dest,
-                                              const struct NXImage* src)
+static void convert_gray_to_rgba_rows(void *arg, int y0, int y1)
 {
-        NX_ASSERT(src->dtype == dest->dtype);
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
 
         switch (src->dtype) {
         case NX_IMAGE_UCHAR:
-                nx_convert_gray_to_rgba_uc(src->width, src->height,
-                                           dest->data.uc, dest->row_stride,
-                                           src->data.uc, src->row_stride);
+                nx_convert_gray_to_rgba_uc(src->width, y1 - y0,
+                                           dest->data.uc + y0 * dest->row_stride, dest->row_stride,
+                                           src->data.uc + y0 * src->row_stride, src->row_stride);
                 break;
         case NX_IMAGE_FLOAT32:
-                nx_convert_gray_to_rgba_f32(src->width, src->height,
-                                            dest->data.f32, dest->row_stride,
-                                            src->data.f32, src->row_stride);
+                nx_convert_gray_to_rgba_f32(src->width, y1 - y0,
+                                            dest->data.f32 + y0 * dest->row_stride, dest->row_stride,
+                                            src->data.f32 + y0 * src->row_stride, src->row_stride);
                 break;
         default:
                 NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
         }
 }
 
-static inline void convert_image_rgba_to_gray(struct NXImage* dest,
-                                              const struct NXImage* src)
+static void convert_rgba_to_gray_rows(void *arg, int y0, int y1)
 {
-        NX_ASSERT(src->dtype == dest->dtype);
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
 
         switch (src->dtype) {
         case NX_IMAGE_UCHAR:
-                nx_convert_rgba_to_gray_uc(src->width, src->height,
-                                           dest->data.uc, dest->row_stride,
-                                           src->data.uc, src->row_stride);
+                if (dest->dtype == NX_IMAGE_FLOAT32) {
+                        nx_convert_rgba_uc_to_gray_f32(src->width, y1 - y0,
+                                                       dest->data.f32 + y0 * dest->row_stride, dest->row_stride,
+                                                       src->data.uc + y0 * src->row_stride, src->row_stride);
+                } else {
+                        nx_convert_rgba_to_gray_uc(src->width, y1 - y0,
+                                                   dest->data.uc + y0 * dest->row_stride, dest->row_stride,
+                                                   src->data.uc + y0 * src->row_stride, src->row_stride);
+                }
                 break;
         case NX_IMAGE_FLOAT32:
-                nx_convert_rgba_to_gray_f32(src->width, src->height,
-                                            dest->data.f32, dest->row_stride,
-                                            src->data.f32, src->row_stride);
+                nx_convert_rgba_to_gray_f32(src->width, y1 - y0,
+                                            dest->data.f32 + y0 * dest->row_stride, dest->row_stride,
+                                            src->data.f32 + y0 * src->row_stride, src->row_stride);
                 break;
         default:
                 NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
         }
 }
 
+static inline void convert_image_gray_to_rgba(struct NXImage* dest,
+                                              const struct NXImage* src)
+{
+        NX_ASSERT(src->dtype == dest->dtype);
+
+        struct NXImageRowsJob job = { dest, src, 0.0f };
+        nx_image_parallel_for(src->height, src->width, convert_gray_to_rgba_rows, &job);
+}
+
+static inline void convert_image_rgba_to_gray(struct NXImage* dest,
+                                              const struct NXImage* src)
+{
+        NX_ASSERT(src->dtype == dest->dtype
+                  || (src->dtype == NX_IMAGE_UCHAR && dest->dtype == NX_IMAGE_FLOAT32));
+
+        struct NXImageRowsJob job = { dest, src, 0.0f };
+        nx_image_parallel_for(src->height, src->width, convert_rgba_to_gray_rows, &job);
+}
+
 void nx_image_convert_type(struct NXImage* img, enum NXImageType type)
 {
         NX_ASSERT_PTR(img);
-        NX_IMAGE_ASSERT_GRAYSCALE(img);
 
         if (img->type == type || img->data.v == NULL)
                 return;
@@ -378,6 +473,58 @@ void nx_image_convert_type(struct NXImage* img, enum NXImageType type)
         nx_image_free(cpy);
 }
 
+static void convert_uc_to_f32_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
+        for (int y = y0; y < y1; ++y) {
+                const uchar *rsrc = src->data.uc + y * src->row_stride;
+                float *rdest = dest->data.f32 + y * dest->row_stride;
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                const __m256 max_value = _mm256_set1_ps(255.0f);
+                for (; x + 8 <= dest->width; x += 8) {
+                        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(rsrc + x)));
+                        _mm256_storeu_ps(rdest + x, _mm256_div_ps(_mm256_cvtepi32_ps(v), max_value));
+                }
+#endif
+                for (; x < dest->width; ++x) {
+                        rdest[x] = rsrc[x] / 255.0f;
+                }
+        }
+}
+
+static void convert_f32_to_uc_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
+        for (int y = y0; y < y1; ++y) {
+                const float *rsrc = src->data.f32 + y * src->row_stride;
+                uchar *rdest = dest->data.uc + y * dest->row_stride;
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                const __m256 max_value = _mm256_set1_ps(255.0f);
+                for (; x + 8 <= dest->width; x += 8) {
+                        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(rsrc + x), max_value);
+                        v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), max_value);
+                        __m256i vi = _mm256_cvttps_epi32(v);
+                        __m128i v16 = _mm_packus_epi32(_mm256_castsi256_si128(vi),
+                                                       _mm256_extracti128_si256(vi, 1));
+                        _mm_storel_epi64((__m128i *)(rdest + x), _mm_packus_epi16(v16, v16));
+                }
+#endif
+                for (; x < dest->width; ++x) {
+                        /* Saturate before truncating, NaN maps to zero */
+                        float value = rsrc[x] * 255.0f;
+                        value = value > 0.0f ? value : 0.0f;
+                        value = value < 255.0f ? value : 255.0f;
+                        rdest[x] = (uchar)value;
+                }
+        }
+}
+
 static void nx_image_convert_uc_to_f32(struct NXImage* dest, const struct NXImage *src)
 {
         NX_ASSERT_PTR(src);
@@ -387,13 +534,8 @@ static void nx_image_convert_uc_to_f32(struct NXImage* dest, const struct NXImag
         nx_image_resize(dest, src->width, src->height, NX_IMAGE_STRIDE_DEFAULT,
                         src->type, NX_IMAGE_FLOAT32);
 
-        for (int y = 0; y < dest->height; ++y) {
-                const uchar *rsrc = src->data.uc + y * src->row_stride;
-                float *rdest = dest->data.f32 + y * dest->row_stride;
-                for (int x = 0; x < dest->width; ++x) {
-                        rdest[x] = rsrc[x] / 255.0f;
-                }
-        }
+        struct NXImageRowsJob job = { dest, src, 0.0f };
+        nx_image_parallel_for(dest->height, dest->width, convert_uc_to_f32_rows, &job);
 }
 
 static void nx_image_convert_f32_to_uc(struct NXImage* dest, const struct NXImage *src)
@@ -405,15 +547,8 @@ static void nx_image_convert_f32_to_uc(struct NXImage* dest, const struct NXImag
         nx_image_resize(dest, src->width, src->height, NX_IMAGE_STRIDE_DEFAULT,
                         src->type, NX_IMAGE_UCHAR);
 
-        for (int y = 0; y < dest->height; ++y) {
-                const float *rsrc = src->data.f32 + y * src->row_stride;
-                uchar *rdest = dest->data.uc + y * dest->row_stride;
-                for (int x = 0; x < dest->width; ++x) {
-                        int value = rsrc[x] * 255.0f;
-                        value = nx_min_i(0, nx_max_i(255, value));
-                        rdest[x] = value;
-                }
-        }
+        struct NXImageRowsJob job = { dest, src, 0.0f };
+        nx_image_parallel_for(dest->height, dest->width, convert_f32_to_uc_rows, &job);
 }
 
 void nx_image_convert_dtype(struct NXImage* dest, const struct NXImage *src)
@@ -434,6 +569,29 @@ void nx_image_convert_dtype(struct NXImage* dest, const struct NXImage *src)
         }
 }
 
+void nx_image_convert_to_gray_f32(struct NXImage* dest, const struct NXImage *src)
+{
+        NX_ASSERT_PTR(src);
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT(dest != src);
+
+        switch (src->type) {
+        case NX_IMAGE_GRAYSCALE:
+                if (src->dtype == NX_IMAGE_UCHAR)
+                        nx_image_convert_uc_to_f32(dest, src);
+                else
+                        nx_image_copy(dest, src);
+                break;
+        case NX_IMAGE_RGBA:
+                nx_image_resize(dest, src->width, src->height, NX_IMAGE_STRIDE_DEFAULT,
+                                NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+                convert_image_rgba_to_gray(dest, src);
+                break;
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled source image type");
+        }
+}
+
 void nx_image_apply_colormap(struct NXImage* color, struct NXImage* gray,
                              enum NXColorMap map)
 {
@@ -502,6 +660,7 @@ void nx_image_wrap(struct NXImage *img, void *data, int width, int height,
 
         size_t n_bytes = nx_image_bytes_per_channel(dtype);
         size_t sz = row_stride * height * n_bytes;
+        nx_image_mem_release(img->mem);
         nx_mem_block_wrap(img->mem, data, sz, sz, own_memory);
 
         img->width = width;
@@ -532,20 +691,35 @@ void nx_image_swap(struct NXImage *img0, struct NXImage *img1)
 }
 #undef NX_IMAGE_SWAP
 
-void nx_image_scale_uc(struct NXImage *dest, const struct NXImage *src, float scale_f)
+int nx_image_parallel_grain(int n, int item_size)
 {
-        NX_ASSERT_PTR(src);
-        NX_ASSERT_PTR(dest);
-        NX_IMAGE_ASSERT_GRAYSCALE_UCHAR(src);
+        if (n <= 1)
+                return 1;
 
-        int dest_width = src->width * scale_f;
-        int dest_height = src->height * scale_f;
-        int n_ch = nx_image_n_channels(src->type);
-        int dest_row_stride = dest_width*n_ch;
-        nx_image_resize(dest, dest_width, dest_height, dest_row_stride, src->type, src->dtype);
+        int n_threads = nx_thread_pool_n_workers(nx_thread_pool_instance()) + 1;
+        if (n_threads == 1)
+                return n;
+
+        item_size = nx_max_i(1, item_size);
+        int min_items = (NX_IMAGE_PARALLEL_MIN_PIXELS + item_size - 1) / item_size;
+        int n_target = NX_IMAGE_PARALLEL_CHUNKS_PER_THREAD * n_threads;
+        int grain = nx_max_i(min_items, (n + n_target - 1) / n_target);
 
-        float inv_scale = 1.0f / scale_f;
-        for (int y = 0; y < dest->height; ++y) {
+        return nx_min_i(n, grain);
+}
+
+void nx_image_parallel_for(int n, int item_size, NXParallelForFunc func, void *arg)
+{
+        nx_parallel_for(NULL, 0, n, nx_image_parallel_grain(n, item_size), func, arg);
+}
+
+static void scale_uc_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
+        float inv_scale = 1.0f / job->scale_f;
+        for (int y = y0; y < y1; ++y) {
                 uchar *row = dest->data.uc + y * dest->row_stride;
 
                 float yp = y * inv_scale;
@@ -580,23 +754,38 @@ void nx_image_scale_uc(struct NXImage *dest, const struct NXImage *src, float sc
         }
 }
 
-void nx_image_subtract(struct NXImage *difference,
-                       const struct NXImage *img0,
-                       const struct NXImage *img1)
+void nx_image_scale_uc(struct NXImage *dest, const struct NXImage *src, float scale_f)
 {
-        NX_ASSERT_PTR(difference);
-        NX_ASSERT_PTR(img0);
-        NX_ASSERT_PTR(img1);
+        NX_ASSERT_PTR(src);
+        NX_ASSERT_PTR(dest);
+        NX_IMAGE_ASSERT_GRAYSCALE_UCHAR(src);
 
-        NX_IMAGE_ASSERT_GRAYSCALE(img0);
-        NX_IMAGE_ASSERT_EQUAL_TYPES_AND_DTYPES(img0, img1);
+        int dest_width = src->width * scale_f;
+        int dest_height = src->height * scale_f;
+        int n_ch = nx_image_n_channels(src->type);
+        int dest_row_stride = dest_width*n_ch;
+        nx_image_resize(dest, dest_width, dest_height, dest_row_stride, src->type, src->dtype);
 
-        int w = nx_min_i(img0->width, img1->width);
-        int h = nx_min_i(img0->height, img1->height);
-        nx_image_resize(difference, w, h, NX_IMAGE_STRIDE_DEFAULT,
-                        NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+        struct NXImageRowsJob job = { dest, src, scale_f };
+        nx_image_parallel_for(dest->height, dest->width, scale_uc_rows, &job);
+}
+
+struct NXImageSubtractJob
+{
+        struct NXImage *difference;
+        const struct NXImage *img0;
+        const struct NXImage *img1;
+};
+
+static void subtract_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageSubtractJob *job = (const struct NXImageSubtractJob *)arg;
+        struct NXImage *difference = job->difference;
+        const struct NXImage *img0 = job->img0;
+        const struct NXImage *img1 = job->img1;
+        const int w = difference->width;
         if (img0->dtype == NX_IMAGE_UCHAR) {
-                for (int y = 0; y < h; ++y) {
+                for (int y = y0; y < y1; ++y) {
                         float *drow = difference->data.f32 + y * difference->row_stride;
                         const uchar *row0 = img0->data.uc + y * img0->row_stride;
                         const uchar *row1 = img1->data.uc + y * img1->row_stride;
@@ -605,7 +794,7 @@ void nx_image_subtract(struct NXImage *difference,
                         }
                 }
         } else {
-                for (int y = 0; y < h; ++y) {
+                for (int y = y0; y < y1; ++y) {
                         float *drow = difference->data.f32 + y * difference->row_stride;
                         const float *row0 = img0->data.f32 + y * img0->row_stride;
                         const float *row1 = img1->data.f32 + y * img1->row_stride;
@@ -616,22 +805,34 @@ void nx_image_subtract(struct NXImage *difference,
         }
 }
 
-
-void nx_image_scale_f32(struct NXImage *dest, const struct NXImage *src, float scale_f)
+void nx_image_subtract(struct NXImage *difference,
+                       const struct NXImage *img0,
+                       const struct NXImage *img1)
 {
-        NX_ASSERT_PTR(src);
-        NX_ASSERT_PTR(dest);
-        NX_IMAGE_ASSERT_GRAYSCALE(src);
-        NX_ASSERT_CUSTOM("Image data must be of type float", src->dtype==NX_IMAGE_FLOAT32);
+        NX_ASSERT_PTR(difference);
+        NX_ASSERT_PTR(img0);
+        NX_ASSERT_PTR(img1);
 
-        int dest_width = src->width * scale_f;
-        int dest_height = src->height * scale_f;
-        int n_ch = nx_image_n_channels(src->type);
-        int dest_row_stride = dest_width*n_ch;
-        nx_image_resize(dest, dest_width, dest_height, dest_row_stride, src->type, src->dtype);
+        NX_IMAGE_ASSERT_GRAYSCALE(img0);
+        NX_IMAGE_ASSERT_EQUAL_TYPES_AND_DTYPES(img0, img1);
+
+        int w = nx_min_i(img0->width, img1->width);
+        int h = nx_min_i(img0->height, img1->height);
+        nx_image_resize(difference, w, h, NX_IMAGE_STRIDE_DEFAULT,
+                        NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
 
-        float inv_scale = 1.0f / scale_f;
-        for (int y = 0; y < dest->height; ++y) {
+        struct NXImageSubtractJob job = { difference, img0, img1 };
+        nx_image_parallel_for(h, w, subtract_rows, &job);
+}
+
+
+static void scale_f32_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
+        float inv_scale = 1.0f / job->scale_f;
+        for (int y = y0; y < y1; ++y) {
                 float *row = dest->data.f32 + y * dest->row_stride;
 
                 float yp = y * inv_scale;
@@ -661,6 +862,23 @@ void nx_image_scale_f32(struct NXImage *dest, const struct NXImage *src, float s
         }
 }
 
+void nx_image_scale_f32(struct NXImage *dest, const struct NXImage *src, float scale_f)
+{
+        NX_ASSERT_PTR(src);
+        NX_ASSERT_PTR(dest);
+        NX_IMAGE_ASSERT_GRAYSCALE(src);
+        NX_ASSERT_CUSTOM("Image data must be of type float", src->dtype==NX_IMAGE_FLOAT32);
+
+        int dest_width = src->width * scale_f;
+        int dest_height = src->height * scale_f;
+        int n_ch = nx_image_n_channels(src->type);
+        int dest_row_stride = dest_width*n_ch;
+        nx_image_resize(dest, dest_width, dest_height, dest_row_stride, src->type, src->dtype);
+
+        struct NXImageRowsJob job = { dest, src, scale_f };
+        nx_image_parallel_for(dest->height, dest->width, scale_f32_rows, &job);
+}
+
 void nx_image_scale(struct NXImage *dest, const struct NXImage *src, float scale_f)
 {
         NX_ASSERT_PTR(src);
@@ -816,278 +1034,742 @@ void nx_image_upsample(struct NXImage *dest, const struct NXImage *src)
         }
 }
 
-#define NX_DEFINE_DOWNSAMPLE_AA_X_FUNC(F,T)                             \
-        void nx_image_downsample_aa_x_##F(struct NXImage *dest, const struct NXImage *src) \
+/* The anti-aliasing filters reduce with [1 6 11 6 1] / 25 and mirrored
+ * borders. The passes and nx_image_downsample_aa share the row kernels below,
+ * which all round like aa_sum(), so the fused filter gives exactly the result
+ * of the two passes. */
+#define NX_IMAGE_AA_NORM (1.0f / (1 + 6 + 11 + 6 + 1))
+
+static inline float aa_sum(float a, float b, float c, float d, float e)
+{
+#if (NX_SIMD_AVX2)
+        return fmaf(11.0f, c, fmaf(6.0f, b + d, a + e)) * NX_IMAGE_AA_NORM;
+#else
+        return (a + e + 6 * (b + d) + 11 * c) * NX_IMAGE_AA_NORM;
+#endif
+}
+
+static inline int aa_mirror(int i, int n)
+{
+        if (i < 0)
+                return -i;
+        else if (i >= n)
+                return 2 * (n - 1) - i;
+        else
+                return i;
+}
+
+#if (NX_SIMD_AVX2)
+static inline __m256 aa_reduce8(__m256 a, __m256 b, __m256 c, __m256 d, __m256 e)
+{
+        __m256 t = _mm256_fmadd_ps(_mm256_set1_ps(6.0f), _mm256_add_ps(b, d), _mm256_add_ps(a, e));
+        t = _mm256_fmadd_ps(_mm256_set1_ps(11.0f), c, t);
+        return _mm256_mul_ps(t, _mm256_set1_ps(NX_IMAGE_AA_NORM));
+}
+
+/* Splits p[0..15] into the even and the odd elements */
+static inline void aa_deinterleave_f32(const float *p, __m256 *even, __m256 *odd)
+{
+        __m256 v0 = _mm256_loadu_ps(p);
+        __m256 v1 = _mm256_loadu_ps(p + 8);
+        *even = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(v0, v1, 0x88)), 0xD8));
+        *odd = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(v0, v1, 0xDD)), 0xD8));
+}
+
+static inline void aa_deinterleave_uc(const uchar *p, __m256 *even, __m256 *odd)
+{
+        const __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), split);
+        *even = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+        *odd = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+}
+#endif
+
+#if (NX_SIMD_AVX2)
+#define AA_REDUCE_ROW_X_SIMD(F)                                         \
+        for (; x + 8 < dn && 2 * x + 18 <= n; x += 8) {                 \
+                __m256 a, b, c, d, e, o;                                \
+                aa_deinterleave_##F(src + 2*x - 2, &a, &b);             \
+                aa_deinterleave_##F(src + 2*x, &c, &d);                 \
+                aa_deinterleave_##F(src + 2*x + 2, &e, &o);             \
+                _mm256_storeu_ps(dest + x, aa_reduce8(a, b, c, d, e));  \
+        }
+#else
+#define AA_REDUCE_ROW_X_SIMD(F)
+#endif
+
+/* Horizontal reduction of a row of width n >= 3 into n / 2 floats */
+#define NX_DEFINE_AA_REDUCE_ROW_X_FUNC(F,T)                             \
+        static void aa_reduce_row_x_##F(int n, float *dest, const T *src) \
         {                                                               \
-                NX_ASSERT_PTR(src);                                     \
-                NX_ASSERT_PTR(dest);                                    \
-                NX_IMAGE_ASSERT_GRAYSCALE(src);                         \
-                                                                        \
-                int dest_width = src->width / 2;                        \
-                int dest_height = src->height;                          \
-                nx_image_resize(dest, dest_width, dest_height, 0, src->type, src->dtype); \
-                                                                        \
-                const float norm_f = 1.0f / (1 + 6 + 11 + 6 + 1);       \
-                for (int y = 0; y < dest->height; ++y) {                \
-                        const T *src_row = src->data.F + y * src->row_stride; \
-                        T *dest_row = dest->data.F + y * dest->row_stride; \
-                        dest_row[0] = (2*src_row[2] + 12*src_row[1]     \
-                                       + 11 * src_row[0]) * norm_f;     \
-                        for (int x = 1; x < dest->width-1; ++x) {       \
-                                float sum = src_row[2*x-2] + src_row[2*x+2] \
-                                        + 6 * (src_row[2*x-1] + src_row[2*x+1]) \
-                                        + 11 * src_row[2*x];            \
-                                dest_row[x] = sum * norm_f;             \
-                        }                                               \
-                        int twodw = 2*dest->width;                      \
-                        if (twodw == src->width)                        \
-                                dest_row[dest->width-1] = (src_row[twodw-4] \
-                                                           + 6 * (src_row[twodw-3] \
-                                                                  + src_row[twodw-1]) \
-                                                           + 12 * src_row[twodw-2]) * norm_f; \
-                        else                                            \
-                                dest_row[dest->width-1] = (src_row[twodw-4] \
-                                                           + src_row[twodw] \
-                                                           + 6 * (src_row[twodw-3] \
-                                                                  + src_row[twodw-1]) \
-                                                           + 11 * src_row[twodw-2]) * norm_f; \
+                const int dn = n / 2;                                   \
+                int x = 1;                                              \
+                dest[0] = aa_sum(src[2], src[1], src[0], src[1], src[2]); \
+                AA_REDUCE_ROW_X_SIMD(F)                                 \
+                for (; x < dn - 1; ++x)                                 \
+                        dest[x] = aa_sum(src[2*x-2], src[2*x-1], src[2*x], \
+                                         src[2*x+1], src[2*x+2]);       \
+                if (dn > 1) {                                           \
+                        x = dn - 1;                                     \
+                        dest[x] = aa_sum(src[2*x-2], src[2*x-1], src[2*x], \
+                                         src[2*x+1], src[aa_mirror(2*x+2, n)]); \
                 }                                                       \
         }
 
-NX_DEFINE_DOWNSAMPLE_AA_X_FUNC(uc,uchar)
-NX_DEFINE_DOWNSAMPLE_AA_X_FUNC(f32,float)
-#undef NX_DEFINE_DOWNSAMPLE_AA_X_FUNC
-void nx_image_downsample_aa_x(struct NXImage *dest, const struct NXImage *src)
+NX_DEFINE_AA_REDUCE_ROW_X_FUNC(uc,uchar)
+NX_DEFINE_AA_REDUCE_ROW_X_FUNC(f32,float)
+#undef NX_DEFINE_AA_REDUCE_ROW_X_FUNC
+#undef AA_REDUCE_ROW_X_SIMD
+
+/* Vertical reduction of five rows */
+static void aa_reduce_rows_y(int n, float *dest, const float *const *rows)
 {
-        NX_ASSERT_PTR(src);
-        NX_ASSERT_PTR(dest);
-        NX_IMAGE_ASSERT_GRAYSCALE(src);
+        int x = 0;
+#if (NX_SIMD_AVX2)
+        for (; x + 8 <= n; x += 8)
+                _mm256_storeu_ps(dest + x, aa_reduce8(_mm256_loadu_ps(rows[0] + x),
+                                                      _mm256_loadu_ps(rows[1] + x),
+                                                      _mm256_loadu_ps(rows[2] + x),
+                                                      _mm256_loadu_ps(rows[3] + x),
+                                                      _mm256_loadu_ps(rows[4] + x)));
+#endif
+        for (; x < n; ++x)
+                dest[x] = aa_sum(rows[0][x], rows[1][x], rows[2][x], rows[3][x], rows[4][x]);
+}
 
-        switch (src->dtype) {
-        case NX_IMAGE_UCHAR: nx_image_downsample_aa_x_uc(dest, src); break;
-        case NX_IMAGE_FLOAT32: nx_image_downsample_aa_x_f32(dest, src); break;
-        default: NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+/* Truncates n values in [0, 255] to unsigned char like a C cast */
+static void aa_truncate_to_uc(int n, uchar *dest, const float *src)
+{
+        int x = 0;
+#if (NX_SIMD_AVX2)
+        for (; x + 8 <= n; x += 8) {
+                __m256i v = _mm256_cvttps_epi32(_mm256_loadu_ps(src + x));
+                __m128i v16 = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+                _mm_storel_epi64((__m128i *)(dest + x), _mm_packus_epi16(v16, v16));
         }
+#endif
+        for (; x < n; ++x)
+                dest[x] = (uchar)src[x];
 }
 
-#define NX_DEFINE_DOWNSAMPLE_AA_Y_FUNC(F,T)                             \
-        void nx_image_downsample_aa_y_##F(struct NXImage *dest, const struct NXImage *src) \
-        {                                                               \
-                NX_ASSERT_PTR(src);                                     \
-                NX_ASSERT_PTR(dest);                                    \
-                NX_IMAGE_ASSERT_GRAYSCALE(src);                         \
-                                                                        \
-                int dest_width = src->width;                            \
-                int dest_height = src->height / 2;                      \
-                nx_image_resize(dest, dest_width, dest_height, 0, src->type, src->dtype); \
-                                                                        \
-                const float norm_f = 1.0f / (1 + 6 + 11 + 6 + 1);       \
-                const int ss = src->row_stride;                         \
-                const int ds = dest->row_stride;                        \
-                for (int x = 0; x < dest->width; ++x) {                 \
-                        const T *src_col = src->data.F + x;        \
-                        T *dest_col = dest->data.F + x;            \
-                        dest_col[0] = (2*src_col[2*ss] + 12 * src_col[ss] \
-                                       + 11 * src_col[0]) * norm_f;     \
-                        for (int y = 1; y < dest->height-1; ++y) {      \
-                                int yds = y*dest->row_stride;           \
-                                float sum = src_col[(2*y-2)*ss] + src_col[(2*y+2)*ss] \
-                                        + 6 * (src_col[(2*y-1)*ss] + src_col[(2*y+1)*ss]) \
-                                        + 11 * src_col[2*y*ss];         \
-                                dest_col[yds] = sum * norm_f;           \
-                        }                                               \
-                        const int dlast_col = (dest->height-1)*ds;      \
-                        int twodh = 2*dest->height;                     \
-                        if (twodh == src->height)                       \
-                                dest_col[dlast_col] = (src_col[(twodh-4)*ss] \
-                                                       + 6 * (src_col[(twodh-3)*ss] \
-                                                              + src_col[(twodh-1)*ss]) \
-                                                       + 12 * src_col[(twodh-2)*ss]) * norm_f; \
-                        else                                            \
-                                dest_col[dlast_col] = (src_col[(twodh-4)*ss] \
-                                                       + src_col[(twodh)*ss] \
-                                                       + 6 * (src_col[(twodh-3)*ss] \
-                                                              + src_col[(twodh-1)*ss]) \
-                                                       + 11 * src_col[(twodh-2)*ss]) * norm_f; \
-                                                                        \
-                }                                                       \
+static void aa_truncate(int n, float *row)
+{
+        int x = 0;
+#if (NX_SIMD_AVX2)
+        for (; x + 8 <= n; x += 8)
+                _mm256_storeu_ps(row + x, _mm256_round_ps(_mm256_loadu_ps(row + x),
+                                                          _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+#endif
+        for (; x < n; ++x)
+                row[x] = truncf(row[x]);
+}
+
+static void aa_reduce_row_x(int n, float *dest, const struct NXImage *img, int y)
+{
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR:
+                aa_reduce_row_x_uc(n, dest, img->data.uc + y * img->row_stride);
+                break;
+        case NX_IMAGE_FLOAT32:
+                aa_reduce_row_x_f32(n, dest, img->data.f32 + y * img->row_stride);
+                break;
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
         }
+}
 
-NX_DEFINE_DOWNSAMPLE_AA_Y_FUNC(uc,uchar)
-NX_DEFINE_DOWNSAMPLE_AA_Y_FUNC(f32,float)
-#undef NX_DEFINE_DOWNSAMPLE_AA_Y_FUNC
-void nx_image_downsample_aa_y(struct NXImage *dest, const struct NXImage *src)
+static void aa_store_row(struct NXImage *img, int y, const float *row)
+{
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR:
+                aa_truncate_to_uc(img->width, img->data.uc + y * img->row_stride, row);
+                break;
+        case NX_IMAGE_FLOAT32:
+                memcpy(img->data.f32 + y * img->row_stride, row, img->width * sizeof(float));
+                break;
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        }
+}
+
+static void downsample_aa_x_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *row = NX_ARENA_NEW_S(arena, dest->width);
+
+        for (int y = y0; y < y1; ++y) {
+                if (dest->dtype == NX_IMAGE_FLOAT32) {
+                        aa_reduce_row_x_f32(src->width, dest->data.f32 + y * dest->row_stride,
+                                            src->data.f32 + y * src->row_stride);
+                } else {
+                        aa_reduce_row_x(src->width, row, src, y);
+                        aa_store_row(dest, y, row);
+                }
+        }
+
+        nx_arena_rewind(arena, mark);
+}
+
+void nx_image_downsample_aa_x(struct NXImage *dest, const struct NXImage *src)
 {
         NX_ASSERT_PTR(src);
         NX_ASSERT_PTR(dest);
         NX_IMAGE_ASSERT_GRAYSCALE(src);
+        NX_ASSERT(src->width > 2);
 
-        switch (src->dtype) {
-        case NX_IMAGE_UCHAR: nx_image_downsample_aa_y_uc(dest, src); break;
-        case NX_IMAGE_FLOAT32: nx_image_downsample_aa_y_f32(dest, src); break;
-        default: NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
-        }
+        nx_image_resize(dest, src->width / 2, src->height, 0, src->type, src->dtype);
+
+        struct NXImageRowsJob job = { dest, src, 0.0f };
+        nx_image_parallel_for(dest->height, src->width, downsample_aa_x_rows, &job);
 }
 
-float *nx_image_filter_buffer_alloc(int width, int height,
-                                    float sigma_x, float sigma_y,
-                                    float kernel_truncation_factor,
-                                    int *nk_x, int *nk_y)
+static void downsample_aa_y_rows(void *arg, int y0, int y1)
 {
-        *nk_x = nx_kernel_size_gaussian(sigma_x, kernel_truncation_factor);
-        *nk_y = nx_kernel_size_gaussian(sigma_y, kernel_truncation_factor);
-        int nk_max = nx_max_i(*nk_x, *nk_y);
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
+        const int w = dest->width;
+        const int row_stride = nx_align_size(w * sizeof(float), NX_ARENA_ALIGNMENT) / sizeof(float);
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *ring = NULL;
+        float *acc = NULL;
+        if (src->dtype != NX_IMAGE_FLOAT32) {
+                ring = NX_ARENA_NEW_S(arena, 6 * row_stride);
+                acc = ring + 5 * row_stride;
+        }
 
-        int max_dim = nx_max_i(width, height);
+        int n_loaded = nx_max_i(0, 2 * y0 - 2);
+        for (int y = y0; y < y1; ++y) {
+                const float *rows[5];
+                if (src->dtype == NX_IMAGE_FLOAT32) {
+                        for (int k = 0; k < 5; ++k)
+                                rows[k] = src->data.f32 + aa_mirror(2 * y - 2 + k, src->height) * src->row_stride;
+                        aa_reduce_rows_y(w, dest->data.f32 + y * dest->row_stride, rows);
+                        continue;
+                }
 
-        return nx_filter_buffer_alloc(max_dim, nk_max / 2);
+                int last = nx_min_i(src->height - 1, 2 * y + 2);
+                for (; n_loaded <= last; ++n_loaded)
+                        nx_filter_convert_uc_to_f32(w, ring + (n_loaded % 5) * row_stride,
+                                                    src->data.uc + n_loaded * src->row_stride);
+                for (int k = 0; k < 5; ++k)
+                        rows[k] = ring + (aa_mirror(2 * y - 2 + k, src->height) % 5) * row_stride;
+                aa_reduce_rows_y(w, acc, rows);
+                aa_store_row(dest, y, acc);
+        }
+
+        nx_arena_rewind(arena, mark);
 }
 
-void nx_image_smooth(struct NXImage *dest, const struct NXImage *src,
-                     float sigma_x, float sigma_y,
-                     float kernel_truncation_factor, float *filter_buffer)
+void nx_image_downsample_aa_y(struct NXImage *dest, const struct NXImage *src)
 {
         NX_ASSERT_PTR(src);
         NX_ASSERT_PTR(dest);
         NX_IMAGE_ASSERT_GRAYSCALE(src);
+        NX_ASSERT(src->height > 2);
 
-        if (dest != src) {
-                int dest_width = src->width;
-                int dest_height = src->height;
-                int n_ch = nx_image_n_channels(src->type);
-                int dest_row_stride = dest_width*n_ch;
-                nx_image_resize(dest, dest_width, dest_height,
-                                dest_row_stride, src->type, src->dtype);
+        nx_image_resize(dest, src->width, src->height / 2, 0, src->type, src->dtype);
+
+        struct NXImageRowsJob job = { dest, src, 0.0f };
+        nx_image_parallel_for(dest->height, 2 * dest->width, downsample_aa_y_rows, &job);
+}
+
+/* Every output row reduces five rows of a ring of horizontally reduced input
+ * rows, so each input row is read once and no intermediate image is written */
+static void downsample_aa_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
+        const int w = dest->width;
+        const int row_stride = nx_align_size(w * sizeof(float), NX_ARENA_ALIGNMENT) / sizeof(float);
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *ring = NX_ARENA_NEW_S(arena, 6 * row_stride);
+        float *acc = ring + 5 * row_stride;
+
+        int n_loaded = nx_max_i(0, 2 * y0 - 2);
+        for (int y = y0; y < y1; ++y) {
+                int last = nx_min_i(src->height - 1, 2 * y + 2);
+                for (; n_loaded <= last; ++n_loaded) {
+                        float *slot = ring + (n_loaded % 5) * row_stride;
+                        aa_reduce_row_x(src->width, slot, src, n_loaded);
+                        /* The separate passes store the horizontal result as uchar */
+                        if (src->dtype == NX_IMAGE_UCHAR)
+                                aa_truncate(w, slot);
+                }
+
+                const float *rows[5];
+                for (int k = 0; k < 5; ++k)
+                        rows[k] = ring + (aa_mirror(2 * y - 2 + k, src->height) % 5) * row_stride;
+                if (dest->dtype == NX_IMAGE_FLOAT32) {
+                        aa_reduce_rows_y(w, dest->data.f32 + y * dest->row_stride, rows);
+                } else {
+                        aa_reduce_rows_y(w, acc, rows);
+                        aa_store_row(dest, y, acc);
+                }
         }
 
-        float *buffer = filter_buffer;
-        int nkx = nx_kernel_size_gaussian(sigma_x, kernel_truncation_factor);
-        int nky = nx_kernel_size_gaussian(sigma_y, kernel_truncation_factor);
-        if (!buffer) {
-                buffer = nx_image_filter_buffer_alloc(src->width, src->height,
-                                                      sigma_x, sigma_y,
-                                                      kernel_truncation_factor,
-                                                      &nkx, &nky);
+        nx_arena_rewind(arena, mark);
+}
+
+void nx_image_downsample_aa(struct NXImage *dest, const struct NXImage *src)
+{
+        NX_ASSERT_PTR(src);
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT(dest != src);
+        NX_IMAGE_ASSERT_GRAYSCALE(src);
+        NX_ASSERT(src->width > 2 && src->height > 2);
+
+        nx_image_resize(dest, src->width / 2, src->height / 2, 0, src->type, src->dtype);
+
+        struct NXImageRowsJob job = { dest, src, 0.0f };
+        nx_image_parallel_for(dest->height, 2 * src->width, downsample_aa_rows, &job);
+}
+
+float *nx_image_filter_buffer_alloc(int width, int height,
+                                    float sigma_x, float sigma_y,
+                                    float kernel_truncation_factor,
+                                    int *nk_x, int *nk_y)
+{
+        *nk_x = nx_kernel_size_gaussian(sigma_x, kernel_truncation_factor);
+        *nk_y = nx_kernel_size_gaussian(sigma_y, kernel_truncation_factor);
+        int nk_max = nx_max_i(*nk_x, *nk_y);
+
+        int max_dim = nx_max_i(width, height);
+
+        return nx_filter_buffer_alloc(max_dim, nk_max / 2);
+}
+
+/* Vertical pass of nx_image_smooth, in place, over bands of rows run in
+ * parallel. Within a band, columns are processed in blocks of
+ * NX_IMAGE_SMOOTH_BLOCK_WIDTH: the block of every input row still needed is
+ * kept in a ring of 2 * (n_k - 1) + 1 float rows, and each output row is
+ * convolved from whole ring rows by nx_convolve_sym_rows. Rows outside the
+ * image are clamped to the first and last row, which is the same as
+ * NX_BORDER_REPEAT. The arithmetic per pixel is the same as nx_convolve_sym.
+ *
+ * Bands overwrite rows their neighbours still have to read, so the rows within
+ * n_k - 1 of every band boundary are copied to a halo buffer before the bands
+ * start, and a band reads the rows outside itself from there. */
+struct NXImageSmoothYJob
+{
+        struct NXImage *img;
+        int n_k;
+        const float *kernel;
+        int band_height;
+        /* 2 * (n_k - 1) rows per boundary, starting n_k - 1 rows above it */
+        const uchar *halo;
+        size_t row_size;
+};
+
+static const uchar *smooth_y_source_row(const struct NXImageSmoothYJob *job,
+                                        int y, int y0, int y1)
+{
+        const struct NXImage *img = job->img;
+        if (y >= y0 && y < y1)
+                return img->data.uc + (size_t)y * img->row_stride * nx_image_bytes_per_channel(img->dtype);
+
+        const int radius = job->n_k - 1;
+        int b = (y < y0) ? y0 / job->band_height : y1 / job->band_height;
+        int slot = (b - 1) * 2 * radius + y - (b * job->band_height - radius);
+        return job->halo + slot * job->row_size;
+}
+
+static void smooth_y_bands(void *arg, int y0, int y1)
+{
+        const struct NXImageSmoothYJob *job = (const struct NXImageSmoothYJob *)arg;
+        struct NXImage *img = job->img;
+        const int n_k = job->n_k;
+        const float *kernel = job->kernel;
+        const int width = img->width;
+        const int height = img->height;
+        const int radius = n_k - 1;
+        const int n_ring = 2 * radius + 1;
+        const int block_width = nx_min_i(width, NX_IMAGE_SMOOTH_BLOCK_WIDTH);
+        const int ring_stride = nx_align_size(block_width * sizeof(float), NX_ARENA_ALIGNMENT) / sizeof(float);
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *ring = NX_ARENA_NEW_S(arena, n_ring * ring_stride);
+        float *acc = NX_ARENA_NEW_S(arena, ring_stride);
+        const float **rows = NX_ARENA_NEW(arena, n_ring, const float *);
+
+        for (int x0 = 0; x0 < width; x0 += block_width) {
+                const int w = nx_min_i(block_width, width - x0);
+                int n_loaded = nx_max_i(0, y0 - radius);
+                for (int y = y0; y < y1; ++y) {
+                        int last = nx_min_i(height - 1, y + radius);
+                        for (; n_loaded <= last; ++n_loaded) {
+                                float *slot = ring + (n_loaded % n_ring) * ring_stride;
+                                const uchar *row = smooth_y_source_row(job, n_loaded, y0, y1);
+                                switch (img->dtype) {
+                                case NX_IMAGE_UCHAR:
+                                        nx_filter_convert_uc_to_f32(w, slot, row + x0);
+                                        break;
+                                case NX_IMAGE_FLOAT32:
+                                        memcpy(slot, (const float *)row + x0, w * sizeof(float));
+                                        break;
+                                default:
+                                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+                                }
+                        }
+
+                        for (int k = -radius; k <= radius; ++k) {
+                                int yk = nx_min_i(height - 1, nx_max_i(0, y + k));
+                                rows[radius + k] = ring + (yk % n_ring) * ring_stride;
+                        }
+
+                        switch (img->dtype) {
+                        case NX_IMAGE_UCHAR:
+                                nx_convolve_sym_rows(w, acc, rows, n_k, kernel);
+                                nx_filter_convert_f32_to_uc(w, img->data.uc + y * img->row_stride + x0, acc);
+                                break;
+                        case NX_IMAGE_FLOAT32:
+                                nx_convolve_sym_rows(w, img->data.f32 + y * img->row_stride + x0,
+                                                     rows, n_k, kernel);
+                                break;
+                        default:
+                                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+                        }
+                }
         }
 
-        int nk_max = nx_max_i(nkx, nky);
-        /* fprintf(stderr, "Called with %.4f sigma, %d kernel size\n", sigma_x, nk_max); */
-        int nk_sym = nk_max / 2 + 1;
-        float *kernel = NX_NEW_S(nk_sym);
+        nx_arena_rewind(arena, mark);
+}
 
-        // Smooth in x-direction
-        int nk = nkx / 2 + 1;
-        nx_kernel_sym_gaussian(nk, kernel, sigma_x);
-        for (int y = 0; y < src->height; ++y) {
-                switch (src->dtype) {
-                case NX_IMAGE_UCHAR:
-                        nx_filter_copy_to_buffer1_uc(src->width, buffer,
-                                                     src->data.uc + y * src->row_stride,
-                                                     nkx / 2, NX_BORDER_REPEAT);
-                        break;
-                case NX_IMAGE_FLOAT32:
-                        nx_filter_copy_to_buffer1(src->width, buffer,
-                                                  src->data.f32 + y * src->row_stride,
-                                                  nkx / 2, NX_BORDER_REPEAT);
-                        break;
-                default:
-                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+static void nx_image_smooth_y(struct NXImage *img, int n_k, const float *kernel,
+                              struct NXArena *arena)
+{
+        const int height = img->height;
+        const int radius = n_k - 1;
+
+        struct NXImageSmoothYJob job;
+        job.img = img;
+        job.n_k = n_k;
+        job.kernel = kernel;
+        job.band_height = nx_image_parallel_grain(height, img->width);
+        job.halo = NULL;
+        job.row_size = (size_t)img->width * nx_image_bytes_per_channel(img->dtype);
+
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        const int n_bands = (height + job.band_height - 1) / job.band_height;
+        if (n_bands > 1 && radius > 0) {
+                uchar *halo = NX_ARENA_NEW(arena, (size_t)(n_bands - 1) * 2 * radius * job.row_size, uchar);
+                for (int b = 1; b < n_bands; ++b) {
+                        for (int i = 0; i < 2 * radius; ++i) {
+                                int y = b * job.band_height - radius + i;
+                                if (y >= 0 && y < height)
+                                        memcpy(halo + ((b - 1) * 2 * radius + i) * job.row_size,
+                                               smooth_y_source_row(&job, y, y, y + 1), job.row_size);
+                        }
                 }
-                nx_convolve_sym(src->width, buffer, nk, kernel);
-                switch (src->dtype) {
-                case NX_IMAGE_UCHAR:
-                        for (int x = 0; x < dest->width; ++x)
-                                dest->data.uc[y*dest->row_stride+x] = (uchar)buffer[x];
-                        break;
-                case NX_IMAGE_FLOAT32:
-                        memcpy(dest->data.f32 + y*dest->row_stride, buffer,
-                               dest->width*dest->n_channels*sizeof(float));
-                        break;
-                default:
-                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+                job.halo = halo;
+        }
+
+        nx_parallel_for(NULL, 0, height, job.band_height, smooth_y_bands, &job);
+
+        nx_arena_rewind(arena, mark);
+}
+
+#if (NX_SIMD_AVX2)
+static inline void transpose8_ps(__m256 *v)
+{
+        __m256 t[8];
+        for (int k = 0; k < 8; k += 2) {
+                t[k] = _mm256_unpacklo_ps(v[k], v[k+1]);
+                t[k+1] = _mm256_unpackhi_ps(v[k], v[k+1]);
+        }
+        __m256 s[8];
+        for (int k = 0; k < 8; k += 4) {
+                s[k] = _mm256_shuffle_ps(t[k], t[k+2], _MM_SHUFFLE(1, 0, 1, 0));
+                s[k+1] = _mm256_shuffle_ps(t[k], t[k+2], _MM_SHUFFLE(3, 2, 3, 2));
+                s[k+2] = _mm256_shuffle_ps(t[k+1], t[k+3], _MM_SHUFFLE(1, 0, 1, 0));
+                s[k+3] = _mm256_shuffle_ps(t[k+1], t[k+3], _MM_SHUFFLE(3, 2, 3, 2));
+        }
+        for (int k = 0; k < 4; ++k) {
+                v[k] = _mm256_permute2f128_ps(s[k], s[k+4], 0x20);
+                v[k+4] = _mm256_permute2f128_ps(s[k], s[k+4], 0x31);
+        }
+}
+
+static inline __m256 load8_ps(const struct NXImage *img, int y, int x)
+{
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR: {
+                const uchar *p = img->data.uc + y * img->row_stride + x;
+                return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p)));
+        }
+        case NX_IMAGE_FLOAT32:
+                return _mm256_loadu_ps(img->data.f32 + y * img->row_stride + x);
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        }
+}
+
+static inline void store8_ps(struct NXImage *img, int y, int x, __m256 v)
+{
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR: {
+                __m256i vi = _mm256_cvttps_epi32(v);
+                __m128i v16 = _mm_packus_epi32(_mm256_castsi256_si128(vi), _mm256_extracti128_si256(vi, 1));
+                _mm_storel_epi64((__m128i *)(img->data.uc + y * img->row_stride + x), _mm_packus_epi16(v16, v16));
+                break;
+        }
+        case NX_IMAGE_FLOAT32:
+                _mm256_storeu_ps(img->data.f32 + y * img->row_stride + x, v);
+                break;
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        }
+}
+#endif
+
+static inline float image_value(const struct NXImage *img, int y, int x)
+{
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR: return img->data.uc[y * img->row_stride + x];
+        case NX_IMAGE_FLOAT32: return img->data.f32[y * img->row_stride + x];
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        }
+}
+
+static inline void set_image_value(struct NXImage *img, int y, int x, float v)
+{
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR:
+                img->data.uc[y * img->row_stride + x] = (uchar)nx_min_s(255.0f, nx_max_s(0.0f, v));
+                break;
+        case NX_IMAGE_FLOAT32:
+                img->data.f32[y * img->row_stride + x] = v;
+                break;
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        }
+}
+
+/* Copies rows [y0, y0 + n_rows) to the band buffer, transposed so that
+ * band[x * NX_IMAGE_SMOOTH_IIR_BAND_HEIGHT + r] is pixel x of row y0 + r. The
+ * lanes past the last row repeat it. */
+static void smooth_iir_load_band(float *band, const struct NXImage *img, int y0, int n_rows)
+{
+        const int bh = NX_IMAGE_SMOOTH_IIR_BAND_HEIGHT;
+        int x = 0;
+#if (NX_SIMD_AVX2)
+        for (; x + 8 <= img->width; x += 8) {
+                for (int r0 = 0; r0 < bh; r0 += 8) {
+                        __m256 v[8];
+                        for (int k = 0; k < 8; ++k)
+                                v[k] = load8_ps(img, y0 + nx_min_i(r0 + k, n_rows - 1), x);
+                        transpose8_ps(v);
+                        for (int k = 0; k < 8; ++k)
+                                _mm256_storeu_ps(band + (x + k) * bh + r0, v[k]);
                 }
         }
+#endif
+        for (; x < img->width; ++x)
+                for (int r = 0; r < bh; ++r)
+                        band[x * bh + r] = image_value(img, y0 + nx_min_i(r, n_rows - 1), x);
+}
 
-        // Smooth in y-direction
-        nk = nky / 2 + 1;
-        nx_kernel_sym_gaussian(nk, kernel, sigma_y);
-        for (int x = 0; x < dest->width; ++x) {
-                switch (src->dtype) {
-                case NX_IMAGE_UCHAR:
-                        nx_filter_copy_to_buffer_uc(dest->height, buffer,
-                                                    dest->data.uc + x,
-                                                    dest->row_stride, nky / 2,
-                                                    NX_BORDER_REPEAT);
-                        break;
-                case NX_IMAGE_FLOAT32:
-                        nx_filter_copy_to_buffer(dest->height, buffer,
-                                                 dest->data.f32 + x,
-                                                 dest->row_stride, nky / 2,
-                                                 NX_BORDER_REPEAT);
-                        break;
-                default:
-                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+static void smooth_iir_store_band(struct NXImage *img, const float *band, int y0, int n_rows)
+{
+        const int bh = NX_IMAGE_SMOOTH_IIR_BAND_HEIGHT;
+        int x = 0;
+#if (NX_SIMD_AVX2)
+        for (; x + 8 <= img->width; x += 8) {
+                for (int r0 = 0; r0 < n_rows; r0 += 8) {
+                        __m256 v[8];
+                        for (int k = 0; k < 8; ++k)
+                                v[k] = _mm256_loadu_ps(band + (x + k) * bh + r0);
+                        transpose8_ps(v);
+                        for (int k = 0; k < 8 && r0 + k < n_rows; ++k)
+                                store8_ps(img, y0 + r0 + k, x, v[k]);
                 }
+        }
+#endif
+        for (; x < img->width; ++x)
+                for (int r = 0; r < n_rows; ++r)
+                        set_image_value(img, y0 + r, x, band[x * bh + r]);
+}
 
-                nx_convolve_sym(dest->height, buffer, nk, kernel);
+struct NXImageSmoothIIRJob
+{
+        struct NXImage *dest;
+        const struct NXImage *src;
+        int n_border;
+        float coeffs[4];
+};
 
-                switch (src->dtype) {
-                case NX_IMAGE_UCHAR:
-                        for (int y = 0; y < dest->height; ++y)
-                                dest->data.uc[x + y*dest->row_stride] = (uchar)buffer[y];
-                        break;
-                case NX_IMAGE_FLOAT32:
-                        for (int y = 0; y < dest->height; ++y)
-                                dest->data.f32[x + y*dest->row_stride] = buffer[y];
-                        break;
-                default:
-                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+static void smooth_x_iir_bands(void *arg, int b0, int b1)
+{
+        const struct NXImageSmoothIIRJob *job = (const struct NXImageSmoothIIRJob *)arg;
+        const struct NXImage *src = job->src;
+        const int bh = NX_IMAGE_SMOOTH_IIR_BAND_HEIGHT;
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *band = NX_ARENA_NEW_S(arena, (src->width + job->n_border) * bh);
+
+        for (int b = b0; b < b1; ++b) {
+                int y0 = b * bh;
+                int n_rows = nx_min_i(bh, src->height - y0);
+                smooth_iir_load_band(band, src, y0, n_rows);
+                nx_convolve_recursive_gaussian(src->width, job->n_border, band, bh, bh, job->coeffs);
+                smooth_iir_store_band(job->dest, band, y0, n_rows);
+        }
+
+        nx_arena_rewind(arena, mark);
+}
+
+/* Horizontal recursive Gaussian. Bands of rows are transposed so that the
+ * recursion runs over whole vectors of rows, the bands run in parallel. */
+static void nx_image_smooth_x_iir(struct NXImage *dest, const struct NXImage *src,
+                                  float sigma, int n_border)
+{
+        const int bh = NX_IMAGE_SMOOTH_IIR_BAND_HEIGHT;
+        struct NXImageSmoothIIRJob job;
+        job.dest = dest;
+        job.src = src;
+        job.n_border = n_border;
+        nx_recursive_gaussian_coefficients(sigma, job.coeffs);
+
+        nx_image_parallel_for((src->height + bh - 1) / bh, bh * src->width,
+                              smooth_x_iir_bands, &job);
+}
+
+static void smooth_y_iir_blocks(void *arg, int i0, int i1)
+{
+        const struct NXImageSmoothIIRJob *job = (const struct NXImageSmoothIIRJob *)arg;
+        struct NXImage *img = job->dest;
+        const int bw = NX_IMAGE_SMOOTH_IIR_BLOCK_WIDTH;
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *block = NX_ARENA_NEW_S(arena, (img->height + job->n_border) * bw);
+
+        for (int i = i0; i < i1; ++i) {
+                const int x0 = i * bw;
+                const int w = nx_min_i(bw, img->width - x0);
+                for (int y = 0; y < img->height; ++y) {
+                        switch (img->dtype) {
+                        case NX_IMAGE_UCHAR:
+                                nx_filter_convert_uc_to_f32(w, block + y * bw, img->data.uc + y * img->row_stride + x0);
+                                break;
+                        case NX_IMAGE_FLOAT32:
+                                memcpy(block + y * bw, img->data.f32 + y * img->row_stride + x0, w * sizeof(float));
+                                break;
+                        default:
+                                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+                        }
+                }
+
+                nx_convolve_recursive_gaussian(img->height, job->n_border, block, bw, w, job->coeffs);
+
+                for (int y = 0; y < img->height; ++y) {
+                        switch (img->dtype) {
+                        case NX_IMAGE_UCHAR:
+                                nx_filter_convert_f32_to_uc(w, img->data.uc + y * img->row_stride + x0, block + y * bw);
+                                break;
+                        case NX_IMAGE_FLOAT32:
+                                memcpy(img->data.f32 + y * img->row_stride + x0, block + y * bw, w * sizeof(float));
+                                break;
+                        default:
+                                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+                        }
                 }
         }
 
-        nx_free(kernel);
+        nx_arena_rewind(arena, mark);
+}
 
-        // Clean-up if allocated buffer
-        if (!filter_buffer)
-                nx_free(buffer);
+/* Vertical recursive Gaussian, in place. Runs over blocks of
+ * NX_IMAGE_SMOOTH_IIR_BLOCK_WIDTH columns copied to a float buffer, the blocks
+ * run in parallel. */
+static void nx_image_smooth_y_iir(struct NXImage *img, float sigma, int n_border)
+{
+        const int bw = NX_IMAGE_SMOOTH_IIR_BLOCK_WIDTH;
+        struct NXImageSmoothIIRJob job;
+        job.dest = img;
+        job.src = img;
+        job.n_border = n_border;
+        nx_recursive_gaussian_coefficients(sigma, job.coeffs);
+
+        nx_image_parallel_for((img->width + bw - 1) / bw, bw * img->height,
+                              smooth_y_iir_blocks, &job);
 }
 
-void nx_image_filter_box_x(struct NXImage *dest, const struct NXImage *src,
-                           int sum_radius, float *filter_buffer)
+/**
+ * Gaussian smoothing with the recursive filter of nx_convolve_recursive_gaussian
+ * in both directions. The cost per pixel does not depend on the sigmas, which
+ * must be at least 0.5. Borders repeat the first and last pixels, the right
+ * and bottom extensions span kernel_truncation_factor sigmas.
+ */
+void nx_image_smooth_iir(struct NXImage *dest, const struct NXImage *src,
+                         float sigma_x, float sigma_y,
+                         float kernel_truncation_factor)
 {
         NX_ASSERT_PTR(src);
         NX_ASSERT_PTR(dest);
         NX_IMAGE_ASSERT_GRAYSCALE(src);
 
         if (dest != src)
-                nx_image_resize(dest, src->width, src->height,
-                                NX_IMAGE_STRIDE_DEFAULT, src->type, src->dtype);
+                nx_image_resize(dest, src->width, src->height, src->width,
+                                src->type, src->dtype);
 
-        float *buffer = filter_buffer;
-        if (!buffer) {
-                buffer = nx_filter_buffer_alloc(src->width, sum_radius);
-        }
+        int nkx = nx_kernel_size_gaussian(sigma_x, kernel_truncation_factor);
+        int nky = nx_kernel_size_gaussian(sigma_y, kernel_truncation_factor);
+        nx_image_smooth_x_iir(dest, src, sigma_x, nkx / 2);
+        nx_image_smooth_y_iir(dest, sigma_y, nky / 2);
+}
 
-        for (int y = 0; y < src->height; ++y) {
+struct NXImageSmoothXJob
+{
+        struct NXImage *dest;
+        const struct NXImage *src;
+        int n_k;
+        const float *kernel;
+};
+
+static void smooth_x_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageSmoothXJob *job = (const struct NXImageSmoothXJob *)arg;
+        const struct NXImage *src = job->src;
+        struct NXImage *dest = job->dest;
+        const int n_border = job->n_k - 1;
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *buffer = NX_ARENA_NEW_S(arena, src->width + 2 * n_border);
+
+        for (int y = y0; y < y1; ++y) {
                 switch (src->dtype) {
                 case NX_IMAGE_UCHAR:
                         nx_filter_copy_to_buffer1_uc(src->width, buffer,
                                                      src->data.uc + y * src->row_stride,
-                                                     sum_radius, NX_BORDER_REPEAT);
+                                                     n_border, NX_BORDER_REPEAT);
                         break;
                 case NX_IMAGE_FLOAT32:
                         nx_filter_copy_to_buffer1(src->width, buffer,
                                                   src->data.f32 + y * src->row_stride,
-                                                  sum_radius, NX_BORDER_REPEAT);
+                                                  n_border, NX_BORDER_REPEAT);
                         break;
                 default:
                         NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
                 }
-                nx_convolve_box(src->width, buffer, sum_radius);
+                nx_convolve_sym(src->width, buffer, job->n_k, job->kernel);
                 switch (src->dtype) {
                 case NX_IMAGE_UCHAR:
-                        for (int x = 0; x < dest->width; ++x)
-                                dest->data.uc[y*dest->row_stride+x] = (uchar)buffer[x];
+                        nx_filter_convert_f32_to_uc(dest->width, dest->data.uc + y*dest->row_stride, buffer);
                         break;
                 case NX_IMAGE_FLOAT32:
                         memcpy(dest->data.f32 + y*dest->row_stride, buffer,
@@ -1098,93 +1780,289 @@ void nx_image_filter_box_x(struct NXImage *dest, const struct NXImage *src,
                 }
         }
 
-        if (!filter_buffer)
-                nx_free(buffer);
+        nx_arena_rewind(arena, mark);
 }
 
-void nx_image_filter_box_y(struct NXImage *dest, const struct NXImage *src,
-                           int sum_radius, float *filter_buffer)
+void nx_image_smooth(struct NXImage *dest, const struct NXImage *src,
+                     float sigma_x, float sigma_y,
+                     float kernel_truncation_factor, float *filter_buffer)
 {
         NX_ASSERT_PTR(src);
         NX_ASSERT_PTR(dest);
         NX_IMAGE_ASSERT_GRAYSCALE(src);
 
-        if (dest != src)
-                nx_image_resize(dest, src->width, src->height,
-                                NX_IMAGE_STRIDE_DEFAULT, src->type, src->dtype);
+        /* Every band allocates its own row buffer */
+        (void)filter_buffer;
 
-        float *buffer = filter_buffer;
-        if (!buffer) {
-                buffer = nx_filter_buffer_alloc(src->height, sum_radius);
+        if (dest != src) {
+                int dest_width = src->width;
+                int dest_height = src->height;
+                int n_ch = nx_image_n_channels(src->type);
+                int dest_row_stride = dest_width*n_ch;
+                nx_image_resize(dest, dest_width, dest_height,
+                                dest_row_stride, src->type, src->dtype);
         }
 
-        for (int x = 0; x < dest->width; ++x) {
-                switch (src->dtype) {
-                case NX_IMAGE_UCHAR:
-                        nx_filter_copy_to_buffer_uc(src->height, buffer,
-                                                    src->data.uc + x,
-                                                    src->row_stride, sum_radius,
-                                                    NX_BORDER_REPEAT);
-                        break;
-                case NX_IMAGE_FLOAT32:
-                        nx_filter_copy_to_buffer(src->height, buffer,
-                                                 src->data.f32 + x,
-                                                 src->row_stride, sum_radius,
-                                                 NX_BORDER_REPEAT);
-                        break;
-                default:
-                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+
+        int nkx = nx_kernel_size_gaussian(sigma_x, kernel_truncation_factor);
+        int nky = nx_kernel_size_gaussian(sigma_y, kernel_truncation_factor);
+        int nk_max = nx_max_i(nkx, nky);
+
+        /* fprintf(stderr, "Called with %.4f sigma, %d kernel size\n", sigma_x, nk_max); */
+        int nk_sym = nk_max / 2 + 1;
+        float *kernel = NX_ARENA_NEW_S(arena, nk_sym);
+
+        // Smooth in x-direction
+        if (sigma_x >= NX_IMAGE_SMOOTH_IIR_MIN_SIGMA) {
+                nx_image_smooth_x_iir(dest, src, sigma_x, nkx / 2);
+        } else {
+                struct NXImageSmoothXJob job;
+                job.dest = dest;
+                job.src = src;
+                job.n_k = nkx / 2 + 1;
+                job.kernel = kernel;
+                nx_kernel_sym_gaussian(job.n_k, kernel, sigma_x);
+                nx_image_parallel_for(src->height, src->width, smooth_x_rows, &job);
+        }
+
+        // Smooth in y-direction
+        if (sigma_y >= NX_IMAGE_SMOOTH_IIR_MIN_SIGMA) {
+                nx_image_smooth_y_iir(dest, sigma_y, nky / 2);
+        } else {
+                int nk = nky / 2 + 1;
+                nx_kernel_sym_gaussian(nk, kernel, sigma_y);
+                nx_image_smooth_y(dest, nk, kernel, arena);
+        }
+
+        nx_arena_rewind(arena, mark);
+}
+
+/* Copies a row of n unsigned char values into a buffer with n_border border
+ * elements on each side for the fixed-point filters. */
+static void copy_to_buffer_fixed(int n, uchar *buffer, const uchar *data, int n_border,
+                                 enum NXBorderMode mode)
+{
+        memcpy(buffer + n_border, data, n);
+        switch (mode) {
+        case NX_BORDER_REPEAT:
+                memset(buffer, data[0], n_border);
+                memset(buffer + n_border + n, data[n-1], n_border);
+                break;
+        case NX_BORDER_MIRROR:
+                for (int i = 0; i < n_border; ++i) {
+                        buffer[n_border - 1 - i] = data[i + 1];
+                        buffer[n_border + n + i] = data[n - 2 - i];
                 }
+                break;
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for border mode.");
+        }
+}
 
-                nx_convolve_box(dest->height, buffer, sum_radius);
+/**
+ * Gaussian smoothing of unsigned char images in 16-bit fixed point. The
+ * horizontal pass keeps rows in Q8 with a Q8 kernel, the vertical pass uses a
+ * Q16 kernel and rounds to the nearest value. Borders repeat the first and last
+ * pixels as in nx_image_smooth. Results are within one or two gray levels of
+ * nx_image_smooth, which truncates instead of rounding.
+ */
+void nx_image_smooth_fixed(struct NXImage *dest, const struct NXImage *src,
+                           float sigma_x, float sigma_y,
+                           float kernel_truncation_factor)
+{
+        NX_ASSERT_PTR(src);
+        NX_ASSERT_PTR(dest);
+        NX_IMAGE_ASSERT_GRAYSCALE_UCHAR(src);
 
-                switch (dest->dtype) {
-                case NX_IMAGE_UCHAR:
-                        for (int y = 0; y < dest->height; ++y)
-                                dest->data.uc[x + y*dest->row_stride] = (uchar)buffer[y];
-                        break;
-                case NX_IMAGE_FLOAT32:
-                        for (int y = 0; y < dest->height; ++y)
-                                dest->data.f32[x + y*dest->row_stride] = buffer[y];
-                        break;
-                default:
-                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        if (dest != src)
+                nx_image_resize(dest, src->width, src->height, src->width,
+                                src->type, src->dtype);
+
+        const int width = src->width;
+        const int height = src->height;
+        const int nkx = nx_kernel_size_gaussian(sigma_x, kernel_truncation_factor) / 2 + 1;
+        const int nky = nx_kernel_size_gaussian(sigma_y, kernel_truncation_factor) / 2 + 1;
+        const int radius_x = nkx - 1;
+        const int radius_y = nky - 1;
+        const int n_ring = 2 * radius_y + 1;
+        const int ring_stride = nx_align_size(width * sizeof(uint16_t), NX_ARENA_ALIGNMENT) / sizeof(uint16_t);
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+
+        float *kernel = NX_ARENA_NEW_S(arena, nx_max_i(nkx, nky));
+        uint16_t *kernel_x = NX_ARENA_NEW(arena, nkx, uint16_t);
+        uint16_t *kernel_y = NX_ARENA_NEW(arena, nky, uint16_t);
+        nx_kernel_sym_gaussian(nkx, kernel, sigma_x);
+        nx_kernel_sym_quantize(nkx, kernel_x, kernel, 8);
+        nx_kernel_sym_gaussian(nky, kernel, sigma_y);
+        nx_kernel_sym_quantize(nky, kernel_y, kernel, 16);
+
+        uchar *buffer = NX_ARENA_NEW_UC(arena, width + 2 * radius_x);
+        uint16_t *ring = NX_ARENA_NEW(arena, n_ring * ring_stride, uint16_t);
+        const uint16_t **rows = NX_ARENA_NEW(arena, n_ring, const uint16_t *);
+
+        /* Source row y is consumed before destination row y is written, so
+         * smoothing in place is safe. */
+        int n_loaded = 0;
+        for (int y = 0; y < height; ++y) {
+                int last = nx_min_i(height - 1, y + radius_y);
+                for (; n_loaded <= last; ++n_loaded) {
+                        copy_to_buffer_fixed(width, buffer, src->data.uc + n_loaded * src->row_stride,
+                                             radius_x, NX_BORDER_REPEAT);
+                        nx_convolve_sym_uc_q8(width, ring + (n_loaded % n_ring) * ring_stride,
+                                              buffer, 1, nkx, kernel_x);
+                }
+
+                for (int k = -radius_y; k <= radius_y; ++k) {
+                        int yk = nx_min_i(height - 1, nx_max_i(0, y + k));
+                        rows[radius_y + k] = ring + (yk % n_ring) * ring_stride;
                 }
+                nx_convolve_sym_rows_q8(width, dest->data.uc + y * dest->row_stride,
+                                        rows, nky, kernel_y);
         }
 
-        // Clean-up if allocated buffer
-        if (!filter_buffer)
-                nx_free(buffer);
+        nx_arena_rewind(arena, mark);
+}
+
+/**
+ * Fixed-point version of nx_image_downsample_aa_x followed by
+ * nx_image_downsample_aa_y for unsigned char images. Only the rows and
+ * columns that survive the decimation are filtered.
+ */
+void nx_image_downsample_aa_fixed(struct NXImage *dest, const struct NXImage *src)
+{
+        NX_ASSERT_PTR(src);
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT(dest != src);
+        NX_IMAGE_ASSERT_GRAYSCALE_UCHAR(src);
+        NX_ASSERT(src->width > 2);
+        NX_ASSERT(src->height > 2);
+
+        const int width = src->width;
+        const int height = src->height;
+        const int dest_width = width / 2;
+        const int dest_height = height / 2;
+        nx_image_resize(dest, dest_width, dest_height, 0, src->type, src->dtype);
+
+        /* [1 6 11 6 1] / 25 with mirrored borders, as in the float version */
+        static const float aa_kernel[3] = { 11.0f / 25.0f, 6.0f / 25.0f, 1.0f / 25.0f };
+        const int n_k = 3;
+        const int radius = n_k - 1;
+        const int n_ring = 2 * radius + 1;
+        uint16_t kernel_x[3];
+        uint16_t kernel_y[3];
+        nx_kernel_sym_quantize(n_k, kernel_x, aa_kernel, 8);
+        nx_kernel_sym_quantize(n_k, kernel_y, aa_kernel, 16);
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+
+        const int ring_stride = nx_align_size(dest_width * sizeof(uint16_t), NX_ARENA_ALIGNMENT) / sizeof(uint16_t);
+        uchar *buffer = NX_ARENA_NEW_UC(arena, width + 2 * radius);
+        uint16_t *ring = NX_ARENA_NEW(arena, n_ring * ring_stride, uint16_t);
+        const uint16_t *rows[5];
+
+        int n_loaded = 0;
+        for (int y = 0; y < dest_height; ++y) {
+                int last = nx_min_i(height - 1, 2 * y + radius);
+                for (; n_loaded <= last; ++n_loaded) {
+                        copy_to_buffer_fixed(width, buffer, src->data.uc + n_loaded * src->row_stride,
+                                             radius, NX_BORDER_MIRROR);
+                        nx_convolve_sym_uc_q8(dest_width, ring + (n_loaded % n_ring) * ring_stride,
+                                              buffer, 2, n_k, kernel_x);
+                }
+
+                for (int k = -radius; k <= radius; ++k) {
+                        int yk = 2 * y + k;
+                        if (yk < 0)
+                                yk = -yk;
+                        else if (yk >= height)
+                                yk = 2 * (height - 1) - yk;
+                        rows[radius + k] = ring + (yk % n_ring) * ring_stride;
+                }
+                nx_convolve_sym_rows_q8(dest_width, dest->data.uc + y * dest->row_stride,
+                                        rows, n_k, kernel_y);
+        }
+
+        nx_arena_rewind(arena, mark);
+}
+
+void nx_image_filter_box_x(struct NXImage *dest, const struct NXImage *src,
+                           int sum_radius)
+{
+        nx_image_filter_box(dest, src, sum_radius, 0);
+}
+
+void nx_image_filter_box_y(struct NXImage *dest, const struct NXImage *src,
+                           int sum_radius)
+{
+        nx_image_filter_box(dest, src, 0, sum_radius);
 }
 
 void nx_image_filter_box(struct NXImage *dest, const struct NXImage *src,
-                         int sum_radius_x, int sum_radius_y,
-                         float *filter_buffer)
+                         int sum_radius_x, int sum_radius_y)
 {
         NX_ASSERT_PTR(src);
         NX_ASSERT_PTR(dest);
         NX_IMAGE_ASSERT_GRAYSCALE(src);
+        NX_ASSERT(sum_radius_x >= 0 && sum_radius_y >= 0);
 
-        if (dest != src)
-                nx_image_resize(dest, src->width, src->height,
-                                NX_IMAGE_STRIDE_DEFAULT, src->type, src->dtype);
+        struct NXIntegralImage *ii = nx_integral_image_alloc();
+        nx_integral_image_compute(ii, src, nx_max_i(sum_radius_x, sum_radius_y));
+        nx_integral_image_box_filter(dest, ii, sum_radius_x, sum_radius_y);
+        nx_integral_image_free(ii);
+}
 
-        float *buffer = filter_buffer;
-        if (!buffer) {
-                int n = nx_max_i(src->width, src->height);
-                int r = nx_max_i(sum_radius_x, sum_radius_y);
-                buffer = nx_filter_buffer_alloc(n, r);
+/* Central differences along a row, one sided at the ends */
+#define NX_DEFINE_DERIV_ROW_FUNCS(F,T,S)                                \
+        static inline void deriv_x_row_##F(int w, float *dest_row, const T *src_row) \
+        {                                                               \
+                dest_row[0] = 2.0f * (src_row[1]-src_row[0])/S;         \
+                for (int x = 1; x < w-1; ++x) {                         \
+                        dest_row[x] = (src_row[x+1]-src_row[x-1])/S;    \
+                }                                                       \
+                dest_row[w-1] = 2.0f * (src_row[w-1]-src_row[w-2])/S;   \
+        }                                                               \
+                                                                        \
+        static inline void deriv_y_row_##F(int w, float *dest_row, const T *src_row_m, \
+                                           const T *src_row_p, float f) \
+        {                                                               \
+                for (int x = 0; x < w; ++x) {                           \
+                        dest_row[x] = f * (src_row_p[x]-src_row_m[x])/S; \
+                }                                                       \
+        }                                                               \
+                                                                        \
+        static inline void deriv_y_row_at_##F(int y, float *dest_row, const struct NXImage *src) \
+        {                                                               \
+                const int h = src->height;                              \
+                int ym = (y == 0) ? 0 : ((y == h-1) ? h-2 : y-1);       \
+                int yp = (y == h-1) ? h-1 : y+1;                        \
+                float f = (y == 0 || y == h-1) ? 2.0f : 1.0f;           \
+                deriv_y_row_##F(src->width, dest_row,                   \
+                                src->data.F + ym*src->row_stride,       \
+                                src->data.F + yp*src->row_stride, f);   \
         }
 
-        nx_image_filter_box_x(dest, src, sum_radius_x, buffer);
-        nx_image_filter_box_y(dest, dest, sum_radius_y, buffer);
-
-        // Clean-up if allocated buffer
-        if (!filter_buffer)
-                nx_free(buffer);
-}
+NX_DEFINE_DERIV_ROW_FUNCS(uc,uchar,255.0f)
+NX_DEFINE_DERIV_ROW_FUNCS(f32,float,1.0f)
+#undef NX_DEFINE_DERIV_ROW_FUNCS
 
-#define NX_DEFINE_DERIV_X_FUNC(F,T,S)                                   \
+#define NX_DEFINE_DERIV_FUNCS(F)                                        \
+        static void nx_image_deriv_x_rows_##F(void *arg, int y0, int y1) \
+        {                                                               \
+                const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg; \
+                const struct NXImage *src = job->src;                   \
+                struct NXImage *dest = job->dest;                       \
+                                                                        \
+                for (int y = y0; y < y1; ++y) {                         \
+                        deriv_x_row_##F(dest->width, dest->data.f32 + y*dest->row_stride, \
+                                        src->data.F + y*src->row_stride); \
+                }                                                       \
+        }                                                               \
+                                                                        \
         void nx_image_deriv_x_##F(struct NXImage *dest,                 \
                                   const struct NXImage *src)            \
         {                                                               \
@@ -1195,20 +2073,40 @@ void nx_image_filter_box(struct NXImage *dest, const struct NXImage *src,
                 nx_image_resize(dest, src->width, src->height, NX_IMAGE_STRIDE_DEFAULT, \
                                 src->type, NX_IMAGE_FLOAT32);           \
                                                                         \
-                for (int y = 0; y < src->height; ++y) {                 \
-                        const T *src_row = src->data.F + y*src->row_stride; \
-                        float *dest_row = dest->data.f32 + y*dest->row_stride; \
-                        dest_row[0] = 2.0f * (src_row[1]-src_row[0])/S; \
-                        for (int x = 1; x < dest->width-1; ++x) {       \
-                                dest_row[x] = (src_row[x+1]-src_row[x-1])/S; \
-                        }                                               \
-                        dest_row[dest->width-1] = 2.0f * (src_row[src->width-1]-src_row[src->width-2])/S; \
+                struct NXImageRowsJob job = { dest, src, 0.0f };        \
+                nx_image_parallel_for(dest->height, dest->width,        \
+                                      nx_image_deriv_x_rows_##F, &job); \
+        }                                                               \
+                                                                        \
+        static void nx_image_deriv_y_rows_##F(void *arg, int y0, int y1) \
+        {                                                               \
+                const struct NXImageRowsJob *job = (const struct NXImageRowsJob *)arg; \
+                const struct NXImage *src = job->src;                   \
+                struct NXImage *dest = job->dest;                       \
+                                                                        \
+                for (int y = y0; y < y1; ++y) {                         \
+                        deriv_y_row_at_##F(y, dest->data.f32 + y*dest->row_stride, src); \
                 }                                                       \
+        }                                                               \
+                                                                        \
+        void nx_image_deriv_y_##F(struct NXImage *dest,                 \
+                                  const struct NXImage *src)            \
+        {                                                               \
+                NX_ASSERT_PTR(src);                                     \
+                NX_ASSERT_PTR(dest);                                    \
+                NX_IMAGE_ASSERT_GRAYSCALE(src);                         \
+                                                                        \
+                nx_image_resize(dest, src->width, src->height, NX_IMAGE_STRIDE_DEFAULT, \
+                                src->type, NX_IMAGE_FLOAT32);           \
+                                                                        \
+                struct NXImageRowsJob job = { dest, src, 0.0f };        \
+                nx_image_parallel_for(dest->height, 2 * dest->width,    \
+                                      nx_image_deriv_y_rows_##F, &job); \
         }
 
-NX_DEFINE_DERIV_X_FUNC(uc,uchar,255.0f)
-NX_DEFINE_DERIV_X_FUNC(f32,float,1)
-#undef NX_DEFINE_DERIV_X_FUNC
+NX_DEFINE_DERIV_FUNCS(uc)
+NX_DEFINE_DERIV_FUNCS(f32)
+#undef NX_DEFINE_DERIV_FUNCS
 
 void nx_image_deriv_x(struct NXImage *dest, const struct NXImage *src)
 {
@@ -1223,40 +2121,6 @@ void nx_image_deriv_x(struct NXImage *dest, const struct NXImage *src)
         }
 }
 
-#define NX_DEFINE_DERIV_Y_FUNC(F,T,S)                                   \
-        void nx_image_deriv_y_##F(struct NXImage *dest,                 \
-                                  const struct NXImage *src)            \
-        {                                                               \
-                NX_ASSERT_PTR(src);                                     \
-                NX_ASSERT_PTR(dest);                                    \
-                NX_IMAGE_ASSERT_GRAYSCALE(src);                         \
-                                                                        \
-                nx_image_resize(dest, src->width, src->height, NX_IMAGE_STRIDE_DEFAULT, \
-                                src->type, NX_IMAGE_FLOAT32);           \
-                nx_image_set_zero(dest);                                \
-                                                                        \
-                for (int x = 0; x < dest->width; ++x) {                 \
-                        dest->data.f32[x] = 2.0f * (src->data.F[x + src->row_stride] \
-                                                   - src->data.F[x])/S; \
-                }                                                       \
-                for (int y = 1; y < src->height-1; ++y) {               \
-                        const T *src_row_m = src->data.F + (y-1)*src->row_stride; \
-                        const T *src_row_p = src->data.F + (y+1)*src->row_stride; \
-                        float *dest_row = dest->data.f32 + y*dest->row_stride; \
-                        for (int x = 0; x < dest->width; ++x) {         \
-                                dest_row[x] = (src_row_p[x]-src_row_m[x])/S; \
-                        }                                               \
-                }                                                       \
-                for (int x = 0; x < dest->width; ++x) {                 \
-                        dest->data.f32[x + (src->height-1)*dest->row_stride] = 2.0f * (src->data.F[x + (src->height-1)*dest->row_stride] \
-                                                                                       - src->data.F[x + (src->height-2)*dest->row_stride])/S; \
-                }                                                       \
-        }
-
-NX_DEFINE_DERIV_Y_FUNC(uc,uchar,255.0f)
-NX_DEFINE_DERIV_Y_FUNC(f32,float,1.0f)
-#undef NX_DEFINE_DERIV_Y_FUNC
-
 void nx_image_deriv_y(struct NXImage *dest, const struct NXImage *src)
 {
         NX_ASSERT_PTR(src);
@@ -1270,3 +2134,83 @@ void nx_image_deriv_y(struct NXImage *dest, const struct NXImage *src)
         }
 }
 
+static void gradient_polar_row(int n, float *mag, float *ori, const float *gx, const float *gy)
+{
+        int x = 0;
+#if (NX_SIMD_AVX2)
+        for (; x + 8 <= n; x += 8) {
+                __m256 vx = _mm256_loadu_ps(gx + x);
+                __m256 vy = _mm256_loadu_ps(gy + x);
+                __m256 sq = _mm256_fmadd_ps(vx, vx, _mm256_mul_ps(vy, vy));
+                _mm256_storeu_ps(mag + x, nx_vmath_sqrt_ps(sq));
+                _mm256_storeu_ps(ori + x, nx_vmath_atan2_ps(vy, vx));
+        }
+        for (; x < n; ++x) {
+                mag[x] = nx_vmath_sqrtf(fmaf(gx[x], gx[x], gy[x] * gy[x]));
+                ori[x] = nx_vmath_atan2f(gy[x], gx[x]);
+        }
+#else
+        for (; x < n; ++x) {
+                mag[x] = nx_vmath_sqrtf(gx[x] * gx[x] + gy[x] * gy[x]);
+                ori[x] = nx_vmath_atan2f(gy[x], gx[x]);
+        }
+#endif
+}
+
+struct NXImageGradientPolarJob
+{
+        struct NXImage *mag;
+        struct NXImage *ori;
+        const struct NXImage *src;
+};
+
+static void gradient_polar_rows(void *arg, int y0, int y1)
+{
+        const struct NXImageGradientPolarJob *job = (const struct NXImageGradientPolarJob *)arg;
+        const struct NXImage *src = job->src;
+        const int w = src->width;
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *gx = NX_ARENA_NEW_S(arena, w);
+        float *gy = NX_ARENA_NEW_S(arena, w);
+
+        for (int y = y0; y < y1; ++y) {
+                switch (src->dtype) {
+                case NX_IMAGE_UCHAR:
+                        deriv_x_row_uc(w, gx, src->data.uc + y*src->row_stride);
+                        deriv_y_row_at_uc(y, gy, src);
+                        break;
+                case NX_IMAGE_FLOAT32:
+                        deriv_x_row_f32(w, gx, src->data.f32 + y*src->row_stride);
+                        deriv_y_row_at_f32(y, gy, src);
+                        break;
+                default:
+                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+                }
+                gradient_polar_row(w, job->mag->data.f32 + y*job->mag->row_stride,
+                                   job->ori->data.f32 + y*job->ori->row_stride, gx, gy);
+        }
+
+        nx_arena_rewind(arena, mark);
+}
+
+void nx_image_gradient_polar(struct NXImage *mag, struct NXImage *ori,
+                             const struct NXImage *src)
+{
+        NX_ASSERT_PTR(mag);
+        NX_ASSERT_PTR(ori);
+        NX_ASSERT_PTR(src);
+        NX_IMAGE_ASSERT_GRAYSCALE(src);
+        NX_ASSERT(mag != src && ori != src && mag != ori);
+        NX_ASSERT(src->width > 1 && src->height > 1);
+
+        nx_image_resize(mag, src->width, src->height, NX_IMAGE_STRIDE_DEFAULT,
+                        NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+        nx_image_resize(ori, src->width, src->height, NX_IMAGE_STRIDE_DEFAULT,
+                        NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+
+        struct NXImageGradientPolarJob job = { mag, ori, src };
+        nx_image_parallel_for(src->height, 4 * src->width, gradient_polar_rows, &job);
+}
+
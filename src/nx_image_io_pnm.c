@@ -28,6 +28,7 @@
 #include <stdlib.h>
 
 #include "virg/nexus/nx_log.h"
+#include "virg/nexus/nx_alloc.h"
 #include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_io.h"
 #include "virg/nexus/nx_colorspace.h"
@@ -98,6 +99,17 @@ NXResult nx_image_save_pnm(const struct NXImage *img, const char *filename)
         return res;
 }
 
+/* Expands packed RGB to RGBA with an opaque alpha channel */
+static void rgb_to_rgba_row(int width, uchar *rgba, const uchar *rgb)
+{
+        for (int x = 0; x < width; ++x) {
+                rgba[4*x]   = rgb[3*x];
+                rgba[4*x+1] = rgb[3*x+1];
+                rgba[4*x+2] = rgb[3*x+2];
+                rgba[4*x+3] = 255;
+        }
+}
+
 static NXResult read_pnm_data(struct NXImage *img, enum NXImageType img_type,
                               FILE *pnm, int pnm_width, int pnm_height, enum NXImageType pnm_type)
 {
@@ -107,55 +119,46 @@ static NXResult read_pnm_data(struct NXImage *img, enum NXImageType img_type,
 
         nx_image_resize(img, pnm_width, pnm_height, NX_IMAGE_STRIDE_DEFAULT, img_type, img->dtype);
 
-        if (pnm_type == NX_IMAGE_GRAYSCALE) {
-                if (img_type == NX_IMAGE_GRAYSCALE) {
-                        for (int y = 0; y < img->height; ++y) {
-                                uchar* row = img->data.uc + y * img->row_stride;
-                                if (fread((void*)row, sizeof(uchar), img->width, pnm) != (size_t)img->width)
-                                        return NX_FAIL;
-                        }
-                } else if (img_type == NX_IMAGE_RGBA) {
-                        for (int y = 0; y < img->height; ++y) {
-                                uchar* row = img->data.uc + y * img->row_stride;
-                                for(int x = 0; x < img->width; ++x) {
-                                        uchar value;
-                                        if (fread((void*)&value, sizeof(uchar), 1, pnm) != 1)
-                                                return NX_FAIL;
-                                        row[4*x] = value;
-                                        row[4*x+1] = value;
-                                        row[4*x+2] = value;
-                                        row[4*x+3] = 255;
-                                }
-                        }
-                } else {
-                        NX_FATAL(NX_LOG_TAG, "Unsupported image type while loading grayscale PNM!");
+        if (pnm_type == NX_IMAGE_GRAYSCALE && img_type == NX_IMAGE_GRAYSCALE) {
+                for (int y = 0; y < img->height; ++y) {
+                        uchar* row = img->data.uc + y * img->row_stride;
+                        if (fread((void*)row, sizeof(uchar), img->width, pnm) != (size_t)img->width)
+                                return NX_FAIL;
                 }
-        } else {
-                if (img_type == NX_IMAGE_GRAYSCALE) {
-                        for (int y = 0; y < img->height; ++y) {
-                                uchar* row = img->data.uc + y * img->row_stride;
-                                for (int x = 0; x < img->width; ++x) {
-                                        uchar value[3];
-                                        if (fread((void*)&value, sizeof(uchar), 3, pnm) != 3)
-                                                return NX_FAIL;
-                                        row[x] = nx_rgb_to_gray_uc(value[0], value[1], value[2]);
-                                }
-                        }
+                return NX_OK;
+        }
+
+        if (img_type != NX_IMAGE_GRAYSCALE && img_type != NX_IMAGE_RGBA)
+                NX_FATAL(NX_LOG_TAG, "Unsupported image type while loading PNM!");
+
+        /* Rows are read whole and converted with the colorspace kernels */
+        int pnm_n_channels = (pnm_type == NX_IMAGE_GRAYSCALE) ? 1 : 3;
+        size_t row_size = (size_t)img->width * pnm_n_channels;
+        uchar *buffer = NX_NEW_UC(row_size);
+        uchar *rgba = (pnm_type != NX_IMAGE_GRAYSCALE && img_type == NX_IMAGE_GRAYSCALE)
+                ? NX_NEW_UC(4 * img->width) : NULL;
+
+        NXResult result = NX_OK;
+        for (int y = 0; y < img->height; ++y) {
+                uchar* row = img->data.uc + y * img->row_stride;
+                if (fread((void*)buffer, sizeof(uchar), row_size, pnm) != row_size) {
+                        result = NX_FAIL;
+                        break;
+                }
+
+                if (pnm_type == NX_IMAGE_GRAYSCALE) {
+                        nx_convert_gray_to_rgba_uc(img->width, 1, row, img->row_stride, buffer, img->width);
                 } else if (img_type == NX_IMAGE_RGBA) {
-                        for (int y = 0; y < img->height; ++y) {
-                                uchar* row = img->data.uc + y * img->row_stride;
-                                for (int x = 0; x < img->width; ++x) {
-                                        if (fread((void*)(row + 4*x), sizeof(uchar), 3, pnm) != 3)
-                                                return NX_FAIL;
-                                        row[4*x+3] = 255;
-                                }
-                        }
+                        rgb_to_rgba_row(img->width, row, buffer);
                 } else {
-                        NX_FATAL(NX_LOG_TAG, "Unsupported image type while loading RGB PNM!");
+                        rgb_to_rgba_row(img->width, rgba, buffer);
+                        nx_convert_rgba_to_gray_uc(img->width, 1, row, img->row_stride, rgba, 4 * img->width);
                 }
         }
 
-        return NX_OK;
+        nx_free(rgba);
+        nx_free(buffer);
+        return result;
 }
 
 void nx_image_xload_pnm(struct NXImage *img, const char *filename,
@@ -0,0 +1,224 @@
+/**
+ * @file nx_image_pool.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_image_pool.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_log.h"
+
+#define NX_IMAGE_POOL_MIN_EXP 12
+#define NX_IMAGE_POOL_MAX_EXP 48
+#define NX_IMAGE_POOL_CLASSES_PER_EXP 4
+#define NX_IMAGE_POOL_N_CLASSES ((NX_IMAGE_POOL_MAX_EXP - NX_IMAGE_POOL_MIN_EXP) * NX_IMAGE_POOL_CLASSES_PER_EXP)
+
+/* Cached buffers are unused, so their bookkeeping lives at their start. */
+struct NXImagePoolEntry
+{
+        struct NXImagePoolEntry *lru_prev;
+        struct NXImagePoolEntry *lru_next;
+        struct NXImagePoolEntry *class_next;
+        struct NXImagePoolEntry *class_prev;
+        size_t capacity;
+        int class_id;
+};
+
+struct NXImagePool
+{
+        size_t max_bytes;
+        struct NXImagePoolEntry *classes[NX_IMAGE_POOL_N_CLASSES];
+        struct NXImagePoolEntry *lru_oldest;
+        struct NXImagePoolEntry *lru_newest;
+        struct NXImagePoolStats stats;
+};
+
+static pthread_mutex_t nx_s_image_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct NXImagePool nx_s_image_pool;
+
+static inline int nx_image_pool_exp(size_t sz)
+{
+        return (int)(8 * sizeof(unsigned long long)) - 1 - __builtin_clzll((unsigned long long)sz);
+}
+
+static inline size_t nx_image_pool_class_size(int class_id)
+{
+        int e = NX_IMAGE_POOL_MIN_EXP + class_id / NX_IMAGE_POOL_CLASSES_PER_EXP;
+        int q = class_id % NX_IMAGE_POOL_CLASSES_PER_EXP;
+        return ((size_t)1 << e) + (size_t)q * ((size_t)1 << (e - 2));
+}
+
+/* Largest class with size <= sz */
+static inline int nx_image_pool_floor_class(size_t sz)
+{
+        int e = nx_image_pool_exp(sz);
+        if (e >= NX_IMAGE_POOL_MAX_EXP)
+                return NX_IMAGE_POOL_N_CLASSES - 1;
+        int q = (int)((sz - ((size_t)1 << e)) >> (e - 2));
+        return (e - NX_IMAGE_POOL_MIN_EXP) * NX_IMAGE_POOL_CLASSES_PER_EXP + q;
+}
+
+/* Smallest class with size >= sz */
+static inline int nx_image_pool_ceil_class(size_t sz)
+{
+        int class_id = nx_image_pool_floor_class(sz);
+        if (nx_image_pool_class_size(class_id) < sz)
+                ++class_id;
+        return class_id;
+}
+
+static void nx_image_pool_unlink(struct NXImagePool *pool, struct NXImagePoolEntry *e)
+{
+        if (e->lru_prev) e->lru_prev->lru_next = e->lru_next;
+        else pool->lru_oldest = e->lru_next;
+        if (e->lru_next) e->lru_next->lru_prev = e->lru_prev;
+        else pool->lru_newest = e->lru_prev;
+
+        if (e->class_prev) e->class_prev->class_next = e->class_next;
+        else pool->classes[e->class_id] = e->class_next;
+        if (e->class_next) e->class_next->class_prev = e->class_prev;
+
+        pool->stats.n_cached--;
+        pool->stats.cached_bytes -= e->capacity;
+}
+
+static void nx_image_pool_link(struct NXImagePool *pool, struct NXImagePoolEntry *e)
+{
+        e->lru_next = NULL;
+        e->lru_prev = pool->lru_newest;
+        if (pool->lru_newest) pool->lru_newest->lru_next = e;
+        else pool->lru_oldest = e;
+        pool->lru_newest = e;
+
+        e->class_prev = NULL;
+        e->class_next = pool->classes[e->class_id];
+        if (e->class_next) e->class_next->class_prev = e;
+        pool->classes[e->class_id] = e;
+
+        pool->stats.n_cached++;
+        pool->stats.cached_bytes += e->capacity;
+}
+
+static void nx_image_pool_evict(struct NXImagePool *pool, size_t max_bytes)
+{
+        while (pool->lru_oldest && pool->stats.cached_bytes > max_bytes) {
+                struct NXImagePoolEntry *e = pool->lru_oldest;
+                nx_image_pool_unlink(pool, e);
+                nx_free(e);
+                pool->stats.n_evictions++;
+        }
+}
+
+void nx_image_pool_set_capacity(size_t max_bytes)
+{
+        pthread_mutex_lock(&nx_s_image_pool_mutex);
+        nx_s_image_pool.max_bytes = max_bytes;
+        nx_image_pool_evict(&nx_s_image_pool, max_bytes);
+        pthread_mutex_unlock(&nx_s_image_pool_mutex);
+}
+
+size_t nx_image_pool_capacity()
+{
+        pthread_mutex_lock(&nx_s_image_pool_mutex);
+        size_t max_bytes = nx_s_image_pool.max_bytes;
+        pthread_mutex_unlock(&nx_s_image_pool_mutex);
+
+        return max_bytes;
+}
+
+NXBool nx_image_pool_is_enabled()
+{
+        return nx_image_pool_capacity() > 0;
+}
+
+void *nx_image_pool_checkout(size_t sz, size_t *capacity)
+{
+        NX_ASSERT_PTR(capacity);
+
+        if (sz < NX_IMAGE_POOL_MIN_BYTES)
+                sz = NX_IMAGE_POOL_MIN_BYTES;
+
+        int class_id = nx_image_pool_ceil_class(sz);
+        if (class_id >= NX_IMAGE_POOL_N_CLASSES)
+                NX_FATAL(NX_LOG_TAG, "Image pool can not allocate %zd bytes!", sz);
+
+        pthread_mutex_lock(&nx_s_image_pool_mutex);
+        struct NXImagePool *pool = &nx_s_image_pool;
+        pool->stats.n_checkouts++;
+        struct NXImagePoolEntry *e = pool->classes[class_id];
+        if (e) {
+                nx_image_pool_unlink(pool, e);
+                pool->stats.n_hits++;
+        }
+        pthread_mutex_unlock(&nx_s_image_pool_mutex);
+
+        if (e) {
+                *capacity = e->capacity;
+                return (void *)e;
+        }
+
+        *capacity = nx_image_pool_class_size(class_id);
+        return nx_xaligned_alloc(NX_SIMD_ALIGNMENT, *capacity);
+}
+
+void nx_image_pool_return(void *ptr, size_t capacity)
+{
+        if (!ptr)
+                return;
+
+        pthread_mutex_lock(&nx_s_image_pool_mutex);
+        struct NXImagePool *pool = &nx_s_image_pool;
+        if (capacity < NX_IMAGE_POOL_MIN_BYTES || capacity > pool->max_bytes) {
+                pthread_mutex_unlock(&nx_s_image_pool_mutex);
+                nx_free(ptr);
+                return;
+        }
+
+        struct NXImagePoolEntry *e = (struct NXImagePoolEntry *)ptr;
+        e->capacity = capacity;
+        e->class_id = nx_image_pool_floor_class(capacity);
+        pool->stats.n_returns++;
+        nx_image_pool_evict(pool, pool->max_bytes - capacity);
+        nx_image_pool_link(pool, e);
+        pthread_mutex_unlock(&nx_s_image_pool_mutex);
+}
+
+void nx_image_pool_clear()
+{
+        pthread_mutex_lock(&nx_s_image_pool_mutex);
+        nx_image_pool_evict(&nx_s_image_pool, 0);
+        pthread_mutex_unlock(&nx_s_image_pool_mutex);
+}
+
+void nx_image_pool_get_stats(struct NXImagePoolStats *stats)
+{
+        NX_ASSERT_PTR(stats);
+
+        pthread_mutex_lock(&nx_s_image_pool_mutex);
+        *stats = nx_s_image_pool.stats;
+        pthread_mutex_unlock(&nx_s_image_pool_mutex);
+}
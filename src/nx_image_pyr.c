@@ -30,6 +30,7 @@
 #include <math.h>
 
 #include <virg/nexus/nx_alloc.h>
+#include <virg/nexus/nx_alloc_stats.h>
 #include <virg/nexus/nx_log.h>
 #include <virg/nexus/nx_assert.h>
 
@@ -88,7 +89,9 @@ void nx_image_pyr_create_level(struct NXImagePyr *pyr, int level_id, int width,
 
         struct NXImagePyrLevel *level = pyr->levels + level_id;
 
+        NX_ALLOC_TAG_PUSH("pyr.level");
         nx_image_resize(level->img, width, height, 0, NX_IMAGE_GRAYSCALE, NX_IMAGE_UCHAR);
+        NX_ALLOC_TAG_POP();
 
         level->scale = scale;
         level->sigma = sigma;
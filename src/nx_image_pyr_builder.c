@@ -41,12 +41,17 @@ static void _nx_image_pyr_builder_update_fine(struct NXImagePyrBuilder *builder,
 static void _nx_image_pyr_builder_update_scaled(struct NXImagePyrBuilder *builder, struct NXImagePyr *pyr);
 
 static inline float compute_sigma_g(float sigma_current, float sigma_desired);
+static void builder_smooth(const struct NXImagePyrBuilder *builder, struct NXImage *dest,
+                           const struct NXImage *src, float sigma);
+static inline NXBool use_fixed_point(const struct NXImagePyrBuilder *builder,
+                                     const struct NXImage *img);
 
 struct NXImagePyrBuilder *nx_image_pyr_builder_alloc()
 {
         struct NXImagePyrBuilder *builder = NX_NEW(1, struct NXImagePyrBuilder);
 
         builder->type = NX_IMAGE_PYR_BUILDER_NONE;
+        builder->engine = NX_IMAGE_PYR_ENGINE_FLOAT;
         memset(&builder->pyr_info, 0, sizeof(struct NXImagePyrInfo));
         builder->work_img = nx_image_alloc();
 
@@ -144,6 +149,20 @@ void nx_image_pyr_builder_set_scaled(struct NXImagePyrBuilder *builder, int n_le
         builder->pyr_info.sigma0 = sigma0;
 }
 
+void nx_image_pyr_builder_set_engine(struct NXImagePyrBuilder *builder, enum NXImagePyrEngine engine)
+{
+        NX_ASSERT_PTR(builder);
+
+        switch (engine) {
+        case NX_IMAGE_PYR_ENGINE_FLOAT:
+        case NX_IMAGE_PYR_ENGINE_FIXED_POINT:
+                builder->engine = engine;
+                break;
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unknown image pyramid engine %d!", (int)engine);
+        }
+}
+
 struct NXImagePyr *nx_image_pyr_builder_build0(struct NXImagePyrBuilder *builder, const struct NXImage *img)
 {
         NX_ASSERT_PTR(builder);
@@ -233,15 +252,16 @@ void _nx_image_pyr_builder_update_fast(struct NXImagePyrBuilder *builder, struct
         float sigma_g = compute_sigma_g(NX_IMAGE_PYR_BUILDER_INITIAL_SIGMA,
                                         pyr->levels[0].sigma);
         if (sigma_g > 0.0f)
-                nx_image_smooth(pyr->levels[0].img, pyr->levels[0].img,
-                                sigma_g, sigma_g,
-                                NX_PYR_KERNEL_TRUNCATION_FACTOR, NULL);
+                builder_smooth(builder, pyr->levels[0].img, pyr->levels[0].img, sigma_g);
 
         // Downsample each layer with AA filter to yield the next one
         int n_levels = pyr->n_levels;
         for (int i = 1; i < n_levels; ++i) {
-                nx_image_downsample_aa_x(builder->work_img, pyr->levels[i-1].img);
-                nx_image_downsample_aa_y(pyr->levels[i].img, builder->work_img);
+                if (use_fixed_point(builder, pyr->levels[i-1].img)) {
+                        nx_image_downsample_aa_fixed(pyr->levels[i].img, pyr->levels[i-1].img);
+                } else {
+                        nx_image_downsample_aa(pyr->levels[i].img, pyr->levels[i-1].img);
+                }
         }
 }
 
@@ -259,9 +279,7 @@ void _nx_image_pyr_builder_update_fine(struct NXImagePyrBuilder *builder, struct
                 if (i == 0) {
                         float sigma_g = compute_sigma_g(sigma_current, oct_levels[0].sigma);
                         if (sigma_g > 0.0f) {
-                                nx_image_smooth(oct_levels[0].img, oct_levels[0].img,
-                                                sigma_g, sigma_g,
-                                                NX_PYR_KERNEL_TRUNCATION_FACTOR, NULL);
+                                builder_smooth(builder, oct_levels[0].img, oct_levels[0].img, sigma_g);
                                 sigma_current = oct_levels[0].sigma;
                         }
                 }
@@ -271,9 +289,7 @@ void _nx_image_pyr_builder_update_fine(struct NXImagePyrBuilder *builder, struct
                 for (int j = 1; j < n_steps; ++j) {
                         float sigma_desired = oct_levels[j].sigma * sigma_multiplier;
                         float sigma_g = compute_sigma_g(sigma_current, sigma_desired);
-                        nx_image_smooth(oct_levels[j].img, oct_levels[j-1].img,
-                                        sigma_g, sigma_g,
-                                        NX_PYR_KERNEL_TRUNCATION_FACTOR, NULL);
+                        builder_smooth(builder, oct_levels[j].img, oct_levels[j-1].img, sigma_g);
                         sigma_current = sigma_desired;
                 }
 
@@ -283,9 +299,7 @@ void _nx_image_pyr_builder_update_fine(struct NXImagePyrBuilder *builder, struct
                         struct NXImagePyrLevel *next_oct_level0 = oct_levels + n_steps;
                         float sigma_desired = next_oct_level0->sigma * sigma_multiplier;
                         float sigma_g = compute_sigma_g(sigma_current, sigma_desired);
-                        nx_image_smooth(builder->work_img, oct_levels[n_steps-1].img,
-                                        sigma_g, sigma_g,
-                                        NX_PYR_KERNEL_TRUNCATION_FACTOR, NULL);
+                        builder_smooth(builder, builder->work_img, oct_levels[n_steps-1].img, sigma_g);
                         nx_image_downsample(next_oct_level0->img, builder->work_img);
                         sigma_current = sigma_desired;
 
@@ -301,9 +315,7 @@ void _nx_image_pyr_builder_update_scaled(struct NXImagePyrBuilder *builder, stru
         float sigma_g = compute_sigma_g(sigma_current, pyr->levels[0].sigma);
 
         if (sigma_g > 0.0f) {
-                nx_image_smooth(pyr->levels[0].img, pyr->levels[0].img,
-                                sigma_g, sigma_g,
-                                NX_PYR_KERNEL_TRUNCATION_FACTOR, NULL);
+                builder_smooth(builder, pyr->levels[0].img, pyr->levels[0].img, sigma_g);
                 sigma_current = pyr->levels[0].sigma;
         }
 
@@ -313,15 +325,31 @@ void _nx_image_pyr_builder_update_scaled(struct NXImagePyrBuilder *builder, stru
         for (int i = 1; i < n_levels; ++i) {
                 float sigma_desired = pyr->levels[i].sigma;
                 float sigma_g = compute_sigma_g(sigma_current, sigma_desired);
-                nx_image_smooth(builder->work_img, builder->work_img,
-                                sigma_g, sigma_g,
-                                NX_PYR_KERNEL_TRUNCATION_FACTOR, NULL);
+                builder_smooth(builder, builder->work_img, builder->work_img, sigma_g);
                 sigma_current = sigma_desired;
 
                 nx_image_scale(pyr->levels[i].img, builder->work_img, 1.0f / pyr->levels[i].scale);
         }
 }
 
+static inline NXBool use_fixed_point(const struct NXImagePyrBuilder *builder,
+                                     const struct NXImage *img)
+{
+        return builder->engine == NX_IMAGE_PYR_ENGINE_FIXED_POINT
+                && img->dtype == NX_IMAGE_UCHAR;
+}
+
+static void builder_smooth(const struct NXImagePyrBuilder *builder, struct NXImage *dest,
+                           const struct NXImage *src, float sigma)
+{
+        if (use_fixed_point(builder, src))
+                nx_image_smooth_fixed(dest, src, sigma, sigma,
+                                      NX_PYR_KERNEL_TRUNCATION_FACTOR);
+        else
+                nx_image_smooth(dest, src, sigma, sigma,
+                                NX_PYR_KERNEL_TRUNCATION_FACTOR, NULL);
+}
+
 float compute_sigma_g(float sigma_current, float sigma_desired)
 {
         float sigma_g = sqrt(sigma_desired*sigma_desired
@@ -0,0 +1,139 @@
+/**
+ * @file nx_image_region.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_image_region.h"
+
+#include <math.h>
+
+#include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_math.h"
+
+void nx_image_region_init(struct NXImageRegion *region, int x, int y,
+                          int width, int height, const struct NXImage *mask)
+{
+        NX_ASSERT_PTR(region);
+
+        region->x = x;
+        region->y = y;
+        region->width = width;
+        region->height = height;
+        region->mask = mask;
+
+        if (mask == NULL)
+                return;
+
+        NX_IMAGE_ASSERT_GRAYSCALE_UCHAR(mask);
+
+        int x0 = nx_max_i(x, 0);
+        int y0 = nx_max_i(y, 0);
+        int x1 = nx_min_i(x + width, mask->width);
+        int y1 = nx_min_i(y + height, mask->height);
+
+        int bx0 = x1;
+        int by0 = y1;
+        int bx1 = x0;
+        int by1 = y0;
+        for (int yi = y0; yi < y1; ++yi) {
+                const uchar *row = mask->data.uc + yi * mask->row_stride;
+                int xi0 = x0;
+                while (xi0 < x1 && row[xi0] == 0)
+                        ++xi0;
+                if (xi0 == x1)
+                        continue;
+
+                int xi1 = x1;
+                while (row[xi1-1] == 0)
+                        --xi1;
+
+                bx0 = nx_min_i(bx0, xi0);
+                bx1 = nx_max_i(bx1, xi1);
+                by0 = nx_min_i(by0, yi);
+                by1 = yi + 1;
+        }
+
+        region->x = bx0;
+        region->y = by0;
+        region->width = nx_max_i(bx1 - bx0, 0);
+        region->height = nx_max_i(by1 - by0, 0);
+}
+
+NXBool nx_image_region_contains(const struct NXImageRegion *region,
+                                float x, float y)
+{
+        if (region == NULL)
+                return NX_TRUE;
+
+        int xi = (int)floorf(x + 0.5f);
+        int yi = (int)floorf(y + 0.5f);
+        if (xi < region->x || xi >= region->x + region->width
+            || yi < region->y || yi >= region->y + region->height)
+                return NX_FALSE;
+
+        const struct NXImage *mask = region->mask;
+        if (mask == NULL)
+                return NX_TRUE;
+
+        if (xi < 0 || xi >= mask->width || yi < 0 || yi >= mask->height)
+                return NX_FALSE;
+
+        return mask->data.uc[yi * mask->row_stride + xi] != 0;
+}
+
+void nx_image_region_level_bounds(const struct NXImageRegion *region,
+                                  float scale, int margin,
+                                  int width, int height,
+                                  int *x0, int *y0, int *x1, int *y1)
+{
+        NX_ASSERT(scale > 0.0f);
+        NX_ASSERT_PTR(x0);
+        NX_ASSERT_PTR(y0);
+        NX_ASSERT_PTR(x1);
+        NX_ASSERT_PTR(y1);
+
+        if (region == NULL) {
+                *x0 = 0;
+                *y0 = 0;
+                *x1 = width;
+                *y1 = height;
+                return;
+        }
+
+        // level pixels whose rounded level 0 position is in the rectangle,
+        // one more pixel on each side against rounding of x * scale
+        int lx0 = (int)floorf((region->x - 0.5f) / scale) - 1;
+        int ly0 = (int)floorf((region->y - 0.5f) / scale) - 1;
+        int lx1 = (int)floorf((region->x + region->width - 0.5f) / scale) + 2;
+        int ly1 = (int)floorf((region->y + region->height - 0.5f) / scale) + 2;
+        if (region->width <= 0 || region->height <= 0) {
+                lx1 = lx0;
+                ly1 = ly0;
+                margin = 0;
+        }
+
+        *x0 = nx_max_i(lx0 - margin, 0);
+        *y0 = nx_max_i(ly0 - margin, 0);
+        *x1 = nx_min_i(lx1 + margin, width);
+        *y1 = nx_min_i(ly1 + margin, height);
+}
@@ -49,6 +49,8 @@ void nx_image_warp_affine_bilinear(int dest_w, int dest_h, uchar *dest, int dest
         if (bg_mode == NX_IMAGE_WARP_WHITE)
                 bg_fixed = 255;
 
+        struct NXUniformSampler *sampler = nx_uniform_sampler_instance();
+
         const float *t = t_dest2src;
         for (int y = 0; y < dest_h; ++y) {
                 uchar *drow = dest + y*dest_stride;
@@ -86,7 +88,7 @@ void nx_image_warp_affine_bilinear(int dest_w, int dest_h, uchar *dest, int dest
                         case NX_IMAGE_WARP_NOISE:
                                 if (idx[0] < 0 || idx[0] >= LAST_X
                                     || idy[0] < 0 || idy[0] >= LAST_Y) {
-                                        drow[x] = 255.0f * NX_UNIFORM_SAMPLE_S;
+                                        drow[x] = 255.0f * nx_uniform_sampler_sample_s(sampler);
                                         continue;
                                 }
                                 break;
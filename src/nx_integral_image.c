@@ -0,0 +1,462 @@
+/**
+ * @file nx_integral_image.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_integral_image.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_log.h"
+#include "virg/nexus/nx_math.h"
+#include "virg/nexus/nx_mem_block.h"
+
+#if (NX_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+static inline int clamp_i(int v, int v_min, int v_max)
+{
+        return nx_min_i(nx_max_i(v, v_min), v_max);
+}
+
+/* Adds the running sum of src to the previous table row */
+static void integral_row_u32(int n, uint32_t *row, const uint32_t *prev,
+                             const uchar *src)
+{
+        uint32_t sum = 0;
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        __m256i carry = _mm256_setzero_si256();
+        const __m256i last = _mm256_set1_epi32(7);
+        for (; i + 8 <= n; i += 8) {
+                __m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+                x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+                x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+                __m256i low_sum = _mm256_shuffle_epi32(x, 0xFF);
+                x = _mm256_add_epi32(x, _mm256_permute2x128_si256(low_sum, low_sum, 0x08));
+                x = _mm256_add_epi32(x, carry);
+                carry = _mm256_permutevar8x32_epi32(x, last);
+                x = _mm256_add_epi32(x, _mm256_loadu_si256((const __m256i *)(prev + i)));
+                _mm256_storeu_si256((__m256i *)(row + i), x);
+        }
+        sum = (uint32_t)_mm256_cvtsi256_si32(carry);
+#endif
+        for (; i < n; ++i) {
+                sum += src[i];
+                row[i] = prev[i] + sum;
+        }
+}
+
+static void integral_row_f64(int n, double *row, const double *prev,
+                             const float *src)
+{
+        double sum = 0.0;
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        __m256d carry = _mm256_setzero_pd();
+        const __m256d zero = _mm256_setzero_pd();
+        for (; i + 4 <= n; i += 4) {
+                __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(src + i));
+                x = _mm256_add_pd(x, _mm256_castsi256_pd(_mm256_slli_si256(_mm256_castpd_si256(x), 8)));
+                x = _mm256_add_pd(x, _mm256_blend_pd(zero, _mm256_permute4x64_pd(x, 0x55), 0xC));
+                x = _mm256_add_pd(x, carry);
+                carry = _mm256_permute4x64_pd(x, 0xFF);
+                _mm256_storeu_pd(row + i, _mm256_add_pd(x, _mm256_loadu_pd(prev + i)));
+        }
+        sum = _mm256_cvtsd_f64(carry);
+#endif
+        for (; i < n; ++i) {
+                sum += src[i];
+                row[i] = prev[i] + sum;
+        }
+}
+
+struct NXIntegralImage *nx_integral_image_alloc()
+{
+        struct NXIntegralImage *ii = NX_NEW(1, struct NXIntegralImage);
+
+        ii->width = 0;
+        ii->height = 0;
+        ii->pad = 0;
+        ii->rotated = NX_FALSE;
+        ii->dtype = NX_INTEGRAL_IMAGE_U32;
+        ii->n_rows = 0;
+        ii->n_cols = 0;
+        ii->mem = nx_mem_block_alloc_aligned(NX_SIMD_ALIGNMENT);
+        ii->data.v = NULL;
+
+        return ii;
+}
+
+void nx_integral_image_free(struct NXIntegralImage *ii)
+{
+        if (ii) {
+                nx_mem_block_free(ii->mem);
+                nx_free(ii);
+        }
+}
+
+static void integral_image_resize(struct NXIntegralImage *ii,
+                                  const struct NXImage *img, int pad,
+                                  NXBool rotated, int n_rows, int n_cols)
+{
+        size_t n_bytes = 0;
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR:
+                ii->dtype = NX_INTEGRAL_IMAGE_U32;
+                n_bytes = sizeof(uint32_t);
+                break;
+        case NX_IMAGE_FLOAT32:
+                ii->dtype = NX_INTEGRAL_IMAGE_F64;
+                n_bytes = sizeof(double);
+                break;
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        }
+
+        ii->width = img->width;
+        ii->height = img->height;
+        ii->pad = pad;
+        ii->rotated = rotated;
+        ii->n_rows = n_rows;
+        ii->n_cols = n_cols;
+        nx_mem_block_resize(ii->mem, (size_t)n_rows * n_cols * n_bytes);
+        ii->data.v = ii->mem->ptr;
+}
+
+#define NX_DEFINE_INTEGRAL_IMAGE_COMPUTE_FUNCS(F,T,TF,TT)               \
+        static void integral_image_compute_##F(struct NXIntegralImage *ii, \
+                                               const struct NXImage *img) \
+        {                                                               \
+                const int pad = ii->pad;                                \
+                const int pw = img->width + 2 * pad;                    \
+                T *prow = NX_NEW(pw, T);                                \
+                memset(ii->data.TF, 0, ii->n_cols * sizeof(TT));        \
+                for (int j = 0; j < ii->n_rows - 1; ++j) {              \
+                        int y = clamp_i(j - pad, 0, img->height - 1);   \
+                        const T *row = img->data.F + y * img->row_stride; \
+                        for (int i = 0; i < pad; ++i) {                 \
+                                prow[i] = row[0];                       \
+                                prow[pad + img->width + i] = row[img->width - 1]; \
+                        }                                               \
+                        memcpy(prow + pad, row, img->width * sizeof(T)); \
+                        TT *t = ii->data.TF + (size_t)(j + 1) * ii->n_cols; \
+                        t[0] = 0;                                       \
+                        integral_row_##TF(pw, t + 1, t + 1 - ii->n_cols, prow); \
+                }                                                       \
+                nx_free(prow);                                          \
+        }                                                               \
+                                                                        \
+        static void integral_image_compute_rotated_##F(struct NXIntegralImage *ii, \
+                                                       const struct NXImage *img) \
+        {                                                               \
+                const int pad = ii->pad;                                \
+                const int pw = img->width + 2 * pad;                    \
+                const int ph = img->height + 2 * pad;                   \
+                const int n = ii->n_cols - 1;                           \
+                T *prow = NX_NEW(n, T);                                 \
+                memset(ii->data.TF, 0, ii->n_cols * sizeof(TT));        \
+                for (int s = 0; s < n; ++s) {                           \
+                        memset(prow, 0, n * sizeof(T));                 \
+                        int px0 = nx_max_i(0, s - ph + 1);              \
+                        int px1 = nx_min_i(pw - 1, s);                  \
+                        for (int px = px0; px <= px1; ++px) {           \
+                                int x = clamp_i(px - pad, 0, img->width - 1); \
+                                int y = clamp_i(s - px - pad, 0, img->height - 1); \
+                                prow[2 * px - s + ph - 1] = img->data.F[y * img->row_stride + x]; \
+                        }                                               \
+                        TT *t = ii->data.TF + (size_t)(s + 1) * ii->n_cols; \
+                        t[0] = 0;                                       \
+                        integral_row_##TF(n, t + 1, t + 1 - ii->n_cols, prow); \
+                }                                                       \
+                nx_free(prow);                                          \
+        }
+
+NX_DEFINE_INTEGRAL_IMAGE_COMPUTE_FUNCS(uc,uchar,u32,uint32_t)
+NX_DEFINE_INTEGRAL_IMAGE_COMPUTE_FUNCS(f32,float,f64,double)
+
+void nx_integral_image_compute(struct NXIntegralImage *ii,
+                               const struct NXImage *img, int pad)
+{
+        NX_ASSERT_PTR(ii);
+        NX_ASSERT_PTR(img);
+        NX_IMAGE_ASSERT_GRAYSCALE(img);
+        NX_ASSERT(img->width > 0 && img->height > 0);
+        NX_ASSERT(pad >= 0);
+
+        integral_image_resize(ii, img, pad, NX_FALSE,
+                              img->height + 2 * pad + 1,
+                              img->width + 2 * pad + 1);
+
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR: integral_image_compute_uc(ii, img); break;
+        case NX_IMAGE_FLOAT32: integral_image_compute_f32(ii, img); break;
+        default: NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        }
+}
+
+void nx_integral_image_compute_rotated(struct NXIntegralImage *ii,
+                                       const struct NXImage *img, int pad)
+{
+        NX_ASSERT_PTR(ii);
+        NX_ASSERT_PTR(img);
+        NX_IMAGE_ASSERT_GRAYSCALE(img);
+        NX_ASSERT(img->width > 0 && img->height > 0);
+        NX_ASSERT(pad >= 0);
+
+        int n = img->width + img->height + 4 * pad - 1;
+        integral_image_resize(ii, img, pad, NX_TRUE, n + 1, n + 1);
+
+        switch (img->dtype) {
+        case NX_IMAGE_UCHAR: integral_image_compute_rotated_uc(ii, img); break;
+        case NX_IMAGE_FLOAT32: integral_image_compute_rotated_f32(ii, img); break;
+        default: NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+        }
+}
+
+/* Sum of the table entries in columns [i0,i1) and rows [j0,j1) */
+static double integral_image_sum(const struct NXIntegralImage *ii,
+                                 int i0, int j0, int i1, int j1)
+{
+        size_t r0 = (size_t)j0 * ii->n_cols;
+        size_t r1 = (size_t)j1 * ii->n_cols;
+        switch (ii->dtype) {
+        case NX_INTEGRAL_IMAGE_U32: {
+                const uint32_t *t = ii->data.u32;
+                return (uint32_t)(t[r1 + i1] - t[r0 + i1] - t[r1 + i0] + t[r0 + i0]);
+        }
+        case NX_INTEGRAL_IMAGE_F64: {
+                const double *t = ii->data.f64;
+                return (t[r1 + i1] - t[r0 + i1]) - (t[r1 + i0] - t[r0 + i0]);
+        }
+        default:
+                NX_FATAL(NX_LOG_TAG, "Unhandled switch case for integral image data type");
+        }
+        return 0.0;
+}
+
+double nx_integral_image_box_sum(const struct NXIntegralImage *ii,
+                                 int x0, int y0, int x1, int y1)
+{
+        NX_ASSERT_PTR(ii);
+        NX_ASSERT(!ii->rotated);
+
+        if (x0 > x1 || y0 > y1)
+                return 0.0;
+
+        int i0 = clamp_i(x0 + ii->pad, 0, ii->n_cols - 1);
+        int i1 = clamp_i(x1 + ii->pad + 1, 0, ii->n_cols - 1);
+        int j0 = clamp_i(y0 + ii->pad, 0, ii->n_rows - 1);
+        int j1 = clamp_i(y1 + ii->pad + 1, 0, ii->n_rows - 1);
+        return integral_image_sum(ii, i0, j0, i1, j1);
+}
+
+double nx_integral_image_rotated_box_sum(const struct NXIntegralImage *ii,
+                                         int x, int y, int r_diag, int r_anti)
+{
+        NX_ASSERT_PTR(ii);
+        NX_ASSERT(ii->rotated);
+        NX_ASSERT(r_diag >= 0 && r_anti >= 0);
+
+        int s = x + y + 2 * ii->pad;
+        int d = x - y + ii->height + 2 * ii->pad - 1;
+        int n = ii->n_cols - 1;
+        int i0 = clamp_i(d - 2 * r_anti, 0, n);
+        int i1 = clamp_i(d + 2 * r_anti + 1, 0, n);
+        int j0 = clamp_i(s - 2 * r_diag, 0, n);
+        int j1 = clamp_i(s + 2 * r_diag + 1, 0, n);
+        return integral_image_sum(ii, i0, j0, i1, j1);
+}
+
+/* Arguments of the row bands of nx_integral_image_box_filter */
+struct NXIntegralImageBoxFilterJob
+{
+        struct NXImage *dest;
+        const struct NXIntegralImage *ii;
+        int r_x;
+        int r_y;
+};
+
+static void integral_image_resize_dest(struct NXImage *dest,
+                                       const struct NXIntegralImage *ii)
+{
+        enum NXImageDataType dtype = NX_IMAGE_UCHAR;
+        switch (ii->dtype) {
+        case NX_INTEGRAL_IMAGE_U32: dtype = NX_IMAGE_UCHAR; break;
+        case NX_INTEGRAL_IMAGE_F64: dtype = NX_IMAGE_FLOAT32; break;
+        default: NX_FATAL(NX_LOG_TAG, "Unhandled switch case for integral image data type");
+        }
+
+        if (dest->width != ii->width || dest->height != ii->height
+            || dest->type != NX_IMAGE_GRAYSCALE || dest->dtype != dtype)
+                nx_image_resize(dest, ii->width, ii->height, NX_IMAGE_STRIDE_DEFAULT,
+                                NX_IMAGE_GRAYSCALE, dtype);
+}
+
+static void integral_image_box_filter_uc(void *arg, int y0, int y1)
+{
+        const struct NXIntegralImageBoxFilterJob *job = (const struct NXIntegralImageBoxFilterJob *)arg;
+        struct NXImage *dest = job->dest;
+        const struct NXIntegralImage *ii = job->ii;
+        const int r_x = job->r_x;
+        const int r_y = job->r_y;
+        const int w = 2 * r_x + 1;
+        const float area = (float)w * (2 * r_y + 1);
+        for (int y = y0; y < y1; ++y) {
+                const uint32_t *top = ii->data.u32 + (size_t)(y + ii->pad - r_y) * ii->n_cols
+                        + ii->pad - r_x;
+                const uint32_t *bottom = top + (size_t)(2 * r_y + 1) * ii->n_cols;
+                uchar *drow = dest->data.uc + y * dest->row_stride;
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                const __m256 area_v = _mm256_set1_ps(area);
+                for (; x + 8 <= dest->width; x += 8) {
+                        __m256i sum = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(bottom + x + w)),
+                                                       _mm256_loadu_si256((const __m256i *)(top + x + w)));
+                        sum = _mm256_sub_epi32(sum, _mm256_loadu_si256((const __m256i *)(bottom + x)));
+                        sum = _mm256_add_epi32(sum, _mm256_loadu_si256((const __m256i *)(top + x)));
+                        __m256i mean = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(sum), area_v));
+                        __m128i mean16 = _mm_packus_epi32(_mm256_castsi256_si128(mean),
+                                                          _mm256_extracti128_si256(mean, 1));
+                        _mm_storel_epi64((__m128i *)(drow + x), _mm_packus_epi16(mean16, mean16));
+                }
+#endif
+                for (; x < dest->width; ++x) {
+                        uint32_t sum = bottom[x + w] - top[x + w] - bottom[x] + top[x];
+                        drow[x] = (uchar)((float)sum / area);
+                }
+        }
+}
+
+static void integral_image_box_filter_f32(void *arg, int y0, int y1)
+{
+        const struct NXIntegralImageBoxFilterJob *job = (const struct NXIntegralImageBoxFilterJob *)arg;
+        struct NXImage *dest = job->dest;
+        const struct NXIntegralImage *ii = job->ii;
+        const int r_x = job->r_x;
+        const int r_y = job->r_y;
+        const int w = 2 * r_x + 1;
+        const double area = (double)w * (2 * r_y + 1);
+        for (int y = y0; y < y1; ++y) {
+                const double *top = ii->data.f64 + (size_t)(y + ii->pad - r_y) * ii->n_cols
+                        + ii->pad - r_x;
+                const double *bottom = top + (size_t)(2 * r_y + 1) * ii->n_cols;
+                float *drow = dest->data.f32 + y * dest->row_stride;
+                int x = 0;
+#if (NX_SIMD_AVX2)
+                const __m256d area_v = _mm256_set1_pd(area);
+                for (; x + 4 <= dest->width; x += 4) {
+                        __m256d right = _mm256_sub_pd(_mm256_loadu_pd(bottom + x + w),
+                                                      _mm256_loadu_pd(top + x + w));
+                        __m256d left = _mm256_sub_pd(_mm256_loadu_pd(bottom + x),
+                                                     _mm256_loadu_pd(top + x));
+                        __m256d mean = _mm256_div_pd(_mm256_sub_pd(right, left), area_v);
+                        _mm_storeu_ps(drow + x, _mm256_cvtpd_ps(mean));
+                }
+#endif
+                for (; x < dest->width; ++x) {
+                        double sum = (bottom[x + w] - top[x + w]) - (bottom[x] - top[x]);
+                        drow[x] = (float)(sum / area);
+                }
+        }
+}
+
+void nx_integral_image_box_filter(struct NXImage *dest,
+                                  const struct NXIntegralImage *ii,
+                                  int r_x, int r_y)
+{
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT_PTR(ii);
+        NX_ASSERT(!ii->rotated);
+        NX_ASSERT(r_x >= 0 && r_x <= ii->pad);
+        NX_ASSERT(r_y >= 0 && r_y <= ii->pad);
+
+        integral_image_resize_dest(dest, ii);
+
+        struct NXIntegralImageBoxFilterJob job = { dest, ii, r_x, r_y };
+        switch (ii->dtype) {
+        case NX_INTEGRAL_IMAGE_U32:
+                nx_image_parallel_for(dest->height, dest->width, integral_image_box_filter_uc, &job);
+                break;
+        case NX_INTEGRAL_IMAGE_F64:
+                nx_image_parallel_for(dest->height, dest->width, integral_image_box_filter_f32, &job);
+                break;
+        default: NX_FATAL(NX_LOG_TAG, "Unhandled switch case for integral image data type");
+        }
+}
+
+/* Pixels on an anti-diagonal x + y = k share the table rows of their boxes,
+ * so the filter walks the image along anti-diagonals and reads every other
+ * entry of two table rows instead of stepping through four rows per pixel */
+#define NX_DEFINE_INTEGRAL_IMAGE_ROTATED_BOX_FILTER_FUNC(F,T,TF,TT,MEAN) \
+        static void integral_image_rotated_box_filter_##F(struct NXImage *dest, \
+                                                          const struct NXIntegralImage *ii, \
+                                                          int r_diag, int r_anti) \
+        {                                                               \
+                const int w = dest->width;                              \
+                const int h = dest->height;                             \
+                const int ds = dest->row_stride - 1;                    \
+                const double area = (double)(2 * r_diag + 1) * (2 * r_anti + 1) \
+                        + 4.0 * r_diag * r_anti;                        \
+                for (int k = 0; k < w + h - 1; ++k) {                   \
+                        int x0 = nx_max_i(0, k - h + 1);                \
+                        int x1 = nx_min_i(w - 1, k);                    \
+                        int s = k + 2 * ii->pad;                        \
+                        int d = 2 * x0 - k + ii->height + 2 * ii->pad - 1; \
+                        const TT *t0 = ii->data.TF + (size_t)(s - 2 * r_diag) * ii->n_cols \
+                                + d - 2 * r_anti;                       \
+                        const TT *t1 = t0 + (size_t)(4 * r_diag + 1) * ii->n_cols; \
+                        const int i1 = 4 * r_anti + 1;                  \
+                        T *p = dest->data.F + (k - x0) * dest->row_stride + x0; \
+                        for (int i = 0; i <= 2 * (x1 - x0); i += 2, p -= ds) { \
+                                TT sum = t1[i + i1] - t1[i] - t0[i + i1] + t0[i]; \
+                                *p = (T)(MEAN);                         \
+                        }                                               \
+                }                                                       \
+        }
+
+NX_DEFINE_INTEGRAL_IMAGE_ROTATED_BOX_FILTER_FUNC(uc,uchar,u32,uint32_t,(float)sum / (float)area)
+NX_DEFINE_INTEGRAL_IMAGE_ROTATED_BOX_FILTER_FUNC(f32,float,f64,double,sum / area)
+
+void nx_integral_image_rotated_box_filter(struct NXImage *dest,
+                                          const struct NXIntegralImage *ii,
+                                          int r_diag, int r_anti)
+{
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT_PTR(ii);
+        NX_ASSERT(ii->rotated);
+        NX_ASSERT(r_diag >= 0 && r_anti >= 0);
+        NX_ASSERT(r_diag + r_anti <= ii->pad);
+
+        integral_image_resize_dest(dest, ii);
+
+        switch (ii->dtype) {
+        case NX_INTEGRAL_IMAGE_U32: integral_image_rotated_box_filter_uc(dest, ii, r_diag, r_anti); break;
+        case NX_INTEGRAL_IMAGE_F64: integral_image_rotated_box_filter_f32(dest, ii, r_diag, r_anti); break;
+        default: NX_FATAL(NX_LOG_TAG, "Unhandled switch case for integral image data type");
+        }
+}
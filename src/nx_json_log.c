@@ -26,46 +26,109 @@
 #define NX_ENABLE_JLOG 1
 #include "virg/nexus/nx_json_log.h"
 
+#include <stdatomic.h>
+#include <pthread.h>
+
 #include "virg/nexus/nx_alloc.h"
 #include "virg/nexus/nx_log.h"
 
-static struct NXJSONNode **nx_s_json_log = NULL;
+/* Every thread logs into its own set of streams, the sets are only visited
+ * together when streams are merged, cleared or freed. */
+struct NXJSONLogStreams {
+        struct NXJSONLogStreams *next;
+        struct NXJSONNode *streams[NX_JLOG_N_STREAMS];
+};
 
-struct NXJSONNode *nx_json_log_get_stream(int jlog_id)
-{
-        if (nx_s_json_log == NULL) {
-                nx_s_json_log = NX_NEW(NX_JLOG_N_STREAMS, struct NXJSONNode *);
-                for (int i = 0; i < NX_JLOG_N_STREAMS; ++i)
-                        nx_s_json_log[i] = NULL;
-        }
+static struct NXJSONLogStreams *nx_s_json_log_head = NULL;
+static struct NXJSONLogStreams *nx_s_json_log_tail = NULL;
+static atomic_uint nx_s_json_log_generation = 1;
+static pthread_mutex_t nx_s_json_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local struct NXJSONLogStreams *nx_s_json_log = NULL;
+static _Thread_local unsigned nx_s_json_log_thread_generation = 0;
 
+static inline void nx_json_log_check_id(int jlog_id)
+{
         if (jlog_id < 0 || jlog_id >= NX_JLOG_N_STREAMS)
                 NX_FATAL(NX_LOG_TAG, "JSON log id %d is not in range [0, %d]",
                          jlog_id, NX_JLOG_N_STREAMS-1);
-        else if (nx_s_json_log[jlog_id] == NULL)
-                nx_s_json_log[jlog_id] = nx_json_node_new_object();
+}
+
+static struct NXJSONLogStreams *nx_json_log_thread_streams()
+{
+        unsigned generation = atomic_load(&nx_s_json_log_generation);
+        if (nx_s_json_log != NULL && nx_s_json_log_thread_generation == generation)
+                return nx_s_json_log;
+
+        struct NXJSONLogStreams *log = NX_NEW(1, struct NXJSONLogStreams);
+        log->next = NULL;
+        for (int i = 0; i < NX_JLOG_N_STREAMS; ++i)
+                log->streams[i] = NULL;
+
+        pthread_mutex_lock(&nx_s_json_log_mutex);
+        if (nx_s_json_log_tail == NULL)
+                nx_s_json_log_head = log;
+        else
+                nx_s_json_log_tail->next = log;
+        nx_s_json_log_tail = log;
+        nx_s_json_log_thread_generation = atomic_load(&nx_s_json_log_generation);
+        pthread_mutex_unlock(&nx_s_json_log_mutex);
+
+        nx_s_json_log = log;
+        return log;
+}
 
-        return nx_s_json_log[jlog_id];
+struct NXJSONNode *nx_json_log_get_stream(int jlog_id)
+{
+        nx_json_log_check_id(jlog_id);
+
+        struct NXJSONLogStreams *log = nx_json_log_thread_streams();
+        if (log->streams[jlog_id] == NULL)
+                log->streams[jlog_id] = nx_json_node_new_object();
+
+        return log->streams[jlog_id];
+}
+
+struct NXJSONNode *nx_json_log_merge_stream(int jlog_id)
+{
+        struct NXJSONNode *stream = nx_json_log_get_stream(jlog_id);
+
+        pthread_mutex_lock(&nx_s_json_log_mutex);
+        for (struct NXJSONLogStreams *log = nx_s_json_log_head; log != NULL; log = log->next)
+                if (log != nx_s_json_log && log->streams[jlog_id] != NULL)
+                        nx_json_object_merge(stream, log->streams[jlog_id]);
+        pthread_mutex_unlock(&nx_s_json_log_mutex);
+
+        return stream;
 }
 
 void nx_json_log_free()
 {
-        if (nx_s_json_log != NULL) {
+        pthread_mutex_lock(&nx_s_json_log_mutex);
+        struct NXJSONLogStreams *log = nx_s_json_log_head;
+        while (log != NULL) {
+                struct NXJSONLogStreams *next = log->next;
                 for (int i = 0; i < NX_JLOG_N_STREAMS; ++i)
-                        nx_json_tree_free(nx_s_json_log[i]);
-                nx_free(nx_s_json_log);
-                nx_s_json_log = NULL;
+                        nx_json_tree_free(log->streams[i]);
+                nx_free(log);
+                log = next;
         }
+        nx_s_json_log_head = NULL;
+        nx_s_json_log_tail = NULL;
+        atomic_fetch_add(&nx_s_json_log_generation, 1);
+        pthread_mutex_unlock(&nx_s_json_log_mutex);
+
+        nx_s_json_log = NULL;
 }
 
 void nx_json_log_clear_stream(int jlog_id)
 {
-        if (jlog_id < 0 || jlog_id >= NX_JLOG_N_STREAMS)
-                NX_FATAL(NX_LOG_TAG, "JSON log id %d is not in range [0, %d]",
-                         jlog_id, NX_JLOG_N_STREAMS-1);
-        else if (nx_s_json_log == NULL || nx_s_json_log[jlog_id] == NULL)
-                return;
+        nx_json_log_check_id(jlog_id);
 
-        nx_json_tree_free(nx_s_json_log[jlog_id]);
-        nx_s_json_log[jlog_id] = NULL;
+        pthread_mutex_lock(&nx_s_json_log_mutex);
+        for (struct NXJSONLogStreams *log = nx_s_json_log_head; log != NULL; log = log->next) {
+                nx_json_tree_free(log->streams[jlog_id]);
+                log->streams[jlog_id] = NULL;
+        }
+        pthread_mutex_unlock(&nx_s_json_log_mutex);
 }
@@ -401,6 +401,42 @@ struct NXJSONNode *nx_json_array_add(struct NXJSONNode *jarray, struct NXJSONNod
         return nx_json_node_add_child(jarray, node);
 }
 
+void nx_json_object_merge(struct NXJSONNode *dest, struct NXJSONNode *src)
+{
+        NX_ASSERT_PTR(dest);
+        NX_ASSERT_PTR(src);
+        NX_ASSERT(dest->type == NX_JNT_OBJECT);
+        NX_ASSERT(src->type == NX_JNT_OBJECT);
+
+        struct NXJSONNode *name_node = src->down;
+        src->down = NULL;
+        src->last_child = NULL;
+
+        while (name_node != NULL) {
+                struct NXJSONNode *value = name_node->right;
+                struct NXJSONNode *next = value->right;
+                value->right = NULL;
+
+                struct NXJSONNode *dest_array = NULL;
+                if (value->type == NX_JNT_ARRAY)
+                        dest_array = nx_json_object_get(dest, name_node->text, NX_JNT_ARRAY);
+
+                if (dest_array != NULL) {
+                        if (value->down != NULL)
+                                nx_json_node_add_child(dest_array, value->down);
+                        value->down = NULL;
+                        value->last_child = NULL;
+                        name_node->right = NULL;
+                        nx_json_tree_free(name_node);
+                        nx_json_tree_free(value);
+                } else {
+                        nx_json_node_add_child(dest, name_node);
+                }
+
+                name_node = next;
+        }
+}
+
 struct NXJSONNode *nx_json_object_add(struct NXJSONNode *jobject, const char *name, struct NXJSONNode *node)
 {
         NX_ASSERT_PTR(jobject);
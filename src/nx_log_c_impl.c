@@ -28,11 +28,20 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
 #include <execinfo.h>
 
 #include "virg/nexus/nx_types.h"
+#include "virg/nexus/nx_alloc.h"
 
-#define LOG_STREAM stderr
+#define LOG_STREAM (g_log_stream ? g_log_stream : stderr)
+
+#define NX_LOG_ASYNC_IDLE_SLEEP_NS 200000
 
 #define NX_INFO_COLOR_CODE "\x1b[34;1m"
 #define NX_LOG_COLOR_CODE "\x1b[36m"
@@ -48,6 +57,33 @@ static const char *LOG_HEADER_FORMAT = "[%s][%s][%s:%d] ";
 
 static enum NXLogVerbosity g_log_verbosity = NX_LOG_DEFAULT;
 static __NX_NO_RETURN_PTR NXLogFatalFuncP g_fatal_func = default_fatal_func;
+static FILE *g_log_stream = NULL;
+
+/* Bounded multi-producer ring after D. Vyukov: a slot is free for the
+ * producer at position pos when its sequence equals pos and holds a record
+ * for the consumer when its sequence equals pos + 1. */
+struct NXLogRecord {
+        atomic_size_t sequence;
+        enum NXLogLevel level;
+        const char *function_name;
+        int line_no;
+        char tag[NX_LOG_ASYNC_TAG_LENGTH];
+        char text[NX_LOG_ASYNC_TEXT_LENGTH];
+};
+
+struct NXLogRing {
+        struct NXLogRecord *records;
+        size_t mask;
+        atomic_size_t enqueue_pos;
+        atomic_size_t dequeue_pos;
+        atomic_int stop;
+        pthread_t writer;
+};
+
+static struct NXLogRing *_Atomic g_log_ring = NULL;
+static atomic_int g_log_n_producers = 0;
+static atomic_size_t g_log_n_dropped = 0;
+static pthread_mutex_t g_log_async_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static inline void print_call_stack()
 {
@@ -81,6 +117,120 @@ static inline void stop_color_output()
         fprintf(LOG_STREAM, NX_RESET_COLOR_CODE);
 }
 
+static inline const char *log_level_string(enum NXLogLevel log_level)
+{
+        switch(log_level) {
+        case NX_LOG_INFO: return "I";
+        case NX_LOG_NORMAL: return "L";
+        case NX_LOG_WARNING: return "W";
+        case NX_LOG_ERROR: return "E";
+        default:
+                return "?";
+        }
+}
+
+static inline void start_level_color_output(enum NXLogLevel log_level)
+{
+        switch(log_level) {
+        case NX_LOG_INFO: start_color_output(NX_INFO_COLOR_CODE); break;
+        case NX_LOG_NORMAL: start_color_output(NX_LOG_COLOR_CODE); break;
+        case NX_LOG_WARNING: start_color_output(NX_WARNING_COLOR_CODE); break;
+        case NX_LOG_ERROR: start_color_output(NX_ERROR_COLOR_CODE); break;
+        }
+}
+
+static void log_write_record(const struct NXLogRecord *record)
+{
+        NXBool is_color_term = is_color_terminal();
+        if (is_color_term)
+                start_level_color_output(record->level);
+        fprintf(LOG_STREAM, LOG_HEADER_FORMAT, log_level_string(record->level),
+                record->tag, record->function_name, record->line_no);
+        fputs(record->text, LOG_STREAM);
+        if (is_color_term)
+                stop_color_output();
+        fprintf(LOG_STREAM, "\n");
+}
+
+static NXBool log_ring_write_next(struct NXLogRing *ring)
+{
+        size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+        struct NXLogRecord *record = &ring->records[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        if (seq != pos + 1)
+                return NX_FALSE;
+
+        log_write_record(record);
+
+        atomic_store_explicit(&record->sequence, pos + ring->mask + 1, memory_order_release);
+        atomic_store_explicit(&ring->dequeue_pos, pos + 1, memory_order_release);
+        return NX_TRUE;
+}
+
+static void *log_writer_main(void *arg)
+{
+        struct NXLogRing *ring = (struct NXLogRing *)arg;
+        const struct timespec idle = { 0, NX_LOG_ASYNC_IDLE_SLEEP_NS };
+
+        for (;;) {
+                if (log_ring_write_next(ring))
+                        continue;
+
+                if (atomic_load(&ring->stop)
+                    && atomic_load(&ring->dequeue_pos) == atomic_load(&ring->enqueue_pos))
+                        break;
+
+                fflush(LOG_STREAM);
+                nanosleep(&idle, NULL);
+        }
+        fflush(LOG_STREAM);
+
+        return NULL;
+}
+
+/* Returns NX_FALSE if logging is synchronous, otherwise the record has been
+ * queued or dropped. */
+static NXBool log_ring_push(enum NXLogLevel log_level, const char* function_name, int line_no,
+                            const char *tag, const char *msg, va_list prm)
+{
+        atomic_fetch_add(&g_log_n_producers, 1);
+        struct NXLogRing *ring = atomic_load(&g_log_ring);
+        if (ring == NULL) {
+                atomic_fetch_sub(&g_log_n_producers, 1);
+                return NX_FALSE;
+        }
+
+        struct NXLogRecord *record;
+        size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+        for (;;) {
+                record = &ring->records[pos & ring->mask];
+                size_t seq = atomic_load_explicit(&record->sequence, memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if (diff == 0) {
+                        if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1,
+                                                                  memory_order_relaxed,
+                                                                  memory_order_relaxed))
+                                break;
+                } else if (diff < 0) {
+                        atomic_fetch_add(&g_log_n_dropped, 1);
+                        atomic_fetch_sub(&g_log_n_producers, 1);
+                        return NX_TRUE;
+                } else {
+                        pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+                }
+        }
+
+        record->level = log_level;
+        record->function_name = function_name;
+        record->line_no = line_no;
+        snprintf(record->tag, NX_LOG_ASYNC_TAG_LENGTH, "%s", tag);
+        vsnprintf(record->text, NX_LOG_ASYNC_TEXT_LENGTH, msg, prm);
+        atomic_store_explicit(&record->sequence, pos + 1, memory_order_release);
+
+        atomic_fetch_sub(&g_log_n_producers, 1);
+        return NX_TRUE;
+}
+
 void default_fatal_func(const char* function_name, int line_no, const char* tag, const char* msg, va_list prm)
 {
         NXBool is_color_term = is_color_terminal();
@@ -102,26 +252,12 @@ void nx_log_formatted(enum NXLogLevel log_level, const char* function_name, int
 {
         va_list prm;
         va_start(prm, msg);
-        if ((int)g_log_verbosity <= (int)log_level) {
+        if ((int)g_log_verbosity <= (int)log_level
+            && !log_ring_push(log_level, function_name, line_no, tag, msg, prm)) {
                 NXBool is_color_term = is_color_terminal();
-                if (is_color_term) {
-                        switch(log_level) {
-                        case NX_LOG_INFO: start_color_output(NX_INFO_COLOR_CODE); break;
-                        case NX_LOG_NORMAL: start_color_output(NX_LOG_COLOR_CODE); break;
-                        case NX_LOG_WARNING: start_color_output(NX_WARNING_COLOR_CODE); break;
-                        case NX_LOG_ERROR: start_color_output(NX_ERROR_COLOR_CODE); break;
-                        }
-                }
-                const char *type_string;
-                switch(log_level) {
-                case NX_LOG_INFO: type_string = "I"; break;
-                case NX_LOG_NORMAL: type_string = "L"; break;
-                case NX_LOG_WARNING: type_string = "W"; break;
-                case NX_LOG_ERROR: type_string = "E"; break;
-                default:
-                        type_string = "?"; break;
-                }
-                fprintf(LOG_STREAM, LOG_HEADER_FORMAT, type_string, tag, function_name, line_no);
+                if (is_color_term)
+                        start_level_color_output(log_level);
+                fprintf(LOG_STREAM, LOG_HEADER_FORMAT, log_level_string(log_level), tag, function_name, line_no);
                 vfprintf(LOG_STREAM, msg, prm);
                 if (is_color_term)
                         stop_color_output();
@@ -132,6 +268,8 @@ void nx_log_formatted(enum NXLogLevel log_level, const char* function_name, int
 
 void nx_log_fatal(const char* function_name, int line_no, const char *tag, const char* msg, ...)
 {
+        nx_log_async_flush();
+
         va_list prm;
         va_start(prm, msg);
         g_fatal_func(function_name, line_no, tag, msg, prm);
@@ -151,3 +289,94 @@ void nx_log_fatal_func(NXLogFatalFuncP fatal_func)
                 g_fatal_func = default_fatal_func;
         }
 }
+
+void nx_log_stream(FILE *stream)
+{
+        nx_log_async_flush();
+        g_log_stream = stream;
+}
+
+void nx_log_async_start(int capacity)
+{
+        if (capacity <= 0)
+                capacity = NX_LOG_ASYNC_DEFAULT_CAPACITY;
+        size_t n = 1;
+        while (n < (size_t)capacity)
+                n *= 2;
+
+        struct NXLogRing *ring = NX_NEW(1, struct NXLogRing);
+        ring->records = NX_NEW(n, struct NXLogRecord);
+        ring->mask = n - 1;
+        for (size_t i = 0; i < n; ++i)
+                atomic_init(&ring->records[i].sequence, i);
+        atomic_init(&ring->enqueue_pos, 0);
+        atomic_init(&ring->dequeue_pos, 0);
+        atomic_init(&ring->stop, 0);
+
+        pthread_mutex_lock(&g_log_async_mutex);
+        if (atomic_load(&g_log_ring) != NULL
+            || pthread_create(&ring->writer, NULL, log_writer_main, ring) != 0) {
+                NXBool is_running = atomic_load(&g_log_ring) != NULL;
+                pthread_mutex_unlock(&g_log_async_mutex);
+                nx_free(ring->records);
+                nx_free(ring);
+                if (!is_running)
+                        NX_WARNING(NX_LOG_TAG, "Could not start log writer thread, logging stays synchronous");
+                return;
+        }
+
+        atomic_store(&g_log_n_dropped, 0);
+        atomic_store(&g_log_ring, ring);
+        pthread_mutex_unlock(&g_log_async_mutex);
+}
+
+void nx_log_async_stop()
+{
+        pthread_mutex_lock(&g_log_async_mutex);
+        struct NXLogRing *ring = atomic_exchange(&g_log_ring, NULL);
+        if (ring == NULL) {
+                pthread_mutex_unlock(&g_log_async_mutex);
+                return;
+        }
+
+        /* Producers that saw the ring finish their record before it goes. */
+        while (atomic_load(&g_log_n_producers) > 0)
+                sched_yield();
+
+        atomic_store(&ring->stop, 1);
+        pthread_join(ring->writer, NULL);
+        pthread_mutex_unlock(&g_log_async_mutex);
+        nx_free(ring->records);
+        nx_free(ring);
+
+        size_t n_dropped = atomic_load(&g_log_n_dropped);
+        if (n_dropped > 0)
+                NX_WARNING(NX_LOG_TAG, "%zd log records were dropped because the log ring was full", n_dropped);
+}
+
+void nx_log_async_flush()
+{
+        const struct timespec wait = { 0, NX_LOG_ASYNC_IDLE_SLEEP_NS / 4 };
+
+        /* Counts as a producer so that the ring outlives the wait. */
+        atomic_fetch_add(&g_log_n_producers, 1);
+        struct NXLogRing *ring = atomic_load(&g_log_ring);
+        if (ring != NULL) {
+                size_t target = atomic_load(&ring->enqueue_pos);
+                while (atomic_load(&ring->dequeue_pos) < target)
+                        nanosleep(&wait, NULL);
+        }
+        atomic_fetch_sub(&g_log_n_producers, 1);
+
+        fflush(LOG_STREAM);
+}
+
+int nx_log_async_is_running()
+{
+        return atomic_load(&g_log_ring) != NULL;
+}
+
+size_t nx_log_async_n_dropped()
+{
+        return atomic_load(&g_log_n_dropped);
+}
@@ -38,6 +38,18 @@ struct NXMemBlock *nx_mem_block_alloc()
         mem->size = 0;
         mem->capacity = 0;
         mem->own_memory = NX_FALSE;
+        mem->alignment = 0;
+
+        return mem;
+}
+
+struct NXMemBlock *nx_mem_block_alloc_aligned(size_t alignment)
+{
+        NX_ASSERT(alignment > 0);
+        NX_ASSERT((alignment & (alignment - 1)) == 0);
+
+        struct NXMemBlock *mem = nx_mem_block_alloc();
+        mem->alignment = alignment;
 
         return mem;
 }
@@ -65,7 +77,16 @@ void *nx_mem_block_reserve(struct NXMemBlock *mem, size_t new_capacity)
         NX_ASSERT_PTR(mem);
 
         if (new_capacity > mem->capacity) {
-                if (mem->own_memory) {
+                if (mem->alignment > 0) {
+                        new_capacity = nx_align_size(new_capacity, mem->alignment);
+                        void *new_ptr = nx_xaligned_alloc(mem->alignment, new_capacity);
+                        if (mem->size > 0)
+                                memcpy(new_ptr, mem->ptr, mem->size);
+                        if (mem->own_memory)
+                                nx_free(mem->ptr);
+                        mem->ptr = new_ptr;
+                        mem->own_memory = NX_TRUE;
+                } else if (mem->own_memory) {
                         mem->ptr = nx_xrealloc(mem->ptr, new_capacity);
                 } else {
                         void *new_ptr = nx_xmalloc(new_capacity);
@@ -133,12 +154,15 @@ void nx_mem_block_swap(struct NXMemBlock *mem0, struct NXMemBlock *mem1)
         t_sz = mem0->size; mem0->size = mem1->size; mem1->size = t_sz;
         t_sz = mem0->capacity; mem0->capacity = mem1->capacity; mem1->capacity = t_sz;
         t_om = mem0->own_memory; mem0->own_memory = mem1->own_memory; mem1->own_memory = t_om;
+        t_sz = mem0->alignment; mem0->alignment = mem1->alignment; mem1->alignment = t_sz;
 }
 
 struct NXMemBlock *nx_mem_block_copy0(struct NXMemBlock *mem)
 {
         NX_ASSERT_PTR(mem);
-        struct NXMemBlock *cpy = nx_mem_block_alloc();
+        struct NXMemBlock *cpy = mem->alignment > 0
+                ? nx_mem_block_alloc_aligned(mem->alignment)
+                : nx_mem_block_alloc();
 
         nx_mem_block_copy(cpy, mem);
         return cpy;
@@ -36,26 +36,40 @@
 
 #include <math.h>
 
+#if (NX_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
 #include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_alloc_stats.h"
+#include "virg/nexus/nx_arena.h"
 #include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_string.h"
-#include "virg/nexus/nx_filesystem.h"
 #include "virg/nexus/nx_image.h"
 #include "virg/nexus/nx_image_io.h"
 #include "virg/nexus/nx_io.h"
 #include "virg/nexus/nx_math.h"
+#include "virg/nexus/nx_vmath.h"
 #include "virg/nexus/nx_mat234.h"
 #include "virg/nexus/nx_vec234.h"
 #include "virg/nexus/nx_vec.h"
 #include "virg/nexus/nx_types.h"
-#include "virg/nexus/nx_hash_sha256.h"
+#include "virg/nexus/nx_cache.h"
+#include "virg/nexus/nx_thread_pool.h"
 
 #define NX_SIFT_N_ORI_BINS 36
+#define NX_SIFT_BAND_HEIGHT 32
+
+/* Input pixels around a region that are kept when the input is cropped to it,
+ * and the alignment of the crop origin, so that the sampling grids of the
+ * first octaves are those of the whole image */
+#define NX_SIFT_REGION_MARGIN 32
+#define NX_SIFT_REGION_ALIGNMENT 16
 
 void nx_sift_parameters_add_to_options(struct NXOptions *opt)
 {
         struct NXSIFTDetectorParams default_params = nx_sift_default_parameters();
-        nx_options_add(opt, "biddiddi",
+        nx_options_add(opt, "biddiddibii",
                        "--sift-double-image", "double input image size before computation", NX_FALSE,
                        "--sift-n-scales-per-octave", "number of intermediate scales within each octave", default_params.n_scales_per_octave,
                        "--sift-sigma0", "initial sigma for the input image", (double)default_params.sigma0,
@@ -63,7 +77,10 @@ void nx_sift_parameters_add_to_options(struct NXOptions *opt)
                        "--sift-border-distance", "distance to border within which to skip extraction", default_params.border_distance,
                        "--sift-peak-threshold", "DoG score threshold, decrease to get more keypoints", (double)default_params.peak_threshold,
                        "--sift-edge-threshold", "threshold for filtering edge like regions", (double)default_params.edge_threshold,
-                       "--sift-magnification-factor", "multipler to determine descriptor radius", default_params.magnification_factor);
+                       "--sift-magnification-factor", "multipler to determine descriptor radius", default_params.magnification_factor,
+                       "--sift-downsample-aa", "anti-alias before downsampling to the next octave", NX_FALSE,
+                       "--sift-key-budget", "maximum number of keypoints, 0 for no limit", default_params.key_budget,
+                       "--sift-budget-grid-size", "grid cells along each image side to spread the key budget over", default_params.budget_grid_size);
 }
 
 struct NXSIFTDetectorParams
@@ -78,38 +95,119 @@ nx_sift_parameters_from_options(struct NXOptions *opt)
         params.peak_threshold = nx_options_get_double(opt, "--sift-peak-threshold");
         params.edge_threshold = nx_options_get_double(opt, "--sift-edge-threshold");
         params.magnification_factor = nx_options_get_int(opt, "--sift-magnification-factor");
+        params.downsample_aa = nx_options_get_bool(opt, "--sift-downsample-aa");
+        params.key_budget = nx_options_get_int(opt, "--sift-key-budget");
+        params.budget_grid_size = nx_options_get_int(opt, "--sift-budget-grid-size");
 
         return params;
 }
 
+struct NXSIFTKeyStore {
+        int n;
+        int cap;
+        struct NXKeypoint *keys;
+        uchar *desc;
+};
+
+/* Refined DoG extremum, scale is the interpolated DoG index */
+struct NXSIFTPeak {
+        float x;
+        float y;
+        float scale;
+        float score;
+};
+
+/* Peaks and keys of a row band of a DoG scan */
+struct NXSIFTBand {
+        int n_peaks;
+        int peak_cap;
+        struct NXSIFTPeak *peaks;
+        struct NXSIFTKeyStore store;
+};
+
+/* Peak kept for the key budget, group is the scan that found it */
+struct NXSIFTCandidate {
+        struct NXSIFTPeak peak;
+        int group;
+        int cell;
+        int rank;
+        int id;
+};
+
+/* DoG scan with peaks in budget mode and the level for their gradients */
+struct NXSIFTPeakGroup {
+        int octave;
+        float sigma_c;
+        struct NXImage *level;
+};
+
+/* Number of levels and DoGs kept while building the scale space of an
+ * octave. Scanning DoG i needs DoGs i-1 to i+1 and the gradients of level
+ * i-1, the level above is kept for the next blur. */
+#define NX_SIFT_N_LEVEL_SLOTS 4
+#define NX_SIFT_N_DOG_SLOTS 3
+
 struct NXSIFTDetector
 {
         struct NXSIFTDetectorParams param;
 
-        struct NXImage *gx;
-        struct NXImage *gy;
-
-        struct NXImage **levels;
-        struct NXImage **dogs;
+        /* gradients of the level below the scanned DoG, only computed when
+         * the scan finds peaks */
+        struct NXImage *gmag;
+        struct NXImage *gori;
+
+        /* level k of the octave is in levels[k % NX_SIFT_N_LEVEL_SLOTS], DoG k
+         * in dogs[k % NX_SIFT_N_DOG_SLOTS] */
+        struct NXImage *levels[NX_SIFT_N_LEVEL_SLOTS];
+        struct NXImage *dogs[NX_SIFT_N_DOG_SLOTS];
+
+        int n_bands;
+        struct NXSIFTBand *bands;
+
+        /* with a key budget, the peaks of all scans and the levels of the
+         * scans that found any are kept until the selection */
+        int n_cands;
+        int cand_cap;
+        struct NXSIFTCandidate *cands;
+        int n_groups;
+        int group_cap;
+        struct NXSIFTPeakGroup *groups;
+
+        /* region of the current computation, NULL for the whole image, the
+         * input is cropped at (crop_x, crop_y) and scan_region is the
+         * rectangle of the region relative to the crop */
+        const struct NXImageRegion *region;
+        int crop_x;
+        int crop_y;
+        struct NXImageRegion scan_region;
 };
 
 struct NXSIFTDetector *nx_sift_detector_new(struct NXSIFTDetectorParams sift_param)
 {
-        const int n_scales = sift_param.n_scales_per_octave;
-
         struct NXSIFTDetector *det = NX_NEW(1, struct NXSIFTDetector);
         det->param = sift_param;
 
-        det->gx = nx_image_alloc();
-        det->gy = nx_image_alloc();
+        det->gmag = nx_image_alloc();
+        det->gori = nx_image_alloc();
 
-        det->levels = NX_NEW(n_scales + 3, struct NXImage *);
-        det->dogs   = NX_NEW(n_scales + 2, struct NXImage *);
-        for (int i = 0; i < n_scales + 2; ++i) {
+        for (int i = 0; i < NX_SIFT_N_LEVEL_SLOTS; ++i)
                 det->levels[i] = nx_image_alloc();
+        for (int i = 0; i < NX_SIFT_N_DOG_SLOTS; ++i)
                 det->dogs[i] = nx_image_alloc();
-        }
-        det->levels[n_scales + 2] = nx_image_alloc();
+
+        det->n_bands = 0;
+        det->bands = NULL;
+
+        det->n_cands = 0;
+        det->cand_cap = 0;
+        det->cands = NULL;
+        det->n_groups = 0;
+        det->group_cap = 0;
+        det->groups = NULL;
+
+        det->region = NULL;
+        det->crop_x = 0;
+        det->crop_y = 0;
 
         return det;
 }
@@ -117,23 +215,40 @@ struct NXSIFTDetector *nx_sift_detector_new(struct NXSIFTDetectorParams sift_par
 void nx_sift_detector_free(struct NXSIFTDetector *det)
 {
         if (det) {
-                const int n_scales = det->param.n_scales_per_octave;
-                for (int i = 0; i < n_scales + 2; ++i) {
+                for (int i = 0; i < NX_SIFT_N_LEVEL_SLOTS; ++i)
                         nx_image_free(det->levels[i]);
+                for (int i = 0; i < NX_SIFT_N_DOG_SLOTS; ++i)
                         nx_image_free(det->dogs[i]);
-                }
-                nx_image_free(det->levels[n_scales + 2]);
 
-                nx_free(det->levels);
-                nx_free(det->dogs);
+                nx_image_free(det->gmag);
+                nx_image_free(det->gori);
 
-                nx_image_free(det->gx);
-                nx_image_free(det->gy);
+                for (int i = 0; i < det->n_bands; ++i) {
+                        nx_free(det->bands[i].peaks);
+                        nx_free(det->bands[i].store.keys);
+                        nx_free(det->bands[i].store.desc);
+                }
+                nx_free(det->bands);
+
+                nx_free(det->cands);
+                for (int i = 0; i < det->group_cap; ++i)
+                        nx_image_free(det->groups[i].level);
+                nx_free(det->groups);
 
                 nx_free(det);
         }
 }
 
+static inline struct NXImage *nx_sift_level(struct NXSIFTDetector *det, int i)
+{
+        return det->levels[i % NX_SIFT_N_LEVEL_SLOTS];
+}
+
+static inline struct NXImage *nx_sift_dog(struct NXSIFTDetector *det, int i)
+{
+        return det->dogs[i % NX_SIFT_N_DOG_SLOTS];
+}
+
 static inline float kernel_sigma(float sigma_current, float sigma_desired)
 {
         float sigma_g = sqrt(sigma_desired*sigma_desired
@@ -141,23 +256,39 @@ static inline float kernel_sigma(float sigma_current, float sigma_desired)
         return sigma_g;
 }
 
-struct NXSIFTKeyStore {
-        int n;
-        int cap;
-        struct NXKeypoint *keys;
-        uchar *desc;
-};
-
-int nx_sift_key_store_append(struct NXSIFTKeyStore *store)
+void nx_sift_key_store_reserve(struct NXSIFTKeyStore *store, int n)
 {
-        if (store->n >= store->cap) {
-                int new_cap = (int)(store->cap * 1.6f);
+        if (n > store->cap) {
+                int new_cap = nx_max_i(n, nx_max_i(16, (int)(store->cap * 1.6f)));
+                NX_ALLOC_TAG_PUSH("sift.keys");
                 store->keys = (struct NXKeypoint *)nx_xrealloc(store->keys,
                                                                new_cap*sizeof(struct NXKeypoint));
                 store->desc = (uchar *)nx_xrealloc(store->desc,
                                                    new_cap*NX_SIFT_DESC_DIM*sizeof(uchar));
+                NX_ALLOC_TAG_POP();
                 store->cap = new_cap;
         }
+}
+
+void nx_sift_band_add_peak(struct NXSIFTBand *band, float x, float y,
+                           float scale, float score)
+{
+        if (band->n_peaks >= band->peak_cap) {
+                band->peak_cap = nx_max_i(16, (int)(band->peak_cap * 1.6f));
+                band->peaks = (struct NXSIFTPeak *)nx_xrealloc(band->peaks,
+                                                               band->peak_cap * sizeof(struct NXSIFTPeak));
+        }
+
+        struct NXSIFTPeak *peak = band->peaks + band->n_peaks++;
+        peak->x = x;
+        peak->y = y;
+        peak->scale = scale;
+        peak->score = score;
+}
+
+int nx_sift_key_store_append(struct NXSIFTKeyStore *store)
+{
+        nx_sift_key_store_reserve(store, store->n + 1);
 
         NX_ASSERT(store->n < store->cap);
         int id = store->n;
@@ -165,7 +296,26 @@ int nx_sift_key_store_append(struct NXSIFTKeyStore *store)
         return id;
 }
 
+/* Appends the keys of src to store and renumbers their ids */
+void nx_sift_key_store_merge(struct NXSIFTKeyStore *store,
+                             const struct NXSIFTKeyStore *src)
+{
+        if (src->n == 0)
+                return;
+
+        nx_sift_key_store_reserve(store, store->n + src->n);
+        memcpy(store->keys + store->n, src->keys,
+               src->n * sizeof(struct NXKeypoint));
+        memcpy(store->desc + store->n * NX_SIFT_DESC_DIM, src->desc,
+               src->n * NX_SIFT_DESC_DIM * sizeof(uchar));
+        for (int i = 0; i < src->n; ++i)
+                store->keys[store->n + i].id = store->n + i;
+        store->n += src->n;
+}
+
 void nx_sift_compute_fdescriptor(struct NXSIFTDetector *det,
+                                 const struct NXImage *gmag,
+                                 const struct NXImage *gori,
                                  struct NXKeypoint *key,
                                  float *desc)
 {
@@ -184,38 +334,51 @@ void nx_sift_compute_fdescriptor(struct NXSIFTDetector *det,
         float rx_offset = key->xs - key->x;
         float ry_offset = key->ys - key->y;
 
+        const float patch_sigma = 0.5f * N_PATCH_XY;
+        const int n_row = 2 * sample_radius + 1;
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *row_px = NX_ARENA_NEW_S(arena, n_row);
+        float *row_py = NX_ARENA_NEW_S(arena, n_row);
+        float *row_weight = NX_ARENA_NEW_S(arena, n_row);
+
         for (int dy = -sample_radius; dy <= +sample_radius; ++dy) {
                 int sample_y = dy + key->y;
                 // skip if sample is out of the image
-                if (sample_y < 0 || sample_y >= det->gx->height)
+                if (sample_y < 0 || sample_y >= gmag->height)
                         continue;
-                const float *gx_row = det->gx->data.f32 + sample_y * det->gx->row_stride;
-                const float *gy_row = det->gy->data.f32 + sample_y * det->gy->row_stride;
-                for (int dx = -sample_radius; dx <= +sample_radius; ++dx) {
-                        int sample_x = dx + key->x;
-                        // skip if sample is out of the image
-                        if (sample_x < 0 || sample_x >= det->gx->width)
-                                continue;
+                const float *gmag_row = gmag->data.f32 + sample_y * gmag->row_stride;
+                const float *gori_row = gori->data.f32 + sample_y * gori->row_stride;
 
-                        // calculate sample's patch coordinates
+                // calculate patch coordinates and Gaussian weights of the row
+                for (int k = 0; k < n_row; ++k) {
+                        int dx = k - sample_radius;
                         float ry =  cori * dy + sori * dx;
                         float rx = -sori * dy + cori * dx;
-                        float patch_x = (rx - rx_offset) / patch_size;
-                        float patch_y = (ry - ry_offset) / patch_size;
+                        row_px[k] = (rx - rx_offset) / patch_size;
+                        row_py[k] = (ry - ry_offset) / patch_size;
+                        row_weight[k] = -0.5f * (row_px[k]*row_px[k] + row_py[k]*row_py[k])
+                                / (patch_sigma * patch_sigma);
+                }
+                nx_vmath_exp(n_row, row_weight, row_weight);
+
+                for (int k = 0; k < n_row; ++k) {
+                        int sample_x = k - sample_radius + key->x;
+                        // skip if sample is out of the image
+                        if (sample_x < 0 || sample_x >= gmag->width)
+                                continue;
 
+                        float patch_x = row_px[k];
+                        float patch_y = row_py[k];
                         if (patch_x > -radius_in_patches
                             && patch_x < radius_in_patches
                             && patch_y > -radius_in_patches
                             && patch_y < radius_in_patches) {
-                                float gx = gx_row[sample_x];
-                                float gy = -gy_row[sample_x];
-                                float gmag = sqrtf(gx*gx + gy*gy);
-                                float gori = atan2f(gy, gx);
-                                float patch_sigma = 0.5f * N_PATCH_XY;
-                                float gweight = expf(-0.5f * (patch_x*patch_x + patch_y*patch_y)
-                                                     / (patch_sigma * patch_sigma));
+                                // orientations are flipped to have y point up
+                                float gmag = gmag_row[sample_x];
+                                float gori = -gori_row[sample_x];
                                 // Calculate sample values
-                                float sample_weight = gweight * gmag;
+                                float sample_weight = row_weight[k] * gmag;
                                 float sample_ori = gori - key->ori;
                                 while (sample_ori > 2*NX_PI)
                                         sample_ori -= 2*NX_PI;
@@ -273,14 +436,18 @@ void nx_sift_compute_fdescriptor(struct NXSIFTDetector *det,
                         }
                 }
         }
+
+        nx_arena_rewind(arena, mark);
 }
 
 void nx_sift_compute_descriptor(struct NXSIFTDetector *det,
+                                const struct NXImage *gmag,
+                                const struct NXImage *gori,
                                 struct NXKeypoint *key,
                                 uchar *desc)
 {
         float fdesc[NX_SIFT_DESC_DIM];
-        nx_sift_compute_fdescriptor(det, key, &fdesc[0]);
+        nx_sift_compute_fdescriptor(det, gmag, gori, key, &fdesc[0]);
         nx_svec_to_unit(NX_SIFT_DESC_DIM, &fdesc[0]);
 
         for (int i = 0; i < NX_SIFT_DESC_DIM; ++i)
@@ -292,8 +459,8 @@ void nx_sift_compute_descriptor(struct NXSIFTDetector *det,
                 desc[i] = nx_min_i(255, (int)(512.0f * fdesc[i]));
 }
 
-float nx_sift_compute_ori_hist(float *hist, const struct NXImage *gx,
-                               const struct NXImage *gy, float x, float y,
+float nx_sift_compute_ori_hist(float *hist, const struct NXImage *gmag,
+                               const struct NXImage *gori, float x, float y,
                                float sigma)
 {
         nx_svec_set_zero(NX_SIFT_N_ORI_BINS, &hist[1]);
@@ -303,37 +470,49 @@ float nx_sift_compute_ori_hist(float *hist, const struct NXImage *gx,
         const float dist_factor = -0.5 / sigma_sq;
 
         int r = (int)(sigma * 3.0f);
-        int w = gx->width;
-        int h = gx->height;
+        int w = gmag->width;
+        int h = gmag->height;
         int xi = (int)(x + 0.5f);
         int yi = (int)(y + 0.5f);
-        for (int v = yi - r; v <= yi + r; ++v) {
+        // samples on the image border are skipped
+        int u0 = nx_max_i(xi - r, 1);
+        int u1 = nx_min_i(xi + r, w - 3);
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *row_dr_sq = NX_ARENA_NEW_S(arena, 2 * r + 1);
+        float *row_weight = NX_ARENA_NEW_S(arena, 2 * r + 1);
+
+        for (int v = yi - r; v <= yi + r && u0 <= u1; ++v) {
                 if (v <= 0 || v >= h - 2)
                         continue;
-                const float *rx = gx->data.f32 + v * gx->row_stride;
-                const float *ry = gy->data.f32 + v * gy->row_stride;
-                for (int u = xi - r; u <= xi + r; ++u) {
-                        // skip if outside image border
-                        if (u <= 0 || u >= w - 2)
-                                continue;
+                const float *rmag = gmag->data.f32 + v * gmag->row_stride;
+                const float *rori = gori->data.f32 + v * gori->row_stride;
 
+                for (int u = u0; u <= u1; ++u) {
                         float dr_sq = (u - x) * (u - x) + (v - y) * (v - y);
+                        row_dr_sq[u - u0] = dr_sq;
+                        row_weight[u - u0] = dist_factor * dr_sq;
+                }
+                nx_vmath_exp(u1 - u0 + 1, row_weight, row_weight);
+
+                for (int u = u0; u <= u1; ++u) {
                         // skip if too far from the center
-                        if (dr_sq > (r * r + 0.5))
+                        if (row_dr_sq[u - u0] > (r * r + 0.5))
                                 continue;
 
-                        float gx_val = rx[u];
-                        float gy_val = -ry[u];
-                        float gmag = sqrtf(gx_val*gx_val + gy_val*gy_val);
-                        float gori = atan2f(gy_val, gx_val);
-                        int bin = (int)(NX_SIFT_N_ORI_BINS * (gori + NX_PI + 0.00001f)
+                        float mag = rmag[u];
+                        float ori = -rori[u];
+                        int bin = (int)(NX_SIFT_N_ORI_BINS * (ori + NX_PI + 0.00001f)
                                         / (2.0 * NX_PI));
                         if (bin >= NX_SIFT_N_ORI_BINS)
                                 bin = NX_SIFT_N_ORI_BINS - 1;
-                        hist[bin+1] += expf(dist_factor * dr_sq) * gmag;
+                        hist[bin+1] += row_weight[u - u0] * mag;
                 }
         }
 
+        nx_arena_rewind(arena, mark);
+
         // Smooth buffer by averaging multiple times using an auxilary buffer to
         // handle boundaries
         float hist_buffer[NX_SIFT_N_ORI_BINS+2];
@@ -361,6 +540,8 @@ float nx_sift_compute_ori_hist(float *hist, const struct NXImage *gx,
 
 void nx_sift_compute_keys(struct NXSIFTDetector *det,
                           struct NXSIFTKeyStore *store,
+                          const struct NXImage *gmag,
+                          const struct NXImage *gori,
                           int octave, float sigma_c, float dog_val,
                           float i, float x, float y)
 {
@@ -371,8 +552,7 @@ void nx_sift_compute_keys(struct NXSIFTDetector *det,
         // fashion
         float hist[NX_SIFT_N_ORI_BINS+2];
         float sigma = sigma_c * pow(2.0, i / n_scales);
-        float hist_peak = nx_sift_compute_ori_hist(&hist[0],
-                                                   det->gx, det->gy,
+        float hist_peak = nx_sift_compute_ori_hist(&hist[0], gmag, gori,
                                                    x, y, sigma);
 
         for (int b = 1; b <= NX_SIFT_N_ORI_BINS; ++b) {
@@ -401,7 +581,7 @@ void nx_sift_compute_keys(struct NXSIFTDetector *det,
                         key->id = key_id;
 
                         uchar *desc = store->desc + key_id * NX_SIFT_DESC_DIM;
-                        nx_sift_compute_descriptor(det, key, desc);
+                        nx_sift_compute_descriptor(det, gmag, gori, key, desc);
 
                         /* NX_LOG(NX_LOG_TAG, "Key (%6.3f, %6.3f), sigma = %6.3f, ori = %6.3f", */
                                /* key->xs, key->ys, key->sigma, key->ori); */
@@ -410,8 +590,7 @@ void nx_sift_compute_keys(struct NXSIFTDetector *det,
 }
 
 void nx_sift_interp_peak_location(struct NXSIFTDetector *det,
-                                  struct NXSIFTKeyStore *store,
-                                  int octave, float sigma_c,
+                                  struct NXSIFTBand *band,
                                   int i, int x, int y)
 {
         float dval;
@@ -420,9 +599,9 @@ void nx_sift_interp_peak_location(struct NXSIFTDetector *det,
         const int n_scales = det->param.n_scales_per_octave;
         const float peak_thr = det->param.peak_threshold / n_scales;
 
-        const struct NXImage *dog = det->dogs[i];
-        const struct NXImage *dogm = det->dogs[i-1];
-        const struct NXImage *dogp = det->dogs[i+1];
+        const struct NXImage *dog = nx_sift_dog(det, i);
+        const struct NXImage *dogm = nx_sift_dog(det, i-1);
+        const struct NXImage *dogp = nx_sift_dog(det, i+1);
 
         int n_tries = 5;
         while (n_tries-- > 0) {
@@ -483,8 +662,7 @@ void nx_sift_interp_peak_location(struct NXSIFTDetector *det,
             || fabs(dval) < peak_thr)
                 return;
 
-        nx_sift_compute_keys(det, store, octave, sigma_c, dval,
-                             i + b[2], x + b[0], y + b[1]);
+        nx_sift_band_add_peak(band, x + b[0], y + b[1], i + b[2], dval);
 }
 
 static inline NXBool nx_sift_check_edge_threshold(const float *dog_rowm,
@@ -504,106 +682,516 @@ static inline NXBool nx_sift_check_edge_threshold(const float *dog_rowm,
         return det * edge_thr_p1 * edge_thr_p1 > edge_thr * tr * tr;
 }
 
+/* rows holds the three rows around y of DoGs i-1, i and i+1, rows[4] is the
+ * row of the candidate. Tests if dval at x is above abs_thr in magnitude and a
+ * strict maximum or minimum of its 26 neighbours. */
+static inline NXBool nx_sift_is_extremum(const float *const *rows, int x,
+                                         float abs_thr)
+{
+        float dval = rows[4][x];
+        if (!(fabsf(dval) > abs_thr))
+                return NX_FALSE;
+
+        NXBool is_max = dval > 0.0f;
+        NXBool is_min = dval < 0.0f;
+        for (int r = 0; r < 9; ++r) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                        if (r == 4 && dx == 0)
+                                continue;
+                        float v = rows[r][x + dx];
+                        is_max = is_max && dval > v;
+                        is_min = is_min && dval < v;
+                }
+        }
+
+        return is_max || is_min;
+}
+
+#if (NX_SIMD_AVX2)
+/* Updates the maxima and minima with row[x-1..x+8] in three 8 wide windows */
+static inline void nx_sift_row_max_min_ps(const float *row, int x,
+                                          __m256 *nmax, __m256 *nmin)
+{
+        __m256 v0 = _mm256_loadu_ps(row + x - 1);
+        __m256 v1 = _mm256_loadu_ps(row + x);
+        __m256 v2 = _mm256_loadu_ps(row + x + 1);
+        *nmax = _mm256_max_ps(*nmax, _mm256_max_ps(v0, _mm256_max_ps(v1, v2)));
+        *nmin = _mm256_min_ps(*nmin, _mm256_min_ps(v0, _mm256_min_ps(v1, v2)));
+}
+
+/* Vector version of nx_sift_is_extremum() for x..x+7, returns a bit mask of
+ * the extrema. Pixels are rejected on the threshold and on their own DoG
+ * before the neighbouring scales are loaded. */
+static inline int nx_sift_extrema_mask_ps(const float *const *rows, int x,
+                                          __m256 abs_thr)
+{
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 dval = _mm256_loadu_ps(rows[4] + x);
+        __m256 abs_dval = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), dval);
+        __m256 strong = _mm256_cmp_ps(abs_dval, abs_thr, _CMP_GT_OQ);
+        if (_mm256_movemask_ps(strong) == 0)
+                return 0;
+
+        __m256 vl = _mm256_loadu_ps(rows[4] + x - 1);
+        __m256 vr = _mm256_loadu_ps(rows[4] + x + 1);
+        __m256 nmax = _mm256_max_ps(vl, vr);
+        __m256 nmin = _mm256_min_ps(vl, vr);
+        nx_sift_row_max_min_ps(rows[3], x, &nmax, &nmin);
+        nx_sift_row_max_min_ps(rows[5], x, &nmax, &nmin);
+
+        __m256 is_max = _mm256_and_ps(_mm256_cmp_ps(dval, zero, _CMP_GT_OQ),
+                                      _mm256_cmp_ps(dval, nmax, _CMP_GT_OQ));
+        __m256 is_min = _mm256_and_ps(_mm256_cmp_ps(dval, zero, _CMP_LT_OQ),
+                                      _mm256_cmp_ps(dval, nmin, _CMP_LT_OQ));
+        __m256 candidates = _mm256_and_ps(strong, _mm256_or_ps(is_max, is_min));
+        if (_mm256_movemask_ps(candidates) == 0)
+                return 0;
+
+        for (int r = 0; r < 3; ++r) {
+                nx_sift_row_max_min_ps(rows[r], x, &nmax, &nmin);
+                nx_sift_row_max_min_ps(rows[r + 6], x, &nmax, &nmin);
+        }
+        is_max = _mm256_cmp_ps(dval, nmax, _CMP_GT_OQ);
+        is_min = _mm256_cmp_ps(dval, nmin, _CMP_LT_OQ);
+        candidates = _mm256_and_ps(candidates, _mm256_or_ps(is_max, is_min));
+
+        return _mm256_movemask_ps(candidates);
+}
+#endif
+
+/* Scans [x0, x1) x [y0, y1) of DoG i for extrema */
 void nx_sift_process_dog(struct NXSIFTDetector *det,
-                         struct NXSIFTKeyStore *store,
-                         int octave, float sigma_c, int i)
+                         struct NXSIFTBand *band,
+                         int i, int x0, int y0, int x1, int y1)
 {
         const int n_scales = det->param.n_scales_per_octave;
         const float peak_thr = det->param.peak_threshold / n_scales;
         const float edge_thr = det->param.edge_threshold;
 
-        const struct NXImage *dog = det->dogs[i];
-        const struct NXImage *dogm = det->dogs[i-1];
-        const struct NXImage *dogp = det->dogs[i+1];
-
-        const int B = det->param.border_distance;
-        for (int y = B; y < dog->height - B; ++y) {
-                const float *dogm_rowm  = dogm->data.f32 + (y-1) * dogm->row_stride;
-                const float *dogm_row   = dogm_rowm + dogm->row_stride;
-                const float *dogm_rowp  = dogm_row  + dogm->row_stride;
-                const float *dog_rowm   = dog->data.f32 + (y-1) * dog->row_stride;
-                const float *dog_row    = dog_rowm + dog->row_stride;
-                const float *dog_rowp   = dog_row  + dog->row_stride;
-                const float *dogp_rowm  = dogp->data.f32 + (y-1) * dogp->row_stride;
-                const float *dogp_row   = dogp_rowm + dogp->row_stride;
-                const float *dogp_rowp  = dogp_row  + dogp->row_stride;
-                for (int x = B; x < dog->width + B; ++x) {
-                        float dval = dog_row[x];
-                        if (fabs(dval) > 0.8 * peak_thr
-                            && ((dval > 0 && dval > dog_row[x-1]   && dval > dog_row[x+1]
-                                 && dval > dog_rowm[x-1]  && dval > dog_rowm[x]  && dval > dog_rowm[x+1]
-                                 && dval > dog_rowp[x-1]  && dval > dog_rowp[x]  && dval > dog_rowp[x+1]
-                                 && dval > dogm_row[x-1]  && dval > dogm_row[x]  && dval > dogm_row[x+1]
-                                 && dval > dogm_rowm[x-1] && dval > dogm_rowm[x] && dval > dogm_rowm[x+1]
-                                 && dval > dogm_rowp[x-1] && dval > dogm_rowp[x] && dval > dogm_rowp[x+1]
-                                 && dval > dogp_row[x-1]  && dval > dogp_row[x]  && dval > dogp_row[x+1]
-                                 && dval > dogp_rowm[x-1] && dval > dogp_rowm[x] && dval > dogp_rowm[x+1]
-                                 && dval > dogp_rowp[x-1] && dval > dogp_rowp[x] && dval > dogp_rowp[x+1])
-                                || (dval < 0 && dval < dog_row[x-1] && dval < dog_row[x+1]
-                                    && dval < dog_rowm[x-1] && dval < dog_rowm[x] && dval < dog_rowm[x+1]
-                                    && dval < dog_rowp[x-1] && dval < dog_rowp[x] && dval < dog_rowp[x+1]
-                                    && dval < dogm_row[x-1] && dval < dogm_row[x] && dval < dogm_row[x+1]
-                                    && dval < dogm_rowm[x-1] && dval < dogm_rowm[x] && dval < dogm_rowm[x+1]
-                                    && dval < dogm_rowp[x-1] && dval < dogm_rowp[x] && dval < dogm_rowp[x+1]
-                                    && dval < dogp_row[x-1] && dval < dogp_row[x] && dval < dogp_row[x+1]
-                                    && dval < dogp_rowm[x-1] && dval < dogp_rowm[x] && dval < dogp_rowm[x+1]
-                                    && dval < dogp_rowp[x-1] && dval < dogp_rowp[x] && dval < dogp_rowp[x+1]))
-                            && nx_sift_check_edge_threshold(dog_rowm, dog_row,
-                                                            dog_rowp, x, edge_thr)) {
-                                nx_sift_interp_peak_location(det, store,
-                                                             octave, sigma_c,
+        // largest float not above the threshold, so that the float compare
+        // gives the result of comparing to the threshold in double
+        const double abs_thr_d = 0.8 * peak_thr;
+        float abs_thr = (float)abs_thr_d;
+        if (abs_thr > abs_thr_d)
+                abs_thr = nextafterf(abs_thr, 0.0f);
+
+        const struct NXImage *dog = nx_sift_dog(det, i);
+        const struct NXImage *dogm = nx_sift_dog(det, i-1);
+        const struct NXImage *dogp = nx_sift_dog(det, i+1);
+
+#if (NX_SIMD_AVX2)
+        const __m256 abs_thr_ps = _mm256_set1_ps(abs_thr);
+#endif
+        for (int y = y0; y < y1; ++y) {
+                const float *dogm_row = dogm->data.f32 + y * dogm->row_stride;
+                const float *dog_row  = dog->data.f32  + y * dog->row_stride;
+                const float *dogp_row = dogp->data.f32 + y * dogp->row_stride;
+                const float *const rows[9] = {
+                        dogm_row - dogm->row_stride, dogm_row, dogm_row + dogm->row_stride,
+                        dog_row  - dog->row_stride,  dog_row,  dog_row  + dog->row_stride,
+                        dogp_row - dogp->row_stride, dogp_row, dogp_row + dogp->row_stride };
+
+                int x = x0;
+#if (NX_SIMD_AVX2)
+                for (; x + 8 <= x1; x += 8) {
+                        int mask = nx_sift_extrema_mask_ps(rows, x, abs_thr_ps);
+                        while (mask) {
+                                int xk = x + __builtin_ctz(mask);
+                                mask &= mask - 1;
+                                if (nx_sift_check_edge_threshold(rows[3], rows[4],
+                                                                 rows[5], xk, edge_thr))
+                                        nx_sift_interp_peak_location(det, band,
+                                                                     i, xk, y);
+                        }
+                }
+#endif
+                for (; x < x1; ++x) {
+                        if (nx_sift_is_extremum(rows, x, abs_thr)
+                            && nx_sift_check_edge_threshold(rows[3], rows[4],
+                                                            rows[5], x, edge_thr)) {
+                                nx_sift_interp_peak_location(det, band,
                                                              i, x, y);
                         }
                 }
         }
 }
 
-void nx_sift_detector_process_octave(struct NXSIFTDetector *det,
-                                     struct NXSIFTKeyStore *store,
-                                     int octave,
-                                     float sigma_c)
+/* Scan of DoG i, [x0, x1) x [y0, y1) are the scanned pixels */
+struct NXSIFTScanJob
 {
-        const int n_scales = det->param.n_scales_per_octave;
-        for (int i = 1; i < n_scales + 1; ++i) {
-                nx_image_deriv_x(det->gx, det->levels[i-1]);
-                nx_image_deriv_y(det->gy, det->levels[i-1]);
-                nx_sift_process_dog(det, store, octave, sigma_c, i);
+        struct NXSIFTDetector *det;
+        int octave;
+        float sigma_c;
+        int i;
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+};
+
+/* Drops the peaks of the band that are not in the region of the detector */
+static void nx_sift_band_keep_region_peaks(const struct NXSIFTDetector *det,
+                                           struct NXSIFTBand *band, int octave)
+{
+        const float scale = pow(2.0, octave);
+        int n_kept = 0;
+        for (int p = 0; p < band->n_peaks; ++p) {
+                const struct NXSIFTPeak *peak = band->peaks + p;
+                if (nx_image_region_contains(det->region,
+                                             det->crop_x + peak->x * scale,
+                                             det->crop_y + peak->y * scale))
+                        band->peaks[n_kept++] = *peak;
+        }
+        band->n_peaks = n_kept;
+}
+
+static void nx_sift_scan_bands(void *arg, int begin, int end)
+{
+        const struct NXSIFTScanJob *job = (const struct NXSIFTScanJob *)arg;
+        struct NXSIFTDetector *det = job->det;
+        for (int k = begin; k < end; ++k) {
+                int y0 = job->y0 + k * NX_SIFT_BAND_HEIGHT;
+                int y1 = nx_min_i(y0 + NX_SIFT_BAND_HEIGHT, job->y1);
+                struct NXSIFTBand *band = det->bands + k;
+                band->n_peaks = 0;
+                nx_sift_process_dog(det, band, job->i, job->x0, y0, job->x1, y1);
+                if (det->region != NULL)
+                        nx_sift_band_keep_region_peaks(det, band, job->octave);
+        }
+}
+
+static void nx_sift_describe_bands(void *arg, int begin, int end)
+{
+        const struct NXSIFTScanJob *job = (const struct NXSIFTScanJob *)arg;
+        struct NXSIFTDetector *det = job->det;
+        for (int k = begin; k < end; ++k) {
+                struct NXSIFTBand *band = det->bands + k;
+                band->store.n = 0;
+                for (int p = 0; p < band->n_peaks; ++p) {
+                        const struct NXSIFTPeak *peak = band->peaks + p;
+                        nx_sift_compute_keys(det, &band->store, det->gmag, det->gori,
+                                             job->octave, job->sigma_c, peak->score,
+                                             peak->scale, peak->x, peak->y);
+                }
+        }
+}
+
+static void nx_sift_detector_reserve_bands(struct NXSIFTDetector *det, int n_bands)
+{
+        if (n_bands > det->n_bands) {
+                det->bands = (struct NXSIFTBand *)nx_xrealloc(det->bands,
+                                                              n_bands * sizeof(struct NXSIFTBand));
+                for (int k = det->n_bands; k < n_bands; ++k) {
+                        struct NXSIFTBand *band = det->bands + k;
+                        band->n_peaks = 0;
+                        band->peak_cap = 0;
+                        band->peaks = NULL;
+                        band->store.n = 0;
+                        band->store.cap = 0;
+                        band->store.keys = NULL;
+                        band->store.desc = NULL;
+                }
+                det->n_bands = n_bands;
+        }
+}
+
+/* Moves the peaks of the bands of DoG i to the candidates and keeps level i-1
+ * for their gradients. Its slot is written next by level i+3, so the level is
+ * swapped with the image of the group instead of being copied. */
+static void nx_sift_detector_keep_peaks(struct NXSIFTDetector *det,
+                                        int octave, float sigma_c,
+                                        int i, int n_bands)
+{
+        if (det->n_groups >= det->group_cap) {
+                int new_cap = nx_max_i(8, 2 * det->group_cap);
+                det->groups = (struct NXSIFTPeakGroup *)nx_xrealloc(det->groups,
+                                                                    new_cap * sizeof(struct NXSIFTPeakGroup));
+                for (int g = det->group_cap; g < new_cap; ++g)
+                        det->groups[g].level = nx_image_alloc();
+                det->group_cap = new_cap;
+        }
+
+        int group_id = det->n_groups++;
+        struct NXSIFTPeakGroup *group = det->groups + group_id;
+        group->octave = octave;
+        group->sigma_c = sigma_c;
+
+        int slot = (i-1) % NX_SIFT_N_LEVEL_SLOTS;
+        struct NXImage *level = det->levels[slot];
+        det->levels[slot] = group->level;
+        group->level = level;
+
+        for (int k = 0; k < n_bands; ++k) {
+                const struct NXSIFTBand *band = det->bands + k;
+                for (int p = 0; p < band->n_peaks; ++p) {
+                        if (det->n_cands >= det->cand_cap) {
+                                det->cand_cap = nx_max_i(256, (int)(det->cand_cap * 1.6f));
+                                det->cands = (struct NXSIFTCandidate *)nx_xrealloc(det->cands,
+                                                                                   det->cand_cap * sizeof(struct NXSIFTCandidate));
+                        }
+                        struct NXSIFTCandidate *cand = det->cands + det->n_cands;
+                        cand->peak = band->peaks[p];
+                        cand->group = group_id;
+                        cand->id = det->n_cands;
+                        det->n_cands++;
+                }
+        }
+}
+
+/* Scans DoG i in row bands on the shared thread pool. Peaks are collected per
+ * band first, the gradients of level i-1 are only computed if there are any,
+ * then keys are computed per band into the band stores. The stores are merged
+ * in row order, so the keys come out in the same order for any number of
+ * workers. */
+void nx_sift_detector_scan_dog(struct NXSIFTDetector *det,
+                               struct NXSIFTKeyStore *store,
+                               int octave, float sigma_c, int i)
+{
+        const int B = det->param.border_distance;
+        const struct NXImage *dog = nx_sift_dog(det, i);
+        struct NXSIFTScanJob job = { det, octave, sigma_c, i,
+                                     B, B, dog->width - B, dog->height - B };
+        if (det->region != NULL) {
+                // one more pixel around the region for the interpolation,
+                // peaks are checked against the region once refined
+                int x0, y0, x1, y1;
+                nx_image_region_level_bounds(&det->scan_region, pow(2.0, octave), 1,
+                                             dog->width, dog->height,
+                                             &x0, &y0, &x1, &y1);
+                job.x0 = nx_max_i(job.x0, x0);
+                job.y0 = nx_max_i(job.y0, y0);
+                job.x1 = nx_min_i(job.x1, x1);
+                job.y1 = nx_min_i(job.y1, y1);
+        }
+
+        int n_rows = job.y1 - job.y0;
+        if (n_rows <= 0 || job.x1 <= job.x0)
+                return;
+
+        int n_bands = (n_rows + NX_SIFT_BAND_HEIGHT - 1) / NX_SIFT_BAND_HEIGHT;
+        nx_sift_detector_reserve_bands(det, n_bands);
+
+        nx_parallel_for(NULL, 0, n_bands, 1, nx_sift_scan_bands, &job);
+
+        int n_peaks = 0;
+        for (int k = 0; k < n_bands; ++k)
+                n_peaks += det->bands[k].n_peaks;
+        if (n_peaks == 0)
+                return;
+
+        if (det->param.key_budget > 0) {
+                nx_sift_detector_keep_peaks(det, octave, sigma_c, i, n_bands);
+                return;
+        }
+
+        NX_ALLOC_TAG_PUSH("sift.gradients");
+        nx_image_gradient_polar(det->gmag, det->gori, nx_sift_level(det, i-1));
+        NX_ALLOC_TAG_POP();
+
+        nx_parallel_for(NULL, 0, n_bands, 1, nx_sift_describe_bands, &job);
+        for (int k = 0; k < n_bands; ++k)
+                nx_sift_key_store_merge(store, &det->bands[k].store);
+}
+
+static inline int nx_sift_cmp_id(const struct NXSIFTCandidate *a,
+                                 const struct NXSIFTCandidate *b)
+{
+        return (a->id > b->id) - (a->id < b->id);
+}
+
+static inline int nx_sift_cmp_score(const struct NXSIFTCandidate *a,
+                                    const struct NXSIFTCandidate *b)
+{
+        float sa = fabsf(a->peak.score);
+        float sb = fabsf(b->peak.score);
+        if (sa != sb)
+                return (sa < sb) - (sa > sb);
+        return nx_sift_cmp_id(a, b);
+}
+
+static int nx_sift_cmp_cell_score(const void *a, const void *b)
+{
+        const struct NXSIFTCandidate *ca = (const struct NXSIFTCandidate *)a;
+        const struct NXSIFTCandidate *cb = (const struct NXSIFTCandidate *)b;
+        if (ca->cell != cb->cell)
+                return (ca->cell > cb->cell) - (ca->cell < cb->cell);
+        return nx_sift_cmp_score(ca, cb);
+}
+
+static int nx_sift_cmp_rank_score(const void *a, const void *b)
+{
+        const struct NXSIFTCandidate *ca = (const struct NXSIFTCandidate *)a;
+        const struct NXSIFTCandidate *cb = (const struct NXSIFTCandidate *)b;
+        if (ca->rank != cb->rank)
+                return (ca->rank > cb->rank) - (ca->rank < cb->rank);
+        return nx_sift_cmp_score(ca, cb);
+}
+
+static int nx_sift_cmp_cand_id(const void *a, const void *b)
+{
+        return nx_sift_cmp_id((const struct NXSIFTCandidate *)a,
+                              (const struct NXSIFTCandidate *)b);
+}
+
+/* Reduces the candidates to the key budget. Candidates are ranked by |DoG|
+ * within their grid cell and taken rank by rank, the best of every cell
+ * first, so the budget is spread over the image and unused cell shares go to
+ * the next ranks of the busy cells. The selected candidates stay in scan
+ * order. */
+static void nx_sift_detector_select_candidates(struct NXSIFTDetector *det,
+                                               int width, int height)
+{
+        const int budget = det->param.key_budget;
+        if (det->n_cands <= budget)
+                return;
+
+        const int G = nx_max_i(1, det->param.budget_grid_size);
+        for (int c = 0; c < det->n_cands; ++c) {
+                struct NXSIFTCandidate *cand = det->cands + c;
+                float scale = pow(2.0, det->groups[cand->group].octave);
+                int cx = (int)(cand->peak.x * scale * G / width);
+                int cy = (int)(cand->peak.y * scale * G / height);
+                cand->cell = nx_min_i(nx_max_i(cy, 0), G - 1) * G
+                        + nx_min_i(nx_max_i(cx, 0), G - 1);
+        }
+
+        qsort(det->cands, det->n_cands, sizeof(struct NXSIFTCandidate),
+              nx_sift_cmp_cell_score);
+        for (int c = 0; c < det->n_cands; ++c) {
+                struct NXSIFTCandidate *cand = det->cands + c;
+                cand->rank = (c > 0 && cand[-1].cell == cand->cell) ? cand[-1].rank + 1 : 0;
+        }
+
+        qsort(det->cands, det->n_cands, sizeof(struct NXSIFTCandidate),
+              nx_sift_cmp_rank_score);
+        det->n_cands = budget;
+        qsort(det->cands, det->n_cands, sizeof(struct NXSIFTCandidate),
+              nx_sift_cmp_cand_id);
+}
+
+/* Computes the keys of the candidates group by group, spread over bands of a
+ * few peaks each and merged in scan order */
+static void nx_sift_detector_describe_candidates(struct NXSIFTDetector *det,
+                                                 struct NXSIFTKeyStore *store)
+{
+        const int N_BAND_PEAKS = 16;
+
+        int c = 0;
+        while (c < det->n_cands) {
+                const int group_id = det->cands[c].group;
+                const struct NXSIFTPeakGroup *group = det->groups + group_id;
+                int c_end = c;
+                while (c_end < det->n_cands && det->cands[c_end].group == group_id)
+                        ++c_end;
+
+                int n_bands = (c_end - c + N_BAND_PEAKS - 1) / N_BAND_PEAKS;
+                nx_sift_detector_reserve_bands(det, n_bands);
+                for (int k = 0; k < n_bands; ++k)
+                        det->bands[k].n_peaks = 0;
+                for (int j = c; j < c_end; ++j) {
+                        const struct NXSIFTPeak *peak = &det->cands[j].peak;
+                        nx_sift_band_add_peak(det->bands + (j - c) / N_BAND_PEAKS,
+                                              peak->x, peak->y, peak->scale, peak->score);
+                }
+
+                NX_ALLOC_TAG_PUSH("sift.gradients");
+                nx_image_gradient_polar(det->gmag, det->gori, group->level);
+                NX_ALLOC_TAG_POP();
+
+                struct NXSIFTScanJob job = { det, group->octave, group->sigma_c, 0, 0, 0, 0, 0 };
+                nx_parallel_for(NULL, 0, n_bands, 1, nx_sift_describe_bands, &job);
+                for (int k = 0; k < n_bands; ++k)
+                        nx_sift_key_store_merge(store, &det->bands[k].store);
+
+                c = c_end;
+        }
+}
+
+static int nx_sift_cmp_float_desc(const void *a, const void *b)
+{
+        float fa = *(const float *)a;
+        float fb = *(const float *)b;
+        return (fa < fb) - (fa > fb);
+}
+
+/* Drops the keys with the lowest |DoG| until at most n are left, a selected
+ * peak can give more than one key with multiple orientations */
+static void nx_sift_key_store_trim(struct NXSIFTKeyStore *store, int n)
+{
+        if (store->n <= n)
+                return;
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float *scores = NX_ARENA_NEW_S(arena, store->n);
+        for (int i = 0; i < store->n; ++i)
+                scores[i] = fabsf(store->keys[i].score);
+        qsort(scores, store->n, sizeof(float), nx_sift_cmp_float_desc);
+        const float thr = scores[n - 1];
+        int n_at_thr = 0;
+        for (int i = 0; i < n; ++i)
+                n_at_thr += scores[i] == thr;
+        nx_arena_rewind(arena, mark);
+
+        int n_kept = 0;
+        for (int i = 0; i < store->n; ++i) {
+                float score = fabsf(store->keys[i].score);
+                if (score < thr || (score == thr && n_at_thr-- <= 0))
+                        continue;
+                if (n_kept != i) {
+                        store->keys[n_kept] = store->keys[i];
+                        memcpy(store->desc + n_kept * NX_SIFT_DESC_DIM,
+                               store->desc + i * NX_SIFT_DESC_DIM,
+                               NX_SIFT_DESC_DIM * sizeof(uchar));
+                }
+                store->keys[n_kept].id = n_kept;
+                ++n_kept;
         }
+        store->n = n_kept;
 }
 
-void nx_sift_detector_prepare_octave(struct NXSIFTDetector *det,
-                                     float sigma_c)
+/* Builds the scale space of the octave from level 0 one level at a time and
+ * scans every DoG as soon as the DoGs around it exist, so only a few levels
+ * and DoGs are alive at any time. sigma_0 is the actual blur of level 0, it
+ * can be above the nominal sigma_c when the octave was downsampled with
+ * anti-aliasing. */
+void nx_sift_detector_process_octave(struct NXSIFTDetector *det,
+                                     struct NXSIFTKeyStore *store,
+                                     int octave, float sigma_0, float sigma_c)
 {
         const int n_scales = det->param.n_scales_per_octave;
         float scale_multiplier = pow(2.0, 1.0 / n_scales);
-        for (int i = 1; i < n_scales + 3; ++i) {
-                nx_image_copy(det->levels[i], det->levels[i-1]);
-                float sigma_g = kernel_sigma(sigma_c, scale_multiplier * sigma_c);
-                nx_image_smooth(det->levels[i], det->levels[i],
+        float sigma = sigma_c;
+        for (int k = 1; k < n_scales + 3; ++k) {
+                float sigma_g = kernel_sigma((k == 1) ? sigma_0 : sigma,
+                                             scale_multiplier * sigma);
+                NX_ALLOC_TAG_PUSH("sift.levels");
+                nx_image_smooth(nx_sift_level(det, k), nx_sift_level(det, k-1),
                                 sigma_g, sigma_g,
                                 det->param.kernel_truncation_factor, NULL);
-                sigma_c *= scale_multiplier;
-        }
+                NX_ALLOC_TAG_POP();
+                sigma *= scale_multiplier;
+
+                NX_ALLOC_TAG_PUSH("sift.dogs");
+                nx_image_subtract(nx_sift_dog(det, k-1),
+                                  nx_sift_level(det, k-1), nx_sift_level(det, k));
+                NX_ALLOC_TAG_POP();
 
-        for (int i = 0; i < n_scales + 2; ++i) {
-                nx_image_subtract(det->dogs[i],
-                                  det->levels[i], det->levels[i+1]);
+                // DoG k-2 has both of its neighbours now
+                if (k >= 3)
+                        nx_sift_detector_scan_dog(det, store, octave, sigma_c, k-2);
         }
 }
 
-int nx_sift_detector_compute(struct NXSIFTDetector *det,
-                             struct NXImage *image,
-                             int *max_n_keys,
-                             struct NXKeypoint **keys,
-                             uchar **desc)
+static int nx_sift_detector_compute_image(struct NXSIFTDetector *det,
+                                          struct NXImage *image,
+                                          int *max_n_keys,
+                                          struct NXKeypoint **keys,
+                                          uchar **desc)
 {
-        NX_ASSERT_PTR(det);
-        NX_ASSERT_PTR(image);
-        NX_IMAGE_ASSERT_GRAYSCALE(image);
-        NX_ASSERT_PTR(keys);
-        NX_ASSERT_PTR(desc);
-
         const int MIN_DIM = 2 * det->param.border_distance + 2;
+        const int width = image->width;
+        const int height = image->height;
 
         float sigma_c = 0.5f;
         int octave = 0;
@@ -617,10 +1205,12 @@ int nx_sift_detector_compute(struct NXSIFTDetector *det,
                 octave--;
         }
 
+        NX_ALLOC_TAG_PUSH("sift.levels");
         nx_image_resize(det->levels[0], image->width, image->height,
                         NX_IMAGE_STRIDE_DEFAULT,
                         NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
         nx_image_convert_dtype(det->levels[0], image);
+        NX_ALLOC_TAG_POP();
 
         nx_image_free(dbl_img);
         image = NULL;
@@ -640,15 +1230,39 @@ int nx_sift_detector_compute(struct NXSIFTDetector *det,
         store.keys = *keys;
         store.desc = *desc;
 
+        det->n_cands = 0;
+        det->n_groups = 0;
+        if (det->param.key_budget > 0)
+                nx_sift_key_store_reserve(&store, det->param.key_budget);
+
+        float sigma_0 = sigma_c;
         while (det->levels[0]->width > MIN_DIM
                && det->levels[0]->height > MIN_DIM) {
-                nx_sift_detector_prepare_octave(det, sigma_c);
-                nx_sift_detector_process_octave(det, &store, octave, sigma_c);
-                nx_image_downsample(det->levels[0],
-                                    det->levels[det->param.n_scales_per_octave]);
+                nx_sift_detector_process_octave(det, &store, octave,
+                                                sigma_0, sigma_c);
+
+                // level n_scales - 1 is no longer used, the next octave starts
+                // in its slot
+                const int n_scales = det->param.n_scales_per_octave;
+                const int next_slot = (n_scales - 1) % NX_SIFT_N_LEVEL_SLOTS;
+                struct NXImage *next = det->levels[next_slot];
+                if (det->param.downsample_aa) {
+                        nx_image_downsample_aa(next, nx_sift_level(det, n_scales));
+                        sigma_0 = sqrtf(sigma_c * sigma_c + NX_IMAGE_DOWNSAMPLE_AA_VARIANCE / 4.0f);
+                } else {
+                        nx_image_downsample(next, nx_sift_level(det, n_scales));
+                }
+                det->levels[next_slot] = det->levels[0];
+                det->levels[0] = next;
                 octave++;
         }
 
+        if (det->param.key_budget > 0) {
+                nx_sift_detector_select_candidates(det, width, height);
+                nx_sift_detector_describe_candidates(det, &store);
+                nx_sift_key_store_trim(&store, det->param.key_budget);
+        }
+
         *max_n_keys = store.cap;
         *keys = store.keys;
         *desc = store.desc;
@@ -656,6 +1270,75 @@ int nx_sift_detector_compute(struct NXSIFTDetector *det,
         return store.n;
 }
 
+int nx_sift_detector_compute(struct NXSIFTDetector *det,
+                             struct NXImage *image,
+                             int *max_n_keys,
+                             struct NXKeypoint **keys,
+                             uchar **desc)
+{
+        return nx_sift_detector_compute_region(det, image, NULL,
+                                               max_n_keys, keys, desc);
+}
+
+int nx_sift_detector_compute_region(struct NXSIFTDetector *det,
+                                    struct NXImage *image,
+                                    const struct NXImageRegion *region,
+                                    int *max_n_keys,
+                                    struct NXKeypoint **keys,
+                                    uchar **desc)
+{
+        NX_ASSERT_PTR(det);
+        NX_ASSERT_PTR(image);
+        NX_IMAGE_ASSERT_GRAYSCALE(image);
+        NX_ASSERT_PTR(keys);
+        NX_ASSERT_PTR(desc);
+
+        if (region == NULL)
+                return nx_sift_detector_compute_image(det, image, max_n_keys,
+                                                      keys, desc);
+
+        int x0, y0, x1, y1;
+        nx_image_region_level_bounds(region, 1.0f, NX_SIFT_REGION_MARGIN,
+                                     image->width, image->height,
+                                     &x0, &y0, &x1, &y1);
+        if (x1 <= x0 || y1 <= y0)
+                return 0;
+        x0 -= x0 % NX_SIFT_REGION_ALIGNMENT;
+        y0 -= y0 % NX_SIFT_REGION_ALIGNMENT;
+
+        struct NXImage *crop = nx_image_alloc();
+        uchar *crop_data = (uchar *)image->data.v
+                + (y0 * image->row_stride + x0) * nx_image_bytes_per_channel(image->dtype);
+        nx_image_wrap(crop, crop_data, x1 - x0, y1 - y0, image->row_stride,
+                      image->type, image->dtype, NX_FALSE);
+
+        det->region = region;
+        det->crop_x = x0;
+        det->crop_y = y0;
+        det->scan_region = *region;
+        det->scan_region.x -= x0;
+        det->scan_region.y -= y0;
+        det->scan_region.mask = NULL;
+
+        int n_keys = nx_sift_detector_compute_image(det, crop, max_n_keys,
+                                                    keys, desc);
+
+        det->region = NULL;
+        det->crop_x = 0;
+        det->crop_y = 0;
+        nx_image_free(crop);
+
+        for (int k = 0; k < n_keys; ++k) {
+                struct NXKeypoint *key = *keys + k;
+                key->xs += x0 / key->scale;
+                key->ys += y0 / key->scale;
+                key->x = (int)(key->xs + 0.5f);
+                key->y = (int)(key->ys + 0.5f);
+        }
+
+        return n_keys;
+}
+
 int nx_sift_detector_compute_with_cache(struct NXSIFTDetector *detector,
                                         struct NXImage *image,
                                         int *max_n_keys,
@@ -669,62 +1352,66 @@ int nx_sift_detector_compute_with_cache(struct NXSIFTDetector *detector,
         NX_ASSERT_PTR(keys);
         NX_ASSERT_PTR(desc);
 
-        if (!cache_dir)
-                cache_dir = NX_DEFAULT_CACHE_DIRECTORY;
+        const int image_info[3] = { image->width, image->height, image->dtype };
+        const size_t row_size = (size_t)image->width * image->n_channels
+                * nx_image_bytes_per_channel(image->dtype);
+        const size_t row_stride = (size_t)image->row_stride
+                * nx_image_bytes_per_channel(image->dtype);
 
         int n_rows = image->height;
-        int n_msgs = n_rows + 1;
-        uint8_t **msgs = NX_NEW(n_msgs, uint8_t *);
+        int n_msgs = n_rows + 2;
+        const uint8_t **msgs = NX_NEW(n_msgs, const uint8_t *);
         size_t *lmsg = NX_NEW_Z(n_msgs);
         for (int i = 0; i < n_rows; ++i) {
-                if (image->dtype == NX_IMAGE_UCHAR) {
-                        msgs[i] = (uint8_t *)(image->data.uc + i * image->row_stride);
-                        lmsg[i] = image->width * image->n_channels * sizeof(uchar);
-                } else if (image->dtype == NX_IMAGE_UCHAR) {
-                        msgs[i] = (uint8_t *)(image->data.f32 + i * image->row_stride);
-                        lmsg[i] = image->width * image->n_channels * sizeof(float);
-                }
+                msgs[i] = (const uint8_t *)image->data.v + i * row_stride;
+                lmsg[i] = row_size;
         }
-        msgs[n_msgs - 1] = (uint8_t *)(&detector->param);
-        lmsg[n_msgs - 1] = sizeof(detector->param);
-        uint8_t hash[32];
-        nx_sha256_multi(&hash[0], n_msgs, (const uint8_t *const *)msgs, lmsg);
+        msgs[n_rows] = (const uint8_t *)&image_info[0];
+        lmsg[n_rows] = sizeof(image_info);
+        msgs[n_rows + 1] = (const uint8_t *)&detector->param;
+        lmsg[n_rows + 1] = sizeof(detector->param);
+        struct NXCacheKey key = nx_cache_key_multi(n_msgs, msgs, lmsg);
+        nx_free(msgs);
+        nx_free(lmsg);
 
-        int n_keys = 0;
-        char *hash_str = nx_hash_to_str(32, &hash[0]);
-        char *cachefilepath = nx_fstr("%s/%s.sift", cache_dir, hash_str);
-        if (nx_check_file(cachefilepath)) {
-                // read from cache file
-                FILE *fin = nx_xfopen(cachefilepath, "rb");
-                nx_xfread(&n_keys, sizeof(n_keys), 1, fin);
+        struct NXCache *cache = nx_cache_open(cache_dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
 
+        int n_keys = 0;
+        void *payload = NULL;
+        size_t payload_size = 0;
+        const size_t key_size = sizeof(struct NXKeypoint) + NX_SIFT_DESC_DIM * sizeof(uchar);
+        if (cache && nx_cache_get(cache, key, "sift", &payload, &payload_size)
+            && payload_size >= sizeof(n_keys)
+            && (memcpy(&n_keys, payload, sizeof(n_keys)), n_keys >= 0)
+            && payload_size == sizeof(n_keys) + n_keys * key_size) {
                 if (*max_n_keys < n_keys) {
                         *keys = (struct NXKeypoint *)nx_xrealloc(*keys, n_keys * sizeof(struct NXKeypoint));
                         *desc = (uchar *)nx_xrealloc(*desc, n_keys * NX_SIFT_DESC_DIM * sizeof(uchar));
                         *max_n_keys = n_keys;
                 }
-                nx_xfread(*keys, sizeof(struct NXKeypoint), n_keys, fin);
-                nx_xfread(*desc, sizeof(uchar), n_keys * NX_SIFT_DESC_DIM, fin);
-                nx_fclose(fin, cachefilepath);
-                NX_LOG(NX_LOG_TAG, "Read %d SIFT keypoints and descriptors from cache file %s",
-                       n_keys, cachefilepath);
+                const uchar *p = (const uchar *)payload + sizeof(n_keys);
+                memcpy(*keys, p, n_keys * sizeof(struct NXKeypoint));
+                memcpy(*desc, p + n_keys * sizeof(struct NXKeypoint),
+                       n_keys * NX_SIFT_DESC_DIM * sizeof(uchar));
+                NX_LOG(NX_LOG_TAG, "Read %d SIFT keypoints and descriptors from cache %s",
+                       n_keys, cache_dir ? cache_dir : NX_DEFAULT_CACHE_DIRECTORY);
         } else {
                 n_keys = nx_sift_detector_compute(detector, image,
                                                   max_n_keys, keys, desc);
 
-                // cache keys and descriptors
-                nx_ensure_dir(cache_dir);
-                FILE *fout = nx_xfopen(cachefilepath, "wb");
-                nx_xfwrite(&n_keys, sizeof(n_keys), 1, fout);
-                nx_xfwrite(*keys, sizeof(struct NXKeypoint), n_keys, fout);
-                nx_xfwrite(*desc, sizeof(uchar), n_keys * NX_SIFT_DESC_DIM, fout);
-                nx_fclose(fout, cachefilepath);
-                NX_LOG(NX_LOG_TAG, "Cached %d SIFT keypoints and descriptors to %s",
-                       n_keys, cachefilepath);
+                if (cache) {
+                        const void *parts[3] = { &n_keys, *keys, *desc };
+                        size_t lparts[3] = { sizeof(n_keys),
+                                             n_keys * sizeof(struct NXKeypoint),
+                                             n_keys * NX_SIFT_DESC_DIM * sizeof(uchar) };
+                        nx_cache_put(cache, key, "sift", 3, parts, lparts);
+                        NX_LOG(NX_LOG_TAG, "Cached %d SIFT keypoints and descriptors to %s",
+                               n_keys, cache_dir ? cache_dir : NX_DEFAULT_CACHE_DIRECTORY);
+                }
         }
 
-        nx_free(hash_str);
-        nx_free(cachefilepath);
+        nx_free(payload);
+        nx_cache_close(cache);
 
         return n_keys;
 }
@@ -833,55 +1520,51 @@ int nx_sift_match_brute_force_with_cache(int n,  const struct NXKeypoint *keys,
         NX_ASSERT_PTR(descp);
         NX_ASSERT_PTR(corr);
 
-        if (!cache_dir)
-                cache_dir = NX_DEFAULT_CACHE_DIRECTORY;
-
-        int n_msgs = 5;
-        uint8_t **msgs = NX_NEW(n_msgs, uint8_t *);
-        size_t *lmsg = NX_NEW_Z(n_msgs);
-        msgs[0] = (uint8_t *)(keys);
-        lmsg[0] = n * sizeof(struct NXKeypoint);
-        msgs[1] = (uint8_t *)(desc);
-        lmsg[1] = n * NX_SIFT_DESC_DIM * sizeof(uchar);
-
-        msgs[2] = (uint8_t *)(keyps);
-        lmsg[2] = np * sizeof(struct NXKeypoint);
-        msgs[3] = (uint8_t *)(descp);
-        lmsg[3] = np * NX_SIFT_DESC_DIM * sizeof(uchar);
-
-        msgs[4] = (uint8_t *)(&dist_ratio_thr);
-        lmsg[4] = sizeof(dist_ratio_thr);
-
-        uint8_t hash[32];
-        nx_sha256_multi(&hash[0], n_msgs, (const uint8_t *const *)msgs, lmsg);
+        const int counts[2] = { n, np };
+        const uint8_t *msgs[6] = {
+                (const uint8_t *)&counts[0],
+                (const uint8_t *)keys, (const uint8_t *)desc,
+                (const uint8_t *)keyps, (const uint8_t *)descp,
+                (const uint8_t *)&dist_ratio_thr
+        };
+        const size_t lmsg[6] = {
+                sizeof(counts),
+                n * sizeof(struct NXKeypoint), n * NX_SIFT_DESC_DIM * sizeof(uchar),
+                np * sizeof(struct NXKeypoint), np * NX_SIFT_DESC_DIM * sizeof(uchar),
+                sizeof(dist_ratio_thr)
+        };
+        struct NXCacheKey key = nx_cache_key_multi(6, msgs, lmsg);
+
+        struct NXCache *cache = nx_cache_open(cache_dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
 
         int n_corr = 0;
-        char *hash_str = nx_hash_to_str(32, &hash[0]);
-        char *cachefilepath = nx_fstr("%s/%s.sift_matches", cache_dir, hash_str);
-        if (nx_check_file(cachefilepath)) {
-                // read from cache file
-                FILE *fin = nx_xfopen(cachefilepath, "rb");
-                nx_xfread(&n_corr, sizeof(n_corr), 1, fin);
-                nx_xfread(corr, sizeof(struct NXPointMatch2D), n_corr, fin);
-                nx_fclose(fin, cachefilepath);
-                NX_LOG(NX_LOG_TAG, "Read %d SIFT matches from cache file %s",
-                       n_corr, cachefilepath);
+        void *payload = NULL;
+        size_t payload_size = 0;
+        if (cache && nx_cache_get(cache, key, "sift_matches", &payload, &payload_size)
+            && payload_size >= sizeof(n_corr)
+            && (memcpy(&n_corr, payload, sizeof(n_corr)), n_corr >= 0 && n_corr <= n)
+            && payload_size == sizeof(n_corr) + n_corr * sizeof(struct NXPointMatch2D)) {
+                memcpy(corr, (const uchar *)payload + sizeof(n_corr),
+                       n_corr * sizeof(struct NXPointMatch2D));
+                NX_LOG(NX_LOG_TAG, "Read %d SIFT matches from cache %s",
+                       n_corr, cache_dir ? cache_dir : NX_DEFAULT_CACHE_DIRECTORY);
         } else {
                 n_corr = nx_sift_match_brute_force(n, keys, desc,
                                                    np, keyps, descp,
                                                    corr, dist_ratio_thr);
-                // cache keys and descriptors
-                nx_ensure_dir(cache_dir);
-                FILE *fout = nx_xfopen(cachefilepath, "wb");
-                nx_xfwrite(&n_corr, sizeof(n_corr), 1, fout);
-                nx_xfwrite(corr, sizeof(struct NXPointMatch2D), n_corr, fout);
-                nx_fclose(fout, cachefilepath);
-                NX_LOG(NX_LOG_TAG, "Cached %d SIFT matches to %s",
-                       n_corr, cachefilepath);
-        }
-
-        nx_free(hash_str);
-        nx_free(cachefilepath);
+
+                if (cache) {
+                        const void *parts[2] = { &n_corr, corr };
+                        size_t lparts[2] = { sizeof(n_corr),
+                                             n_corr * sizeof(struct NXPointMatch2D) };
+                        nx_cache_put(cache, key, "sift_matches", 2, parts, lparts);
+                        NX_LOG(NX_LOG_TAG, "Cached %d SIFT matches to %s",
+                               n_corr, cache_dir ? cache_dir : NX_DEFAULT_CACHE_DIRECTORY);
+                }
+        }
+
+        nx_free(payload);
+        nx_cache_close(cache);
 
         return n_corr;
 }
@@ -26,6 +26,7 @@
 #include "virg/nexus/nx_svd.h"
 
 #include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_arena.h"
 #include "virg/nexus/nx_log.h"
 
 /* --------------------------------- LAPACK SVD ----------------------------------- */
@@ -41,6 +42,36 @@ extern void sgesvd_(char* jobu, char* jobvt, int* m, int* n,
                     float* work, int* lwork,
                     int* info);
 
+/* Last workspace size query per thread, repeated solves of the same size skip
+ * the LAPACK query. */
+struct NXSVDWorkQuery {
+        char jobu;
+        char jobvt;
+        int m;
+        int n;
+        int lwork;
+};
+
+static _Thread_local struct NXSVDWorkQuery nx_s_sgesvd_query = { 0, 0, 0, 0, 0 };
+static _Thread_local struct NXSVDWorkQuery nx_s_dgesvd_query = { 0, 0, 0, 0, 0 };
+
+static inline NXBool nx_svd_work_query_matches(const struct NXSVDWorkQuery *q,
+                                               char jobu, char jobvt, int m, int n)
+{
+        return q->lwork > 0 && q->jobu == jobu && q->jobvt == jobvt
+                && q->m == m && q->n == n;
+}
+
+static inline void nx_svd_work_query_set(struct NXSVDWorkQuery *q,
+                                         char jobu, char jobvt, int m, int n,
+                                         int lwork)
+{
+        q->jobu = jobu;
+        q->jobvt = jobvt;
+        q->m = m;
+        q->n = n;
+        q->lwork = lwork;
+}
 
 /*
  * -----------------------------------------------------------------------------
@@ -49,6 +80,9 @@ extern void sgesvd_(char* jobu, char* jobvt, int* m, int* n,
  */
 static int nx_sgesvd_query_lwork(char jobu, char jobvt, int m, int n)
 {
+        if (nx_svd_work_query_matches(&nx_s_sgesvd_query, jobu, jobvt, m, n))
+                return nx_s_sgesvd_query.lwork;
+
         float work = 0;
         int lwork = -1;
 
@@ -65,6 +99,7 @@ static int nx_sgesvd_query_lwork(char jobu, char jobvt, int m, int n)
         sgesvd_(&jobu, &jobvt, &m, &n, A, &ldA, S, U, &ldU, Vt, &ldVt, &work, &lwork, &info);
 
         if(!info) {
+                nx_svd_work_query_set(&nx_s_sgesvd_query, jobu, jobvt, m, n, (int)work);
                 return (int)work;
         }
 
@@ -75,12 +110,14 @@ static void nx_ssvd(char jobU, char jobVt, int m, int n,
                    float* A, int ldA, float* S, float* U, int ldU, float* Vt, int ldVt)
 {
         int  lwork = nx_sgesvd_query_lwork(jobU, jobVt, m, n);
-        float* work  = NX_NEW(lwork, float);
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        float* work  = NX_ARENA_NEW(arena, lwork, float);
 
         int info;
         sgesvd_(&jobU, &jobVt, &m, &n, A, &ldA, S, U, &ldU, Vt, &ldVt, work, &lwork, &info);
 
-        nx_free(work);
+        nx_arena_rewind(arena, mark);
 }
 
 void nx_ssvd_only_s(float *S, int m, int n, float *A, int ldA)
@@ -118,6 +155,9 @@ void nx_ssvd_usvt(float *U, int ldU, float *S, float *Vt, int ldVt, int m, int n
  */
 static int nx_dgesvd_query_lwork(char jobu, char jobvt, int m, int n)
 {
+        if (nx_svd_work_query_matches(&nx_s_dgesvd_query, jobu, jobvt, m, n))
+                return nx_s_dgesvd_query.lwork;
+
         double work = 0;
         int lwork = -1;
 
@@ -134,6 +174,7 @@ static int nx_dgesvd_query_lwork(char jobu, char jobvt, int m, int n)
         dgesvd_(&jobu, &jobvt, &m, &n, A, &ldA, S, U, &ldU, Vt, &ldVt, &work, &lwork, &info);
 
         if(!info) {
+                nx_svd_work_query_set(&nx_s_dgesvd_query, jobu, jobvt, m, n, (int)work);
                 return (int)work;
         }
 
@@ -144,12 +185,14 @@ static void nx_dsvd(char jobU, char jobVt, int m, int n,
                    double* A, int ldA, double* S, double* U, int ldU, double* Vt, int ldVt)
 {
         int  lwork = nx_dgesvd_query_lwork(jobU, jobVt, m, n);
-        double* work  = NX_NEW(lwork, double);
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        double* work  = NX_ARENA_NEW(arena, lwork, double);
 
         int info;
         dgesvd_(&jobU, &jobVt, &m, &n, A, &ldA, S, U, &ldU, Vt, &ldVt, work, &lwork, &info);
 
-        nx_free(work);
+        nx_arena_rewind(arena, mark);
 }
 
 void nx_dsvd_only_s(double *S, int m, int n, double *A, int ldA)
@@ -0,0 +1,568 @@
+/**
+ * @file nx_thread_pool.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_thread_pool.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "virg/nexus/nx_assert.h"
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_log.h"
+#include "virg/nexus/nx_math.h"
+#include "virg/nexus/nx_arena.h"
+#include "virg/nexus/nx_uniform_sampler.h"
+
+#define NX_TASK_DEQUE_INITIAL_CAPACITY 64
+#define NX_THREAD_POOL_N_SPINS 32
+#define NX_PARALLEL_FOR_CHUNKS_PER_THREAD 4
+
+struct NXTask
+{
+        NXTaskFunc func;
+        void *arg;
+        struct NXTaskGroup *group;
+};
+
+/* Ring buffer indexed by unbounded top/bottom counters, capacity is a power of two. */
+struct NXTaskDeque
+{
+        pthread_mutex_t mutex;
+        struct NXTask *tasks;
+        size_t capacity;
+        size_t top;
+        size_t bottom;
+};
+
+struct NXThreadPoolWorker
+{
+        struct NXThreadPool *pool;
+        int id;
+        pthread_t thread;
+};
+
+struct NXThreadPool
+{
+        int n_workers;
+        struct NXThreadPoolWorker *workers;
+        /* deques[0] is the injection deque, deques[i] belongs to worker i. */
+        struct NXTaskDeque *deques;
+        atomic_int n_queued;
+        atomic_int n_sleeping;
+        int quit;
+        pthread_mutex_t sleep_mutex;
+        pthread_cond_t wake_cond;
+};
+
+struct NXTaskGroup
+{
+        struct NXThreadPool *pool;
+        atomic_int n_pending;
+};
+
+struct NXParallelForChunk
+{
+        NXParallelForFunc func;
+        void *arg;
+        int begin;
+        int end;
+};
+
+struct NXParallelFor2DChunk
+{
+        NXParallelFor2DFunc func;
+        void *arg;
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+};
+
+static _Thread_local struct NXThreadPool *nx_s_worker_pool = NULL;
+static _Thread_local int nx_s_worker_id = 0;
+static _Thread_local unsigned nx_s_steal_state = 0;
+
+static struct NXThreadPool *nx_s_thread_pool = NULL;
+static int nx_s_default_n_workers = -1;
+static pthread_mutex_t nx_s_thread_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void nx_task_deque_init(struct NXTaskDeque *deque)
+{
+        pthread_mutex_init(&deque->mutex, NULL);
+        deque->capacity = NX_TASK_DEQUE_INITIAL_CAPACITY;
+        deque->tasks = NX_NEW(deque->capacity, struct NXTask);
+        deque->top = 0;
+        deque->bottom = 0;
+}
+
+static void nx_task_deque_destroy(struct NXTaskDeque *deque)
+{
+        NX_ASSERT(deque->top == deque->bottom);
+        nx_free(deque->tasks);
+        pthread_mutex_destroy(&deque->mutex);
+}
+
+static void nx_task_deque_push_bottom(struct NXTaskDeque *deque, const struct NXTask *task)
+{
+        pthread_mutex_lock(&deque->mutex);
+        if (deque->bottom - deque->top == deque->capacity) {
+                size_t new_capacity = 2 * deque->capacity;
+                struct NXTask *tasks = NX_NEW(new_capacity, struct NXTask);
+                for (size_t i = deque->top; i != deque->bottom; ++i)
+                        tasks[i & (new_capacity - 1)] = deque->tasks[i & (deque->capacity - 1)];
+                nx_free(deque->tasks);
+                deque->tasks = tasks;
+                deque->capacity = new_capacity;
+        }
+        deque->tasks[deque->bottom & (deque->capacity - 1)] = *task;
+        deque->bottom++;
+        pthread_mutex_unlock(&deque->mutex);
+}
+
+static NXBool nx_task_deque_pop_bottom(struct NXTaskDeque *deque, struct NXTask *task)
+{
+        NXBool found = NX_FALSE;
+        pthread_mutex_lock(&deque->mutex);
+        if (deque->bottom != deque->top) {
+                deque->bottom--;
+                *task = deque->tasks[deque->bottom & (deque->capacity - 1)];
+                found = NX_TRUE;
+        }
+        pthread_mutex_unlock(&deque->mutex);
+        return found;
+}
+
+static NXBool nx_task_deque_steal_top(struct NXTaskDeque *deque, struct NXTask *task)
+{
+        NXBool found = NX_FALSE;
+        pthread_mutex_lock(&deque->mutex);
+        if (deque->bottom != deque->top) {
+                *task = deque->tasks[deque->top & (deque->capacity - 1)];
+                deque->top++;
+                found = NX_TRUE;
+        }
+        pthread_mutex_unlock(&deque->mutex);
+        return found;
+}
+
+static int nx_thread_pool_self(const struct NXThreadPool *pool)
+{
+        return (nx_s_worker_pool == pool) ? nx_s_worker_id : -1;
+}
+
+static NXBool nx_thread_pool_find_task(struct NXThreadPool *pool, int self, struct NXTask *task)
+{
+        if (atomic_load(&pool->n_queued) <= 0)
+                return NX_FALSE;
+
+        NXBool found = NX_FALSE;
+        if (self > 0)
+                found = nx_task_deque_pop_bottom(&pool->deques[self], task);
+
+        int n_deques = pool->n_workers + 1;
+        nx_s_steal_state = nx_s_steal_state * 1103515245u + 12345u;
+        int start = (nx_s_steal_state >> 16) % n_deques;
+        for (int i = 0; !found && i < n_deques; ++i) {
+                int victim = (start + i) % n_deques;
+                if (victim != self)
+                        found = nx_task_deque_steal_top(&pool->deques[victim], task);
+        }
+
+        if (found)
+                atomic_fetch_sub(&pool->n_queued, 1);
+
+        return found;
+}
+
+static void nx_thread_pool_run_task(struct NXThreadPool *pool, const struct NXTask *task)
+{
+        task->func(task->arg);
+
+        /* The group may be gone as soon as its count reaches zero. */
+        if (atomic_fetch_sub(&task->group->n_pending, 1) == 1) {
+                pthread_mutex_lock(&pool->sleep_mutex);
+                pthread_cond_broadcast(&pool->wake_cond);
+                pthread_mutex_unlock(&pool->sleep_mutex);
+        }
+}
+
+static void *nx_thread_pool_worker_main(void *arg)
+{
+        struct NXThreadPoolWorker *worker = (struct NXThreadPoolWorker *)arg;
+        struct NXThreadPool *pool = worker->pool;
+
+        nx_s_worker_pool = pool;
+        nx_s_worker_id = worker->id;
+        nx_s_steal_state = (unsigned)worker->id;
+
+        int n_idle = 0;
+        for (;;) {
+                struct NXTask task;
+                if (nx_thread_pool_find_task(pool, worker->id, &task)) {
+                        nx_thread_pool_run_task(pool, &task);
+                        n_idle = 0;
+                        continue;
+                }
+
+                if (++n_idle < NX_THREAD_POOL_N_SPINS) {
+                        sched_yield();
+                        continue;
+                }
+                n_idle = 0;
+
+                pthread_mutex_lock(&pool->sleep_mutex);
+                atomic_fetch_add(&pool->n_sleeping, 1);
+                while (!pool->quit && atomic_load(&pool->n_queued) <= 0)
+                        pthread_cond_wait(&pool->wake_cond, &pool->sleep_mutex);
+                atomic_fetch_sub(&pool->n_sleeping, 1);
+                int quit = pool->quit;
+                pthread_mutex_unlock(&pool->sleep_mutex);
+
+                if (quit && atomic_load(&pool->n_queued) <= 0)
+                        break;
+        }
+
+        nx_uniform_sampler_instance_free();
+        nx_arena_instance_free();
+        nx_s_worker_pool = NULL;
+        nx_s_worker_id = 0;
+
+        return NULL;
+}
+
+struct NXThreadPool *nx_thread_pool_new(int n_workers)
+{
+        if (n_workers < 0)
+                n_workers = nx_thread_pool_default_n_workers();
+
+        struct NXThreadPool *pool = NX_NEW(1, struct NXThreadPool);
+        pool->n_workers = n_workers;
+        atomic_init(&pool->n_queued, 0);
+        atomic_init(&pool->n_sleeping, 0);
+        pool->quit = 0;
+        pthread_mutex_init(&pool->sleep_mutex, NULL);
+        pthread_cond_init(&pool->wake_cond, NULL);
+
+        pool->deques = NX_NEW(n_workers + 1, struct NXTaskDeque);
+        for (int i = 0; i <= n_workers; ++i)
+                nx_task_deque_init(&pool->deques[i]);
+
+        pool->workers = NULL;
+        if (n_workers > 0) {
+                pool->workers = NX_NEW(n_workers, struct NXThreadPoolWorker);
+                for (int i = 0; i < n_workers; ++i) {
+                        struct NXThreadPoolWorker *worker = &pool->workers[i];
+                        worker->pool = pool;
+                        worker->id = i + 1;
+                        int err = pthread_create(&worker->thread, NULL,
+                                                 nx_thread_pool_worker_main, worker);
+                        if (err != 0)
+                                NX_FATAL(NX_LOG_TAG, "Error creating worker thread %d: %s",
+                                         i + 1, strerror(err));
+                }
+        }
+
+        return pool;
+}
+
+void nx_thread_pool_free(struct NXThreadPool *pool)
+{
+        if (pool) {
+                pthread_mutex_lock(&pool->sleep_mutex);
+                pool->quit = 1;
+                pthread_cond_broadcast(&pool->wake_cond);
+                pthread_mutex_unlock(&pool->sleep_mutex);
+
+                for (int i = 0; i < pool->n_workers; ++i)
+                        pthread_join(pool->workers[i].thread, NULL);
+
+                for (int i = 0; i <= pool->n_workers; ++i)
+                        nx_task_deque_destroy(&pool->deques[i]);
+
+                pthread_cond_destroy(&pool->wake_cond);
+                pthread_mutex_destroy(&pool->sleep_mutex);
+                nx_free(pool->deques);
+                nx_free(pool->workers);
+                nx_free(pool);
+        }
+}
+
+int nx_thread_pool_n_workers(const struct NXThreadPool *pool)
+{
+        NX_ASSERT_PTR(pool);
+        return pool->n_workers;
+}
+
+int nx_thread_pool_worker_id()
+{
+        return nx_s_worker_id;
+}
+
+int nx_thread_pool_default_n_workers()
+{
+        pthread_mutex_lock(&nx_s_thread_pool_mutex);
+        int n_workers = nx_s_default_n_workers;
+        pthread_mutex_unlock(&nx_s_thread_pool_mutex);
+        if (n_workers >= 0)
+                return n_workers;
+
+        const char *env = getenv(NX_THREAD_POOL_ENV_N_WORKERS);
+        if (env != NULL && *env != '\0') {
+                char *end = NULL;
+                long n = strtol(env, &end, 10);
+                if (*end == '\0' && n >= 0 && n < 1024)
+                        return (int)n;
+                NX_WARNING(NX_LOG_TAG, "Ignoring invalid %s value '%s'",
+                           NX_THREAD_POOL_ENV_N_WORKERS, env);
+        }
+
+        long n_procs = sysconf(_SC_NPROCESSORS_ONLN);
+        return (n_procs > 1) ? (int)(n_procs - 1) : 0;
+}
+
+void nx_thread_pool_set_default_n_workers(int n_workers)
+{
+        pthread_mutex_lock(&nx_s_thread_pool_mutex);
+        nx_s_default_n_workers = n_workers;
+        pthread_mutex_unlock(&nx_s_thread_pool_mutex);
+}
+
+struct NXThreadPool *nx_thread_pool_instance()
+{
+        pthread_mutex_lock(&nx_s_thread_pool_mutex);
+        struct NXThreadPool *pool = nx_s_thread_pool;
+        pthread_mutex_unlock(&nx_s_thread_pool_mutex);
+        if (pool != NULL)
+                return pool;
+
+        /* Create outside the lock, default_n_workers takes it too. */
+        pool = nx_thread_pool_new(-1);
+        pthread_mutex_lock(&nx_s_thread_pool_mutex);
+        if (nx_s_thread_pool == NULL) {
+                nx_s_thread_pool = pool;
+                pool = NULL;
+        }
+        struct NXThreadPool *instance = nx_s_thread_pool;
+        pthread_mutex_unlock(&nx_s_thread_pool_mutex);
+        nx_thread_pool_free(pool);
+
+        return instance;
+}
+
+void nx_thread_pool_instance_free()
+{
+        pthread_mutex_lock(&nx_s_thread_pool_mutex);
+        struct NXThreadPool *pool = nx_s_thread_pool;
+        nx_s_thread_pool = NULL;
+        pthread_mutex_unlock(&nx_s_thread_pool_mutex);
+
+        nx_thread_pool_free(pool);
+}
+
+static void nx_task_group_init(struct NXTaskGroup *group, struct NXThreadPool *pool)
+{
+        group->pool = pool;
+        atomic_init(&group->n_pending, 0);
+}
+
+struct NXTaskGroup *nx_task_group_new(struct NXThreadPool *pool)
+{
+        NX_ASSERT_PTR(pool);
+
+        struct NXTaskGroup *group = NX_NEW(1, struct NXTaskGroup);
+        nx_task_group_init(group, pool);
+
+        return group;
+}
+
+void nx_task_group_free(struct NXTaskGroup *group)
+{
+        if (group) {
+                nx_task_group_wait(group);
+                nx_free(group);
+        }
+}
+
+void nx_task_group_run(struct NXTaskGroup *group, NXTaskFunc func, void *arg)
+{
+        NX_ASSERT_PTR(group);
+        NX_ASSERT_PTR(func);
+
+        struct NXThreadPool *pool = group->pool;
+        if (pool->n_workers == 0) {
+                func(arg);
+                return;
+        }
+
+        struct NXTask task;
+        task.func = func;
+        task.arg = arg;
+        task.group = group;
+
+        atomic_fetch_add(&group->n_pending, 1);
+        atomic_fetch_add(&pool->n_queued, 1);
+
+        int self = nx_thread_pool_self(pool);
+        nx_task_deque_push_bottom(&pool->deques[(self > 0) ? self : 0], &task);
+
+        if (atomic_load(&pool->n_sleeping) > 0) {
+                pthread_mutex_lock(&pool->sleep_mutex);
+                pthread_cond_broadcast(&pool->wake_cond);
+                pthread_mutex_unlock(&pool->sleep_mutex);
+        }
+}
+
+void nx_task_group_wait(struct NXTaskGroup *group)
+{
+        NX_ASSERT_PTR(group);
+
+        struct NXThreadPool *pool = group->pool;
+        int self = nx_thread_pool_self(pool);
+
+        while (atomic_load(&group->n_pending) > 0) {
+                struct NXTask task;
+                if (nx_thread_pool_find_task(pool, self, &task)) {
+                        nx_thread_pool_run_task(pool, &task);
+                        continue;
+                }
+
+                pthread_mutex_lock(&pool->sleep_mutex);
+                atomic_fetch_add(&pool->n_sleeping, 1);
+                while (atomic_load(&group->n_pending) > 0
+                       && atomic_load(&pool->n_queued) <= 0)
+                        pthread_cond_wait(&pool->wake_cond, &pool->sleep_mutex);
+                atomic_fetch_sub(&pool->n_sleeping, 1);
+                pthread_mutex_unlock(&pool->sleep_mutex);
+        }
+}
+
+static void nx_parallel_for_chunk_run(void *arg)
+{
+        struct NXParallelForChunk *chunk = (struct NXParallelForChunk *)arg;
+        chunk->func(chunk->arg, chunk->begin, chunk->end);
+}
+
+static void nx_parallel_for_2d_chunk_run(void *arg)
+{
+        struct NXParallelFor2DChunk *chunk = (struct NXParallelFor2DChunk *)arg;
+        chunk->func(chunk->arg, chunk->x0, chunk->y0, chunk->x1, chunk->y1);
+}
+
+void nx_parallel_for(struct NXThreadPool *pool, int begin, int end, int grain,
+                     NXParallelForFunc func, void *arg)
+{
+        NX_ASSERT_PTR(func);
+
+        int n = end - begin;
+        if (n <= 0)
+                return;
+
+        if (pool == NULL)
+                pool = nx_thread_pool_instance();
+
+        if (grain <= 0) {
+                int n_target = NX_PARALLEL_FOR_CHUNKS_PER_THREAD * (pool->n_workers + 1);
+                grain = (n + n_target - 1) / n_target;
+        }
+
+        int n_chunks = (n + grain - 1) / grain;
+        if (pool->n_workers == 0 || n_chunks == 1) {
+                func(arg, begin, end);
+                return;
+        }
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        struct NXParallelForChunk *chunks = NX_ARENA_NEW(arena, n_chunks, struct NXParallelForChunk);
+
+        struct NXTaskGroup group;
+        nx_task_group_init(&group, pool);
+
+        /* Submitted back to front so the owner pops the first chunk first. */
+        for (int i = n_chunks - 1; i >= 0; --i) {
+                chunks[i].func = func;
+                chunks[i].arg = arg;
+                chunks[i].begin = begin + i * grain;
+                chunks[i].end = nx_min_i(end, chunks[i].begin + grain);
+                nx_task_group_run(&group, nx_parallel_for_chunk_run, &chunks[i]);
+        }
+        nx_task_group_wait(&group);
+
+        nx_arena_rewind(arena, mark);
+}
+
+void nx_parallel_for_2d(struct NXThreadPool *pool, int width, int height,
+                        int tile_width, int tile_height,
+                        NXParallelFor2DFunc func, void *arg)
+{
+        NX_ASSERT_PTR(func);
+
+        if (width <= 0 || height <= 0)
+                return;
+
+        if (pool == NULL)
+                pool = nx_thread_pool_instance();
+
+        if (tile_width <= 0)
+                tile_width = width;
+        if (tile_height <= 0)
+                tile_height = height;
+
+        int n_tx = (width + tile_width - 1) / tile_width;
+        int n_ty = (height + tile_height - 1) / tile_height;
+        int n_tiles = n_tx * n_ty;
+        if (pool->n_workers == 0 || n_tiles == 1) {
+                for (int y = 0; y < height; y += tile_height)
+                        for (int x = 0; x < width; x += tile_width)
+                                func(arg, x, y, nx_min_i(width, x + tile_width),
+                                     nx_min_i(height, y + tile_height));
+                return;
+        }
+
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        struct NXParallelFor2DChunk *chunks = NX_ARENA_NEW(arena, n_tiles, struct NXParallelFor2DChunk);
+
+        struct NXTaskGroup group;
+        nx_task_group_init(&group, pool);
+
+        for (int i = n_tiles - 1; i >= 0; --i) {
+                int tx = i % n_tx;
+                int ty = i / n_tx;
+                chunks[i].func = func;
+                chunks[i].arg = arg;
+                chunks[i].x0 = tx * tile_width;
+                chunks[i].y0 = ty * tile_height;
+                chunks[i].x1 = nx_min_i(width, chunks[i].x0 + tile_width);
+                chunks[i].y1 = nx_min_i(height, chunks[i].y0 + tile_height);
+                nx_task_group_run(&group, nx_parallel_for_2d_chunk_run, &chunks[i]);
+        }
+        nx_task_group_wait(&group);
+
+        nx_arena_rewind(arena, mark);
+}
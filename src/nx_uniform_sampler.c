@@ -27,29 +27,80 @@
 
 #include <stdlib.h>
 #include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
+#include "virg/nexus/nx_assert.h"
 #include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_arena.h"
 #include "SFMT/SFMT.h"
 
+#define NX_UNIFORM_SAMPLER_KEY_LENGTH 8
+#define NX_UNIFORM_SAMPLER_MAX_REJECTION_N 32
+
 struct NXUniformSampler {
         sfmt_t state;
 };
 
-static struct NXUniformSampler *g_uniform_sampler = NULL;
+static _Thread_local struct NXUniformSampler *nx_s_uniform_sampler = NULL;
+static _Thread_local unsigned nx_s_uniform_sampler_generation = 0;
+
+/* Generation zero means no master seed has been chosen yet. */
+static atomic_uint nx_s_master_generation = 0;
+static uint32_t nx_s_master_seed = 0;
+static uint32_t nx_s_next_stream_id = 0;
+static pthread_mutex_t nx_s_master_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint64_t nx_splitmix64_next(uint64_t *state)
+{
+        uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+}
 
 struct NXUniformSampler *nx_uniform_sampler_instance()
 {
-        if (!g_uniform_sampler) {
-                g_uniform_sampler = nx_uniform_sampler_new();
+        unsigned generation = atomic_load(&nx_s_master_generation);
+        if (nx_s_uniform_sampler != NULL && generation != 0
+            && generation == nx_s_uniform_sampler_generation)
+                return nx_s_uniform_sampler;
+
+        pthread_mutex_lock(&nx_s_master_mutex);
+        if (atomic_load(&nx_s_master_generation) == 0) {
+                nx_s_master_seed = (uint32_t)time(NULL);
+                nx_s_next_stream_id = 0;
+                atomic_store(&nx_s_master_generation, 1);
         }
+        uint32_t seed = nx_s_master_seed;
+        uint32_t stream_id = nx_s_next_stream_id++;
+        nx_s_uniform_sampler_generation = atomic_load(&nx_s_master_generation);
+        pthread_mutex_unlock(&nx_s_master_mutex);
+
+        if (nx_s_uniform_sampler == NULL)
+                nx_s_uniform_sampler = nx_uniform_sampler_alloc();
+        nx_uniform_sampler_init_stream(nx_s_uniform_sampler, seed, stream_id);
 
-        return g_uniform_sampler;
+        return nx_s_uniform_sampler;
 }
 
 void nx_uniform_sampler_instance_free()
 {
-        nx_uniform_sampler_free(g_uniform_sampler);
-        g_uniform_sampler = NULL;
+        nx_uniform_sampler_free(nx_s_uniform_sampler);
+        nx_s_uniform_sampler = NULL;
+        nx_s_uniform_sampler_generation = 0;
+}
+
+void nx_uniform_sampler_set_seed(uint32_t seed)
+{
+        pthread_mutex_lock(&nx_s_master_mutex);
+        nx_s_master_seed = seed;
+        nx_s_next_stream_id = 0;
+        unsigned generation = atomic_load(&nx_s_master_generation) + 1;
+        if (generation == 0)
+                generation = 1;
+        atomic_store(&nx_s_master_generation, generation);
+        pthread_mutex_unlock(&nx_s_master_mutex);
 }
 
 struct NXUniformSampler *nx_uniform_sampler_alloc()
@@ -74,6 +125,14 @@ struct NXUniformSampler *nx_uniform_sampler_new_with_seed(uint32_t seed)
         return sampler;
 }
 
+struct NXUniformSampler *nx_uniform_sampler_new_stream(uint32_t seed, uint32_t stream_id)
+{
+        struct NXUniformSampler *sampler = nx_uniform_sampler_alloc();
+        nx_uniform_sampler_init_stream(sampler, seed, stream_id);
+
+        return sampler;
+}
+
 void nx_uniform_sampler_free(struct NXUniformSampler *sampler)
 {
         if (sampler) {
@@ -91,6 +150,18 @@ void nx_uniform_sampler_init_seed(struct NXUniformSampler *sampler, uint32_t see
         sfmt_init_gen_rand(&sampler->state, seed);
 }
 
+void nx_uniform_sampler_init_stream(struct NXUniformSampler *sampler, uint32_t seed, uint32_t stream_id)
+{
+        uint64_t state = ((uint64_t)stream_id << 32) | seed;
+        uint32_t key[NX_UNIFORM_SAMPLER_KEY_LENGTH];
+        for (int i = 0; i < NX_UNIFORM_SAMPLER_KEY_LENGTH; i += 2) {
+                uint64_t z = nx_splitmix64_next(&state);
+                key[i] = (uint32_t)z;
+                key[i+1] = (uint32_t)(z >> 32);
+        }
+        sfmt_init_by_array(&sampler->state, key, NX_UNIFORM_SAMPLER_KEY_LENGTH);
+}
+
 uint32_t nx_uniform_sampler_sample32(struct NXUniformSampler *sampler)
 {
         return sfmt_genrand_uint32(&sampler->state);
@@ -120,3 +191,70 @@ double nx_uniform_sampler_sample_d(struct NXUniformSampler *sampler)
 {
         return sfmt_genrand_res53_mix(&sampler->state);
 }
+
+int nx_uniform_sampler_sample_index(struct NXUniformSampler *sampler, int range)
+{
+        NX_ASSERT(range > 0);
+
+        /* Multiply-shift with rejection of the biased low products (Lemire). */
+        uint32_t r = (uint32_t)range;
+        uint64_t m = (uint64_t)sfmt_genrand_uint32(&sampler->state) * r;
+        uint32_t low = (uint32_t)m;
+        if (low < r) {
+                uint32_t threshold = -r % r;
+                while (low < threshold) {
+                        m = (uint64_t)sfmt_genrand_uint32(&sampler->state) * r;
+                        low = (uint32_t)m;
+                }
+        }
+
+        return (int)(m >> 32);
+}
+
+void nx_uniform_sampler_fill_s(struct NXUniformSampler *sampler, int n, float *samples)
+{
+        /* sfmt_fill_array32 needs a fresh block, so draw one by one. The top
+         * 24 bits map exactly onto floats in [0, 1). */
+        for (int i = 0; i < n; ++i)
+                samples[i] = (float)(sfmt_genrand_uint32(&sampler->state) >> 8) * (1.0f / 16777216.0f);
+}
+
+void nx_uniform_sampler_fill_index(struct NXUniformSampler *sampler, int n, int *ids, int range)
+{
+        NX_ASSERT(n <= range);
+
+        if (n <= NX_UNIFORM_SAMPLER_MAX_REJECTION_N) {
+                for (int i = 0; i < n; ++i) {
+                        int id;
+                        NXBool is_new;
+                        do {
+                                id = nx_uniform_sampler_sample_index(sampler, range);
+                                is_new = NX_TRUE;
+                                for (int j = 0; j < i; ++j)
+                                        if (ids[j] == id) {
+                                                is_new = NX_FALSE;
+                                                break;
+                                        }
+                        } while (!is_new);
+                        ids[i] = id;
+                }
+                return;
+        }
+
+        /* Partial Fisher-Yates shuffle over all candidates */
+        struct NXArena *arena = nx_arena_instance();
+        struct NXArenaMark mark = nx_arena_mark(arena);
+        int *perm = NX_ARENA_NEW_I(arena, range);
+        for (int i = 0; i < range; ++i)
+                perm[i] = i;
+
+        for (int i = 0; i < n; ++i) {
+                int j = i + nx_uniform_sampler_sample_index(sampler, range - i);
+                int t = perm[j];
+                perm[j] = perm[i];
+                perm[i] = t;
+                ids[i] = t;
+        }
+
+        nx_arena_rewind(arena, mark);
+}
@@ -49,19 +49,8 @@ void nx_usac_homography_sampling(int *sample_ids, void *data)
 {
         struct NXUSACHomographyData *hdata = (struct NXUSACHomographyData *)data;
 
-        sample_ids[0] = (int)(NX_UNIFORM_SAMPLE_S * hdata->n_top_hypo);
-
-        do {
-            sample_ids[1] = (int)(NX_UNIFORM_SAMPLE_S * hdata->n_top_hypo);
-        } while(sample_ids[1]==sample_ids[0]);
-
-        do {
-            sample_ids[2] = (int)(NX_UNIFORM_SAMPLE_S * hdata->n_top_hypo);
-        } while(sample_ids[2]==sample_ids[1] || sample_ids[2]==sample_ids[0]);
-
-        do {
-            sample_ids[3] = (int)(NX_UNIFORM_SAMPLE_S * hdata->n_top_hypo);
-        } while(sample_ids[3]==sample_ids[1] || sample_ids[3]==sample_ids[1] || sample_ids[3]==sample_ids[0]);
+        nx_uniform_sampler_fill_index(nx_uniform_sampler_instance(), 4,
+                                      sample_ids, hdata->n_top_hypo);
 }
 
 NXBool nx_usac_check_homography_sample(const int *sample_ids,
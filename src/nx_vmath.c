@@ -0,0 +1,91 @@
+/**
+ * @file nx_vmath.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include "virg/nexus/nx_vmath.h"
+
+#include "virg/nexus/nx_assert.h"
+
+void nx_vmath_exp(int n, float *y, const float *x)
+{
+        NX_ASSERT_PTR(y);
+        NX_ASSERT_PTR(x);
+
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(y + i, nx_vmath_exp_ps(_mm256_loadu_ps(x + i)));
+#endif
+        for (; i < n; ++i)
+                y[i] = nx_vmath_expf(x[i]);
+}
+
+void nx_vmath_atan2(int n, float *theta, const float *y, const float *x)
+{
+        NX_ASSERT_PTR(theta);
+        NX_ASSERT_PTR(y);
+        NX_ASSERT_PTR(x);
+
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(theta + i, nx_vmath_atan2_ps(_mm256_loadu_ps(y + i),
+                                                              _mm256_loadu_ps(x + i)));
+#endif
+        for (; i < n; ++i)
+                theta[i] = nx_vmath_atan2f(y[i], x[i]);
+}
+
+void nx_vmath_sqrt(int n, float *y, const float *x)
+{
+        NX_ASSERT_PTR(y);
+        NX_ASSERT_PTR(x);
+
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        for (; i + 8 <= n; i += 8)
+                _mm256_storeu_ps(y + i, nx_vmath_sqrt_ps(_mm256_loadu_ps(x + i)));
+#endif
+        for (; i < n; ++i)
+                y[i] = nx_vmath_sqrtf(x[i]);
+}
+
+void nx_vmath_sincos(int n, float *s, float *c, const float *x)
+{
+        NX_ASSERT_PTR(s);
+        NX_ASSERT_PTR(c);
+        NX_ASSERT_PTR(x);
+
+        int i = 0;
+#if (NX_SIMD_AVX2)
+        for (; i + 8 <= n; i += 8) {
+                __m256 vs, vc;
+                nx_vmath_sincos_ps(_mm256_loadu_ps(x + i), &vs, &vc);
+                _mm256_storeu_ps(s + i, vs);
+                _mm256_storeu_ps(c + i, vc);
+        }
+#endif
+        for (; i < n; ++i)
+                nx_vmath_sincosf(x[i], s + i, c + i);
+}
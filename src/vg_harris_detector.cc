@@ -35,13 +35,47 @@ namespace nexus {
 VGHarrisDetector::VGHarrisDetector()
         : m_sigma_win(1.2f),
           m_k(0.06f),
-          m_threshold(0.000005f)
+          m_threshold(0.000005f),
+          m_score_type(NX_HARRIS_SCORE_HARRIS),
+          m_use_region(false)
 {}
 
 VGHarrisDetector::~VGHarrisDetector()
 {
 }
 
+void VGHarrisDetector::set_sigma_win(float sigma_win)
+{
+        m_sigma_win = sigma_win;
+}
+
+void VGHarrisDetector::set_k(float k)
+{
+        m_k = k;
+}
+
+void VGHarrisDetector::set_threshold(float threshold)
+{
+        m_threshold = threshold;
+}
+
+void VGHarrisDetector::set_score_type(enum NXHarrisScoreType score_type)
+{
+        m_score_type = score_type;
+}
+
+void VGHarrisDetector::set_region(const struct NXImageRegion *region)
+{
+        m_use_region = region != NULL;
+        if (m_use_region)
+                m_region = *region;
+}
+
+const struct NXImageRegion *VGHarrisDetector::region() const
+{
+        return m_use_region ? &m_region : NULL;
+}
+
 float VGHarrisDetector::adapt_threshold(float threshold, int n_keys,
                                         int max_n_keys)
 {
@@ -65,13 +99,11 @@ float VGHarrisDetector::adapt_threshold(float threshold, int n_keys,
         return threshold;
 }
 
-void VGHarrisDetector::update_score_image(const VGImage& image)
+void VGHarrisDetector::update_score_image(const VGImage& image, float scale)
 {
-        struct NXImage* dimg[3] = { m_dimg[0].nx_img(),
-                                    m_dimg[1].nx_img(),
-                                    m_dimg[2].nx_img() };
-        nx_harris_deriv_images(dimg, image.nx_img(), m_sigma_win);
-        nx_harris_score_image(m_simg.nx_img(), dimg, m_k);
+        nx_harris_compute_score_image_region(m_simg.nx_img(), image.nx_img(),
+                                             m_sigma_win, m_k, m_score_type,
+                                             region(), scale);
 }
 
 int VGHarrisDetector::detect(const VGImage& image,
@@ -80,11 +112,12 @@ int VGHarrisDetector::detect(const VGImage& image,
 {
         NX_ASSERT(max_n_keys > 0);
 
-        update_score_image(image);
+        update_score_image(image, 1.0f);
 
         keys.resize(2*max_n_keys);
-        int n_keys = nx_harris_detect_keypoints(2*max_n_keys, &keys[0],
-                                                m_simg.nx_img(), m_threshold);
+        int n_keys = nx_harris_detect_keypoints_region(2*max_n_keys, &keys[0],
+                                                       m_simg.nx_img(), m_threshold,
+                                                       region(), 1.0f);
 
         if (adapt_threshold) {
                 // NX_LOG(VG_LOG_TAG, "adapting threshold with %d keys %d max %.10f threshold",
@@ -116,15 +149,17 @@ int VGHarrisDetector::detect_pyr(const VGImagePyr& pyr,
                 const int level = n_key_levels-1;
                 const int k = total_n_keys;
 
-                update_score_image(pyr[level]);
-                int n_keys = nx_harris_detect_keypoints(buffer_sz,
-                                                        &keys[k],
-                                                        m_simg.nx_img(),
-                                                        m_threshold);
+                const float scale = pyr.level_scale(level);
+                update_score_image(pyr[level], scale);
+                int n_keys = nx_harris_detect_keypoints_region(buffer_sz,
+                                                               &keys[k],
+                                                               m_simg.nx_img(),
+                                                               m_threshold,
+                                                               region(), scale);
 
                 for (int i = k; i < k+n_keys; ++i) {
                         keys[i].level = level;
-                        keys[i].scale = pyr.level_scale(level);
+                        keys[i].scale = scale;
                         keys[i].sigma = pyr.level_sigma(level);
                         keys[i].id = i;
 
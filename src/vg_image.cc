@@ -192,19 +192,19 @@ VGImage& VGImage::smooth(const VGImage& src, float sigma_x,
 
 VGImage& VGImage::filter_box_x(const VGImage& src, int sum_radius)
 {
-        nx_image_filter_box_x(m_img.get(), src.m_img.get(), sum_radius, NULL);
+        nx_image_filter_box_x(m_img.get(), src.m_img.get(), sum_radius);
         return *this;
 }
 
 VGImage& VGImage::filter_box_y(const VGImage& src, int sum_radius)
 {
-        nx_image_filter_box_y(m_img.get(), src.m_img.get(), sum_radius, NULL);
+        nx_image_filter_box_y(m_img.get(), src.m_img.get(), sum_radius);
         return *this;
 }
 
 VGImage& VGImage::filter_box(const VGImage& src, int sum_radius_x, int sum_radius_y)
 {
-        nx_image_filter_box(m_img.get(), src.m_img.get(), sum_radius_x, sum_radius_y, NULL);
+        nx_image_filter_box(m_img.get(), src.m_img.get(), sum_radius_x, sum_radius_y);
         return *this;
 }
 
@@ -0,0 +1,132 @@
+/**
+ * @file tests_alloc_stats.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_alloc_stats.h"
+#include "virg/nexus/nx_json_tree.h"
+
+using namespace std;
+
+namespace {
+
+static const size_t TEST_ALLOC_SIZE = 1 << 20;
+
+class NXAllocStatsTest : public ::testing::Test {
+protected:
+        NXAllocStatsTest()
+                {
+                }
+
+        virtual void SetUp()
+                {
+                }
+
+        virtual void TearDown()
+                {
+                }
+
+        uint64_t tag_count(const char *tag)
+                {
+                        struct NXAllocTagStats tags[NX_ALLOC_STATS_MAX_TAGS];
+                        int n = nx_alloc_stats_get_tags(NX_ALLOC_STATS_MAX_TAGS, &tags[0]);
+                        for (int i = 0; i < n; ++i)
+                                if (strcmp(tags[i].tag, tag) == 0)
+                                        return tags[i].n_allocs;
+                        return 0;
+                }
+};
+
+TEST_F(NXAllocStatsTest, LiveAndPeakBytes) {
+        struct NXAllocStats s0, s1, s2;
+        nx_alloc_stats_get(&s0);
+        void *ptr = nx_xmalloc(TEST_ALLOC_SIZE);
+        nx_alloc_stats_get(&s1);
+        nx_free(ptr);
+        nx_alloc_stats_get(&s2);
+
+        if (nx_alloc_stats_enabled()) {
+                EXPECT_GE(s1.live_bytes - s0.live_bytes, (int64_t)TEST_ALLOC_SIZE);
+                EXPECT_GE(s1.peak_bytes, s1.live_bytes);
+                EXPECT_EQ(s0.n_allocs + 1, s1.n_allocs);
+                EXPECT_EQ(s1.n_frees + 1, s2.n_frees);
+                EXPECT_EQ(s0.live_bytes, s2.live_bytes);
+        } else {
+                EXPECT_EQ(0, s1.live_bytes);
+                EXPECT_EQ(0U, s1.n_allocs);
+        }
+}
+
+TEST_F(NXAllocStatsTest, Realloc) {
+        struct NXAllocStats s0, s1;
+        void *ptr = nx_xmalloc(16);
+        nx_alloc_stats_get(&s0);
+        ptr = nx_xrealloc(ptr, TEST_ALLOC_SIZE);
+        nx_alloc_stats_get(&s1);
+        nx_free(ptr);
+
+        if (nx_alloc_stats_enabled()) {
+                EXPECT_EQ(s0.n_reallocs + 1, s1.n_reallocs);
+                EXPECT_GE(s1.live_bytes - s0.live_bytes, (int64_t)(TEST_ALLOC_SIZE - 64));
+        }
+}
+
+TEST_F(NXAllocStatsTest, Tags) {
+        uint64_t n0 = tag_count("test.outer");
+        NX_ALLOC_TAG_PUSH("test.outer");
+        void *p0 = nx_xmalloc(128);
+        NX_ALLOC_TAG_PUSH("test.inner");
+        void *p1 = nx_xaligned_alloc(64, 256);
+        NX_ALLOC_TAG_POP();
+        void *p2 = nx_xcalloc(4, 32);
+        NX_ALLOC_TAG_POP();
+        nx_free(p0);
+        nx_free(p1);
+        nx_free(p2);
+
+        if (nx_alloc_stats_enabled()) {
+                EXPECT_EQ(n0 + 2, tag_count("test.outer"));
+                EXPECT_LE(1U, tag_count("test.inner"));
+        } else {
+                EXPECT_EQ(0U, tag_count("test.outer"));
+        }
+}
+
+TEST_F(NXAllocStatsTest, JSONReport) {
+        struct NXJSONNode *root = nx_alloc_stats_to_json();
+        EXPECT_TRUE(NULL != root);
+        EXPECT_TRUE(NULL != nx_json_object_get(root, "live_bytes", NX_JNT_INTEGER));
+        EXPECT_TRUE(NULL != nx_json_object_get(root, "peak_bytes", NX_JNT_INTEGER));
+        EXPECT_TRUE(NULL != nx_json_object_get(root, "tags", NX_JNT_OBJECT));
+        EXPECT_TRUE(NULL != nx_json_object_get(root, "enabled", NX_JNT_BOOL));
+        nx_json_tree_free(root);
+}
+
+} // namespace
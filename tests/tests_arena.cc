@@ -0,0 +1,123 @@
+/**
+ * @file tests_arena.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_arena.h"
+
+using namespace std;
+
+namespace {
+
+class NXArenaTest : public ::testing::Test {
+protected:
+        NXArenaTest()
+                {
+                        arena_ = NULL;
+                }
+
+        virtual void SetUp()
+                {
+                        arena_ = nx_arena_new(256);
+                }
+
+        virtual void TearDown()
+                {
+                        nx_arena_free(arena_);
+                }
+
+        struct NXArena *arena_;
+};
+
+TEST_F(NXArenaTest, AllocAligned) {
+        for (int i = 1; i < 10; ++i) {
+                void *ptr = nx_arena_alloc(arena_, 3*i);
+                EXPECT_TRUE(NULL != ptr);
+                EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(ptr) % NX_ARENA_ALIGNMENT);
+                memset(ptr, i, 3*i);
+        }
+}
+
+TEST_F(NXArenaTest, MarkRewind) {
+        struct NXArenaMark mark = nx_arena_mark(arena_);
+        char *p0 = reinterpret_cast<char *>(nx_arena_alloc(arena_, 100));
+        nx_arena_rewind(arena_, mark);
+        char *p1 = reinterpret_cast<char *>(nx_arena_alloc(arena_, 100));
+        EXPECT_EQ(p0, p1);
+        EXPECT_EQ(0U, mark.chunk_used);
+}
+
+TEST_F(NXArenaTest, NestedMarks) {
+        float *a = NX_ARENA_NEW_S(arena_, 16);
+        for (int i = 0; i < 16; ++i)
+                a[i] = (float)i;
+
+        struct NXArenaMark mark = nx_arena_mark(arena_);
+        double *b = NX_ARENA_NEW_D(arena_, 1000);
+        memset(b, 0, 1000*sizeof(double));
+        nx_arena_rewind(arena_, mark);
+
+        for (int i = 0; i < 16; ++i)
+                EXPECT_EQ((float)i, a[i]);
+}
+
+TEST_F(NXArenaTest, GrowsToPeak) {
+        struct NXArenaMark mark = nx_arena_mark(arena_);
+        for (int i = 0; i < 8; ++i)
+                nx_arena_alloc(arena_, 1000);
+        EXPECT_LT(1U, arena_->used / 1000);
+        nx_arena_rewind(arena_, mark);
+        EXPECT_EQ(0U, arena_->used);
+        EXPECT_GE(nx_arena_capacity(arena_), arena_->peak);
+
+        // Same workload fits in a single chunk now
+        size_t capacity = nx_arena_capacity(arena_);
+        for (int i = 0; i < 8; ++i)
+                nx_arena_alloc(arena_, 1000);
+        EXPECT_EQ(capacity, nx_arena_capacity(arena_));
+        nx_arena_reset(arena_);
+        EXPECT_EQ(0U, arena_->used);
+}
+
+TEST_F(NXArenaTest, InstancePerThread) {
+        struct NXArena *main_arena = nx_arena_instance();
+        struct NXArena *thread_arena = NULL;
+        std::thread t([&thread_arena]() {
+                        thread_arena = nx_arena_instance();
+                        nx_arena_instance_free();
+                });
+        t.join();
+        EXPECT_TRUE(NULL != main_arena);
+        EXPECT_TRUE(main_arena != thread_arena);
+        EXPECT_EQ(main_arena, nx_arena_instance());
+}
+
+} // namespace
@@ -0,0 +1,368 @@
+/**
+ * @file tests_cache.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_string.h"
+#include "virg/nexus/nx_cache.h"
+
+namespace {
+
+class NXCacheTest : public ::testing::Test {
+protected:
+        NXCacheTest() {}
+
+        virtual void SetUp() {
+                strcpy(dir, "/tmp/nx_cache_test_XXXXXX");
+                ASSERT_TRUE(mkdtemp(dir) != NULL);
+                for (int i = 0; i < (int)sizeof(payload); ++i)
+                        payload[i] = (uint8_t)(i * 7);
+        }
+
+        virtual void TearDown() {
+                DIR *d = opendir(dir);
+                struct dirent *e;
+                while ((e = readdir(d)) != NULL) {
+                        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+                                continue;
+                        char *path = nx_fstr("%s/%s", dir, e->d_name);
+                        unlink(path);
+                        nx_free(path);
+                }
+                closedir(d);
+                rmdir(dir);
+        }
+
+        static struct NXCacheKey key_of(int id) {
+                const uint8_t *msg[1] = { (const uint8_t *)&id };
+                size_t lmsg[1] = { sizeof(id) };
+                return nx_cache_key_multi(1, msg, lmsg);
+        }
+
+        void put(struct NXCache *cache, int id, size_t size) {
+                const void *parts[2] = { &id, payload };
+                size_t lparts[2] = { sizeof(id), size };
+                nx_cache_put(cache, key_of(id), "test", 2, parts, lparts);
+        }
+
+        bool has(struct NXCache *cache, int id, size_t size) {
+                void *data = NULL;
+                size_t n = 0;
+                if (!nx_cache_get(cache, key_of(id), "test", &data, &n))
+                        return false;
+                bool valid = n == sizeof(id) + size
+                        && memcmp(data, &id, sizeof(id)) == 0
+                        && memcmp((uint8_t *)data + sizeof(id), payload, size) == 0;
+                nx_free(data);
+                return valid;
+        }
+
+        char *record_path(int id) {
+                struct NXCacheKey key = key_of(id);
+                return nx_fstr("%s/%016llx%016llx.test", dir,
+                               (unsigned long long)key.h[0],
+                               (unsigned long long)key.h[1]);
+        }
+
+        char dir[64];
+        uint8_t payload[1000];
+};
+
+TEST_F(NXCacheTest, PutGet) {
+        struct NXCache *cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        EXPECT_FALSE(has(cache, 1, 100));
+        put(cache, 1, 100);
+        put(cache, 2, 0);
+        EXPECT_TRUE(has(cache, 1, 100));
+        EXPECT_TRUE(has(cache, 2, 0));
+
+        void *data = NULL;
+        size_t n = 0;
+        EXPECT_FALSE(nx_cache_get(cache, key_of(1), "other", &data, &n));
+
+        int n_records = 0;
+        size_t n_bytes = 0;
+        nx_cache_usage(cache, &n_records, &n_bytes);
+        EXPECT_EQ(2, n_records);
+        EXPECT_LT(104U, n_bytes);
+        nx_cache_close(cache);
+
+        cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        EXPECT_TRUE(has(cache, 1, 100));
+        nx_cache_close(cache);
+}
+
+TEST_F(NXCacheTest, Replace) {
+        struct NXCache *cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        put(cache, 1, 100);
+        put(cache, 1, 200);
+        EXPECT_TRUE(has(cache, 1, 200));
+
+        int n_records = 0;
+        nx_cache_usage(cache, &n_records, NULL);
+        EXPECT_EQ(1, n_records);
+        nx_cache_close(cache);
+}
+
+TEST_F(NXCacheTest, EvictsLeastRecentlyUsed) {
+        struct NXCache *cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        put(cache, 0, 500);
+        size_t record_size = 0;
+        nx_cache_usage(cache, NULL, &record_size);
+        nx_cache_close(cache);
+
+        cache = nx_cache_open(dir, 3 * record_size);
+        put(cache, 1, 500);
+        put(cache, 2, 500);
+        EXPECT_TRUE(has(cache, 0, 500));
+        put(cache, 3, 500);
+
+        EXPECT_TRUE(has(cache, 0, 500));
+        EXPECT_FALSE(has(cache, 1, 500));
+        EXPECT_TRUE(has(cache, 2, 500));
+        EXPECT_TRUE(has(cache, 3, 500));
+
+        char *path = record_path(1);
+        EXPECT_NE(0, access(path, F_OK));
+        nx_free(path);
+
+        int n_records = 0;
+        size_t n_bytes = 0;
+        nx_cache_usage(cache, &n_records, &n_bytes);
+        EXPECT_EQ(3, n_records);
+        EXPECT_EQ(3 * record_size, n_bytes);
+
+        nx_cache_close(cache);
+
+        // Records larger than the budget are not stored
+        cache = nx_cache_open(dir, record_size);
+        put(cache, 4, 1000);
+        EXPECT_FALSE(has(cache, 4, 1000));
+        EXPECT_TRUE(has(cache, 3, 500));
+        nx_cache_close(cache);
+}
+
+TEST_F(NXCacheTest, DamagedRecordIsMiss) {
+        struct NXCache *cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        put(cache, 1, 100);
+        put(cache, 2, 100);
+
+        char *path = record_path(1);
+        struct stat st;
+        ASSERT_EQ(0, stat(path, &st));
+        int fd = open(path, O_WRONLY);
+        uint8_t byte = 0xff;
+        ASSERT_EQ(1, pwrite(fd, &byte, 1, st.st_size - 1));
+        close(fd);
+
+        EXPECT_FALSE(has(cache, 1, 100));
+        EXPECT_NE(0, access(path, F_OK));
+        nx_free(path);
+
+        path = record_path(2);
+        ASSERT_EQ(0, truncate(path, 10));
+        EXPECT_FALSE(has(cache, 2, 100));
+        nx_free(path);
+
+        int n_records = 0;
+        nx_cache_usage(cache, &n_records, NULL);
+        EXPECT_EQ(0, n_records);
+        nx_cache_close(cache);
+}
+
+TEST_F(NXCacheTest, VersionMismatchResetsIndex) {
+        struct NXCache *cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        put(cache, 1, 100);
+        nx_cache_close(cache);
+
+        char *path = nx_fstr("%s/index", dir);
+        int fd = open(path, O_WRONLY);
+        uint32_t version = NX_CACHE_VERSION + 1;
+        ASSERT_EQ((ssize_t)sizeof(version), pwrite(fd, &version, sizeof(version), 8));
+        close(fd);
+        nx_free(path);
+
+        cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        int n_records = 0;
+        nx_cache_usage(cache, &n_records, NULL);
+        EXPECT_EQ(0, n_records);
+        EXPECT_FALSE(has(cache, 1, 100));
+
+        // The records of the old index are removed with it
+        path = record_path(1);
+        EXPECT_NE(0, access(path, F_OK));
+        nx_free(path);
+        nx_cache_close(cache);
+}
+
+TEST_F(NXCacheTest, UnusableDirectory) {
+        // A path below a regular file can never be created
+        char *path = nx_fstr("%s/file", dir);
+        int fd = open(path, O_WRONLY | O_CREAT, 0600);
+        ASSERT_GE(fd, 0);
+        close(fd);
+
+        char *cache_dir = nx_fstr("%s/cache", path);
+        struct NXCache *cache = nx_cache_open(cache_dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        EXPECT_TRUE(cache == NULL);
+
+        put(cache, 1, 100);
+        EXPECT_FALSE(has(cache, 1, 100));
+
+        int n_records = -1;
+        size_t n_bytes = 1;
+        nx_cache_usage(cache, &n_records, &n_bytes);
+        EXPECT_EQ(0, n_records);
+        EXPECT_EQ(0U, n_bytes);
+        nx_cache_close(cache);
+
+        nx_free(cache_dir);
+        nx_free(path);
+}
+
+TEST_F(NXCacheTest, OpenRemovesOrphanFiles) {
+        struct NXCache *cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        put(cache, 1, 100);
+        nx_cache_close(cache);
+
+        pid_t dead = fork();
+        ASSERT_GE(dead, 0);
+        if (dead == 0)
+                _exit(0);
+        ASSERT_EQ(dead, waitpid(dead, NULL, 0));
+
+        char *orphan_record = record_path(2);
+        char *orphan_tmp = nx_fstr("%s/.tmp.%ld.0.test", dir, (long)dead);
+        char *live_tmp = nx_fstr("%s/.tmp.%ld.0.test", dir, (long)getpid());
+        const char *paths[3] = { orphan_record, orphan_tmp, live_tmp };
+        for (int i = 0; i < 3; ++i) {
+                int fd = open(paths[i], O_WRONLY | O_CREAT, 0600);
+                ASSERT_GE(fd, 0);
+                close(fd);
+        }
+
+        cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        EXPECT_NE(0, access(orphan_record, F_OK));
+        EXPECT_NE(0, access(orphan_tmp, F_OK));
+        EXPECT_EQ(0, access(live_tmp, F_OK));
+        EXPECT_TRUE(has(cache, 1, 100));
+        nx_cache_close(cache);
+
+        nx_free(orphan_record);
+        nx_free(orphan_tmp);
+        nx_free(live_tmp);
+}
+
+TEST_F(NXCacheTest, ConcurrentProcesses) {
+        const int N_PROCESSES = 4;
+        const int N_RECORDS = 40;
+
+        pid_t pids[N_PROCESSES];
+        for (int p = 0; p < N_PROCESSES; ++p) {
+                pids[p] = fork();
+                ASSERT_GE(pids[p], 0);
+                if (pids[p] == 0) {
+                        struct NXCache *cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+                        int n_failed = 0;
+                        for (int i = 0; i < N_RECORDS; ++i) {
+                                int shared = i % 4;
+                                int own = 1000 * (p + 1) + i;
+                                put(cache, shared, 100 + shared);
+                                put(cache, own, i);
+                                if (!has(cache, own, i))
+                                        ++n_failed;
+
+                                // Other processes replace the shared records, a hit
+                                // must still be a complete record
+                                void *data = NULL;
+                                size_t n = 0;
+                                if (nx_cache_get(cache, key_of(shared), "test", &data, &n)) {
+                                        if (n != sizeof(shared) + 100 + shared
+                                            || memcmp(data, &shared, sizeof(shared)) != 0)
+                                                ++n_failed;
+                                        nx_free(data);
+                                }
+                        }
+                        nx_cache_close(cache);
+                        _exit(n_failed == 0 ? 0 : 1);
+                }
+        }
+
+        for (int p = 0; p < N_PROCESSES; ++p) {
+                int status = 0;
+                ASSERT_EQ(pids[p], waitpid(pids[p], &status, 0));
+                EXPECT_TRUE(WIFEXITED(status));
+                EXPECT_EQ(0, WEXITSTATUS(status));
+        }
+
+        struct NXCache *cache = nx_cache_open(dir, NX_CACHE_DEFAULT_BYTE_BUDGET);
+        int n_records = 0;
+        size_t n_bytes = 0;
+        nx_cache_usage(cache, &n_records, &n_bytes);
+        EXPECT_EQ(N_PROCESSES * N_RECORDS + 4, n_records);
+
+        int n_files = 0;
+        int n_tmp_files = 0;
+        size_t n_file_bytes = 0;
+        DIR *d = opendir(dir);
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+                if (strncmp(e->d_name, ".tmp.", 5) == 0)
+                        ++n_tmp_files;
+                if (e->d_name[0] == '.' || strcmp(e->d_name, "index") == 0)
+                        continue;
+                char *path = nx_fstr("%s/%s", dir, e->d_name);
+                struct stat st;
+                if (stat(path, &st) == 0) {
+                        ++n_files;
+                        n_file_bytes += st.st_size;
+                }
+                nx_free(path);
+        }
+        closedir(d);
+        EXPECT_EQ(n_records, n_files);
+        EXPECT_EQ(n_bytes, n_file_bytes);
+        EXPECT_EQ(0, n_tmp_files);
+
+        for (int s = 0; s < 4; ++s)
+                EXPECT_TRUE(has(cache, s, 100 + s));
+        for (int p = 0; p < N_PROCESSES; ++p)
+                for (int i = 0; i < N_RECORDS; ++i)
+                        EXPECT_TRUE(has(cache, 1000 * (p + 1) + i, i));
+        nx_cache_close(cache);
+}
+
+} // namespace
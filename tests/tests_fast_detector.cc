@@ -64,15 +64,55 @@ protected:
 
                 keys_ = NX_NEW(TEST_MAX_N_KEYS, struct NXKeypoint);
                 n_keys_ = 0;
+
+                // disc in the middle of the image with a hole
+                mask_ = nx_image_new_gray_uc(lena_->width, lena_->height);
+                for (int y = 0; y < mask_->height; ++y) {
+                        for (int x = 0; x < mask_->width; ++x) {
+                                int r2 = (x - 250) * (x - 250) + (y - 270) * (y - 270);
+                                mask_->data.uc[y * mask_->row_stride + x] = (r2 < 150 * 150 && r2 > 40 * 40) ? 255 : 0;
+                        }
+                }
         }
 
         virtual void TearDown() {
                 nx_image_pyr_free(pyr_);
                 nx_image_pyr_builder_free(builder_);
                 nx_image_free(lena_);
+                nx_image_free(mask_);
                 nx_free(keys_);
         }
 
+        // Corners of the level detected within the region must be those of
+        // the whole level that are in the region
+        void expect_region_matches_filtered(int level, const struct NXImageRegion *region) {
+                const struct NXImage *img = pyr_->levels[level].img;
+                const float scale = pyr_->levels[level].scale;
+                const int threshold = 20;
+                const int n_max = img->width * img->height;
+                struct NXKeypoint *all = NX_NEW(n_max, struct NXKeypoint);
+                struct NXKeypoint *in = NX_NEW(n_max, struct NXKeypoint);
+
+                int n_all = nx_fast_detect_keypoints(n_max, all, img, threshold);
+                int n_in = nx_fast_detect_keypoints_region(n_max, in, img, threshold,
+                                                           region, scale);
+                int j = 0;
+                for (int i = 0; i < n_all; ++i) {
+                        if (!nx_image_region_contains(region, all[i].x * scale, all[i].y * scale))
+                                continue;
+                        ASSERT_LT(j, n_in);
+                        EXPECT_EQ(all[i].x, in[j].x);
+                        EXPECT_EQ(all[i].y, in[j].y);
+                        EXPECT_EQ(j, (int)in[j].id);
+                        ++j;
+                }
+                EXPECT_EQ(j, n_in);
+                EXPECT_LT(0, n_in);
+
+                nx_free(all);
+                nx_free(in);
+        }
+
         struct NXImage *lena_;
         struct NXImagePyr *pyr_;
         struct NXImagePyrBuilder *builder_;
@@ -80,6 +120,7 @@ protected:
         struct NXFastDetector *det_;
         struct NXKeypoint *keys_;
         int n_keys_;
+        struct NXImage *mask_;
 };
 
 TEST_F(NXFastDetectorTest, FastDetectorAllocFree) {
@@ -105,4 +146,40 @@ TEST_F(NXFastDetectorTest, FastDetectorDetectPyr) {
         nx_fast_detector_free(det_);
 }
 
+TEST_F(NXFastDetectorTest, FastDetectRegion) {
+        struct NXImageRegion rect;
+        nx_image_region_init(&rect, 61, 130, 200, 150, NULL);
+        struct NXImageRegion masked;
+        nx_image_region_init(&masked, 0, 0, lena_->width, lena_->height, mask_);
+        EXPECT_EQ(101, masked.x);
+        EXPECT_EQ(121, masked.y);
+        EXPECT_EQ(299, masked.width);
+        EXPECT_EQ(299, masked.height);
+
+        for (int i = 0; i < TEST_N_LEVELS; ++i) {
+                expect_region_matches_filtered(i, &rect);
+                expect_region_matches_filtered(i, &masked);
+        }
+}
+
+TEST_F(NXFastDetectorTest, FastDetectorDetectPyrRegion) {
+        struct NXImageRegion region;
+        nx_image_region_init(&region, 0, 0, lena_->width, lena_->height, mask_);
+
+        det_ = nx_fast_detector_alloc();
+        n_keys_ = nx_fast_detector_detect_pyr_region(det_, TEST_MAX_N_KEYS, keys_, pyr_, -1, &region);
+        EXPECT_GE(TEST_MAX_N_KEYS, n_keys_);
+        EXPECT_LT(0, n_keys_);
+        for (int i = 0; i < n_keys_; ++i)
+                EXPECT_TRUE(nx_image_region_contains(&region, nx_keypoint_x0(keys_ + i),
+                                                     nx_keypoint_y0(keys_ + i)));
+        nx_fast_detector_free(det_);
+
+        struct NXImageRegion empty;
+        nx_image_region_init(&empty, 10, 10, 0, 5, NULL);
+        det_ = nx_fast_detector_alloc();
+        EXPECT_EQ(0, nx_fast_detector_detect_pyr_region(det_, TEST_MAX_N_KEYS, keys_, pyr_, -1, &empty));
+        nx_fast_detector_free(det_);
+}
+
 } // namespace
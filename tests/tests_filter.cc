@@ -143,4 +143,171 @@ TEST_F(NXFilterTest, BufferConvolveBox) {
     memset(box_buffer_, 0, BRN*sizeof(float));
 }
 
+static void convolve_sym_reference(int n, float *dest, const float *data, int n_k, const float *kernel)
+{
+        for (int i = 0; i < n; ++i) {
+                const float *dk0 = data + i + n_k - 1;
+                double sum = kernel[0] * (double)dk0[0];
+                for (int k = 1; k < n_k; ++k)
+                        sum += kernel[k] * ((double)dk0[-k] + dk0[+k]);
+                dest[i] = sum;
+        }
+}
+
+TEST(NXFilter, ConvolveSymMatchesReference) {
+    const int lengths[] = { 2, 7, 8, 9, 15, 16, 33, 100 };
+    for (int n_k = 2; n_k <= 10; ++n_k) {
+        float kernel[10];
+        nx_kernel_sym_gaussian(n_k, kernel, 0.5f * n_k);
+        for (int l = 0; l < (int)(sizeof(lengths) / sizeof(lengths[0])); ++l) {
+            int n = lengths[l];
+            float *buffer = nx_filter_buffer_alloc(n, n_k - 1);
+            float *ref = new float[n];
+            for (int i = 0; i < n + 2 * (n_k - 1); ++i)
+                buffer[i] = (float)((i * 37 + n_k * 11) % 256);
+            convolve_sym_reference(n, ref, buffer, n_k, kernel);
+            nx_convolve_sym(n, buffer, n_k, kernel);
+            for (int i = 0; i < n; ++i)
+                EXPECT_NEAR(ref[i], buffer[i], 1e-3f) << "n_k = " << n_k << ", n = " << n << ", i = " << i;
+            delete [] ref;
+            nx_free(buffer);
+        }
+    }
+}
+
+TEST(NXFilter, ConvolveSymRowsMatchesConvolveSym) {
+    const int n = 45;
+    for (int n_k = 2; n_k <= 10; ++n_k) {
+        float kernel[10];
+        nx_kernel_sym_gaussian(n_k, kernel, 0.5f * n_k);
+        int n_rows = 2 * n_k - 1;
+        float *data = new float[n_rows * n];
+        const float *rows[19];
+        for (int r = 0; r < n_rows; ++r) {
+            rows[r] = data + r * n;
+            for (int i = 0; i < n; ++i)
+                data[r * n + i] = (float)((r * 53 + i * 29) % 256);
+        }
+
+        float *dest = new float[n];
+        nx_convolve_sym_rows(n, dest, rows, n_k, kernel);
+
+        float *column = nx_filter_buffer_alloc(1, n_k - 1);
+        for (int i = 0; i < n; ++i) {
+            for (int r = 0; r < n_rows; ++r)
+                column[r] = rows[r][i];
+            nx_convolve_sym(2, column, n_k, kernel);
+            EXPECT_NEAR(column[0], dest[i], 1e-3f) << "n_k = " << n_k << ", i = " << i;
+        }
+
+        nx_free(column);
+        delete [] dest;
+        delete [] data;
+    }
+}
+
+TEST(NXFilter, ConvertUCFloat) {
+    const int n = 29;
+    uchar src[n];
+    float f[n];
+    uchar dest[n];
+    for (int i = 0; i < n; ++i)
+        src[i] = (uchar)(i * 9);
+    nx_filter_convert_uc_to_f32(n, f, src);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ((float)src[i], f[i]);
+        f[i] += 0.75f;
+    }
+    f[3] = -4.0f;
+    f[20] = 300.0f;
+    nx_filter_convert_f32_to_uc(n, dest, f);
+    for (int i = 0; i < n; ++i) {
+        if (i == 3)
+            EXPECT_EQ(0, dest[i]);
+        else if (i == 20)
+            EXPECT_EQ(255, dest[i]);
+        else
+            EXPECT_EQ(src[i], dest[i]);
+    }
+}
+
+TEST(NXFilter, ConvolveSymFixedPointMatchesReference) {
+    const int n_max = 71;
+    float kernel[6];
+    uint16_t kernel_q8[6];
+    uint16_t kernel_q16[6];
+    uchar data[2 * n_max + 10];
+    uint16_t dest[n_max];
+    for (int i = 0; i < (int)sizeof(data); ++i)
+        data[i] = (uchar)((i * 89 + 7) % 256);
+
+    for (int n_k = 2; n_k <= 6; ++n_k) {
+        nx_kernel_sym_gaussian(n_k, kernel, 0.4f * n_k);
+        nx_kernel_sym_quantize(n_k, kernel_q8, kernel, 8);
+        nx_kernel_sym_quantize(n_k, kernel_q16, kernel, 16);
+        int sum = kernel_q8[0];
+        for (int k = 1; k < n_k; ++k)
+            sum += 2 * kernel_q8[k];
+        EXPECT_EQ(256, sum);
+
+        for (int step = 1; step <= 2; ++step) {
+            for (int n = 1; n <= n_max - n_k; n += 5) {
+                nx_convolve_sym_uc_q8(n, dest, data, step, n_k, kernel_q8);
+                for (int i = 0; i < n; ++i) {
+                    const uchar *dk0 = data + step * i + n_k - 1;
+                    int ref = kernel_q8[0] * dk0[0];
+                    for (int k = 1; k < n_k; ++k)
+                        ref += kernel_q8[k] * (dk0[-k] + dk0[k]);
+                    EXPECT_EQ(ref, dest[i]);
+                }
+            }
+        }
+
+        const uint16_t *rows[11];
+        for (int r = 0; r < 2 * n_k - 1; ++r)
+            rows[r] = dest + r;
+        uchar out[n_max];
+        int n = n_max - 2 * n_k;
+        nx_convolve_sym_uc_q8(n_max - n_k, dest, data, 1, n_k, kernel_q8);
+        nx_convolve_sym_rows_q8(n, out, rows, n_k, kernel_q16);
+        for (int i = 0; i < n; ++i) {
+            float ref = 0.0f;
+            for (int r = 0; r < 2 * n_k - 1; ++r)
+                ref += kernel[abs(r - n_k + 1)] * rows[r][i] / 256.0f;
+            EXPECT_NEAR(ref, out[i], 1.0f);
+        }
+    }
+}
+
+TEST(NXFilter, ConvolveRecursiveGaussian) {
+    const int n = 200;
+    const int n_border = 40;
+    const int stride = 16;
+    const int n_lanes = 13;
+    float coeffs[4];
+    nx_recursive_gaussian_coefficients(6.0f, coeffs);
+    EXPECT_NEAR(1.0f, coeffs[0] + coeffs[1] + coeffs[2] + coeffs[3], 1e-6f);
+
+    // Constant lanes stay constant, a centered impulse keeps its mass and spreads
+    float *data = new float[(n + n_border) * stride];
+    for (int i = 0; i < n; ++i)
+        for (int l = 0; l < stride; ++l)
+            data[i * stride + l] = (l == 0) ? (i == n / 2 ? 1.0f : 0.0f) : (float)l;
+    nx_convolve_recursive_gaussian(n, n_border, data, stride, n_lanes, coeffs);
+
+    // The third order filter has heavier tails than the Gaussian, so only
+    // check the response pointwise relative to the peak
+    double mass = 0.0;
+    double peak = 1.0 / (sqrt(2.0 * M_PI) * 6.0);
+    for (int i = 0; i < n; ++i) {
+        double g = peak * exp(-(i - n / 2) * (i - n / 2) / 72.0);
+        mass += data[i * stride];
+        EXPECT_NEAR(g, data[i * stride], 0.04 * peak);
+        for (int l = 1; l < n_lanes; ++l)
+            EXPECT_NEAR((float)l, data[i * stride + l], 1e-3f * l);
+    }
+    EXPECT_NEAR(1.0, mass, 1e-3);
+    delete [] data;
+}
+
 } // namespace
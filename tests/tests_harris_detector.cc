@@ -0,0 +1,173 @@
+/**
+ * @file tests_harris_detector.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+#include "test_data.hh"
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_image.h"
+#include "virg/nexus/nx_image_io.h"
+#include "virg/nexus/nx_harris_detector.h"
+
+namespace {
+
+class NXHarrisDetectorTest : public ::testing::Test {
+protected:
+        NXHarrisDetectorTest() {
+                lena_ = NULL;
+                simg_ = NULL;
+                for (int i = 0; i < 3; ++i)
+                        dimg_[i] = NULL;
+        }
+
+        virtual void SetUp() {
+                lena_ = nx_image_alloc();
+                nx_image_xload_pnm(lena_, TEST_DATA_LENA_PPM, NX_IMAGE_LOAD_GRAYSCALE);
+                simg_ = nx_image_alloc();
+        }
+
+        virtual void TearDown() {
+                nx_image_free(lena_);
+                nx_image_free(simg_);
+                for (int i = 0; i < 3; ++i)
+                        nx_image_free(dimg_[i]);
+        }
+
+        void expect_fused_matches_separate(const struct NXImage *img, float sigma_win) {
+                const float k = 0.06f;
+                struct NXImage *sref = nx_image_alloc();
+                nx_harris_deriv_images(&dimg_[0], img, sigma_win);
+                nx_harris_score_image(sref, &dimg_[0], k);
+                nx_harris_compute_score_image(simg_, img, sigma_win, k, NX_HARRIS_SCORE_HARRIS);
+
+                ASSERT_EQ(sref->width, simg_->width);
+                ASSERT_EQ(sref->height, simg_->height);
+                for (int y = 0; y < img->height; ++y)
+                        for (int x = 0; x < img->width; ++x)
+                                EXPECT_EQ(sref->data.f32[y * sref->row_stride + x],
+                                          simg_->data.f32[y * simg_->row_stride + x]);
+                nx_image_free(sref);
+        }
+
+        struct NXImage *lena_;
+        struct NXImage *simg_;
+        struct NXImage *dimg_[3];
+};
+
+TEST_F(NXHarrisDetectorTest, ComputeScoreImageMatchesSeparatePasses) {
+        expect_fused_matches_separate(lena_, 1.2f);
+        expect_fused_matches_separate(lena_, 2.5f);
+        expect_fused_matches_separate(lena_, 0.0f);
+
+        struct NXImage *img = nx_image_new_gray_uc(613, 71);
+        for (int y = 0; y < img->height; ++y)
+                for (int x = 0; x < img->width; ++x)
+                        img->data.uc[y * img->row_stride + x] = (uchar)((x * 37 + y * 101 + x * y) % 256);
+        expect_fused_matches_separate(img, 1.6f);
+        nx_image_free(img);
+}
+
+TEST_F(NXHarrisDetectorTest, ShiTomasiIsMinEigenvalue) {
+        const float sigma_win = 1.2f;
+        nx_harris_deriv_images(&dimg_[0], lena_, sigma_win);
+        nx_harris_compute_score_image(simg_, lena_, sigma_win, 0.0f, NX_HARRIS_SCORE_SHI_TOMASI);
+
+        for (int y = 0; y < lena_->height; ++y) {
+                for (int x = 0; x < lena_->width; ++x) {
+                        double a = dimg_[0]->data.f32[y * dimg_[0]->row_stride + x];
+                        double c = dimg_[1]->data.f32[y * dimg_[1]->row_stride + x];
+                        double b = dimg_[2]->data.f32[y * dimg_[2]->row_stride + x];
+                        double lambda_min = 0.5 * (a + c - sqrt((a - c) * (a - c) + 4.0 * b * b));
+                        EXPECT_NEAR(lambda_min, simg_->data.f32[y * simg_->row_stride + x],
+                                    1e-5 * (a + c) + 1e-9);
+                }
+        }
+}
+
+TEST_F(NXHarrisDetectorTest, DetectRegionMatchesFilteredDetection) {
+        const float sigma_win = 1.2f;
+        const float k = 0.06f;
+        const float threshold = 1e-6f;
+        const int n_max = lena_->width * lena_->height;
+
+        struct NXImage *mask = nx_image_new_gray_uc(lena_->width, lena_->height);
+        for (int y = 0; y < mask->height; ++y)
+                for (int x = 0; x < mask->width; ++x)
+                        mask->data.uc[y * mask->row_stride + x] = (x + y < 600 && x > 90) ? 1 : 0;
+
+        struct NXImageRegion regions[2];
+        nx_image_region_init(&regions[0], 130, 47, 211, 300, NULL);
+        nx_image_region_init(&regions[1], 40, 200, 500, 400, mask);
+
+        struct NXImage *sref = nx_image_alloc();
+        struct NXKeypoint *all = NX_NEW(n_max, struct NXKeypoint);
+        struct NXKeypoint *in = NX_NEW(n_max, struct NXKeypoint);
+        nx_harris_compute_score_image(sref, lena_, sigma_win, k, NX_HARRIS_SCORE_HARRIS);
+        int n_all = nx_harris_detect_keypoints(n_max, all, sref, threshold);
+
+        for (int r = 0; r < 2; ++r) {
+                const struct NXImageRegion *region = &regions[r];
+                nx_harris_compute_score_image_region(simg_, lena_, sigma_win, k,
+                                                     NX_HARRIS_SCORE_HARRIS, region, 1.0f);
+                for (int y = 0; y < lena_->height; ++y) {
+                        for (int x = 0; x < lena_->width; ++x) {
+                                float s = simg_->data.f32[y * simg_->row_stride + x];
+                                if (nx_image_region_contains(region, x, y)) {
+                                        EXPECT_EQ(sref->data.f32[y * sref->row_stride + x], s);
+                                } else if (x < region->x - 3 || x >= region->x + region->width + 3
+                                           || y < region->y - 3 || y >= region->y + region->height + 3) {
+                                        EXPECT_EQ(0.0f, s);
+                                }
+                        }
+                }
+
+                int n_in = nx_harris_detect_keypoints_region(n_max, in, simg_, threshold,
+                                                             region, 1.0f);
+                int j = 0;
+                for (int i = 0; i < n_all; ++i) {
+                        if (!nx_image_region_contains(region, all[i].x, all[i].y))
+                                continue;
+                        ASSERT_LT(j, n_in);
+                        EXPECT_EQ(all[i].x, in[j].x);
+                        EXPECT_EQ(all[i].y, in[j].y);
+                        ++j;
+                }
+                EXPECT_EQ(j, n_in);
+                EXPECT_LT(0, n_in);
+        }
+
+        nx_free(all);
+        nx_free(in);
+        nx_image_free(sref);
+        nx_image_free(mask);
+}
+
+} // namespace
@@ -0,0 +1,179 @@
+/**
+ * @file tests_hash.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_hash.h"
+
+namespace {
+
+const int N_HASH64_MSG = 4;
+const char *HASH64_MSG[N_HASH64_MSG] = {
+        "",
+        "a",
+        "abc",
+        "Nobody inspects the spammish repetition"
+};
+const uint64_t HASH64_VALUE[N_HASH64_MSG] = {
+        0xef46db3751d8e999ULL,
+        0xd24ec4f1a98c6e5bULL,
+        0x44bc2cf5ad770999ULL,
+        0xfbcea83c8a378bf1ULL
+};
+
+struct Hash3Value {
+        int n;
+        uint64_t seed;
+        uint64_t h64;
+        uint64_t lo;
+        uint64_t hi;
+};
+
+// XXH3 values of the first n bytes of the test data, one length per code path
+const int N_HASH3_VALUES = 26;
+const Hash3Value HASH3_VALUE[N_HASH3_VALUES] = {
+        {    0, 0x0000000000000000ULL, 0x2d06800538d394c2ULL, 0x6001c324468d497fULL, 0x99aa06d3014798d8ULL },
+        {    1, 0x0000000000000000ULL, 0xc44bdff4074eecdbULL, 0xc44bdff4074eecdbULL, 0xa6cd5e9392000f6aULL },
+        {    3, 0x0000000000000000ULL, 0x6811538b444fc6dcULL, 0x6811538b444fc6dcULL, 0xc925ae1797c3998fULL },
+        {    4, 0x0000000000000000ULL, 0xed503340c589a28bULL, 0xdb9cecd5eb59a7f1ULL, 0x6ae518c60df23fcaULL },
+        {    8, 0x0000000000000000ULL, 0xe5b43ab074c9c13bULL, 0x5b3f49d0f38f9d7dULL, 0x63f350efc0ba3e2eULL },
+        {    9, 0x0000000000000000ULL, 0x98b5d7141ed79e34ULL, 0xb29819f07be24be8ULL, 0x9779e9837eb46b3fULL },
+        {   16, 0x0000000000000000ULL, 0xac4b400b09fefc71ULL, 0x552f4b2fff1f4d72ULL, 0x3b1969c3d4fe036dULL },
+        {   17, 0x0000000000000000ULL, 0xe43948ad7d39cc4eULL, 0x71ce18c8f219e820ULL, 0xe96ab65d27f6ab6cULL },
+        {  128, 0x0000000000000000ULL, 0xabe5353db9741d3cULL, 0x1188fc8e42200dd7ULL, 0xf2d31679b8b5686eULL },
+        {  129, 0x0000000000000000ULL, 0x62e851eb617ab82cULL, 0x3b5eb4544c504f20ULL, 0xd15ec57e780df3b2ULL },
+        {  240, 0x0000000000000000ULL, 0x3b7fbc325f2fe844ULL, 0xc0a6fe354c39a7d2ULL, 0xfdfc81512b46d647ULL },
+        {  241, 0x0000000000000000ULL, 0xa9d16963bf94ed57ULL, 0xa9d16963bf94ed57ULL, 0xe36e08da3c3d95d6ULL },
+        { 1000, 0x0000000000000000ULL, 0xfe105769432b77c6ULL, 0xfe105769432b77c6ULL, 0x9713c0a0bac1a75bULL },
+        {    0, 0x9e3779b97f4a7c15ULL, 0x602b0e2cd6662c8bULL, 0x4ca5176998171787ULL, 0xd142977a2cca554bULL },
+        {    1, 0x9e3779b97f4a7c15ULL, 0x062b185e4e01441aULL, 0x062b185e4e01441aULL, 0xe366b8c99a31df50ULL },
+        {    3, 0x9e3779b97f4a7c15ULL, 0xf4a795d2019d121aULL, 0xf4a795d2019d121aULL, 0x71e170d90fe63dbdULL },
+        {    4, 0x9e3779b97f4a7c15ULL, 0xf5aee1c988bf33e7ULL, 0xad7fedd6d82926e7ULL, 0xafff1bff33c5f3a5ULL },
+        {    8, 0x9e3779b97f4a7c15ULL, 0xa1c0d07ae3b3cad9ULL, 0xceda20073fb672b1ULL, 0x911425a4894fcccdULL },
+        {    9, 0x9e3779b97f4a7c15ULL, 0xd5c001f6c43d833aULL, 0x0a844e8d1fe47ff6ULL, 0xe4082ca1eeeeb868ULL },
+        {   16, 0x9e3779b97f4a7c15ULL, 0xbd27c79f5e24dc11ULL, 0x370a283b1969c6e3ULL, 0x483bdf50d23d5f55ULL },
+        {   17, 0x9e3779b97f4a7c15ULL, 0xd3a63ae15a3da1a3ULL, 0x228bacdf8365a178ULL, 0xfab193a437c062baULL },
+        {  128, 0x9e3779b97f4a7c15ULL, 0x6561ba1104b96014ULL, 0x92f4436e4bf92cbbULL, 0xa382be144e0e5f6aULL },
+        {  129, 0x9e3779b97f4a7c15ULL, 0x2d1ed10f1fe850adULL, 0x651daa3d41ed3eaaULL, 0x5c9539bb82a9fa80ULL },
+        {  240, 0x9e3779b97f4a7c15ULL, 0x4ab5c7dc45ca4baaULL, 0x9f322fbff63b8609ULL, 0xf04b0d03ef52db3aULL },
+        {  241, 0x9e3779b97f4a7c15ULL, 0x38393807f4c2d1eaULL, 0x38393807f4c2d1eaULL, 0x2594241275169297ULL },
+        { 1000, 0x9e3779b97f4a7c15ULL, 0xf4d583d4c6642fb9ULL, 0xf4d583d4c6642fb9ULL, 0xf0aa58dad2d69d2dULL },
+};
+
+class NXHashTest : public ::testing::Test {
+protected:
+        NXHashTest() {}
+
+        virtual void SetUp() {
+                n = 1000;
+                data = NX_NEW(n, uint8_t);
+                for (int i = 0; i < n; ++i)
+                        data[i] = (uint8_t)(i * 131 + (i >> 3));
+        }
+
+        virtual void TearDown() {
+                nx_free(data);
+        }
+
+        int n;
+        uint8_t *data;
+};
+
+TEST_F(NXHashTest, KnownValues) {
+        for (int t = 0; t < N_HASH64_MSG; ++t)
+                EXPECT_EQ(HASH64_VALUE[t], nx_hash64(HASH64_MSG[t], strlen(HASH64_MSG[t]), 0));
+}
+
+TEST_F(NXHashTest, SeedChangesHash) {
+        EXPECT_NE(nx_hash64(data, n, 0), nx_hash64(data, n, 1));
+}
+
+TEST_F(NXHashTest, StreamingMatchesOneShot) {
+        for (int len = 0; len <= n; len += 37) {
+                uint64_t h = nx_hash64(data, len, 7);
+                for (int step = 1; step <= 67; step += 11) {
+                        struct NXHash64State state;
+                        nx_hash64_init(&state, 7);
+                        for (int i = 0; i < len; i += step) {
+                                int m = (len - i < step) ? len - i : step;
+                                nx_hash64_update(&state, data + i, m);
+                        }
+                        EXPECT_EQ(h, nx_hash64_final(&state));
+                }
+        }
+}
+
+TEST_F(NXHashTest, MultiMatchesConcatenation) {
+        const uint8_t *msg[4] = { data, data + 3, data + 3, data + 100 };
+        size_t lmsg[4] = { 3, 0, 97, (size_t)n - 100 };
+        EXPECT_EQ(nx_hash64(data, n, 0), nx_hash64_multi(4, msg, lmsg, 0));
+        EXPECT_EQ(nx_hash64(data, 0, 5), nx_hash64_multi(0, msg, lmsg, 5));
+}
+
+TEST_F(NXHashTest, Hash3KnownValues) {
+        for (int t = 0; t < N_HASH3_VALUES; ++t) {
+                const Hash3Value *v = &HASH3_VALUE[t];
+                EXPECT_EQ(v->h64, nx_hash3_64(data, v->n, v->seed)) << "n = " << v->n;
+                struct NXHash128 h = nx_hash3_128(data, v->n, v->seed);
+                EXPECT_EQ(v->lo, h.lo) << "n = " << v->n;
+                EXPECT_EQ(v->hi, h.hi) << "n = " << v->n;
+        }
+}
+
+TEST_F(NXHashTest, Hash3StreamingMatchesOneShot) {
+        for (int len = 0; len <= n; len += 19) {
+                uint64_t h64 = nx_hash3_64(data, len, 3);
+                struct NXHash128 h128 = nx_hash3_128(data, len, 3);
+                for (int step = 1; step <= 331; step += 33) {
+                        struct NXHash3State state;
+                        nx_hash3_init(&state, 3);
+                        for (int i = 0; i < len; i += step) {
+                                int m = (len - i < step) ? len - i : step;
+                                nx_hash3_update(&state, data + i, m);
+                        }
+                        EXPECT_EQ(h64, nx_hash3_final64(&state));
+                        struct NXHash128 s128 = nx_hash3_final128(&state);
+                        EXPECT_EQ(h128.lo, s128.lo);
+                        EXPECT_EQ(h128.hi, s128.hi);
+                }
+        }
+}
+
+TEST_F(NXHashTest, Hash3MultiMatchesConcatenation) {
+        const uint8_t *msg[4] = { data, data + 3, data + 3, data + 300 };
+        size_t lmsg[4] = { 3, 0, 297, (size_t)n - 300 };
+        EXPECT_EQ(nx_hash3_64(data, n, 0), nx_hash3_64_multi(4, msg, lmsg, 0));
+        struct NXHash128 h = nx_hash3_128(data, n, 0);
+        struct NXHash128 hm = nx_hash3_128_multi(4, msg, lmsg, 0);
+        EXPECT_EQ(h.lo, hm.lo);
+        EXPECT_EQ(h.hi, hm.hi);
+        EXPECT_EQ(nx_hash3_64(data, 0, 5), nx_hash3_64_multi(0, msg, lmsg, 5));
+}
+
+} // namespace
@@ -34,6 +34,9 @@
 #include "virg/nexus/nx_mem_block.h"
 #include "virg/nexus/nx_image.h"
 #include "virg/nexus/nx_image_io.h"
+#include "virg/nexus/nx_filter.h"
+#include "virg/nexus/nx_colorspace.h"
+#include "virg/nexus/nx_thread_pool.h"
 
 using namespace std;
 
@@ -220,15 +223,428 @@ TEST_F(NXImageTest, ImageGrayUCFilter) {
         nx_image_free(img1_);
 }
 
+static void smooth_y_reference(struct NXImage *img, float sigma)
+{
+        int nk = nx_kernel_size_gaussian(sigma, 4.0f);
+        float *kernel = new float[nk / 2 + 1];
+        float *buffer = new float[img->height + 2 * (nk / 2)];
+        nx_kernel_sym_gaussian(nk / 2 + 1, kernel, sigma);
+        for (int x = 0; x < img->width; ++x) {
+                nx_filter_copy_to_buffer(img->height, buffer, img->data.f32 + x,
+                                         img->row_stride, nk / 2, NX_BORDER_REPEAT);
+                nx_convolve_sym(img->height, buffer, nk / 2 + 1, kernel);
+                for (int y = 0; y < img->height; ++y)
+                        img->data.f32[x + y * img->row_stride] = buffer[y];
+        }
+        delete [] kernel;
+        delete [] buffer;
+}
+
+TEST_F(NXImageTest, ImageSmoothYMatchesColumnPass) {
+        const int SIZES[3][2] = { { 1100, 40 }, { 700, 3 }, { 9, 257 } };
+        for (int s = 0; s < 3; ++s) {
+                img0_ = nx_image_alloc();
+                nx_image_resize(img0_, SIZES[s][0], SIZES[s][1], NX_IMAGE_STRIDE_PADDED,
+                                NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+                for (int y = 0; y < img0_->height; ++y)
+                        for (int x = 0; x < img0_->width; ++x)
+                                img0_->data.f32[y * img0_->row_stride + x] = (float)((x * 7 + y * 13) % 31);
+
+                img1_ = nx_image_copy0(img0_);
+                smooth_y_reference(img1_, 2.5f);
+                nx_image_smooth(img0_, img0_, 0.01f, 2.5f, 4.0f, NULL);
+
+                for (int y = 0; y < img0_->height; ++y)
+                        for (int x = 0; x < img0_->width; ++x)
+                                EXPECT_NEAR(img1_->data.f32[y * img1_->row_stride + x],
+                                            img0_->data.f32[y * img0_->row_stride + x], 1e-4f);
+
+                nx_image_free(img0_);
+                nx_image_free(img1_);
+        }
+}
+
+TEST_F(NXImageTest, ImageSmoothFixedCloseToFloat) {
+        const int SIZES[3][2] = { { 613, 41 }, { 35, 3 }, { 9, 130 } };
+        const float SIGMAS[3] = { 0.6f, 1.6f, 2.9f };
+        for (int s = 0; s < 3; ++s) {
+                img0_ = nx_image_alloc();
+                nx_image_resize(img0_, SIZES[s][0], SIZES[s][1], NX_IMAGE_STRIDE_PADDED,
+                                NX_IMAGE_GRAYSCALE, NX_IMAGE_UCHAR);
+                for (int y = 0; y < img0_->height; ++y)
+                        for (int x = 0; x < img0_->width; ++x)
+                                img0_->data.uc[y * img0_->row_stride + x] = (uchar)((x * 37 + y * 101 + x * y) % 256);
+
+                img1_ = nx_image_alloc();
+                nx_image_smooth(img1_, img0_, SIGMAS[s], SIGMAS[2-s], 4.0f, NULL);
+                nx_image_smooth_fixed(img0_, img0_, SIGMAS[s], SIGMAS[2-s], 4.0f);
+
+                for (int y = 0; y < img0_->height; ++y)
+                        for (int x = 0; x < img0_->width; ++x)
+                                EXPECT_NEAR(img1_->data.uc[y * img1_->row_stride + x],
+                                            img0_->data.uc[y * img0_->row_stride + x], 2);
+
+                nx_image_free(img0_);
+                nx_image_free(img1_);
+        }
+}
+
+TEST_F(NXImageTest, ImageDownsampleAAFixedCloseToFloat) {
+        const int SIZES[3][2] = { { 640, 480 }, { 67, 37 }, { 5, 5 } };
+        for (int s = 0; s < 3; ++s) {
+                img0_ = nx_image_new_gray_uc(SIZES[s][0], SIZES[s][1]);
+                for (int y = 0; y < img0_->height; ++y)
+                        for (int x = 0; x < img0_->width; ++x)
+                                img0_->data.uc[y * img0_->row_stride + x] = (uchar)((x * 37 + y * 101 + x * y) % 256);
+
+                struct NXImage *tmp = nx_image_alloc();
+                img1_ = nx_image_alloc();
+                nx_image_downsample_aa_x(tmp, img0_);
+                nx_image_downsample_aa_y(img1_, tmp);
+
+                struct NXImage *fixed = nx_image_alloc();
+                nx_image_downsample_aa_fixed(fixed, img0_);
+                EXPECT_EQ(img1_->width, fixed->width);
+                EXPECT_EQ(img1_->height, fixed->height);
+                for (int y = 0; y < fixed->height; ++y)
+                        for (int x = 0; x < fixed->width; ++x)
+                                EXPECT_NEAR(img1_->data.uc[y * img1_->row_stride + x],
+                                            fixed->data.uc[y * fixed->row_stride + x], 2);
+
+                nx_image_free(fixed);
+                nx_image_free(tmp);
+                nx_image_free(img0_);
+                nx_image_free(img1_);
+        }
+}
+
+static void smooth_x_reference(struct NXImage *img, float sigma)
+{
+        int nk = nx_kernel_size_gaussian(sigma, 4.0f);
+        float *kernel = new float[nk / 2 + 1];
+        float *buffer = new float[img->width + 2 * (nk / 2)];
+        nx_kernel_sym_gaussian(nk / 2 + 1, kernel, sigma);
+        for (int y = 0; y < img->height; ++y) {
+                float *row = img->data.f32 + y * img->row_stride;
+                nx_filter_copy_to_buffer1(img->width, buffer, row, nk / 2, NX_BORDER_REPEAT);
+                nx_convolve_sym(img->width, buffer, nk / 2 + 1, kernel);
+                memcpy(row, buffer, img->width * sizeof(float));
+        }
+        delete [] kernel;
+        delete [] buffer;
+}
+
+TEST_F(NXImageTest, ImageDownsampleAAMatchesSeparablePasses) {
+        const int SIZES[5][2] = { { 613, 71 }, { 40, 33 }, { 3, 5 }, { 128, 3 }, { 37, 258 } };
+        const enum NXImageDataType DTYPES[2] = { NX_IMAGE_UCHAR, NX_IMAGE_FLOAT32 };
+        for (int d = 0; d < 2; ++d) {
+                for (int s = 0; s < 5; ++s) {
+                        img0_ = nx_image_alloc();
+                        nx_image_resize(img0_, SIZES[s][0], SIZES[s][1], NX_IMAGE_STRIDE_PADDED,
+                                        NX_IMAGE_GRAYSCALE, DTYPES[d]);
+                        for (int y = 0; y < img0_->height; ++y) {
+                                for (int x = 0; x < img0_->width; ++x) {
+                                        int v = (x * 7919 + y * 104729) % 256;
+                                        if (DTYPES[d] == NX_IMAGE_UCHAR)
+                                                img0_->data.uc[y * img0_->row_stride + x] = v;
+                                        else
+                                                img0_->data.f32[y * img0_->row_stride + x] = v / 255.0f;
+                                }
+                        }
+
+                        struct NXImage *tmp = nx_image_alloc();
+                        struct NXImage *ref = nx_image_alloc();
+                        nx_image_downsample_aa_x(tmp, img0_);
+                        nx_image_downsample_aa_y(ref, tmp);
+
+                        img1_ = nx_image_alloc();
+                        nx_image_downsample_aa(img1_, img0_);
+                        ASSERT_EQ(ref->width, img1_->width);
+                        ASSERT_EQ(ref->height, img1_->height);
+                        ASSERT_EQ(DTYPES[d], img1_->dtype);
+
+                        size_t es = nx_image_bytes_per_channel(DTYPES[d]);
+                        for (int y = 0; y < ref->height; ++y)
+                                EXPECT_EQ(0, memcmp((const char *)ref->data.v + y * ref->row_stride * es,
+                                                    (const char *)img1_->data.v + y * img1_->row_stride * es,
+                                                    ref->width * es)) << SIZES[s][0] << "x" << SIZES[s][1] << ", row " << y;
+
+                        nx_image_free(tmp);
+                        nx_image_free(ref);
+                        nx_image_free(img0_);
+                        nx_image_free(img1_);
+                }
+        }
+}
+
+TEST_F(NXImageTest, ImageConvertDTypeSaturates) {
+        const float VALUES[6] = { -0.5f, 0.0f, 0.5f, 1.0f, 1.7f, 1e10f };
+        img0_ = nx_image_alloc();
+        nx_image_resize(img0_, 37, 3, NX_IMAGE_STRIDE_PADDED,
+                        NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+        for (int y = 0; y < img0_->height; ++y)
+                for (int x = 0; x < img0_->width; ++x)
+                        img0_->data.f32[y * img0_->row_stride + x] = VALUES[(x + y) % 6];
+
+        img1_ = nx_image_alloc();
+        nx_image_convert_dtype(img1_, img0_);
+        ASSERT_EQ(NX_IMAGE_UCHAR, img1_->dtype);
+        const int EXPECTED[6] = { 0, 0, 127, 255, 255, 255 };
+        for (int y = 0; y < img1_->height; ++y)
+                for (int x = 0; x < img1_->width; ++x)
+                        EXPECT_EQ(EXPECTED[(x + y) % 6], img1_->data.uc[y * img1_->row_stride + x]);
+
+        nx_image_free(img0_);
+        nx_image_free(img1_);
+}
+
+TEST_F(NXImageTest, ImageConvertTypeMatchesScalar) {
+        img0_ = nx_image_alloc();
+        nx_image_resize(img0_, 61, 7, NX_IMAGE_STRIDE_DEFAULT,
+                        NX_IMAGE_RGBA, NX_IMAGE_UCHAR);
+        for (int y = 0; y < img0_->height; ++y)
+                for (int x = 0; x < 4 * img0_->width; ++x)
+                        img0_->data.uc[y * img0_->row_stride + x] = (x * 7919 + y * 104729) % 256;
+
+        img1_ = nx_image_copy0(img0_);
+        nx_image_convert_type(img1_, NX_IMAGE_GRAYSCALE);
+        for (int y = 0; y < img1_->height; ++y) {
+                for (int x = 0; x < img1_->width; ++x) {
+                        const uchar *p = img0_->data.uc + y * img0_->row_stride + 4 * x;
+                        EXPECT_EQ(nx_rgb_to_gray_uc(p[0], p[1], p[2]),
+                                  img1_->data.uc[y * img1_->row_stride + x]);
+                }
+        }
+
+        struct NXImage *gray_f32 = nx_image_alloc();
+        struct NXImage *fused = nx_image_alloc();
+        nx_image_resize(gray_f32, img1_->width, img1_->height, NX_IMAGE_STRIDE_DEFAULT,
+                        NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+        nx_image_convert_dtype(gray_f32, img1_);
+        nx_image_convert_to_gray_f32(fused, img0_);
+        ASSERT_EQ(NX_IMAGE_GRAYSCALE, fused->type);
+        ASSERT_EQ(NX_IMAGE_FLOAT32, fused->dtype);
+        for (int y = 0; y < fused->height; ++y)
+                EXPECT_EQ(0, memcmp(gray_f32->data.f32 + y * gray_f32->row_stride,
+                                    fused->data.f32 + y * fused->row_stride,
+                                    fused->width * sizeof(float))) << "row " << y;
+
+        nx_image_convert_type(gray_f32, NX_IMAGE_RGBA);
+        for (int y = 0; y < gray_f32->height; ++y) {
+                for (int x = 0; x < gray_f32->width; ++x) {
+                        const float *p = gray_f32->data.f32 + y * gray_f32->row_stride + 4 * x;
+                        float v = fused->data.f32[y * fused->row_stride + x];
+                        EXPECT_EQ(v, p[0]);
+                        EXPECT_EQ(v, p[1]);
+                        EXPECT_EQ(v, p[2]);
+                        EXPECT_EQ(1.0f, p[3]);
+                }
+        }
+
+        nx_image_convert_type(gray_f32, NX_IMAGE_GRAYSCALE);
+        for (int y = 0; y < gray_f32->height; ++y)
+                for (int x = 0; x < gray_f32->width; ++x)
+                        EXPECT_FLOAT_EQ(fused->data.f32[y * fused->row_stride + x],
+                                        gray_f32->data.f32[y * gray_f32->row_stride + x]);
+
+        nx_image_convert_type(img1_, NX_IMAGE_RGBA);
+        for (int y = 0; y < img1_->height; ++y) {
+                for (int x = 0; x < img1_->width; ++x) {
+                        const uchar *p = img1_->data.uc + y * img1_->row_stride + 4 * x;
+                        EXPECT_EQ(p[0], p[1]);
+                        EXPECT_EQ(p[0], p[2]);
+                        EXPECT_EQ(255, p[3]);
+                }
+        }
+
+        nx_image_free(gray_f32);
+        nx_image_free(fused);
+        nx_image_free(img0_);
+        nx_image_free(img1_);
+}
+
+TEST_F(NXImageTest, ImageGradientPolarMatchesDerivatives) {
+        const enum NXImageDataType DTYPES[2] = { NX_IMAGE_UCHAR, NX_IMAGE_FLOAT32 };
+        for (int d = 0; d < 2; ++d) {
+                img0_ = nx_image_alloc();
+                nx_image_resize(img0_, 61, 37, NX_IMAGE_STRIDE_PADDED,
+                                NX_IMAGE_GRAYSCALE, DTYPES[d]);
+                for (int y = 0; y < img0_->height; ++y) {
+                        for (int x = 0; x < img0_->width; ++x) {
+                                int v = (x * 7919 + y * 104729) % 256;
+                                if (DTYPES[d] == NX_IMAGE_UCHAR)
+                                        img0_->data.uc[y * img0_->row_stride + x] = v;
+                                else
+                                        img0_->data.f32[y * img0_->row_stride + x] = v / 255.0f;
+                        }
+                }
+
+                struct NXImage *gx = nx_image_alloc();
+                struct NXImage *gy = nx_image_alloc();
+                struct NXImage *mag = nx_image_alloc();
+                struct NXImage *ori = nx_image_alloc();
+                nx_image_deriv_x(gx, img0_);
+                nx_image_deriv_y(gy, img0_);
+                nx_image_gradient_polar(mag, ori, img0_);
+                ASSERT_EQ(img0_->width, ori->width);
+                ASSERT_EQ(img0_->height, ori->height);
+
+                for (int y = 0; y < img0_->height; ++y) {
+                        for (int x = 0; x < img0_->width; ++x) {
+                                float dx = gx->data.f32[y * gx->row_stride + x];
+                                float dy = gy->data.f32[y * gy->row_stride + x];
+                                float m = mag->data.f32[y * mag->row_stride + x];
+                                float o = ori->data.f32[y * ori->row_stride + x];
+                                EXPECT_NEAR(sqrt(dx * dx + dy * dy), m, 1e-6 * (1.0 + m));
+                                EXPECT_GE(M_PI, fabs(o));
+                                if (dx != 0.0f || dy != 0.0f) {
+                                        double e = fabs(remainder(o - atan2(dy, dx), 2.0 * M_PI));
+                                        EXPECT_GT(2e-6, e) << x << ", " << y;
+                                }
+                        }
+                }
+
+                nx_image_free(gx);
+                nx_image_free(gy);
+                nx_image_free(mag);
+                nx_image_free(ori);
+                nx_image_free(img0_);
+        }
+}
+
+TEST_F(NXImageTest, ImageSmoothIIRCloseToFIR) {
+        const int SIZES[3][2] = { { 301, 157 }, { 40, 33 }, { 13, 90 } };
+        const float SIGMAS[3] = { 3.0f, 5.0f, 9.0f };
+        for (int s = 0; s < 3; ++s) {
+                img0_ = nx_image_alloc();
+                nx_image_resize(img0_, SIZES[s][0], SIZES[s][1], NX_IMAGE_STRIDE_PADDED,
+                                NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+                for (int y = 0; y < img0_->height; ++y)
+                        for (int x = 0; x < img0_->width; ++x)
+                                img0_->data.f32[y * img0_->row_stride + x] = ((x * 7919 + y * 104729) % 1009) / 1009.0f;
+
+                img1_ = nx_image_copy0(img0_);
+                smooth_x_reference(img1_, SIGMAS[s]);
+                smooth_y_reference(img1_, SIGMAS[2-s]);
+                nx_image_smooth(img0_, img0_, SIGMAS[s], SIGMAS[2-s], 4.0f, NULL);
+
+                double sum_sq = 0.0;
+                for (int y = 0; y < img0_->height; ++y) {
+                        for (int x = 0; x < img0_->width; ++x) {
+                                float e = img1_->data.f32[y * img1_->row_stride + x]
+                                        - img0_->data.f32[y * img0_->row_stride + x];
+                                EXPECT_GT(0.015f, fabs(e));
+                                sum_sq += e * e;
+                        }
+                }
+                EXPECT_GT(0.004, sqrt(sum_sq / (img0_->width * img0_->height)));
+
+                nx_image_free(img0_);
+                nx_image_free(img1_);
+        }
+}
+
+static const int N_PARALLEL_OPS = 13;
+
+static void run_parallel_ops(struct NXImage **out, const struct NXImage *img)
+{
+        nx_image_copy(out[0], img);
+        nx_image_smooth(out[0], out[0], 1.6f, 2.2f, 4.0f, NULL);
+        nx_image_smooth(out[1], img, 4.0f, 1.2f, 4.0f, NULL);
+        nx_image_smooth(out[2], img, 0.9f, 5.0f, 4.0f, NULL);
+        nx_image_filter_box(out[3], img, 4, 2);
+        nx_image_deriv_x(out[4], img);
+        nx_image_deriv_y(out[5], img);
+        nx_image_downsample_aa_x(out[6], img);
+        nx_image_downsample_aa_y(out[7], img);
+        nx_image_scale(out[8], img, 0.7f);
+        nx_image_convert_dtype(out[9], img);
+        nx_image_gradient_polar(out[10], out[11], img);
+        nx_image_subtract(out[12], img, out[1]);
+}
+
+TEST_F(NXImageTest, ImageParallelFiltersMatchSerial) {
+        const enum NXImageDataType DTYPES[2] = { NX_IMAGE_UCHAR, NX_IMAGE_FLOAT32 };
+        for (int d = 0; d < 2; ++d) {
+                img0_ = nx_image_alloc();
+                nx_image_resize(img0_, 613, 1037, NX_IMAGE_STRIDE_PADDED,
+                                NX_IMAGE_GRAYSCALE, DTYPES[d]);
+                for (int y = 0; y < img0_->height; ++y) {
+                        for (int x = 0; x < img0_->width; ++x) {
+                                int v = (x * 7919 + y * 104729) % 256;
+                                if (DTYPES[d] == NX_IMAGE_UCHAR)
+                                        img0_->data.uc[y * img0_->row_stride + x] = v;
+                                else
+                                        img0_->data.f32[y * img0_->row_stride + x] = v / 255.0f;
+                        }
+                }
+
+                struct NXImage *serial[N_PARALLEL_OPS];
+                struct NXImage *parallel[N_PARALLEL_OPS];
+                for (int i = 0; i < N_PARALLEL_OPS; ++i) {
+                        serial[i] = nx_image_alloc();
+                        parallel[i] = nx_image_alloc();
+                }
+
+                nx_thread_pool_set_default_n_workers(0);
+                nx_thread_pool_instance_free();
+                run_parallel_ops(serial, img0_);
+
+                nx_thread_pool_set_default_n_workers(4);
+                nx_thread_pool_instance_free();
+                run_parallel_ops(parallel, img0_);
+
+                nx_thread_pool_set_default_n_workers(-1);
+                nx_thread_pool_instance_free();
+
+                for (int i = 0; i < N_PARALLEL_OPS; ++i) {
+                        struct NXImage *a = serial[i];
+                        struct NXImage *b = parallel[i];
+                        ASSERT_EQ(a->width, b->width);
+                        ASSERT_EQ(a->height, b->height);
+                        ASSERT_EQ(a->dtype, b->dtype);
+                        size_t row_size = a->width * nx_image_bytes_per_channel(a->dtype);
+                        size_t es = nx_image_bytes_per_channel(a->dtype);
+                        for (int y = 0; y < a->height; ++y)
+                                EXPECT_EQ(0, memcmp((const char *)a->data.v + y * a->row_stride * es,
+                                                    (const char *)b->data.v + y * b->row_stride * es,
+                                                    row_size)) << "operation " << i << ", row " << y;
+                        nx_image_free(a);
+                        nx_image_free(b);
+                }
+
+                nx_image_free(img0_);
+        }
+}
+
 TEST_F(NXImageTest, ImageGrayUCFilterBox) {
         img0_ = nx_image_new_gray_uc(NX, NY);
         memcpy(img0_->data.uc, TEST_IMAGE_DATA, sizeof(TEST_IMAGE_DATA));
         img1_ = nx_image_alloc();
-        nx_image_filter_box(img1_, img0_, 3, 3, NULL);
+        nx_image_filter_box(img1_, img0_, 3, 3);
         nx_image_free(img0_);
         nx_image_free(img1_);
 }
 
+TEST_F(NXImageTest, ImagePaddedStride) {
+        img0_ = nx_image_alloc();
+        nx_image_resize(img0_, 13, 5, NX_IMAGE_STRIDE_PADDED,
+                        NX_IMAGE_GRAYSCALE, NX_IMAGE_FLOAT32);
+        EXPECT_EQ(13, img0_->width);
+        EXPECT_GE(img0_->row_stride, 13);
+        EXPECT_EQ(0U, img0_->row_stride * sizeof(float) % NX_SIMD_ALIGNMENT);
+        for (int y = 0; y < img0_->height; ++y) {
+                const float *row = img0_->data.f32 + y * img0_->row_stride;
+                EXPECT_EQ(0U, reinterpret_cast<size_t>(row) % NX_SIMD_ALIGNMENT);
+        }
+
+        nx_image_resize(img0_, 7, 3, NX_IMAGE_STRIDE_PADDED,
+                        NX_IMAGE_RGBA, NX_IMAGE_UCHAR);
+        EXPECT_EQ(0, img0_->row_stride % NX_SIMD_ALIGNMENT);
+        EXPECT_GE(img0_->row_stride, 7*4);
+        nx_image_free(img0_);
+}
+
 
 
 
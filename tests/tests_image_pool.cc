@@ -0,0 +1,135 @@
+/**
+ * @file tests_image_pool.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_mem_block.h"
+#include "virg/nexus/nx_image.h"
+#include "virg/nexus/nx_image_pool.h"
+
+using namespace std;
+
+namespace {
+
+static const size_t TEST_POOL_CAPACITY = 16 * 1024 * 1024;
+
+class NXImagePoolTest : public ::testing::Test {
+protected:
+        NXImagePoolTest()
+                {
+                }
+
+        virtual void SetUp()
+                {
+                        nx_image_pool_set_capacity(TEST_POOL_CAPACITY);
+                        nx_image_pool_get_stats(&stats0_);
+                }
+
+        virtual void TearDown()
+                {
+                        nx_image_pool_set_capacity(0);
+                }
+
+        struct NXImagePoolStats stats0_;
+};
+
+TEST_F(NXImagePoolTest, DisabledByDefaultAfterReset) {
+        nx_image_pool_set_capacity(0);
+        EXPECT_FALSE(nx_image_pool_is_enabled());
+        struct NXImagePoolStats stats;
+        nx_image_pool_get_stats(&stats);
+        EXPECT_EQ(0U, stats.n_cached);
+        EXPECT_EQ(0U, stats.cached_bytes);
+}
+
+TEST_F(NXImagePoolTest, CheckoutCapacity) {
+        size_t capacity = 0;
+        void *ptr = nx_image_pool_checkout(100000, &capacity);
+        EXPECT_TRUE(NULL != ptr);
+        EXPECT_GE(capacity, 100000U);
+        EXPECT_LT(capacity, 125000U);
+        EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(ptr) % NX_SIMD_ALIGNMENT);
+        nx_image_pool_return(ptr, capacity);
+
+        size_t capacity2 = 0;
+        void *ptr2 = nx_image_pool_checkout(99000, &capacity2);
+        EXPECT_EQ(ptr, ptr2);
+        EXPECT_EQ(capacity, capacity2);
+        nx_free(ptr2);
+}
+
+TEST_F(NXImagePoolTest, ImageReuse) {
+        struct NXImage *img0 = nx_image_new_gray_f32(640, 480);
+        void *data0 = img0->data.v;
+        nx_image_free(img0);
+
+        struct NXImage *img1 = nx_image_new_gray_uc(1280, 960);
+        EXPECT_EQ(data0, img1->data.v);
+        EXPECT_EQ(1280*960, static_cast<int>(img1->mem->size));
+
+        struct NXImagePoolStats stats;
+        nx_image_pool_get_stats(&stats);
+        EXPECT_EQ(stats0_.n_hits + 1, stats.n_hits);
+        nx_image_free(img1);
+}
+
+TEST_F(NXImagePoolTest, ReleaseReturns) {
+        struct NXImage *img = nx_image_new_gray_uc(512, 512);
+        nx_image_release(img);
+        EXPECT_EQ(NULL, img->data.v);
+
+        struct NXImagePoolStats stats;
+        nx_image_pool_get_stats(&stats);
+        EXPECT_EQ(stats0_.n_returns + 1, stats.n_returns);
+        EXPECT_EQ(stats0_.n_cached + 1, stats.n_cached);
+
+        nx_image_resize(img, 512, 512, NX_IMAGE_STRIDE_DEFAULT,
+                        NX_IMAGE_GRAYSCALE, NX_IMAGE_UCHAR);
+        nx_image_pool_get_stats(&stats);
+        EXPECT_EQ(stats0_.n_cached, stats.n_cached);
+        nx_image_free(img);
+}
+
+TEST_F(NXImagePoolTest, CapacityLimit) {
+        nx_image_pool_set_capacity(1024*1024);
+        struct NXImage *img0 = nx_image_new_gray_uc(800, 800);
+        struct NXImage *img1 = nx_image_new_gray_uc(800, 800);
+        nx_image_free(img0);
+        nx_image_free(img1);
+
+        struct NXImagePoolStats stats;
+        nx_image_pool_get_stats(&stats);
+        EXPECT_LE(stats.cached_bytes, 1024U*1024U);
+        EXPECT_EQ(1U, stats.n_cached);
+        EXPECT_EQ(stats0_.n_evictions + 1, stats.n_evictions);
+}
+
+} // namespace
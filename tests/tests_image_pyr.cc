@@ -196,6 +196,42 @@ TEST_F(NXImagePyrTest, ImagePyrComputeFastLena) {
         nx_image_pyr_builder_free(builder0_);
 }
 
+TEST_F(NXImagePyrTest, ImagePyrComputeFastLenaFixedPoint) {
+        builder0_ = nx_image_pyr_builder_new_fast(TEST_N_LEVELS, TEST_SIGMA0);
+        nx_image_pyr_builder_set_engine(builder0_, NX_IMAGE_PYR_ENGINE_FIXED_POINT);
+        pyr0_ = nx_image_pyr_builder_build0(builder0_, lena_);
+
+        // Same steps as the fast builder in float, without the rounding to uchar
+        struct NXImage *ref = nx_image_new_gray_f32(lena_->width, lena_->height);
+        struct NXImage *tmp = nx_image_alloc();
+        for (int y = 0; y < lena_->height; ++y)
+                for (int x = 0; x < lena_->width; ++x)
+                        ref->data.f32[y * ref->row_stride + x] = lena_->data.uc[y * lena_->row_stride + x];
+        float sigma_g = sqrt(TEST_SIGMA0 * TEST_SIGMA0
+                             - NX_IMAGE_PYR_BUILDER_INITIAL_SIGMA * NX_IMAGE_PYR_BUILDER_INITIAL_SIGMA);
+        nx_image_smooth(ref, ref, sigma_g, sigma_g, 4.0f, NULL);
+
+        for (int i = 0; i < TEST_N_LEVELS; ++i) {
+                if (i > 0) {
+                        nx_image_downsample_aa_x(tmp, ref);
+                        nx_image_downsample_aa_y(ref, tmp);
+                }
+
+                const struct NXImage *img = pyr0_->levels[i].img;
+                EXPECT_EQ(ref->width, img->width);
+                EXPECT_EQ(ref->height, img->height);
+                for (int y = 0; y < img->height; ++y)
+                        for (int x = 0; x < img->width; ++x)
+                                EXPECT_NEAR(ref->data.f32[y * ref->row_stride + x],
+                                            img->data.uc[y * img->row_stride + x], 1.5f);
+        }
+
+        nx_image_free(tmp);
+        nx_image_free(ref);
+        nx_image_pyr_free(pyr0_);
+        nx_image_pyr_builder_free(builder0_);
+}
+
 TEST_F(NXImagePyrTest, ImagePyrComputeFineLena) {
         builder0_ = nx_image_pyr_builder_new_fine(TEST_OCTAVES, TEST_STEPS, TEST_SIGMA0);
         pyr0_ = nx_image_pyr_builder_build0(builder0_, lena_);
@@ -0,0 +1,200 @@
+/**
+ * @file tests_integral_image.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_image.h"
+#include "virg/nexus/nx_integral_image.h"
+
+using namespace std;
+
+namespace {
+
+class NXIntegralImageTest : public ::testing::Test {
+protected:
+        NXIntegralImageTest()
+                {
+                }
+
+        virtual void SetUp()
+                {
+                        img_ = nx_image_alloc();
+                        ii_ = nx_integral_image_alloc();
+                }
+
+        virtual void TearDown()
+                {
+                        nx_integral_image_free(ii_);
+                        nx_image_free(img_);
+                }
+
+        void fill(int width, int height, enum NXImageDataType dtype)
+                {
+                        nx_image_resize(img_, width, height, NX_IMAGE_STRIDE_PADDED,
+                                        NX_IMAGE_GRAYSCALE, dtype);
+                        for (int y = 0; y < height; ++y) {
+                                for (int x = 0; x < width; ++x) {
+                                        int v = (x * 7919 + y * 104729 + x * y) % 256;
+                                        if (dtype == NX_IMAGE_UCHAR)
+                                                img_->data.uc[y * img_->row_stride + x] = (uchar)v;
+                                        else
+                                                img_->data.f32[y * img_->row_stride + x] = v / 255.0f;
+                                }
+                        }
+                }
+
+        // Pixel of the image extended by pad repeated pixels and zeros beyond
+        double pixel(int x, int y, int pad) const
+                {
+                        if (x < -pad || x >= img_->width + pad || y < -pad || y >= img_->height + pad)
+                                return 0.0;
+                        x = x < 0 ? 0 : (x >= img_->width ? img_->width - 1 : x);
+                        y = y < 0 ? 0 : (y >= img_->height ? img_->height - 1 : y);
+                        if (img_->dtype == NX_IMAGE_UCHAR)
+                                return img_->data.uc[y * img_->row_stride + x];
+                        else
+                                return img_->data.f32[y * img_->row_stride + x];
+                }
+
+        double box_sum(int x0, int y0, int x1, int y1, int pad) const
+                {
+                        double sum = 0.0;
+                        for (int y = y0; y <= y1; ++y)
+                                for (int x = x0; x <= x1; ++x)
+                                        sum += pixel(x, y, pad);
+                        return sum;
+                }
+
+        double rotated_box_sum(int x, int y, int r_diag, int r_anti, int pad) const
+                {
+                        double sum = 0.0;
+                        int r = r_diag + r_anti;
+                        for (int v = -r; v <= r; ++v)
+                                for (int u = -r; u <= r; ++u)
+                                        if (abs(u + v) <= 2 * r_diag && abs(u - v) <= 2 * r_anti)
+                                                sum += pixel(x + u, y + v, pad);
+                        return sum;
+                }
+
+        struct NXImage *img_;
+        struct NXIntegralImage *ii_;
+};
+
+TEST_F(NXIntegralImageTest, BoxSum) {
+        const enum NXImageDataType DTYPES[2] = { NX_IMAGE_UCHAR, NX_IMAGE_FLOAT32 };
+        const int PAD = 3;
+        for (int d = 0; d < 2; ++d) {
+                fill(37, 21, DTYPES[d]);
+                nx_integral_image_compute(ii_, img_, PAD);
+                EXPECT_FALSE(ii_->rotated);
+                for (int y0 = -PAD - 1; y0 < img_->height + PAD; y0 += 4) {
+                        for (int x0 = -PAD - 1; x0 < img_->width + PAD; x0 += 3) {
+                                for (int h = 0; h < 8; h += 3) {
+                                        for (int w = 0; w < 9; w += 4) {
+                                                double sum = nx_integral_image_box_sum(ii_, x0, y0, x0 + w, y0 + h);
+                                                EXPECT_NEAR(box_sum(x0, y0, x0 + w, y0 + h, PAD), sum, 1e-9);
+                                        }
+                                }
+                        }
+                }
+        }
+}
+
+TEST_F(NXIntegralImageTest, RotatedBoxSum) {
+        const enum NXImageDataType DTYPES[2] = { NX_IMAGE_UCHAR, NX_IMAGE_FLOAT32 };
+        const int PAD = 4;
+        for (int d = 0; d < 2; ++d) {
+                fill(29, 18, DTYPES[d]);
+                nx_integral_image_compute_rotated(ii_, img_, PAD);
+                EXPECT_TRUE(ii_->rotated);
+                for (int y = -2; y < img_->height + 2; y += 3) {
+                        for (int x = -2; x < img_->width + 2; x += 2) {
+                                for (int ra = 0; ra < 4; ++ra) {
+                                        for (int rb = 0; rb < 4; ++rb) {
+                                                double sum = nx_integral_image_rotated_box_sum(ii_, x, y, ra, rb);
+                                                EXPECT_NEAR(rotated_box_sum(x, y, ra, rb, PAD), sum, 1e-9);
+                                        }
+                                }
+                        }
+                }
+        }
+}
+
+TEST_F(NXIntegralImageTest, BoxFilter) {
+        const int SIZES[3][2] = { { 101, 33 }, { 5, 40 }, { 1, 1 } };
+        const int RADII[3][2] = { { 2, 1 }, { 0, 6 }, { 3, 3 } };
+        for (int s = 0; s < 3; ++s) {
+                const int rx = RADII[s][0];
+                const int ry = RADII[s][1];
+                const int pad = rx > ry ? rx : ry;
+                const double area = (2 * rx + 1) * (2 * ry + 1);
+
+                struct NXImage *res = nx_image_alloc();
+                fill(SIZES[s][0], SIZES[s][1], NX_IMAGE_UCHAR);
+                nx_integral_image_compute(ii_, img_, pad);
+                nx_integral_image_box_filter(res, ii_, rx, ry);
+                ASSERT_EQ(NX_IMAGE_UCHAR, res->dtype);
+                for (int y = 0; y < img_->height; ++y)
+                        for (int x = 0; x < img_->width; ++x)
+                                EXPECT_EQ((int)(box_sum(x - rx, y - ry, x + rx, y + ry, pad) / area),
+                                          res->data.uc[y * res->row_stride + x]);
+
+                fill(SIZES[s][0], SIZES[s][1], NX_IMAGE_FLOAT32);
+                nx_integral_image_compute(ii_, img_, pad);
+                nx_integral_image_box_filter(res, ii_, rx, ry);
+                ASSERT_EQ(NX_IMAGE_FLOAT32, res->dtype);
+                for (int y = 0; y < img_->height; ++y)
+                        for (int x = 0; x < img_->width; ++x)
+                                EXPECT_NEAR(box_sum(x - rx, y - ry, x + rx, y + ry, pad) / area,
+                                            res->data.f32[y * res->row_stride + x], 1e-6);
+                nx_image_free(res);
+        }
+}
+
+TEST_F(NXIntegralImageTest, RotatedBoxFilter) {
+        const int RADII[3][2] = { { 3, 0 }, { 0, 2 }, { 2, 1 } };
+        struct NXImage *res = nx_image_alloc();
+        fill(23, 17, NX_IMAGE_UCHAR);
+        for (int s = 0; s < 3; ++s) {
+                const int ra = RADII[s][0];
+                const int rb = RADII[s][1];
+                const double area = (2 * ra + 1) * (2 * rb + 1) + 4 * ra * rb;
+                nx_integral_image_compute_rotated(ii_, img_, ra + rb);
+                nx_integral_image_rotated_box_filter(res, ii_, ra, rb);
+                for (int y = 0; y < img_->height; ++y)
+                        for (int x = 0; x < img_->width; ++x)
+                                EXPECT_EQ((int)(rotated_box_sum(x, y, ra, rb, ra + rb) / area),
+                                          res->data.uc[y * res->row_stride + x]);
+        }
+        nx_image_free(res);
+}
+
+} // namespace
@@ -0,0 +1,173 @@
+/**
+ * @file tests_log.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#define NX_ENABLE_JLOG 1
+#include "virg/nexus/nx_log.h"
+#include "virg/nexus/nx_json_log.h"
+#include "virg/nexus/nx_json_bundle.h"
+
+using namespace std;
+
+namespace {
+
+static const int N_THREADS = 4;
+static const int N_RECORDS = 200;
+
+static void log_records(int thread_id)
+{
+        for (int i = 0; i < N_RECORDS; ++i)
+                NX_LOG("TEST", "thread %d record %d", thread_id, i);
+}
+
+static int count_lines(FILE *stream)
+{
+        rewind(stream);
+        int n = 0;
+        int c;
+        while ((c = fgetc(stream)) != EOF)
+                n += (c == '\n');
+        return n;
+}
+
+class NXLogTest : public ::testing::Test {
+protected:
+        NXLogTest()
+                {
+                        stream_ = NULL;
+                }
+
+        virtual void SetUp()
+                {
+                        stream_ = tmpfile();
+                        ASSERT_TRUE(stream_ != NULL);
+                        nx_log_stream(stream_);
+                }
+
+        virtual void TearDown()
+                {
+                        nx_log_async_stop();
+                        nx_log_stream(NULL);
+                        fclose(stream_);
+                }
+
+        FILE *stream_;
+};
+
+TEST_F(NXLogTest, SyncWritesImmediately) {
+        EXPECT_FALSE(nx_log_async_is_running());
+        NX_LOG("TEST", "synchronous %d", 1);
+        EXPECT_EQ(1, count_lines(stream_));
+}
+
+TEST_F(NXLogTest, AsyncWritesAllRecords) {
+        nx_log_async_start(N_THREADS * N_RECORDS);
+        EXPECT_TRUE(nx_log_async_is_running());
+
+        vector<thread> threads;
+        for (int i = 0; i < N_THREADS; ++i)
+                threads.push_back(thread(log_records, i));
+        for (int i = 0; i < N_THREADS; ++i)
+                threads[i].join();
+
+        nx_log_async_flush();
+        EXPECT_EQ(0u, nx_log_async_n_dropped());
+        EXPECT_EQ(N_THREADS * N_RECORDS, count_lines(stream_));
+
+        nx_log_async_stop();
+        EXPECT_FALSE(nx_log_async_is_running());
+}
+
+TEST_F(NXLogTest, AsyncDropsWhenFull) {
+        nx_log_async_start(2);
+
+        vector<thread> threads;
+        for (int i = 0; i < N_THREADS; ++i)
+                threads.push_back(thread(log_records, i));
+        for (int i = 0; i < N_THREADS; ++i)
+                threads[i].join();
+
+        nx_log_async_flush();
+        int n_written = count_lines(stream_);
+        EXPECT_EQ(N_THREADS * N_RECORDS, n_written + (int)nx_log_async_n_dropped());
+}
+
+TEST_F(NXLogTest, AsyncTruncatesLongRecords) {
+        nx_log_async_start(16);
+
+        char text[2 * NX_LOG_ASYNC_TEXT_LENGTH];
+        memset(text, 'x', sizeof(text) - 1);
+        text[sizeof(text) - 1] = '\0';
+        NX_LOG("TEST", "%s", text);
+        nx_log_async_flush();
+
+        rewind(stream_);
+        char line[4 * NX_LOG_ASYNC_TEXT_LENGTH];
+        ASSERT_TRUE(fgets(line, sizeof(line), stream_) != NULL);
+        EXPECT_EQ(NX_LOG_ASYNC_TEXT_LENGTH - 1, (int)(strrchr(line, 'x') - strchr(line, 'x') + 1));
+}
+
+static void jlog_records(int thread_id)
+{
+        NX_JLOG_ADDI(0, "values", thread_id);
+        NX_JLOG_ADDI(0, "values", thread_id);
+}
+
+TEST(NXJSONLog, MergeThreadStreams) {
+        NX_JLOG_CLEAR_ALL();
+        NX_JLOG_ADDI(0, "values", -1);
+
+        vector<thread> threads;
+        for (int i = 0; i < N_THREADS; ++i)
+                threads.push_back(thread(jlog_records, i));
+        for (int i = 0; i < N_THREADS; ++i)
+                threads[i].join();
+
+        struct NXJSONNode *stream = nx_json_log_merge_stream(0);
+        struct NXJSONNode *values = nx_json_object_get(stream, "values", NX_JNT_ARRAY);
+        ASSERT_TRUE(values != NULL);
+        EXPECT_EQ(1 + 2 * N_THREADS, nx_json_node_n_children(values));
+
+        vector<int> counts(N_THREADS, 0);
+        for (int i = 1; i < nx_json_node_n_children(values); ++i)
+                counts[atoi(nx_json_node_text(nx_json_array_get(values, i, NX_JNT_INTEGER)))]++;
+        for (int i = 0; i < N_THREADS; ++i)
+                EXPECT_EQ(2, counts[i]);
+
+        /* Merging again does not duplicate records */
+        stream = nx_json_log_merge_stream(0);
+        EXPECT_EQ(1 + 2 * N_THREADS, nx_json_node_n_children(nx_json_object_get(stream, "values", NX_JNT_ARRAY)));
+
+        NX_JLOG_CLEAR_ALL();
+}
+
+} // namespace
@@ -27,6 +27,8 @@
 
 #include "virg/nexus/nx_options.h"
 #include "virg/nexus/nx_log.h"
+#include "virg/nexus/nx_arena.h"
+#include "virg/nexus/nx_thread_pool.h"
 
 bool IS_VALGRIND_RUN = false;
 
@@ -46,5 +48,10 @@ int main(int argc, char** argv)
 
         nx_options_free(opt);
 
-        return RUN_ALL_TESTS();
+        int result = RUN_ALL_TESTS();
+
+        nx_thread_pool_instance_free();
+        nx_arena_instance_free();
+
+        return result;
 }
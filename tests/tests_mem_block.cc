@@ -208,4 +208,48 @@ TEST_F(NXMemBlockTest, CopyOfWrapped) {
         }
 }
 
+TEST_F(NXMemBlockTest, AlignedResize) {
+        const size_t alignment = 64;
+        struct NXMemBlock *m = nx_mem_block_alloc_aligned(alignment);
+        nx_mem_block_resize(m, N_TEST_DATA*sizeof(char));
+        EXPECT_EQ((size_t)N_TEST_DATA, m->size);
+        EXPECT_EQ(0U, m->capacity % alignment);
+        EXPECT_EQ(0U, reinterpret_cast<size_t>(m->ptr) % alignment);
+        memcpy(m->ptr, TEST_GROUND_TRUTH, N_TEST_DATA);
+
+        nx_mem_block_resize(m, 3*alignment + 1);
+        EXPECT_EQ(0U, m->capacity % alignment);
+        EXPECT_EQ(0U, reinterpret_cast<size_t>(m->ptr) % alignment);
+        for (int i = 0; i < N_TEST_DATA; ++i ) {
+                EXPECT_EQ(TEST_GROUND_TRUTH[i], reinterpret_cast<char *>(m->ptr)[i]);
+        }
+        nx_mem_block_free(m);
+}
+
+TEST_F(NXMemBlockTest, AlignedCopyOfWrapped) {
+        const size_t alignment = 64;
+        struct NXMemBlock *m = nx_mem_block_alloc_aligned(alignment);
+        nx_mem_block_copy(m, m1_);
+        EXPECT_TRUE(m->own_memory);
+        EXPECT_EQ(0U, reinterpret_cast<size_t>(m->ptr) % alignment);
+        for (int i = 0; i < N_TEST_DATA; ++i ) {
+                EXPECT_EQ(TEST_GROUND_TRUTH[i], reinterpret_cast<char *>(m->ptr)[i]);
+        }
+        nx_mem_block_free(m);
+}
+
+TEST_F(NXMemBlockTest, Copy0KeepsAlignment) {
+        const size_t alignment = 64;
+        struct NXMemBlock *m = nx_mem_block_alloc_aligned(alignment);
+        nx_mem_block_copy(m, m1_);
+        struct NXMemBlock *c = nx_mem_block_copy0(m);
+        EXPECT_EQ(alignment, c->alignment);
+        EXPECT_EQ(0U, reinterpret_cast<size_t>(c->ptr) % alignment);
+        for (int i = 0; i < N_TEST_DATA; ++i ) {
+                EXPECT_EQ(TEST_GROUND_TRUTH[i], reinterpret_cast<char *>(c->ptr)[i]);
+        }
+        nx_mem_block_free(c);
+        nx_mem_block_free(m);
+}
+
 } // namespace
@@ -0,0 +1,308 @@
+/**
+ * @file tests_sift_detector.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "test_data.hh"
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_string.h"
+#include "virg/nexus/nx_image.h"
+#include "virg/nexus/nx_image_io.h"
+#include "virg/nexus/nx_thread_pool.h"
+#include "virg/nexus/nx_sift_detector.h"
+
+namespace {
+
+class NXSIFTDetectorTest : public ::testing::Test {
+protected:
+        NXSIFTDetectorTest() {
+                lena_ = NULL;
+                det_ = NULL;
+        }
+
+        virtual void SetUp() {
+                lena_ = nx_image_alloc();
+                nx_image_xload_pnm(lena_, TEST_DATA_LENA_PPM, NX_IMAGE_LOAD_GRAYSCALE);
+
+                struct NXSIFTDetectorParams param = nx_sift_default_parameters();
+                param.double_image = NX_FALSE;
+                det_ = nx_sift_detector_new(param);
+        }
+
+        virtual void TearDown() {
+                nx_sift_detector_free(det_);
+                nx_image_free(lena_);
+        }
+
+        int compute_with_n_workers(int n_workers, struct NXKeypoint **keys,
+                                   uchar **desc) {
+                nx_thread_pool_set_default_n_workers(n_workers);
+                nx_thread_pool_instance_free();
+
+                int max_n_keys = 0;
+                *keys = NULL;
+                *desc = NULL;
+                int n = nx_sift_detector_compute(det_, lena_, &max_n_keys, keys, desc);
+                EXPECT_GE(max_n_keys, n);
+
+                nx_thread_pool_set_default_n_workers(-1);
+                nx_thread_pool_instance_free();
+                return n;
+        }
+
+        int compute_with_budget(int key_budget, struct NXKeypoint **keys,
+                                uchar **desc) {
+                struct NXSIFTDetectorParams param = nx_sift_default_parameters();
+                param.double_image = NX_FALSE;
+                param.key_budget = key_budget;
+                struct NXSIFTDetector *det = nx_sift_detector_new(param);
+
+                int max_n_keys = 0;
+                *keys = NULL;
+                *desc = NULL;
+                int n = nx_sift_detector_compute(det, lena_, &max_n_keys, keys, desc);
+                nx_sift_detector_free(det);
+                return n;
+        }
+
+        struct NXImage *lena_;
+        struct NXSIFTDetector *det_;
+};
+
+TEST_F(NXSIFTDetectorTest, SIFTDetectorParallelMatchesSerial) {
+        struct NXKeypoint *keys0;
+        uchar *desc0;
+        int n0 = compute_with_n_workers(0, &keys0, &desc0);
+        EXPECT_LT(0, n0);
+        for (int i = 0; i < n0; ++i)
+                EXPECT_EQ((uint64_t)i, keys0[i].id);
+
+        struct NXKeypoint *keys;
+        uchar *desc;
+        int n = compute_with_n_workers(4, &keys, &desc);
+        ASSERT_EQ(n0, n);
+        for (int i = 0; i < n; ++i) {
+                EXPECT_EQ(keys0[i].xs, keys[i].xs);
+                EXPECT_EQ(keys0[i].ys, keys[i].ys);
+                EXPECT_EQ(keys0[i].level, keys[i].level);
+                EXPECT_EQ(keys0[i].sigma, keys[i].sigma);
+                EXPECT_EQ(keys0[i].score, keys[i].score);
+                EXPECT_EQ(keys0[i].ori, keys[i].ori);
+                EXPECT_EQ(keys0[i].id, keys[i].id);
+        }
+        EXPECT_EQ(0, memcmp(desc0, desc, n * NX_SIFT_DESC_DIM * sizeof(uchar)));
+
+        nx_free(keys0);
+        nx_free(desc0);
+        nx_free(keys);
+        nx_free(desc);
+}
+
+TEST_F(NXSIFTDetectorTest, SIFTDetectorKeyBudget) {
+        struct NXKeypoint *keys0;
+        uchar *desc0;
+        int n0 = compute_with_budget(0, &keys0, &desc0);
+        ASSERT_LT(200, n0);
+
+        // a budget above the number of keys changes nothing
+        struct NXKeypoint *keys;
+        uchar *desc;
+        int n = compute_with_budget(n0 + 100, &keys, &desc);
+        ASSERT_EQ(n0, n);
+        EXPECT_EQ(0, memcmp(desc0, desc, n * NX_SIFT_DESC_DIM * sizeof(uchar)));
+        nx_free(keys);
+        nx_free(desc);
+
+        // budgeted keys are a subset of all keys
+        const int KEY_BUDGET = 200;
+        n = compute_with_budget(KEY_BUDGET, &keys, &desc);
+        ASSERT_EQ(KEY_BUDGET, n);
+        int j = 0;
+        for (int i = 0; i < n; ++i) {
+                EXPECT_EQ((uint64_t)i, keys[i].id);
+                while (j < n0 && (keys0[j].xs != keys[i].xs || keys0[j].ys != keys[i].ys
+                                  || keys0[j].level != keys[i].level
+                                  || keys0[j].ori != keys[i].ori))
+                        ++j;
+                ASSERT_LT(j, n0) << "key " << i << " is not in the full set";
+                EXPECT_EQ(0, memcmp(desc0 + j * NX_SIFT_DESC_DIM,
+                                    desc + i * NX_SIFT_DESC_DIM,
+                                    NX_SIFT_DESC_DIM * sizeof(uchar)));
+        }
+
+        nx_free(keys0);
+        nx_free(desc0);
+        nx_free(keys);
+        nx_free(desc);
+}
+
+TEST_F(NXSIFTDetectorTest, SIFTDetectorRegion) {
+        int max_n_keys0 = 0;
+        struct NXKeypoint *keys0 = NULL;
+        uchar *desc0 = NULL;
+        int n0 = nx_sift_detector_compute(det_, lena_, &max_n_keys0, &keys0, &desc0);
+
+        struct NXImageRegion region;
+        nx_image_region_init(&region, 128, 128, 256, 256, NULL);
+        int max_n_keys = 0;
+        struct NXKeypoint *keys = NULL;
+        uchar *desc = NULL;
+        int n = nx_sift_detector_compute_region(det_, lena_, &region, &max_n_keys, &keys, &desc);
+        ASSERT_LT(0, n);
+        EXPECT_GT(n0, n);
+        for (int i = 0; i < n; ++i) {
+                EXPECT_TRUE(nx_image_region_contains(&region, nx_keypoint_xs0(keys + i),
+                                                     nx_keypoint_ys0(keys + i)));
+                EXPECT_EQ((uint64_t)i, keys[i].id);
+        }
+
+        // keys of the first octaves away from the boundary are found again,
+        // blurs of the crop can differ from the whole image in the last bits
+        const float INNER = 24.0f;
+        int n_inner = 0;
+        for (int i = 0; i < n0; ++i) {
+                float x = nx_keypoint_xs0(keys0 + i);
+                float y = nx_keypoint_ys0(keys0 + i);
+                if (keys0[i].level > 1
+                    || x < region.x + INNER || x >= region.x + region.width - INNER
+                    || y < region.y + INNER || y >= region.y + region.height - INNER)
+                        continue;
+
+                // descriptors are sampled around the rounded position, which
+                // can go either way for positions half way between pixels
+                float fx = keys0[i].xs - floorf(keys0[i].xs);
+                float fy = keys0[i].ys - floorf(keys0[i].ys);
+                if (fabsf(fx - 0.5f) < 1e-3f || fabsf(fy - 0.5f) < 1e-3f)
+                        continue;
+
+                // take the closest of the keys at the same position
+                ++n_inner;
+                int min_dist = -1;
+                for (int j = 0; j < n; ++j) {
+                        if (keys[j].level != keys0[i].level
+                            || fabsf(keys[j].xs - keys0[i].xs) > 1e-2f
+                            || fabsf(keys[j].ys - keys0[i].ys) > 1e-2f
+                            || fabsf(keys[j].sigma - keys0[i].sigma) > 1e-3f
+                            || fabsf(keys[j].ori - keys0[i].ori) > 1e-3f)
+                                continue;
+                        int dist = 0;
+                        for (int d = 0; d < NX_SIFT_DESC_DIM; ++d)
+                                dist += abs(desc0[i * NX_SIFT_DESC_DIM + d] - desc[j * NX_SIFT_DESC_DIM + d]);
+                        if (min_dist < 0 || dist < min_dist)
+                                min_dist = dist;
+                }
+                ASSERT_LE(0, min_dist) << "key " << i << " is not found in the region";
+                EXPECT_GE(24, min_dist);
+        }
+        EXPECT_LT(0, n_inner);
+
+        // peaks on invalid mask pixels are dropped
+        struct NXImage *mask = nx_image_new_gray_uc(lena_->width, lena_->height);
+        for (int y = 0; y < mask->height; ++y)
+                for (int x = 0; x < mask->width; ++x)
+                        mask->data.uc[y * mask->row_stride + x] = ((x / 64 + y / 64) % 2) ? 255 : 0;
+        nx_image_region_init(&region, 0, 0, lena_->width, lena_->height, mask);
+        n = nx_sift_detector_compute_region(det_, lena_, &region, &max_n_keys, &keys, &desc);
+        ASSERT_LT(0, n);
+        for (int i = 0; i < n; ++i)
+                EXPECT_TRUE(nx_image_region_contains(&region, nx_keypoint_xs0(keys + i),
+                                                     nx_keypoint_ys0(keys + i)));
+
+        nx_image_free(mask);
+        nx_free(keys0);
+        nx_free(desc0);
+        nx_free(keys);
+        nx_free(desc);
+}
+
+TEST_F(NXSIFTDetectorTest, SIFTDetectorCache) {
+        char dir[] = "/tmp/nx_sift_cache_test_XXXXXX";
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+
+        int max_n_keys0 = 0;
+        struct NXKeypoint *keys0 = NULL;
+        uchar *desc0 = NULL;
+        int n0 = nx_sift_detector_compute(det_, lena_, &max_n_keys0, &keys0, &desc0);
+
+        // The last pass cannot create its cache and computes without it
+        for (int t = 0; t < 3; ++t) {
+                const char *cache_dir = t < 2 ? dir : "/dev/null/nx_sift_cache";
+                int max_n_keys = 0;
+                struct NXKeypoint *keys = NULL;
+                uchar *desc = NULL;
+                int n = nx_sift_detector_compute_with_cache(det_, lena_, &max_n_keys,
+                                                            &keys, &desc, cache_dir);
+                ASSERT_EQ(n0, n);
+                for (int i = 0; i < n; ++i) {
+                        EXPECT_EQ(keys0[i].xs, keys[i].xs);
+                        EXPECT_EQ(keys0[i].ys, keys[i].ys);
+                        EXPECT_EQ(keys0[i].sigma, keys[i].sigma);
+                        EXPECT_EQ(keys0[i].ori, keys[i].ori);
+                }
+                EXPECT_EQ(0, memcmp(desc0, desc, n * NX_SIFT_DESC_DIM));
+
+                struct NXPointMatch2D *corr = NX_NEW(n, struct NXPointMatch2D);
+                struct NXPointMatch2D *corr0 = NX_NEW(n, struct NXPointMatch2D);
+                int n_corr0 = nx_sift_match_brute_force(n, keys, desc, n, keys, desc,
+                                                        corr0, 0.8f);
+                int n_corr = nx_sift_match_brute_force_with_cache(n, keys, desc, n, keys, desc,
+                                                                  corr, 0.8f, cache_dir);
+                ASSERT_EQ(n_corr0, n_corr);
+                for (int i = 0; i < n_corr; ++i) {
+                        EXPECT_EQ(corr0[i].id, corr[i].id);
+                        EXPECT_EQ(corr0[i].idp, corr[i].idp);
+                        EXPECT_EQ(corr0[i].match_cost, corr[i].match_cost);
+                }
+
+                nx_free(corr0);
+                nx_free(corr);
+                nx_free(keys);
+                nx_free(desc);
+        }
+
+        nx_free(keys0);
+        nx_free(desc0);
+
+        DIR *d = opendir(dir);
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+                char *path = nx_fstr("%s/%s", dir, e->d_name);
+                unlink(path);
+                nx_free(path);
+        }
+        closedir(d);
+        rmdir(dir);
+}
+
+} // namespace
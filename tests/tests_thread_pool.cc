@@ -0,0 +1,202 @@
+/**
+ * @file tests_thread_pool.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+static void mark_range(void *arg, int begin, int end)
+{
+        std::atomic<int> *counts = (std::atomic<int> *)arg;
+        for (int i = begin; i < end; ++i)
+                counts[i].fetch_add(1);
+}
+
+static void mark_tile(void *arg, int x0, int y0, int x1, int y1)
+{
+        std::atomic<int> *counts = (std::atomic<int> *)arg;
+        for (int y = y0; y < y1; ++y)
+                for (int x = x0; x < x1; ++x)
+                        counts[y * 37 + x].fetch_add(1);
+}
+
+static void increment(void *arg)
+{
+        ((std::atomic<int> *)arg)->fetch_add(1);
+}
+
+struct NestedArgs {
+        struct NXThreadPool *pool;
+        std::atomic<int> *counts;
+};
+
+static void nested_range(void *arg, int begin, int end)
+{
+        NestedArgs *args = (NestedArgs *)arg;
+        for (int i = begin; i < end; ++i)
+                nx_parallel_for(args->pool, i * 100, (i + 1) * 100, 7,
+                                mark_range, args->counts);
+}
+
+static void record_worker_id(void *arg, int begin, int end)
+{
+        int *ids = (int *)arg;
+        for (int i = begin; i < end; ++i)
+                ids[i] = nx_thread_pool_worker_id();
+}
+
+static const int N_WORKER_COUNTS = 3;
+static const int WORKER_COUNTS[N_WORKER_COUNTS] = { 0, 1, 3 };
+
+TEST(NXThreadPool, NWorkers) {
+        for (int k = 0; k < N_WORKER_COUNTS; ++k) {
+                struct NXThreadPool *pool = nx_thread_pool_new(WORKER_COUNTS[k]);
+                EXPECT_EQ(WORKER_COUNTS[k], nx_thread_pool_n_workers(pool));
+                nx_thread_pool_free(pool);
+        }
+}
+
+TEST(NXThreadPool, ParallelForVisitsEachIndexOnce) {
+        const int N = 10007;
+        for (int k = 0; k < N_WORKER_COUNTS; ++k) {
+                struct NXThreadPool *pool = nx_thread_pool_new(WORKER_COUNTS[k]);
+                std::vector<std::atomic<int> > counts(N);
+                for (int i = 0; i < N; ++i)
+                        counts[i] = 0;
+
+                nx_parallel_for(pool, 0, N, 13, mark_range, &counts[0]);
+                for (int i = 0; i < N; ++i)
+                        EXPECT_EQ(1, counts[i].load());
+
+                nx_parallel_for(pool, 5, N, 0, mark_range, &counts[0]);
+                for (int i = 0; i < N; ++i)
+                        EXPECT_EQ(i < 5 ? 1 : 2, counts[i].load());
+
+                nx_thread_pool_free(pool);
+        }
+}
+
+TEST(NXThreadPool, ParallelForEmptyRange) {
+        struct NXThreadPool *pool = nx_thread_pool_new(2);
+        std::atomic<int> count(0);
+        nx_parallel_for(pool, 3, 3, 1, mark_range, &count);
+        nx_parallel_for(pool, 3, 1, 1, mark_range, &count);
+        EXPECT_EQ(0, count.load());
+        nx_thread_pool_free(pool);
+}
+
+TEST(NXThreadPool, ParallelFor2DVisitsEachPixelOnce) {
+        const int W = 37;
+        const int H = 23;
+        for (int k = 0; k < N_WORKER_COUNTS; ++k) {
+                struct NXThreadPool *pool = nx_thread_pool_new(WORKER_COUNTS[k]);
+                std::vector<std::atomic<int> > counts(W * H);
+                for (int i = 0; i < W * H; ++i)
+                        counts[i] = 0;
+
+                nx_parallel_for_2d(pool, W, H, 8, 5, mark_tile, &counts[0]);
+                for (int i = 0; i < W * H; ++i)
+                        EXPECT_EQ(1, counts[i].load());
+
+                nx_thread_pool_free(pool);
+        }
+}
+
+TEST(NXThreadPool, NestedParallelFor) {
+        const int N = 64;
+        for (int k = 0; k < N_WORKER_COUNTS; ++k) {
+                struct NXThreadPool *pool = nx_thread_pool_new(WORKER_COUNTS[k]);
+                std::vector<std::atomic<int> > counts(N * 100);
+                for (int i = 0; i < N * 100; ++i)
+                        counts[i] = 0;
+
+                NestedArgs args;
+                args.pool = pool;
+                args.counts = &counts[0];
+                nx_parallel_for(pool, 0, N, 1, nested_range, &args);
+                for (int i = 0; i < N * 100; ++i)
+                        EXPECT_EQ(1, counts[i].load());
+
+                nx_thread_pool_free(pool);
+        }
+}
+
+TEST(NXThreadPool, TaskGroupWait) {
+        const int N = 1000;
+        for (int k = 0; k < N_WORKER_COUNTS; ++k) {
+                struct NXThreadPool *pool = nx_thread_pool_new(WORKER_COUNTS[k]);
+                std::atomic<int> count(0);
+                struct NXTaskGroup *group = nx_task_group_new(pool);
+                for (int i = 0; i < N; ++i)
+                        nx_task_group_run(group, increment, &count);
+                nx_task_group_wait(group);
+                EXPECT_EQ(N, count.load());
+
+                for (int i = 0; i < N; ++i)
+                        nx_task_group_run(group, increment, &count);
+                nx_task_group_free(group);
+                EXPECT_EQ(2 * N, count.load());
+
+                nx_thread_pool_free(pool);
+        }
+}
+
+TEST(NXThreadPool, WorkerIds) {
+        const int N = 4096;
+        struct NXThreadPool *pool = nx_thread_pool_new(3);
+        std::vector<int> ids(N, -1);
+        nx_parallel_for(pool, 0, N, 1, record_worker_id, &ids[0]);
+        for (int i = 0; i < N; ++i) {
+                EXPECT_LE(0, ids[i]);
+                EXPECT_GE(3, ids[i]);
+        }
+        EXPECT_EQ(0, nx_thread_pool_worker_id());
+        nx_thread_pool_free(pool);
+}
+
+TEST(NXThreadPool, DefaultNWorkers) {
+        nx_thread_pool_set_default_n_workers(2);
+        EXPECT_EQ(2, nx_thread_pool_default_n_workers());
+
+        nx_thread_pool_instance_free();
+        struct NXThreadPool *pool = nx_thread_pool_instance();
+        EXPECT_EQ(2, nx_thread_pool_n_workers(pool));
+        EXPECT_EQ(pool, nx_thread_pool_instance());
+
+        nx_thread_pool_set_default_n_workers(-1);
+        nx_thread_pool_instance_free();
+}
+
+} // namespace
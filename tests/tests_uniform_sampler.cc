@@ -0,0 +1,161 @@
+/**
+ * @file tests_uniform_sampler.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_uniform_sampler.h"
+
+using namespace std;
+
+namespace {
+
+static const int N_SAMPLES = 1000;
+
+static void fill_from_instance(uint32_t *samples)
+{
+        struct NXUniformSampler *sampler = nx_uniform_sampler_instance();
+        for (int i = 0; i < N_SAMPLES; ++i)
+                samples[i] = nx_uniform_sampler_sample32(sampler);
+        nx_uniform_sampler_instance_free();
+}
+
+TEST(NXUniformSampler, StreamIsReproducible) {
+        struct NXUniformSampler *s0 = nx_uniform_sampler_new_stream(42, 3);
+        struct NXUniformSampler *s1 = nx_uniform_sampler_new_stream(42, 3);
+        for (int i = 0; i < N_SAMPLES; ++i)
+                EXPECT_EQ(nx_uniform_sampler_sample32(s0), nx_uniform_sampler_sample32(s1));
+        nx_uniform_sampler_free(s0);
+        nx_uniform_sampler_free(s1);
+}
+
+TEST(NXUniformSampler, StreamsDiffer) {
+        struct NXUniformSampler *s0 = nx_uniform_sampler_new_stream(42, 0);
+        struct NXUniformSampler *s1 = nx_uniform_sampler_new_stream(42, 1);
+        struct NXUniformSampler *s2 = nx_uniform_sampler_new_stream(43, 0);
+        int n_equal01 = 0;
+        int n_equal02 = 0;
+        for (int i = 0; i < N_SAMPLES; ++i) {
+                uint32_t v0 = nx_uniform_sampler_sample32(s0);
+                n_equal01 += v0 == nx_uniform_sampler_sample32(s1);
+                n_equal02 += v0 == nx_uniform_sampler_sample32(s2);
+        }
+        EXPECT_GT(2, n_equal01);
+        EXPECT_GT(2, n_equal02);
+        nx_uniform_sampler_free(s0);
+        nx_uniform_sampler_free(s1);
+        nx_uniform_sampler_free(s2);
+}
+
+TEST(NXUniformSampler, FillS) {
+        struct NXUniformSampler *sampler = nx_uniform_sampler_new_stream(7, 0);
+        vector<float> samples(N_SAMPLES);
+        nx_uniform_sampler_fill_s(sampler, N_SAMPLES, &samples[0]);
+
+        double sum = 0.0;
+        for (int i = 0; i < N_SAMPLES; ++i) {
+                EXPECT_LE(0.0f, samples[i]);
+                EXPECT_GT(1.0f, samples[i]);
+                sum += samples[i];
+        }
+        EXPECT_NEAR(0.5, sum / N_SAMPLES, 0.05);
+        nx_uniform_sampler_free(sampler);
+}
+
+TEST(NXUniformSampler, SampleIndexInRange) {
+        struct NXUniformSampler *sampler = nx_uniform_sampler_new_stream(7, 1);
+        const int RANGE = 5;
+        int counts[RANGE] = { 0 };
+        for (int i = 0; i < N_SAMPLES; ++i) {
+                int id = nx_uniform_sampler_sample_index(sampler, RANGE);
+                ASSERT_LE(0, id);
+                ASSERT_GT(RANGE, id);
+                counts[id]++;
+        }
+        for (int i = 0; i < RANGE; ++i)
+                EXPECT_LT(N_SAMPLES / RANGE / 2, counts[i]);
+        nx_uniform_sampler_free(sampler);
+}
+
+TEST(NXUniformSampler, FillIndexDistinct) {
+        struct NXUniformSampler *sampler = nx_uniform_sampler_new_stream(7, 2);
+        const int SIZES[4] = { 4, 8, 50, 100 };
+        const int RANGE = 100;
+        for (int k = 0; k < 4; ++k) {
+                for (int trial = 0; trial < 20; ++trial) {
+                        vector<int> ids(SIZES[k]);
+                        nx_uniform_sampler_fill_index(sampler, SIZES[k], &ids[0], RANGE);
+                        vector<int> seen(RANGE, 0);
+                        for (int i = 0; i < SIZES[k]; ++i) {
+                                ASSERT_LE(0, ids[i]);
+                                ASSERT_GT(RANGE, ids[i]);
+                                EXPECT_EQ(0, seen[ids[i]]);
+                                seen[ids[i]] = 1;
+                        }
+                }
+        }
+        nx_uniform_sampler_free(sampler);
+}
+
+TEST(NXUniformSampler, InstanceFollowsMasterSeed) {
+        uint32_t a[N_SAMPLES];
+        uint32_t b[N_SAMPLES];
+
+        nx_uniform_sampler_set_seed(1234);
+        fill_from_instance(a);
+        nx_uniform_sampler_set_seed(1234);
+        fill_from_instance(b);
+        EXPECT_EQ(0, memcmp(a, b, sizeof(a)));
+
+        struct NXUniformSampler *s0 = nx_uniform_sampler_new_stream(1234, 0);
+        for (int i = 0; i < N_SAMPLES; ++i)
+                EXPECT_EQ(a[i], nx_uniform_sampler_sample32(s0));
+        nx_uniform_sampler_free(s0);
+}
+
+TEST(NXUniformSampler, ThreadInstancesUseDistinctStreams) {
+        uint32_t a[N_SAMPLES];
+        uint32_t b[N_SAMPLES];
+
+        nx_uniform_sampler_set_seed(99);
+        fill_from_instance(a);
+        std::thread t(fill_from_instance, b);
+        t.join();
+
+        EXPECT_NE(0, memcmp(a, b, sizeof(a)));
+
+        struct NXUniformSampler *s1 = nx_uniform_sampler_new_stream(99, 1);
+        for (int i = 0; i < N_SAMPLES; ++i)
+                EXPECT_EQ(b[i], nx_uniform_sampler_sample32(s1));
+        nx_uniform_sampler_free(s1);
+}
+
+} // namespace
@@ -0,0 +1,114 @@
+/**
+ * @file tests_vmath.cc
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * the VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "virg/nexus/nx_vmath.h"
+
+using namespace std;
+
+namespace {
+
+// Odd length to also run the scalar tails of the array functions
+static const int N_SAMPLES = 100003;
+
+static vector<float> linspace(int n, float lo, float hi)
+{
+        vector<float> x(n);
+        for (int i = 0; i < n; ++i)
+                x[i] = lo + (hi - lo) * i / (n - 1);
+        return x;
+}
+
+TEST(NXVMathTest, exp) {
+        vector<float> x = linspace(N_SAMPLES, NX_VMATH_EXP_LO, NX_VMATH_EXP_HI);
+        vector<float> y(N_SAMPLES);
+        nx_vmath_exp(N_SAMPLES, &y[0], &x[0]);
+        for (int i = 0; i < N_SAMPLES; ++i) {
+                double e = exp((double)x[i]);
+                EXPECT_NEAR(e, y[i], 2.0 * FLT_EPSILON * e) << "x = " << x[i];
+                EXPECT_EQ(nx_vmath_expf(x[i]), y[i]);
+        }
+
+        EXPECT_EQ(0.0f, nx_vmath_expf(NX_VMATH_EXP_LO - 1.0f));
+        EXPECT_EQ(0.0f, nx_vmath_expf(-1000.0f));
+        EXPECT_EQ(1.0f, nx_vmath_expf(0.0f));
+}
+
+TEST(NXVMathTest, atan2) {
+        vector<float> t = linspace(N_SAMPLES, -4.0f, 4.0f);
+        vector<float> y(N_SAMPLES);
+        vector<float> x(N_SAMPLES);
+        for (int i = 0; i < N_SAMPLES; ++i) {
+                float r = 0.01f + 100.0f * (i % 17) / 16.0f;
+                y[i] = r * sinf(t[i]);
+                x[i] = r * cosf(t[i]);
+        }
+        x[0] = 0.0f; y[0] = 0.0f;
+        x[1] = 0.0f; y[1] = 1.0f;
+        x[2] = 0.0f; y[2] = -1.0f;
+        x[3] = -1.0f; y[3] = 0.0f;
+
+        vector<float> theta(N_SAMPLES);
+        nx_vmath_atan2(N_SAMPLES, &theta[0], &y[0], &x[0]);
+        for (int i = 0; i < N_SAMPLES; ++i) {
+                EXPECT_NEAR(atan2((double)y[i], (double)x[i]), theta[i], 2e-6)
+                        << "y = " << y[i] << ", x = " << x[i];
+                EXPECT_EQ(nx_vmath_atan2f(y[i], x[i]), theta[i]);
+        }
+}
+
+TEST(NXVMathTest, sqrt) {
+        vector<float> x = linspace(N_SAMPLES, 0.0f, 1000.0f);
+        vector<float> y(N_SAMPLES);
+        nx_vmath_sqrt(N_SAMPLES, &y[0], &x[0]);
+        for (int i = 0; i < N_SAMPLES; ++i) {
+                EXPECT_EQ(sqrtf(x[i]), y[i]);
+                EXPECT_EQ(nx_vmath_sqrtf(x[i]), y[i]);
+        }
+}
+
+TEST(NXVMathTest, sincos) {
+        vector<float> x = linspace(N_SAMPLES, -8192.0f, 8192.0f);
+        vector<float> s(N_SAMPLES);
+        vector<float> c(N_SAMPLES);
+        nx_vmath_sincos(N_SAMPLES, &s[0], &c[0], &x[0]);
+        for (int i = 0; i < N_SAMPLES; ++i) {
+                EXPECT_NEAR(sin((double)x[i]), s[i], 1e-7) << "x = " << x[i];
+                EXPECT_NEAR(cos((double)x[i]), c[i], 1e-7) << "x = " << x[i];
+                float ss, cs;
+                nx_vmath_sincosf(x[i], &ss, &cs);
+                EXPECT_EQ(ss, s[i]);
+                EXPECT_EQ(cs, c[i]);
+        }
+}
+
+} // namespace
@@ -0,0 +1,242 @@
+/**
+ * @file nx_image_benchmark_main.c
+ *
+ * Copyright (C) 2019,2020 Mustafa Ozuysal. All rights reserved.
+ *
+ * This file is part of the VIRG-Nexus Library
+ *
+ * VIRG-Nexus Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * VIRG-Nexus Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with VIRG-Nexus Library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * @author Mustafa Ozuysal
+ *
+ * Contact mustafaozuysal@iyte.edu.tr for comments and bug reports.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+
+#include "virg/nexus/nx_alloc.h"
+#include "virg/nexus/nx_log.h"
+#include "virg/nexus/nx_options.h"
+#include "virg/nexus/nx_timing.h"
+#include "virg/nexus/nx_uniform_sampler.h"
+#include "virg/nexus/nx_image.h"
+#include "virg/nexus/nx_hash.h"
+#include "virg/nexus/nx_hash_sha256.h"
+
+#define KERNEL_TRUNCATION_FACTOR 4.0f
+
+struct BenchmarkOptions {
+        int width;
+        int height;
+        int n_repeats;
+        float sigma;
+        int box_radius;
+};
+
+struct BenchmarkStats {
+        double t_avg;
+        double t_min;
+        double t_max;
+};
+
+enum BenchmarkOp {
+        BENCHMARK_SMOOTH = 0,
+        BENCHMARK_DOWNSAMPLE,
+        BENCHMARK_DOWNSAMPLE_AA,
+        BENCHMARK_SMOOTH_IIR,
+        BENCHMARK_FILTER_BOX,
+        BENCHMARK_SMOOTH_FIXED,
+        BENCHMARK_DOWNSAMPLE_AA_FIXED,
+        BENCHMARK_HASH3,
+        BENCHMARK_SHA256
+};
+
+static const char *BENCHMARK_OP_NAMES[] = { "smooth", "downsample", "down_aa",
+                                            "smooth_iir", "box", "smooth_fx", "down_aa_fx",
+                                            "hash3", "sha256" };
+
+static void fill_random(struct NXImage *img)
+{
+        for (int y = 0; y < img->height; ++y) {
+                for (int x = 0; x < img->width; ++x) {
+                        float v = NX_UNIFORM_SAMPLE_S;
+                        switch (img->dtype) {
+                        case NX_IMAGE_UCHAR: img->data.uc[y*img->row_stride+x] = (uchar)(v * 255.0f); break;
+                        case NX_IMAGE_FLOAT32: img->data.f32[y*img->row_stride+x] = v; break;
+                        default: NX_FATAL(NX_LOG_TAG, "Unhandled switch case for image data type");
+                        }
+                }
+        }
+}
+
+/* Hashes the pixel rows as separate messages the way the feature cache keys
+ * images. */
+static uint64_t hash_rows(const struct NXImage *img, enum BenchmarkOp op)
+{
+        size_t row_size = (size_t)img->width * nx_image_bytes_per_channel(img->dtype);
+        size_t row_stride = (size_t)img->row_stride * nx_image_bytes_per_channel(img->dtype);
+        const uint8_t **msg = NX_NEW(img->height, const uint8_t *);
+        size_t *lmsg = NX_NEW(img->height, size_t);
+        for (int y = 0; y < img->height; ++y) {
+                msg[y] = (const uint8_t *)img->data.v + y * row_stride;
+                lmsg[y] = row_size;
+        }
+
+        uint64_t h = 0;
+        if (op == BENCHMARK_HASH3) {
+                h = nx_hash3_128_multi(img->height, msg, lmsg, 0).lo;
+        } else {
+                uint8_t sha[32];
+                nx_sha256_multi(&sha[0], img->height, msg, lmsg);
+                memcpy(&h, &sha[0], sizeof(h));
+        }
+
+        nx_free(lmsg);
+        nx_free(msg);
+        return h;
+}
+
+static struct BenchmarkStats run_op(const struct BenchmarkOptions *bopt,
+                                    enum BenchmarkOp op,
+                                    enum NXImageDataType dtype,
+                                    int row_stride)
+{
+        struct NXImage *img = nx_image_alloc();
+        nx_image_resize(img, bopt->width, bopt->height, row_stride,
+                        NX_IMAGE_GRAYSCALE, dtype);
+        fill_random(img);
+
+        struct NXImage *res = nx_image_alloc();
+        struct NXImage *tmp = nx_image_alloc();
+        int nkx, nky;
+        float *buffer = nx_image_filter_buffer_alloc(img->width, img->height,
+                                                     bopt->sigma, bopt->sigma,
+                                                     KERNEL_TRUNCATION_FACTOR,
+                                                     &nkx, &nky);
+
+        struct BenchmarkStats stats;
+        stats.t_avg = 0.0;
+        stats.t_min = DBL_MAX;
+        stats.t_max = 0.0;
+        for (int i = 0; i < bopt->n_repeats; ++i) {
+                struct NXTimer timer;
+                nx_timer_start(&timer);
+                switch (op) {
+                case BENCHMARK_SMOOTH:
+                        nx_image_smooth(img, img, bopt->sigma, bopt->sigma,
+                                        KERNEL_TRUNCATION_FACTOR, buffer);
+                        break;
+                case BENCHMARK_DOWNSAMPLE:
+                        nx_image_downsample(res, img);
+                        break;
+                case BENCHMARK_DOWNSAMPLE_AA:
+                        nx_image_downsample_aa_x(tmp, img);
+                        nx_image_downsample_aa_y(res, tmp);
+                        break;
+                case BENCHMARK_SMOOTH_IIR:
+                        nx_image_smooth_iir(img, img, bopt->sigma, bopt->sigma,
+                                            KERNEL_TRUNCATION_FACTOR);
+                        break;
+                case BENCHMARK_FILTER_BOX:
+                        nx_image_filter_box(res, img, bopt->box_radius, bopt->box_radius);
+                        break;
+                case BENCHMARK_SMOOTH_FIXED:
+                        nx_image_smooth_fixed(img, img, bopt->sigma, bopt->sigma,
+                                              KERNEL_TRUNCATION_FACTOR);
+                        break;
+                case BENCHMARK_DOWNSAMPLE_AA_FIXED:
+                        nx_image_downsample_aa_fixed(res, img);
+                        break;
+                case BENCHMARK_HASH3:
+                case BENCHMARK_SHA256:
+                        hash_rows(img, op);
+                        break;
+                default:
+                        NX_FATAL(NX_LOG_TAG, "Unhandled switch case for benchmark operation");
+                }
+                nx_timer_stop(&timer);
+
+                double t = nx_timer_measure_in_msec(&timer);
+                stats.t_avg += t;
+                if (t < stats.t_min) stats.t_min = t;
+                if (t > stats.t_max) stats.t_max = t;
+        }
+        stats.t_avg /= bopt->n_repeats;
+
+        nx_free(buffer);
+        nx_image_free(tmp);
+        nx_image_free(res);
+        nx_image_free(img);
+
+        return stats;
+}
+
+int main(int argc, char **argv)
+{
+        struct NXOptions *opt = nx_options_new("iiidib",
+                                               "--width", "image width", 3840,
+                                               "--height", "image height", 2160,
+                                               "-n|--n-repeats", "number of repetitions per operation", 20,
+                                               "--sigma", "smoothing scale", 1.6,
+                                               "--box-radius", "box filter radius", 5,
+                                               "-v|--verbose", "log more information to stderr", NX_FALSE);
+        nx_options_add_help(opt);
+        nx_options_set_usage_header(opt, "Times image filtering, resampling and content hashing with tight and padded row layouts.\n\n");
+        nx_options_set_usage_footer(opt, "\nCopyright (C) 2019,2020 Mustafa Ozuysal.\n");
+        nx_options_set_from_args(opt, argc, argv);
+
+        struct BenchmarkOptions bopt;
+        bopt.width = nx_options_get_int(opt, "--width");
+        bopt.height = nx_options_get_int(opt, "--height");
+        bopt.n_repeats = nx_options_get_int(opt, "-n");
+        bopt.sigma = (float)nx_options_get_double(opt, "--sigma");
+        bopt.box_radius = nx_options_get_int(opt, "--box-radius");
+
+        if (nx_options_get_bool(opt, "-v")) {
+                nx_log_verbosity(NX_LOG_INFORMATIVE);
+                nx_options_print_values(opt, stderr);
+        }
+
+        if (bopt.width <= 0 || bopt.height <= 0 || bopt.n_repeats <= 0 || bopt.box_radius < 0)
+                NX_FATAL(NX_LOG_TAG, "Image size and number of repetitions must be positive and box radius non-negative!");
+
+        printf(" operation,  dtype, layout, width, height,    t_avg,    t_min,    t_max\n");
+        const enum NXImageDataType dtypes[] = { NX_IMAGE_UCHAR, NX_IMAGE_FLOAT32 };
+        const char *dtype_names[] = { "uchar", "float" };
+        const int strides[] = { NX_IMAGE_STRIDE_DEFAULT, NX_IMAGE_STRIDE_PADDED };
+        const char *stride_names[] = { "tight", "padded" };
+        for (int op = BENCHMARK_SMOOTH; op <= BENCHMARK_SHA256; ++op) {
+                for (int d = 0; d < 2; ++d) {
+                        // The fixed-point filters only handle uchar images
+                        if ((op == BENCHMARK_SMOOTH_FIXED || op == BENCHMARK_DOWNSAMPLE_AA_FIXED)
+                            && dtypes[d] != NX_IMAGE_UCHAR)
+                                continue;
+                        for (int s = 0; s < 2; ++s) {
+                                struct BenchmarkStats stats = run_op(&bopt, op, dtypes[d], strides[s]);
+                                printf("%10s,%7s,%7s,%6d,%7d,%9.3f,%9.3f,%9.3f\n",
+                                       BENCHMARK_OP_NAMES[op], dtype_names[d],
+                                       stride_names[s], bopt.width, bopt.height,
+                                       stats.t_avg, stats.t_min, stats.t_max);
+                        }
+                }
+        }
+
+        nx_options_free(opt);
+        nx_uniform_sampler_instance_free();
+
+        return EXIT_SUCCESS;
+}